@@ -0,0 +1,213 @@
+#pragma once
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <deque>
+#include <tuple>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+#include "texture.h"
+
+// 异步资源加载
+// 图像解码、网格解析与网格的bvh构建互不依赖，原来在主线程上依次完成，启动时间是所有资源的加载时间之和。
+// 加载器用一组工作线程按提交顺序执行加载任务，提交后立即返回句柄，需要结果时再等待：
+// - 句柄对应的任务还没有开始时，等待的线程直接执行它，而不是空等（任务中等待其它任务也不会死锁）
+// - 纹理通过async_texture延迟解析，材质可以在图像解码完成前创建（见resource_manager::get_texture_async）
+// - 网格在加载任务中展开并构建bvh，由hittable_list在构建场景bvh前收集（见add_async）
+
+using std::shared_ptr;
+using std::make_shared;
+
+
+// 一个加载任务，由工作线程或等待结果的线程执行，只执行一次
+class asset_job {
+private:
+	std::function<void()> work;
+	std::atomic<bool> started{ false };
+
+public:
+	explicit asset_job(std::function<void()> work_init) : work(std::move(work_init)) {}
+
+	// 任务还没有开始时在当前线程执行，返回是否执行了任务
+	bool try_run() {
+		if (started.exchange(true)) return false;
+		bool outer = running_asset_job;
+		running_asset_job = true;
+		work();
+		running_asset_job = outer;
+		work = nullptr;
+		return true;
+	}
+};
+
+
+// 加载任务的结果
+template <typename T>
+class asset_handle {
+private:
+	shared_ptr<asset_job> job;
+	std::shared_future<T> result;
+
+public:
+	asset_handle() {}
+	asset_handle(shared_ptr<asset_job> job_init, std::shared_future<T> result_init) : job(std::move(job_init)), result(std::move(result_init)) {}
+
+	bool valid() const {
+		return result.valid();
+	}
+
+	bool ready() const {
+		return result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	// 等待并返回结果，任务还没有开始时在当前线程执行
+	const T& get() const {
+		job->try_run();
+		return result.get();
+	}
+};
+
+
+class asset_loader {
+private:
+	std::deque<shared_ptr<asset_job>> jobs;
+	std::vector<std::thread> workers;
+	std::mutex loader_mutex;
+	std::condition_variable job_available;
+	bool stopping = false;
+
+	void work() {
+		while (true) {
+			shared_ptr<asset_job> job;
+			{
+				std::unique_lock<std::mutex> lock(loader_mutex);
+				job_available.wait(lock, [this] { return stopping or not jobs.empty(); });
+				if (jobs.empty()) return;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			job->try_run();
+		}
+	}
+
+public:
+	// 工作线程数，为0时使用硬件线程数。在第一次提交任务时创建工作线程
+	int thread_num = 0;
+
+	asset_loader() {}
+	asset_loader(const asset_loader&) = delete;
+	asset_loader& operator=(const asset_loader&) = delete;
+
+	~asset_loader() {
+		{
+			std::lock_guard<std::mutex> lock(loader_mutex);
+			stopping = true;
+		}
+		job_available.notify_all();
+		for (std::thread& t : workers) t.join();
+	}
+
+	// 提交一个加载任务，load()的返回值通过句柄取得
+	template <typename function_type>
+	auto submit(function_type load) -> asset_handle<std::invoke_result_t<function_type>> {
+		using result_type = std::invoke_result_t<function_type>;
+		auto task = make_shared<std::packaged_task<result_type()>>(std::move(load));
+		auto job = make_shared<asset_job>([task] { (*task)(); });
+		asset_handle<result_type> handle(job, task->get_future().share());
+		{
+			std::lock_guard<std::mutex> lock(loader_mutex);
+			if (workers.empty()) {
+				int num = thread_num > 0 ? thread_num : std::max(1u, std::thread::hardware_concurrency());
+				for (int i = 0; i < num; i++) workers.emplace_back(&asset_loader::work, this);
+			}
+			jobs.push_back(std::move(job));
+		}
+		job_available.notify_one();
+		return handle;
+	}
+};
+
+// 场景资源的加载器
+asset_loader scene_assets;
+
+
+namespace asset_detail {
+	// 加载任务保存构造参数的副本，字符串（文件名）复制为std::string，调用时再取c_str()
+	template <typename T>
+	std::decay_t<T> store_arg(const T& value) { return value; }
+	inline std::string store_arg(const char* value) { return value; }
+	inline std::string store_arg(const std::string& value) { return value; }
+
+	template <typename T>
+	const T& pass_arg(const T& value) { return value; }
+	inline const char* pass_arg(const std::string& value) { return value.c_str(); }
+
+	// 在加载器中构造resource_type，参数按值保存
+	template <typename resource_type, typename base_type, typename... arg_types>
+	asset_handle<shared_ptr<base_type>> submit_construct(asset_loader& loader, const arg_types&... args) {
+		auto params = std::make_tuple(store_arg(args)...);
+		return loader.submit([params]() -> shared_ptr<base_type> {
+			return std::apply([](const auto&... stored) { return make_shared<resource_type>(pass_arg(stored)...); }, params);
+		});
+	}
+}
+
+
+// 加载中的纹理
+// 在第一次被访问时等待加载完成，之后只多一次间接调用
+class async_texture final : public texture {
+private:
+	asset_handle<shared_ptr<texture>> handle;
+	mutable std::atomic<const texture*> loaded_texture{ nullptr };
+
+	const texture& target() const {
+		const texture* tex = loaded_texture.load(std::memory_order_acquire);
+		if (tex == nullptr) {
+			tex = handle.get().get();
+			loaded_texture.store(tex, std::memory_order_release);
+		}
+		return *tex;
+	}
+
+public:
+	explicit async_texture(asset_handle<shared_ptr<texture>> handle_init) : handle(std::move(handle_init)) {}
+
+	// 等待加载完成
+	void wait() const {
+		target();
+	}
+
+	bool loaded() const override {
+		return loaded_texture.load(std::memory_order_acquire) != nullptr or handle.ready();
+	}
+
+	vec3 get_value(const vec3 &uv) const override {
+		return target().get_value(uv);
+	}
+
+	double get_alpha(const vec3 &uv) const override {
+		return target().get_alpha(uv);
+	}
+
+	void get_rgba(const vec3 &uv, double footprint, vec3 &color, double &alpha) const override {
+		target().get_rgba(uv, footprint, color, alpha);
+	}
+
+	size_t memory_size() const override {
+		return target().memory_size();
+	}
+
+	void alpha_range(const vec3 &uv_min, const vec3 &uv_max, double &alpha_min, double &alpha_max) const override {
+		target().alpha_range(uv_min, uv_max, alpha_min, alpha_max);
+	}
+};
+
+#endif
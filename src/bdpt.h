@@ -0,0 +1,488 @@
+#pragma once
+#ifndef BDPT_H
+#define BDPT_H
+
+#include <vector>
+#include <iostream>
+#include "global.h"
+#include "hittable.h"
+#include "material.h"
+#include "light.h"
+#include "camera.h"
+#include "film.h"
+
+using std::vector;
+
+
+// 路径顶点
+struct path_vertex {
+	enum vertex_type { camera_vertex, light_vertex, surface_vertex };
+
+	vertex_type type = surface_vertex;
+	vec3 p; // 与其他顶点连接的位置（次表面散射材质为采样得到的入射点）
+	vec3 n; // p处法线
+	vec3 p_hit; // 光线击中的位置
+	vec3 n_hit; // 击中位置的法线，与w_prev位于同一侧
+	vec3 w_prev; // 指向路径上前一个顶点的方向
+	vec3 beta; // 从路径起点到该顶点的吞吐量
+	double pdf_fwd = 0; // 沿路径生成方向得到该顶点的pdf（面积）
+	double pdf_rev = 0; // 沿相反方向得到该顶点的pdf（面积）
+	bool delta = false; // 采样方向为delta分布的顶点（见material::is_delta），不能参与连接
+	bool front = true;
+	shading_context ctx; // 击中点的纹理输入
+	const material* mat_ptr = nullptr;
+};
+
+
+// 相机子路径上的光线击中光源
+// 光源不是场景中的几何体，不会遮挡光线，所以只记录下来，相机子路径从原来的击中点继续
+struct light_hit {
+	int t; // 光源顶点在相机子路径中的位置，即策略(0, t)
+	path_vertex v; // 光源上的顶点，beta为击中光源时的吞吐量
+	vec3 radiance;
+};
+
+
+// 双向路径追踪
+// 参考 Veach 1997 / PBRT 16.3
+// 每个样本分别从相机和光源出发生成一条子路径，然后对所有(s, t)组合进行连接，使用power heuristic进行多重重要性采样
+// s为光源子路径的顶点数，t为相机子路径的顶点数
+// 相机子路径的光线穿过光源时记录一个 s = 0 的策略，与其它策略一起计算权重
+// 材质自发光也作为 s = 0 的策略，只有这一种策略可以得到，权重为1
+class bdpt_integrator {
+public:
+	shared_ptr<hittable> world;
+	vector<shared_ptr<light>> light_ptr_list;
+	camera cam;
+	int image_width;
+	int image_height;
+	int max_depth;
+
+private:
+	point3 camera_origin;
+	vec3 camera_forward;
+	double focal_length2; // 焦距的平方
+	double film_area; // 所有像素的总面积
+
+public:
+	bdpt_integrator(shared_ptr<hittable> world_init, const vector<shared_ptr<light>>& light_ptr_list_init, const camera& cam_init,
+		int image_width_init, int image_height_init, int max_depth_init)
+		: world(world_init), light_ptr_list(light_ptr_list_init), cam(cam_init) {
+		image_width = image_width_init;
+		image_height = image_height_init;
+		max_depth = max_depth_init;
+
+		camera_origin = cam.get_origin();
+		camera_forward = cam.get_forward();
+		focal_length2 = cam.get_focal_length() * cam.get_focal_length();
+		// 与render_bvh一致，u = (i + rand) / (width - 1)
+		double pixel_area = cam.get_screen_area() / ((image_width - 1) * (image_height - 1));
+		film_area = pixel_area * image_width * image_height;
+	}
+
+	// 对像素(i, j)采样一次
+	// 返回相机子路径的贡献，光源子路径直接连接到相机（t = 1）的贡献写入target
+	vec3 sample_pixel(int i, int j, film& target) const {
+		vector<path_vertex> camera_path;
+		vector<path_vertex> light_path;
+		camera_path.reserve(max_depth + 1);
+		light_path.reserve(max_depth + 1);
+		vector<light_hit> light_hits;
+		generate_camera_path(i, j, camera_path, light_hits);
+		if (not light_ptr_list.empty()) generate_light_path(light_path);
+
+		vec3 L(0, 0, 0);
+		int camera_num = static_cast<int>(camera_path.size());
+		int light_num = static_cast<int>(light_path.size());
+		for (int t = 1; t <= camera_num; t++) {
+			for (int s = 0; s <= light_num; s++) {
+				int depth = s + t - 2;
+				if ((s == 1 and t == 1) or depth < 0 or depth > max_depth) continue;
+
+				if (t == 1) {
+					int pixel_index;
+					vec3 c = connect_to_camera(light_path, camera_path, s, pixel_index);
+					if (c.length_squared() > 0) target.splat(pixel_index, c);
+				}
+				else {
+					L += connect(light_path, camera_path, s, t);
+				}
+			}
+		}
+
+		// 相机子路径击中光源
+		for (const light_hit& h : light_hits) {
+			L += h.v.beta * h.radiance * mis_weight(light_path, camera_path, h.v, h.v, 0, h.t);
+		}
+
+		return L;
+	}
+
+private:
+	// 生成相机子路径
+	void generate_camera_path(int i, int j, vector<path_vertex>& path, vector<light_hit>& light_hits) const {
+		double u = (i + random_double()) / (image_width - 1);
+		double v = (j + random_double()) / (image_height - 1);
+		ray r = cam.get_ray(u, v);
+
+		path_vertex camera_v;
+		camera_v.type = path_vertex::camera_vertex;
+		camera_v.p = camera_v.p_hit = camera_origin;
+		camera_v.n = camera_v.n_hit = camera_forward;
+		camera_v.beta = vec3(1, 1, 1);
+		path.push_back(camera_v);
+
+		// We * cos / pdf = 1
+		random_walk(r, vec3(1, 1, 1), camera_pdf_dir(r.dir), path, &light_hits);
+	}
+
+	// 生成光源子路径
+	void generate_light_path(vector<path_vertex>& path) const {
+		path_vertex light_v = sample_light_vertex();
+		path.push_back(light_v);
+
+		// 在光源法线方向的半球上cos-weighted采样出射方向
+		double rand1 = random_double();
+		double rand2 = random_double();
+		double theta = acos(sqrt(1 - rand1));
+		double phi = pi2 * rand2;
+		vec3 b1, b2;
+		build_basis(light_v.n, b1, b2);
+		vec3 dir = light_v.n * cos(theta) + b1 * sin(phi) * sin(theta) + b2 * cos(phi) * sin(theta);
+
+		// cos / pdf = pi
+		random_walk(ray(light_v.p, dir), light_v.beta * pi, cos(theta) * pi_inv, path, nullptr);
+	}
+
+	// 均匀选择一个光源并在上面采样一个点
+	path_vertex sample_light_vertex() const {
+		int light_num = static_cast<int>(light_ptr_list.size());
+		int light_index = std::min(static_cast<int>(random_double() * light_num), light_num - 1);
+
+		vec3 position_light, radiance_light, normal_light;
+		double pdf_light = light_ptr_list[light_index]->sample_p(position_light, radiance_light, normal_light);
+
+		path_vertex v;
+		v.type = path_vertex::light_vertex;
+		v.p = v.p_hit = position_light;
+		v.n = v.n_hit = normal_light;
+		v.pdf_fwd = pdf_light / light_num;
+		v.beta = radiance_light / v.pdf_fwd;
+		return v;
+	}
+
+	// 随机游走，顶点追加到path末尾
+	// beta为下一个顶点的吞吐量，pdf_dir为上一个顶点采样出射方向的pdf（立体角）
+	// light_hits不为空时（相机子路径）记录光线击中的光源
+	void random_walk(ray r, vec3 beta, double pdf_dir, vector<path_vertex>& path, vector<light_hit>* light_hits) const {
+		bool camera_side = path.front().type == path_vertex::camera_vertex;
+		while (static_cast<int>(path.size()) <= max_depth) {
+			hit_record rec;
+			bool hit_surface = world->hit(r, 0.00000001, infinity, rec);
+			// 与visible一致，与光源重合的几何体不遮挡光源
+			if (light_hits) record_light_hits(r, hit_surface ? rec.t * (1 + 1e-6) : infinity, beta, pdf_dir, path, *light_hits);
+			if (not hit_surface) break;
+
+			shading_context ctx = make_shading_context(*rec.mat_ptr(), rec, r);
+
+			// 透明部分直接穿过，与ray_color一致
+			if (not rec.alpha_resolved and random_double() > ctx.alpha) {
+				r = ray(rec.p, r.dir, r.med);
+				continue;
+			}
+
+			const path_vertex& prev = path.back();
+			path_vertex v;
+			v.type = path_vertex::surface_vertex;
+			v.p_hit = rec.p;
+			v.n_hit = unit_vector(rec.normal);
+			v.w_prev = unit_vector(-r.dir);
+			v.beta = beta;
+			v.front = rec.front_face;
+			v.ctx = ctx;
+			v.mat_ptr = rec.mat_ptr();
+			v.delta = rec.mat_ptr()->is_delta();
+			v.pdf_fwd = prev.delta ? 0 : pdf_dir * abs(dot(v.n_hit, v.w_prev)) / (v.p_hit - prev.p).length_squared();
+
+			// 采样入射点（只有次表面散射材质会改变位置）
+			double pdf_p;
+			tie(pdf_p, v.n, v.p) = rec.mat_ptr()->sample_positioni(v.n_hit, v.p_hit, *world);
+			if (dot(v.n, v.n_hit) < 0) v.n = -v.n;
+			path.push_back(v);
+			if (static_cast<int>(path.size()) > max_depth) break;
+
+			// 采样下一个方向
+			double pdf_w;
+			vec3 wi;
+			bool wi_front;
+			tie(pdf_w, wi, wi_front) = rec.mat_ptr()->sample_wi(v.w_prev, v.n, v.front, v.ctx);
+
+			path_vertex& prev_vertex = path[path.size() - 2];
+			if (v.delta) {
+				// 与ray_color相同，折射时pdf与cos同为负值，相除后为正
+				vec3 f = rec.mat_ptr()->bsdf(v.w_prev, v.n_hit, v.p_hit, v.front, v.ctx, wi, v.n, v.p, wi_front);
+				beta = clamp(beta * f * dot(v.n, wi) / (pdf_w * pdf_p), 0, infinity);
+				pdf_dir = 0;
+				prev_vertex.pdf_rev = 0;
+			}
+			else {
+				// 吞吐量使用pdf_wi，与多重重要性采样权重中的pdf一致
+				// 光源子路径上光从w_prev射来，使用bsdf的伴随形式（见eval_f）
+				pdf_dir = rec.mat_ptr()->pdf_wi(v.w_prev, v.n, v.front, v.ctx, wi, wi_front);
+				if (pdf_dir <= 0) break;
+				beta = clamp(beta * eval_f(v, wi, camera_side) * abs(dot(v.n, wi)) / (pdf_dir * pdf_p), 0, infinity);
+
+				// 计算前一个顶点的反向pdf
+				double pdf_rev_w = rec.mat_ptr()->pdf_wi(wi, side_normal(v, wi_front), wi_front, v.ctx, v.w_prev, v.front);
+				prev_vertex.pdf_rev = to_area(pdf_rev_w, v.p_hit, prev_vertex);
+			}
+			if (beta.length_squared() == 0) break;
+
+			r = ray(v.p, wi);
+		}
+	}
+
+	// 记录从path最后一个顶点出发的光线在t_max之前击中的光源
+	// beta为光线的吞吐量，pdf_dir为最后一个顶点采样该方向的pdf（立体角）
+	void record_light_hits(const ray& r, double t_max, const vec3& beta, double pdf_dir, const vector<path_vertex>& path, vector<light_hit>& light_hits) const {
+		const path_vertex& prev = path.back();
+		int light_num = static_cast<int>(light_ptr_list.size());
+		for (const shared_ptr<light>& light_ptr : light_ptr_list) {
+			double t, pdf_light;
+			light_hit h;
+			if (not light_ptr->hit(r, t_max, t, h.radiance, h.v.n, pdf_light)) continue;
+			h.t = static_cast<int>(path.size()) + 1;
+			h.v.type = path_vertex::light_vertex;
+			h.v.p = h.v.p_hit = r.at(t);
+			h.v.n_hit = h.v.n;
+			h.v.w_prev = unit_vector(-r.dir);
+			h.v.beta = beta;
+			h.v.pdf_fwd = prev.delta ? 0 : to_area(pdf_dir, prev.p, h.v);
+			h.v.pdf_rev = pdf_light / light_num; // 在光源上采样到该点的pdf
+			light_hits.push_back(h);
+		}
+	}
+
+	// 连接光源子路径的前s个顶点与相机子路径的前t个顶点（t >= 2）
+	vec3 connect(const vector<path_vertex>& light_path, const vector<path_vertex>& camera_path, int s, int t) const {
+		const path_vertex& pt = camera_path[t - 1];
+
+		// 击中自发光材质
+		if (s == 0) return pt.beta * pt.mat_ptr->get_radiance(pt.ctx);
+		if (pt.delta) return vec3(0, 0, 0);
+
+		// s = 1 时重新采样光源，相当于路径追踪中的直接光采样
+		path_vertex sampled;
+		if (s == 1) {
+			if (light_ptr_list.empty()) return vec3(0, 0, 0);
+			sampled = sample_light_vertex();
+		}
+		const path_vertex& ps = s == 1 ? sampled : light_path[s - 1];
+		if (ps.delta) return vec3(0, 0, 0);
+
+		vec3 d = ps.p - pt.p;
+		double distance2 = d.length_squared();
+		vec3 dir = d / sqrt(distance2);
+
+		vec3 f_t = eval_f(pt, dir, true);
+		vec3 f_s;
+		if (s == 1) {
+			f_s = dot(ps.n, -dir) > 0 ? vec3(1, 1, 1) : vec3(0, 0, 0);
+		}
+		else {
+			f_s = eval_f(ps, -dir, false);
+		}
+		double G = abs(dot(pt.n, dir)) * abs(dot(ps.n, dir)) / distance2;
+
+		vec3 c = pt.beta * f_t * ps.beta * f_s * G;
+		if (c.length_squared() == 0) return c;
+		if (not visible(pt.p, ps.p)) return vec3(0, 0, 0);
+
+		return c * mis_weight(light_path, camera_path, ps, pt, s, t);
+	}
+
+	// 将光源子路径的第s个顶点连接到相机（t = 1）
+	// 返回需要累加到pixel_index像素上的值
+	vec3 connect_to_camera(const vector<path_vertex>& light_path, const vector<path_vertex>& camera_path, int s, int& pixel_index) const {
+		const path_vertex& ps = light_path[s - 1];
+		if (ps.delta) return vec3(0, 0, 0);
+
+		double u, v;
+		point3 screen_point;
+		int i, j;
+		if (not cam.project(ps.p, u, v, screen_point) or not to_pixel(u, v, i, j)) return vec3(0, 0, 0);
+
+		vec3 d = camera_origin - ps.p;
+		double distance2 = d.length_squared();
+		vec3 dir = d / sqrt(distance2);
+		double cos_theta = dot(-dir, camera_forward);
+
+		// 小孔相机的importance：We = f^2 / (A * cos^4)
+		double We = focal_length2 / (film_area * pow(cos_theta, 4));
+		vec3 c = ps.beta * eval_f(ps, dir, false) * We * abs(dot(ps.n, dir)) * cos_theta / distance2;
+		if (c.length_squared() == 0) return c;
+
+		// 相机光线从屏幕出发，所以只检查到屏幕之间的遮挡
+		if (not visible(ps.p, screen_point)) return vec3(0, 0, 0);
+
+		pixel_index = (image_height - 1 - j) * image_width + i;
+
+		return c * mis_weight(light_path, camera_path, ps, camera_path[0], s, 1);
+	}
+
+	// 多重重要性采样权重（power heuristic）
+	// ps为光源子路径的最后一个顶点（s = 1 时为重新采样的光源顶点），pt为相机子路径的最后一个顶点（s = 0 时为击中的光源顶点）
+	double mis_weight(const vector<path_vertex>& light_path, const vector<path_vertex>& camera_path, const path_vertex& ps, const path_vertex& pt, int s, int t) const {
+		if (s + t == 2) return 1;
+
+		vector<double> light_fwd(s), light_rev(s), camera_fwd(t), camera_rev(t);
+		vector<bool> light_delta(s), camera_delta(t);
+		for (int i = 0; i < s; i++) {
+			const path_vertex& v = i == s - 1 ? ps : light_path[i];
+			light_fwd[i] = v.pdf_fwd;
+			light_rev[i] = v.pdf_rev;
+			light_delta[i] = v.delta;
+		}
+		for (int i = 0; i < t; i++) {
+			const path_vertex& v = i == t - 1 ? pt : camera_path[i];
+			camera_fwd[i] = v.pdf_fwd;
+			camera_rev[i] = v.pdf_rev;
+			camera_delta[i] = v.delta;
+		}
+
+		// 连接处附近的反向pdf需要根据连接重新计算
+		const path_vertex* pt_minus = t > 1 ? &camera_path[t - 2] : nullptr;
+		if (s == 0) {
+			// 击中的光源顶点的反向pdf为在光源上采样到该点的pdf，前一个顶点的反向pdf由光源发射方向的pdf得到
+			camera_rev[t - 2] = pdf(pt, nullptr, *pt_minus);
+		}
+		else {
+			const path_vertex* ps_minus = s > 1 ? &light_path[s - 2] : nullptr;
+			camera_rev[t - 1] = pdf(ps, ps_minus, pt);
+			if (pt_minus) camera_rev[t - 2] = pdf(pt, &ps, *pt_minus);
+			light_rev[s - 1] = pdf(pt, pt_minus, ps);
+			if (ps_minus) light_rev[s - 2] = pdf(ps, &pt, *ps_minus);
+		}
+
+		auto remap0 = [](double f) { return f != 0 ? f : 1.0; };
+
+		// 向相机方向移动连接点
+		double sum_ri = 0;
+		double ri = 1;
+		for (int i = t - 1; i > 0; i--) {
+			double ratio = remap0(camera_rev[i]) / remap0(camera_fwd[i]);
+			ri *= ratio * ratio;
+			if (not camera_delta[i] and not camera_delta[i - 1]) sum_ri += ri;
+		}
+
+		// 向光源方向移动连接点
+		// i = 0对应光线击中光源的策略（s = 0），相机子路径的最后一段不追踪，所以深度达到max_depth时不存在
+		ri = 1;
+		for (int i = s - 1; i >= 0; i--) {
+			double ratio = remap0(light_rev[i]) / remap0(light_fwd[i]);
+			ri *= ratio * ratio;
+			if (i == 0 and s + t - 2 >= max_depth) break;
+			if (not light_delta[i] and (i == 0 or not light_delta[i - 1])) sum_ri += ri;
+		}
+
+		return 1 / (1 + sum_ri);
+	}
+
+	// 从顶点v（前一个顶点为prev）采样到next的pdf（面积）
+	double pdf(const path_vertex& v, const path_vertex* prev, const path_vertex& next) const {
+		vec3 dir = unit_vector(next.p - v.p);
+		double pdf_w;
+		if (v.type == path_vertex::camera_vertex) {
+			pdf_w = camera_pdf_dir(dir);
+		}
+		else if (v.type == path_vertex::light_vertex) {
+			pdf_w = std::max(0.0, dot(v.n, dir)) * pi_inv;
+		}
+		else {
+			vec3 to_prev = unit_vector(prev->p - v.p);
+			bool prev_front = side(v, to_prev);
+			pdf_w = v.mat_ptr->pdf_wi(to_prev, side_normal(v, prev_front), prev_front, v.ctx, dir, side(v, dir));
+		}
+		return to_area(pdf_w, v.p, next);
+	}
+
+	// 将立体角pdf转换为next处的面积pdf
+	double to_area(double pdf_w, const vec3& from, const path_vertex& next) const {
+		vec3 d = next.p - from;
+		double distance2 = d.length_squared();
+		if (distance2 == 0) return 0;
+		if (next.type == path_vertex::camera_vertex) return pdf_w / distance2;
+		return pdf_w * abs(dot(next.n, d)) / (distance2 * sqrt(distance2));
+	}
+
+	// 相机采样方向dir的pdf（立体角）
+	double camera_pdf_dir(const vec3& dir) const {
+		double cos_theta = dot(unit_vector(dir), camera_forward);
+		if (cos_theta <= 0) return 0;
+		double u, v;
+		point3 screen_point;
+		int i, j;
+		if (not cam.project(camera_origin + dir, u, v, screen_point) or not to_pixel(u, v, i, j)) return 0;
+		return focal_length2 / (film_area * pow(cos_theta, 3));
+	}
+
+	// 屏幕坐标转换为像素坐标，超出胶片范围时返回false
+	// 与render_bvh一致，u = (i + rand) / (width - 1)，所以u的范围是[0, width / (width - 1))
+	bool to_pixel(double u, double v, int& i, int& j) const {
+		double x = u * (image_width - 1);
+		double y = v * (image_height - 1);
+		if (x < 0 or y < 0 or x >= image_width or y >= image_height) return false;
+		i = static_cast<int>(x);
+		j = static_cast<int>(y);
+		return true;
+	}
+
+	// 方向dir在顶点v的哪一侧，与front的含义相同
+	bool side(const path_vertex& v, const vec3& dir) const {
+		return dot(dir, v.n) > 0 ? v.front : not v.front;
+	}
+
+	// 顶点v处朝向front一侧的法线
+	vec3 side_normal(const path_vertex& v, bool front) const {
+		return front == v.front ? v.n : -v.n;
+	}
+
+	// 计算顶点v处的bsdf，dir为连接方向
+	// 相机子路径上w_prev为出射方向；光源子路径上光从w_prev射来，dir为出射方向（伴随bsdf，折射时不对称）
+	// dir与w_prev不在同一侧时，只有能采样到透射方向（pdf_wi不为0）的材质才有贡献
+	vec3 eval_f(const path_vertex& v, const vec3& dir, bool camera_side) const {
+		bool dir_front = side(v, dir);
+		if (dir_front != v.front and v.mat_ptr->pdf_wi(v.w_prev, v.n, v.front, v.ctx, dir, dir_front) <= 0) return vec3(0, 0, 0);
+		if (camera_side) return v.mat_ptr->bsdf(v.w_prev, v.n_hit, v.p_hit, v.front, v.ctx, dir, v.n, v.p, dir_front);
+		return v.mat_ptr->bsdf(dir, side_normal(v, dir_front), v.p, dir_front, v.ctx, v.w_prev, v.n_hit, v.p_hit, v.front);
+	}
+
+	// 检查a与b之间是否有遮挡
+	bool visible(const vec3& a, const vec3& b) const {
+		vec3 d = b - a;
+		double distance = d.length();
+		hit_record rec;
+		return not (world->hit(ray(a, d / distance), 0.000001, infinity, rec) and rec.t < distance * (1 - 1e-6));
+	}
+};
+
+
+// 使用双向路径追踪渲染
+// 参数与render_bvh相同，结果写入target，渲染完成后调用film::develop写入framebuffer
+void render_bdpt(int image_height, int image_width, int samples_per_pixel, int max_depth,
+	shared_ptr<hittable> bvh_root, camera cam, film* target, vector<shared_ptr<light>> light_ptr_list, int step, int bias)
+{
+	bdpt_integrator integrator(bvh_root, light_ptr_list, cam, image_width, image_height, max_depth);
+	for (int j = image_height - 1; j >= 0; --j) {
+		std::cerr << "\rScanlines remaining: " << j << ' ' << std::flush; // 进度显示
+		for (int i = bias; i < image_width; i += step) {
+			color pixel_color(0, 0, 0);
+			for (int s = 0; s < samples_per_pixel; ++s) {
+				pixel_color += clamp(integrator.sample_pixel(i, j, *target), 0, 1);
+			}
+			target->add_sample((image_height - 1 - j) * image_width + i, pixel_color);
+		}
+	}
+}
+
+#endif
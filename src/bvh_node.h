@@ -1,99 +1,199 @@
-#pragma once
-#ifndef BVH_NODE_H
-#define BVH_NODE_H
-
-#include "hittable.h"
-#include "hittable_list.h"
-#include "bounds.h"
-#include "global.h"
-
-
-class bvh_node : public hittable {
-public:
-	// ܽڵ
-	static int node_num;
-	// ӽڵָ
-	shared_ptr<hittable> left, right;
-	// Χ
-	bounds3 box;
-
-public:
-	bvh_node() {};
-
-	// hittableָбʼbvh_node
-	// objectsֱhittable_listͬԱ
-	// startend˸bvh_nodeҪobjectsΧ(end)Ӹڵ㵽ҶӽΧ𽥱С
-	bvh_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end) {
-		node_num++;
-		
-		// ȷҪָ
-		int axis = random_int_012();
-
-		// ӦͼԪȽ
-		comparator_t comparator = box_x_compare;
-		switch (axis) {
-		case 0: comparator = box_x_compare; break;
-		case 1: comparator = box_y_compare; break;
-		case 2: comparator = box_z_compare; break;
-		}
-
-		// ǰbvh_nodeаobject
-		size_t object_span = end - start;
-
-		// ʼӽڵ
-		if (object_span == 1) { // nodeֻһobjectӽڵΪͬobject
-			left = right = objects[start];
-		}
-		else if (object_span == 2) { // nodeֻobjectֱ䵽ӽڵ
-			if (comparator(objects[start], objects[start + 1])) {
-				left = objects[start];
-				right = objects[start + 1];
-			}
-			else {
-				left = objects[start + 1];
-				right = objects[start];
-			}
-		}
-		else { // nodeжobject򴴽bvh_nodeΪӽڵ
-
-			// ԷΧڵobject
-			std::sort(objects.begin() + start, objects.begin() + end, comparator);
-
-			// Χٷֳɲֱ֣𴴽ӽڵ
-			size_t mid = start + object_span / 2;
-			left = make_shared<bvh_node>(objects, start, mid);
-			right = make_shared<bvh_node>(objects, mid, end);
-		}
-
-		// ýڵboundsӽڵboundsĲ
-		box = Union(left->bounds(), right->bounds());
-	}
-
-	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override {
-		// nodeboundsûн㣬ֱӷfalse
-		if (not box.hit(r, t_min, t_max))
-			return false;
-
-		// Ƿӽڵн
-		bool hit_left = left->hit(r, t_min, t_max, rec);
-		// Ƿӽڵн㣬ʱ޶tҪӽڵС
-		bool hit_right = right->hit(r, t_min, hit_left ? rec.t : t_max, rec);
-
-		return hit_left or hit_right;
-	}
-
-	virtual bounds3 bounds() const override {
-		return box;
-	}
-};
-
-int bvh_node::node_num = 0;
-
-// bvhظڵ
-shared_ptr<hittable> generate_bvh(hittable_list &list) {
-	shared_ptr<hittable> root = make_shared<bvh_node>(list.objects, 0, list.objects.size());
-	return root;
-}
-
-
+#pragma once
+#ifndef BVH_NODE_H
+#define BVH_NODE_H
+
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include "hittable.h"
+#include "hittable_list.h"
+#include "bounds.h"
+#include "global.h"
+#include "material.h"
+
+
+class bvh_node : public hittable {
+public:
+	// 总节点个数（网格的bvh在加载线程中构建）
+	static std::atomic<int> node_num;
+	// 子节点指针
+	shared_ptr<hittable> left, right;
+	// 包围盒
+	bounds3 box;
+	// 所有object的材质相同时为该材质，否则为空
+	material* shared_material = nullptr;
+
+public:
+	bvh_node() {};
+
+	// 根据hittable指针列表初始化bvh_node
+	// 这里的objects可以直接输入hittable_list的同名成员变量
+	// start和end给出了该bvh_node需要包含的objects索引范围(不包含end)，从根节点到叶子结点这个范围逐渐变小
+	bvh_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end) {
+		node_num++;
+		
+		// 确定需要分割的坐标轴
+		int axis = random_int_012();
+
+		// 分配对应的图元比较器用于排序
+		comparator_t comparator = box_x_compare;
+		switch (axis) {
+		case 0: comparator = box_x_compare; break;
+		case 1: comparator = box_y_compare; break;
+		case 2: comparator = box_z_compare; break;
+		}
+
+		// 当前bvh_node中包含的object个数
+		size_t object_span = end - start;
+
+		// 开始构建子节点
+		if (object_span == 1) { // 该node中只有一个object，子节点为相同的object
+			left = right = objects[start];
+		}
+		else if (object_span == 2) { // 该node中只有两个object，分别分配到左右子节点
+			if (comparator(objects[start], objects[start + 1])) {
+				left = objects[start];
+				right = objects[start + 1];
+			}
+			else {
+				left = objects[start + 1];
+				right = objects[start];
+			}
+		}
+		else { // 该node中有多于两个object，则创建两个bvh_node作为子节点
+
+			// 对范围内的object进行排序
+			std::sort(objects.begin() + start, objects.begin() + end, comparator);
+
+			// 将范围再分成部分，分别创建左右子节点
+			size_t mid = start + object_span / 2;
+			left = make_shared<bvh_node>(objects, start, mid);
+			right = make_shared<bvh_node>(objects, mid, end);
+		}
+
+		// 该节点的bounds是左右子节点bounds的并
+		box = Union(left->bounds(), right->bounds());
+		material* left_material = left->get_material();
+		if (left_material == right->get_material()) shared_material = left_material;
+	}
+
+	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override {
+		// 如果该node的bounds与光线没有交点，直接返回false
+		if (not box.hit(r, t_min, t_max))
+			return false;
+
+		// 检查是否与左子节点有交点
+		bool hit_left = left->hit(r, t_min, t_max, rec);
+		// 只有一个object时左右子节点相同，不再重复求交（随机alpha测试会重新抽样，使不透明度偏高）
+		if (right == left) return hit_left;
+		// 检查是否与右子节点有交点，此时限定t必须要比左子节点小
+		bool hit_right = right->hit(r, t_min, hit_left ? rec.t : t_max, rec);
+
+		return hit_left or hit_right;
+	}
+
+	virtual void hit_all(const ray& r, double t_min, double t_max, std::vector<hit_record>& recs) const override {
+		if (not box.hit(r, t_min, t_max))
+			return;
+
+		left->hit_all(r, t_min, t_max, recs);
+		// 只有一个object时左右子节点相同
+		if (right != left) right->hit_all(r, t_min, t_max, recs);
+	}
+
+	virtual bounds3 bounds() const override {
+		return box;
+	}
+
+	virtual material* get_material() const override {
+		return shared_material;
+	}
+};
+
+std::atomic<int> bvh_node::node_num{ 0 };
+
+// 生成推迟的不透明度微图（见triangle::omm_pending），会等待纹理加载完成
+inline void build_pending_micromaps(const std::vector<shared_ptr<hittable>>& objects) {
+	for (const shared_ptr<hittable>& object : objects) {
+		triangle* triangle_ptr = dynamic_cast<triangle*>(object.get());
+		if (triangle_ptr and triangle_ptr->omm_pending) triangle_ptr->build_opacity_micromap();
+	}
+}
+
+// 生成bvh，并返回根节点
+// 先等待加载中的物体（见add_async），并为直接加入的三角形生成推迟的微图
+shared_ptr<hittable> generate_bvh(hittable_list &list) {
+	list.wait_pending();
+	build_pending_micromaps(list.objects);
+	shared_ptr<hittable> root = make_shared<bvh_node>(list.objects, 0, list.objects.size());
+	return root;
+}
+
+// 异步加载网格，在加载线程中展开并构建bvh，主线程可以继续提交其它资源
+// 整个网格构建一棵bvh，作为场景bvh中的一个物体。网格只使用一种材质时，get_material返回该材质（见shared_material）
+// 结果在generate_bvh时加入list
+// 多个网格的任务同时运行，它们共用的场景状态都可以并发访问：材质表（scene_materials）、图元编号、bvh节点计数与资源管理器
+// 纹理还在加载的三角形的不透明度微图由之后的另一个任务生成，网格的展开与bvh构建不等待图像解码
+inline void add_async(hittable_list& list, shared_ptr<mesh_triangle> mesh_ptr) {
+	auto finish_micromaps = make_shared<std::function<void()>>();
+	auto mesh_handle = scene_assets.submit([mesh_ptr, finish_micromaps]() {
+		std::vector<shared_ptr<hittable>> objects;
+		if (load_mesh_snapshot(*mesh_ptr, objects)) {
+			*finish_micromaps = [objects]() { build_pending_micromaps(objects); };
+			return objects;
+		}
+
+		// 能直接生成三角形数据的网格不创建triangle对象（见make_flat_mesh）
+		std::vector<triangle_data> faces;
+		shared_ptr<material> faces_mat_ptr;
+		if (mesh_ptr->unpack_faces(faces, faces_mat_ptr)) {
+			shared_ptr<hittable> flat_mesh = make_flat_mesh(std::move(faces), faces_mat_ptr, *finish_micromaps);
+			if (flat_mesh) objects.push_back(flat_mesh);
+			return objects;
+		}
+
+		std::vector<shared_ptr<hittable>> triangles;
+		auto pending_triangles = make_shared<std::vector<shared_ptr<hittable>>>();
+		for (shared_ptr<triangle>& triangle_ptr : mesh_ptr->unpack()) {
+			triangles.push_back(triangle_ptr);
+			if (triangle_ptr->omm_pending) pending_triangles->push_back(triangle_ptr);
+		}
+		if (not pending_triangles->empty()) *finish_micromaps = [pending_triangles]() { build_pending_micromaps(*pending_triangles); };
+		if (triangles.size() == 1) objects.push_back(triangles[0]);
+		else if (triangles.size() > 1) objects.push_back(make_shared<bvh_node>(triangles, 0, triangles.size()));
+		return objects;
+	});
+	list.add(mesh_handle);
+	list.add(scene_assets.submit([mesh_handle, finish_micromaps]() {
+		mesh_handle.get();
+		if (*finish_micromaps) (*finish_micromaps)();
+		return std::vector<shared_ptr<hittable>>();
+	}));
+}
+
+// 把使用sss材质的物体按材质分组
+// 使用多种材质的网格是一个get_material为空的bvh_node，递归到材质相同的子树（或单个三角形）
+inline void collect_sss_objects(const shared_ptr<hittable>& object, std::unordered_map<sss_material*, std::vector<shared_ptr<hittable>>>& objects_by_material) {
+	material* mat_ptr = object->get_material();
+	if (mat_ptr) {
+		if (mat_ptr->get_material_number() == 3) objects_by_material[static_cast<sss_material*>(mat_ptr)].push_back(object);
+		return;
+	}
+	const bvh_node* node = dynamic_cast<const bvh_node*>(object.get());
+	if (node == nullptr) return;
+	collect_sss_objects(node->left, objects_by_material);
+	if (node->right != node->left) collect_sss_objects(node->right, objects_by_material);
+}
+
+// 为次表面散射材质生成投影采样用的局部bvh
+// 每个sss材质的bvh只包含使用该材质的物体，投影时不会与场景中其他物体求交
+void generate_sss_probes(const hittable_list& list) {
+	std::unordered_map<sss_material*, std::vector<shared_ptr<hittable>>> objects_by_material;
+	for (const shared_ptr<hittable>& object : list.objects) collect_sss_objects(object, objects_by_material);
+	for (auto& item : objects_by_material) {
+		item.first->probe_root = make_shared<bvh_node>(item.second, 0, item.second.size());
+	}
+}
+
+
 #endif
\ No newline at end of file
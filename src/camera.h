@@ -1,41 +1,88 @@
-#pragma once
-#ifndef CAMERA_H
-#define CAMERA_H
-
-#include "global.h"
-
-class camera {
-
-private:
-	point3 origin;
-	point3 lower_left_corner;
-	vec3 horizontal;
-	vec3 vertical;
-
-
-public:
-	camera(double aspect_ratio = 16.0 / 9.0) {
-		//auto aspect_ratio = 16.0 / 9.0; //  / ߶
-		auto viewport_height = 2.0;
-		auto viewport_width = aspect_ratio * viewport_height;
-		auto focal_length = 2.5;
-
-		origin = point3(0, 0, 0.5);
-		horizontal = vec3(viewport_width, 0.0, 0.0);
-		vertical = vec3(0.0, viewport_height, 0.0);
-		lower_left_corner = origin - horizontal / 2 - vertical / 2 - vec3(0, 0, focal_length);
-	}
-
-	// Ļɹ
-	// uvȡֵΧΪ[0, 1] ^ 2
-	ray get_ray(double u, double v) const {
-		vec3 dir = lower_left_corner + u * horizontal + v * vertical - origin;
-		dir = unit_vector(dir); //λ
-		//return ray(origin, dir);
-		ray ret = ray(lower_left_corner + u * horizontal + v * vertical, dir); // ĻϵĵΪߵ
-		if (isnan(ret.orig[0])) std::cout << "nan ray orig id = 5";
-		return ret;
-		
-	}
-};
+#pragma once
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include "global.h"
+
+class camera {
+
+private:
+	point3 origin;
+	point3 lower_left_corner;
+	vec3 horizontal;
+	vec3 vertical;
+	double pixel_spread = 0; // 一个像素对应的张角，用于光锥。为0时相机光线不带光锥
+
+public:
+	shared_ptr<medium> medium_ptr = nullptr; // 相机所在的介质，例如充满雾的室内，为空时视为真空
+
+public:
+	camera(double aspect_ratio = 16.0 / 9.0) {
+		//auto aspect_ratio = 16.0 / 9.0; // 宽度 / 高度
+		auto viewport_height = 2.0;
+		auto viewport_width = aspect_ratio * viewport_height;
+		auto focal_length = 2.5;
+
+		origin = point3(0, 0, 0.5);
+		horizontal = vec3(viewport_width, 0.0, 0.0);
+		vertical = vec3(0.0, viewport_height, 0.0);
+		lower_left_corner = origin - horizontal / 2 - vertical / 2 - vec3(0, 0, focal_length);
+	}
+
+	// 根据屏幕坐标生成光线
+	// uv取值范围为[0, 1] ^ 2
+	ray get_ray(double u, double v) const {
+		vec3 dir = lower_left_corner + u * horizontal + v * vertical - origin;
+		dir = unit_vector(dir); //方向单位化
+		//return ray(origin, dir);
+		ray ret = ray(lower_left_corner + u * horizontal + v * vertical, dir, medium_ptr.get()); // 屏幕上的点作为光线的起点
+		// 光锥的顶点在小孔处，起点处的宽度为一个像素
+		ret.cone_spread = pixel_spread;
+		ret.cone_width = pixel_spread * (ret.orig - origin).length();
+		if (std::isnan(ret.orig[0])) std::cout << "nan ray orig id = 5";
+		return ret;
+		
+	}
+
+	// 设置图像分辨率，用于计算光锥的扩散角
+	// 与render_bvh一致，相邻像素的屏幕坐标相差1 / (height - 1)
+	void set_image_size(int image_width, int image_height) {
+		pixel_spread = vertical.length() / (std::max(image_height - 1, 1) * get_focal_length());
+	}
+
+	// 获取相机位置（小孔）
+	point3 get_origin() const {
+		return origin;
+	}
+
+	// 相机朝向（屏幕中心方向）
+	vec3 get_forward() const {
+		return unit_vector(lower_left_corner + horizontal / 2 + vertical / 2 - origin);
+	}
+
+	// 小孔到屏幕的距离
+	double get_focal_length() const {
+		return (lower_left_corner + horizontal / 2 + vertical / 2 - origin).length();
+	}
+
+	// 屏幕面积
+	double get_screen_area() const {
+		return horizontal.length() * vertical.length();
+	}
+
+	// 将空间中的点投影到屏幕所在平面上，得到屏幕坐标uv以及平面上对应的点
+	// 点在相机后方时返回false，uv是否在屏幕范围内由调用者判断
+	bool project(const point3& p, double& u, double& v, point3& screen_point) const {
+		vec3 forward = get_forward();
+		vec3 dir = p - origin;
+		double cos_theta = dot(dir, forward);
+		if (cos_theta <= 0) return false;
+
+		screen_point = origin + dir * (get_focal_length() / cos_theta);
+		vec3 offset = screen_point - lower_left_corner;
+		u = dot(offset, horizontal) / horizontal.length_squared();
+		v = dot(offset, vertical) / vertical.length_squared();
+		return true;
+	}
+};
 #endif
\ No newline at end of file
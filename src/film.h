@@ -0,0 +1,56 @@
+#pragma once
+#ifndef FILM_H
+#define FILM_H
+
+#include <vector>
+#include <atomic>
+#include "global.h"
+#include "color.h"
+
+using std::vector;
+
+
+// 胶片
+// 支持两种写入方式：
+// 1. add_sample：写入相机路径的结果，每个像素只由一个线程负责，不需要同步
+// 2. splat：写入光线追踪到的任意像素（例如双向路径追踪中的光源路径），使用原子操作，多个线程可以同时写入
+class film {
+public:
+	int width, height;
+	// 相机路径累加值
+	vector<vec3> pixels;
+	// splat累加值，每个像素三个通道
+	vector<std::atomic<double>> splats;
+
+public:
+	film(int width_init, int height_init) : width(width_init), height(height_init), pixels(width_init * height_init, vec3(0, 0, 0)), splats(3 * width_init * height_init) {
+		for (std::atomic<double>& s : splats) s.store(0, std::memory_order_relaxed);
+	}
+
+	// 写入一个相机路径样本
+	void add_sample(int index, const vec3& c) {
+		pixels[index] += c;
+	}
+
+	// 向任意像素累加，线程安全
+	void splat(int index, const vec3& c) {
+		for (int k = 0; k < 3; k++) {
+			if (c[k] == 0) continue;
+			std::atomic<double>& target = splats[3 * index + k];
+			double old_value = target.load(std::memory_order_relaxed);
+			while (not target.compare_exchange_weak(old_value, old_value + c[k], std::memory_order_relaxed));
+		}
+	}
+
+	// 将结果写入framebuffer
+	// 相机样本和splat都除以每像素采样数
+	void develop(vector<vec3>* framebuffer, int samples_per_pixel, double splat_scale = 1) const {
+		for (int index = 0; index < width * height; index++) {
+			vec3 splat_value(splats[3 * index].load(), splats[3 * index + 1].load(), splats[3 * index + 2].load());
+			vec3 c = pixels[index] + splat_value * splat_scale;
+			write_color_to_framebuffer(framebuffer, clamp(c, 0, infinity), samples_per_pixel, index);
+		}
+	}
+};
+
+#endif
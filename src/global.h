@@ -1,107 +1,124 @@
-#pragma once
-#ifndef GLOBAL_H
-#define GLOBAL_H
-
-#include <cmath>
-#include <limits>
-#include <memory>
-#include <thread>
-#include <random>
-
-// Usings
-
-using std::shared_ptr;
-using std::make_shared;
-using std::sqrt;
-
-// Constants
-
-const double infinity = std::numeric_limits<double>::infinity();
-const double pi = 3.1415926535897932385;
-const double pi2 = 6.283185307179586476925286766559;
-const double pi_inv = 0.3183098861837907;
-const double pi2_inv = 0.1591549430918953357;
-
-// Utility Functions
-
-inline double degrees_to_radians(double degrees) {
-	return degrees * pi / 180.0;
-}
-
-// Random
-std::default_random_engine e1;
-std::uniform_real_distribution<double> u1(0.0, 1.0);
-inline double random_double() {
-	return u1(e1);
-}
-
-inline double random_double(double min, double max) {
-	// Returns a random real in [min,max).
-	return min + (max - min)*random_double();
-}
-
-std::default_random_engine e2;
-std::uniform_int_distribution<unsigned> u2(0, 2);
-inline int random_int_012() {
-	return u2(e2);
-}
-
-// Clamp
-
-inline double clamp(double x, double min, double max) {
-	if (x < min) return min;
-	if (x > max) return max;
-	return x;
-}
-
-// disney brdf functions
-
-double sqr(double x) { return x * x; }
-
-double SchlickFresnel(double u) {
-    double m = clamp(1 - u, 0, 1);
-    double m2 = m * m;
-    return m2 * m2 * m; // pow(m,5)
-}
-
-double GTR1(double NdotH, double a) {
-    if (a >= 1) return 1 / pi;
-    double a2 = a * a;
-    double t = 1 + (a2 - 1) * NdotH * NdotH;
-    return (a2 - 1) / (pi * log(a2) * t);
-}
-
-double GTR2(double NdotH, double a) {
-    double a2 = a * a;
-    double t = 1 + (a2 - 1) * NdotH * NdotH;
-    return a2 / (pi * t * t);
-}
-
-double GTR2_aniso(double NdotH, double HdotX, double HdotY, double ax, double ay) {
-    return 1 / (pi * ax * ay * sqr(sqr(HdotX / ax) + sqr(HdotY / ay) + NdotH * NdotH));
-}
-
-double smithG_GGX(double NdotV, double alphaG) {
-    double a = alphaG * alphaG;
-    double b = NdotV * NdotV;
-    return 1 / (NdotV + sqrt(a + b - a * b));
-}
-
-double smithG_GGX_aniso(double NdotV, double VdotX, double VdotY, double ax, double ay) {
-    return 1.0 / (NdotV + sqrt(sqr(VdotX * ax) + sqr(VdotY * ay) + sqr(NdotV)));
-}
-
-
-
-
-// Common Headers
-
-#include "ray.h"
-#include "vec3.h"
-
-
-// Test
-//#define test_mode
-bool sample_light_flag;
-
+#pragma once
+#ifndef GLOBAL_H
+#define GLOBAL_H
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <random>
+
+// Usings
+
+using std::shared_ptr;
+using std::make_shared;
+using std::sqrt;
+
+// Constants
+
+const double infinity = std::numeric_limits<double>::infinity();
+const double pi = 3.1415926535897932385;
+const double pi2 = 6.283185307179586476925286766559;
+const double pi_inv = 0.3183098861837907;
+const double pi2_inv = 0.1591549430918953357;
+
+// Utility Functions
+
+inline double degrees_to_radians(double degrees) {
+	return degrees * pi / 180.0;
+}
+
+// Random
+
+// 采样器
+// 渲染器中的随机数都通过random_double获取
+// 当前线程设置了采样器时，random_double从采样器中取值，例如PSSMLT中的主样本空间采样器
+class sampler {
+public:
+	virtual double next_1d() = 0;
+};
+
+// 当前线程使用的采样器，为空指针时使用默认随机数引擎
+thread_local sampler* current_sampler = nullptr;
+
+// 当前线程是否在执行加载任务（见asset_loader.h）。加载任务之间已经并行，任务内部不再创建线程
+thread_local bool running_asset_job = false;
+
+std::default_random_engine e1;
+std::uniform_real_distribution<double> u1(0.0, 1.0);
+inline double random_double() {
+	if (current_sampler) return current_sampler->next_1d();
+	return u1(e1);
+}
+
+inline double random_double(double min, double max) {
+	// Returns a random real in [min,max).
+	return min + (max - min)*random_double();
+}
+
+// 用于bvh构建时选择分割轴，网格的bvh在加载线程中构建，每个线程使用自己的随机数引擎
+thread_local std::default_random_engine e2;
+thread_local std::uniform_int_distribution<unsigned> u2(0, 2);
+inline int random_int_012() {
+	return u2(e2);
+}
+
+// Clamp
+
+inline double clamp(double x, double min, double max) {
+	if (x < min) return min;
+	if (x > max) return max;
+	return x;
+}
+
+// disney brdf functions
+
+double sqr(double x) { return x * x; }
+
+double SchlickFresnel(double u) {
+    double m = clamp(1 - u, 0, 1);
+    double m2 = m * m;
+    return m2 * m2 * m; // pow(m,5)
+}
+
+double GTR1(double NdotH, double a) {
+    if (a >= 1) return 1 / pi;
+    double a2 = a * a;
+    double t = 1 + (a2 - 1) * NdotH * NdotH;
+    return (a2 - 1) / (pi * log(a2) * t);
+}
+
+double GTR2(double NdotH, double a) {
+    double a2 = a * a;
+    double t = 1 + (a2 - 1) * NdotH * NdotH;
+    return a2 / (pi * t * t);
+}
+
+double GTR2_aniso(double NdotH, double HdotX, double HdotY, double ax, double ay) {
+    return 1 / (pi * ax * ay * sqr(sqr(HdotX / ax) + sqr(HdotY / ay) + NdotH * NdotH));
+}
+
+double smithG_GGX(double NdotV, double alphaG) {
+    double a = alphaG * alphaG;
+    double b = NdotV * NdotV;
+    return 1 / (NdotV + sqrt(a + b - a * b));
+}
+
+double smithG_GGX_aniso(double NdotV, double VdotX, double VdotY, double ax, double ay) {
+    return 1.0 / (NdotV + sqrt(sqr(VdotX * ax) + sqr(VdotY * ay) + sqr(NdotV)));
+}
+
+
+
+
+// Common Headers
+
+#include "ray.h"
+#include "vec3.h"
+
+
+// Test
+//#define test_mode
+bool sample_light_flag;
+
 #endif
\ No newline at end of file
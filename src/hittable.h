@@ -1,33 +1,137 @@
-#pragma once
-#ifndef HITTABLE_H
-#define HITTABLE_H
-
-#include "ray.h"
-#include "bounds.h"
-
-class material;
-
-struct hit_record {
-	vec3 p;
-	vec3 normal;
-	shared_ptr<material> mat_ptr;
-	double t;
-	bool front_face;
-	vec3 uv;
-
-	// Զ÷ߣʹ͹λͬһ
-	inline void set_face_normal(const ray& r, const vec3& outward_normal) {
-		front_face = dot(r.direction(), outward_normal) < 0;
-		normal = front_face ? outward_normal : -outward_normal;
-	}
-};
-
-
-// Ļ
-class hittable {
-public:
-	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const = 0;
-	virtual bounds3 bounds() const = 0;
-};
-
+#pragma once
+#ifndef HITTABLE_H
+#define HITTABLE_H
+
+#include <vector>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <iostream>
+#include <unordered_map>
+#include "ray.h"
+#include "bounds.h"
+
+class material;
+
+
+// 场景材质表
+// 材质由表持有，物体与hit_record中只记录32位的材质编号，着色时通过编号取得非持有指针
+// 这样求交和着色的热路径上不再有shared_ptr的拷贝（引用计数的原子操作会在多线程之间争用）
+// 编号0保留给空材质
+// 网格在加载线程中构造时会同时调用add与get，所以材质存放在固定大小的块中，加入新材质不会移动已有的元素，get不需要加锁
+class material_table {
+private:
+	static constexpr uint32_t chunk_size = 1024;
+	static constexpr uint32_t max_chunk_num = 4096; // 最多约420万个材质
+
+	struct chunk {
+		shared_ptr<material> materials[chunk_size];
+	};
+
+	std::atomic<chunk*> chunks[max_chunk_num] = {};
+	std::atomic<uint32_t> material_num{ 1 };
+	std::unordered_map<const material*, uint32_t> ids;
+	std::mutex table_mutex;
+
+public:
+	material_table() {
+		chunks[0].store(new chunk, std::memory_order_release);
+	}
+
+	material_table(const material_table&) = delete;
+	material_table& operator=(const material_table&) = delete;
+
+	~material_table() {
+		for (std::atomic<chunk*>& c : chunks) delete c.load();
+	}
+
+	// 加入材质并返回编号，同一个材质只会加入一次
+	uint32_t add(const shared_ptr<material>& mat_ptr) {
+		if (not mat_ptr) return 0;
+		std::lock_guard<std::mutex> lock(table_mutex);
+		auto itr = ids.find(mat_ptr.get());
+		if (itr != ids.end()) return itr->second;
+		uint32_t id = material_num.load(std::memory_order_relaxed);
+		if (id / chunk_size >= max_chunk_num) {
+			std::cout << "error in hittable.h: material_table::add(): too many materials\n";
+			exit(-1);
+		}
+		chunk* c = chunks[id / chunk_size].load(std::memory_order_relaxed);
+		if (c == nullptr) {
+			c = new chunk;
+			chunks[id / chunk_size].store(c, std::memory_order_release);
+		}
+		c->materials[id % chunk_size] = mat_ptr;
+		ids[mat_ptr.get()] = id;
+		material_num.store(id + 1, std::memory_order_release);
+		return id;
+	}
+
+	material* get(uint32_t id) const {
+		return chunks[id / chunk_size].load(std::memory_order_acquire)->materials[id % chunk_size].get();
+	}
+
+	size_t size() const {
+		return material_num.load(std::memory_order_acquire);
+	}
+};
+
+material_table scene_materials;
+
+
+// 分配图元编号，每个几何图元（球、三角形等）构造时获取一个
+// count大于1时分配连续的count个编号并返回第一个
+inline uint32_t new_primitive_id(uint32_t count = 1) {
+	static std::atomic<uint32_t> primitive_count{ 0 };
+	return primitive_count.fetch_add(count);
+}
+
+
+struct hit_record {
+	vec3 p;
+	vec3 normal;
+	uint32_t mat_id = 0; // 材质编号
+	uint32_t prim_id = 0; // 图元编号
+	double t;
+	bool front_face;
+	vec3 uv;
+	vec3 tangent; // 切线，用于法线贴图。不支持法线贴图的图元为0
+	double uv_density = 0; // 单位长度对应的uv长度，sqrt(uv面积 / 表面积)，用于纹理LOD。不支持uv的图元为0
+	bool alpha_resolved = false; // 求交时已经完成alpha测试（见opacity_micromap.h），着色时不再随机穿透
+
+	// 击中点的材质（非持有指针）
+	material* mat_ptr() const {
+		return scene_materials.get(mat_id);
+	}
+
+	// 自动设置法线，使得它和光线位于同一个半球
+	inline void set_face_normal(const ray& r, const vec3& outward_normal) {
+		front_face = dot(r.direction(), outward_normal) < 0;
+		normal = front_face ? outward_normal : -outward_normal;
+	}
+};
+
+
+// 所有物体的基类
+class hittable {
+public:
+	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const = 0;
+	virtual bounds3 bounds() const = 0;
+
+	// 获取光线在(t_min, t_max)范围内与物体的所有交点，追加到recs中，不保证顺序
+	// 默认实现从最近的交点开始逐个向后查找，容器类（bvh等）在一次遍历中收集所有子物体的交点
+	virtual void hit_all(const ray& r, double t_min, double t_max, std::vector<hit_record>& recs) const {
+		hit_record rec;
+		while (hit(r, t_min, t_max, rec)) {
+			recs.push_back(rec);
+			t_min = rec.t + 0.000001;
+		}
+	}
+
+	// 物体的材质，容器类返回空指针
+	virtual material* get_material() const {
+		return nullptr;
+	}
+};
+
 #endif
\ No newline at end of file
@@ -1,102 +1,151 @@
-#pragma once
-#ifndef HITTABLE_LIST_H
-#define HITTABLE_LIST_H
-
-#include "hittable.h"
-
-#include <memory>
-#include <vector>
-#include <algorithm>
-#include "mesh_triangle.h"
-
-using std::shared_ptr;
-using std::make_shared;
-
-// bvh_nodeʱҪʹõıȽϺ
-inline bool box_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b, int axis) {
-	bounds3 box_a = a->bounds();
-	bounds3 box_b = b->bounds();
-
-	return box_a.pMin[axis] < box_b.pMin[axis];
-}
-
-bool box_x_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
-	return box_compare(a, b, 0);
-}
-
-bool box_y_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
-	return box_compare(a, b, 1);
-}
-
-bool box_z_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
-	return box_compare(a, b, 2);
-}
-
-// comparator_tһָ룬һ
-typedef bool(*comparator_t)(const shared_ptr<hittable>, const shared_ptr<hittable>);
-
-
-// hittableб
-class hittable_list : public hittable {
-public:
-	// objectָvector
-	std::vector<shared_ptr<hittable>> objects;
-
-public:
-	hittable_list() {}
-	hittable_list(shared_ptr<hittable> object) { add(object); }
-
-	void clear() { objects.clear(); }
-
-	// һhittableobject
-	void add(shared_ptr<hittable> object) { 
-		objects.push_back(object);
-	}
-
-
-	// һmesh_triangle
-	void add(shared_ptr<mesh_triangle> mesh_ptr) {
-		vector<shared_ptr<triangle>> triangle_ptr_list = mesh_ptr->unpack();
-		// бhittable_list
-		for (shared_ptr<hittable> triangle_ptr : triangle_ptr_list) {
-			add(triangle_ptr);
-		}
-	}
-
-
-	// ȡhittable_listĽ
-	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override {
-		hit_record temp_rec;
-		bool hit_anything = false;
-		auto closest_so_far = t_max;
-
-		for (const auto& object : objects) {
-			if (object->hit(r, t_min, closest_so_far, temp_rec)) {
-				hit_anything = true;
-				// ͨt_maxΪǰtҵСt
-				closest_so_far = temp_rec.t;
-				rec = temp_rec;
-			}
-		}
-
-		return hit_anything;
-	}
-
-	virtual bounds3 bounds() const override {
-		bounds3 box = objects[0]->bounds();
-		int len = objects.size();
-
-	    // ӵڶԪؿʼϺϲΧ
-		bounds3 box_tmp;
-		for (int i = 1; i < len; i++) {
-			box_tmp = objects[i]->bounds();
-			box = Union(box, box_tmp);
-		}
-
-		return box;
-	}
-};
-
-
-
+#pragma once
+#ifndef HITTABLE_LIST_H
+#define HITTABLE_LIST_H
+
+#include "hittable.h"
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include "mesh_triangle.h"
+#include "scene_snapshot.h"
+#include "asset_loader.h"
+
+using std::shared_ptr;
+using std::make_shared;
+
+// 构建bvh_node时需要使用的比较函数
+inline bool box_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b, int axis) {
+	bounds3 box_a = a->bounds();
+	bounds3 box_b = b->bounds();
+
+	return box_a.pMin[axis] < box_b.pMin[axis];
+}
+
+bool box_x_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
+	return box_compare(a, b, 0);
+}
+
+bool box_y_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
+	return box_compare(a, b, 1);
+}
+
+bool box_z_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
+	return box_compare(a, b, 2);
+}
+
+// 定义comparator_t，这是一个函数指针，可以是上面三个函数中任意一个
+typedef bool(*comparator_t)(const shared_ptr<hittable>, const shared_ptr<hittable>);
+
+
+// 存放hittable对象的列表
+class hittable_list : public hittable {
+public:
+	// 所有object的指针存放在vector中
+	std::vector<shared_ptr<hittable>> objects;
+	// 加载中的物体（见add_async），构建bvh前由wait_pending加入objects
+	std::vector<asset_handle<std::vector<shared_ptr<hittable>>>> pending;
+
+public:
+	hittable_list() {}
+	hittable_list(shared_ptr<hittable> object) { add(object); }
+
+	void clear() { objects.clear(); pending.clear(); }
+
+	// 增加一个hittable类型object
+	void add(shared_ptr<hittable> object) { 
+		objects.push_back(object);
+	}
+
+
+	// 增加一个mesh_triangle
+	// 优先使用网格快照（见scene_snapshot.h），快照中的每个物体包含网格中使用同一材质的所有三角形
+	void add(shared_ptr<mesh_triangle> mesh_ptr) {
+		vector<shared_ptr<hittable>> snapshot_objects;
+		if (load_mesh_snapshot(*mesh_ptr, snapshot_objects)) {
+			for (shared_ptr<hittable>& object : snapshot_objects) add(object);
+			return;
+		}
+
+		// 能直接生成三角形数据的网格构建一个展平的bvh，推迟的微图由加载器生成，generate_bvh时等待完成
+		vector<triangle_data> faces;
+		shared_ptr<material> faces_mat_ptr;
+		if (mesh_ptr->unpack_faces(faces, faces_mat_ptr)) {
+			std::function<void()> finish_micromaps;
+			shared_ptr<hittable> flat_mesh = make_flat_mesh(std::move(faces), faces_mat_ptr, finish_micromaps);
+			if (flat_mesh) add(flat_mesh);
+			if (finish_micromaps) {
+				add(scene_assets.submit([finish_micromaps]() {
+					finish_micromaps();
+					return std::vector<shared_ptr<hittable>>();
+				}));
+			}
+			return;
+		}
+
+		vector<shared_ptr<triangle>> triangle_ptr_list = mesh_ptr->unpack();
+		// 将列表中三角形逐个加入hittable_list中
+		for (shared_ptr<hittable> triangle_ptr : triangle_ptr_list) {
+			add(triangle_ptr);
+		}
+	}
+
+
+	// 增加一个加载中的物体列表
+	void add(asset_handle<std::vector<shared_ptr<hittable>>> handle) {
+		pending.push_back(std::move(handle));
+	}
+
+	// 等待所有加载中的物体，按加入的顺序加入objects
+	void wait_pending() {
+		for (const auto& handle : pending) {
+			for (const shared_ptr<hittable>& object : handle.get()) add(object);
+		}
+		pending.clear();
+	}
+
+
+	// 获取光线与hittable_list最近的交点
+	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override {
+		hit_record temp_rec;
+		bool hit_anything = false;
+		auto closest_so_far = t_max;
+
+		for (const auto& object : objects) {
+			if (object->hit(r, t_min, closest_so_far, temp_rec)) {
+				hit_anything = true;
+				// 通过将t_max设置为当前交点的t来找到最小的t
+				closest_so_far = temp_rec.t;
+				rec = temp_rec;
+			}
+		}
+
+		return hit_anything;
+	}
+
+	// 获取所有交点
+	virtual void hit_all(const ray& r, double t_min, double t_max, std::vector<hit_record>& recs) const override {
+		for (const auto& object : objects) {
+			object->hit_all(r, t_min, t_max, recs);
+		}
+	}
+
+	virtual bounds3 bounds() const override {
+		bounds3 box = objects[0]->bounds();
+		int len = objects.size();
+
+	    // 从第二个元素开始不断合并包围盒
+		bounds3 box_tmp;
+		for (int i = 1; i < len; i++) {
+			box_tmp = objects[i]->bounds();
+			box = Union(box, box_tmp);
+		}
+
+		return box;
+	}
+};
+
+
+
 #endif
\ No newline at end of file
@@ -0,0 +1,262 @@
+#pragma once
+#ifndef IRRADIANCE_CACHE_H
+#define IRRADIANCE_CACHE_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <shared_mutex>
+#include <mutex>
+#include "global.h"
+#include "hittable.h"
+#include "bounds.h"
+
+using std::vector;
+using std::unique_ptr;
+
+
+// 辐照度缓存记录
+struct irradiance_record {
+	vec3 position; // 记录位置
+	vec3 normal; // 记录法线
+	vec3 E; // 辐照度
+	double R; // 到周围几何的调和平均距离（已截断）
+	vec3 grad_t[3]; // 平移梯度，RGB三个通道分别对应一个梯度向量
+	vec3 grad_r[3]; // 旋转梯度
+};
+
+
+// 辐照度缓存
+// 参考 Ward 1988 / Ward & Heckbert 1992 / Krivanek 2005
+// 记录存放在八叉树中，渲染时按需计算（懒填充），之后在附近的漫反射着色点上插值复用
+// 查找使用共享锁，插入使用独占锁，计算新记录时不持有锁
+class irradiance_cache {
+public:
+	// 允许误差，越小记录越密集
+	double a = 0.2;
+	// 记录有效半径的截断范围
+	double R_min;
+	double R_max;
+	// 半球分层采样数，theta方向M层，phi方向N层
+	int M = 8;
+	int N = 24;
+
+private:
+	struct octree_node {
+		vec3 center;
+		double half_size;
+		unique_ptr<octree_node> children[8];
+		vector<int> record_index;
+	};
+
+	octree_node root;
+	std::deque<irradiance_record> records;
+	mutable std::shared_mutex cache_mutex;
+
+public:
+	// scene_bounds为场景包围盒，R_min_init与R_max_init为记录间距的截断范围
+	irradiance_cache(const bounds3& scene_bounds, double R_min_init = 0.05, double R_max_init = 2.0, double a_init = 0.2) {
+		R_min = R_min_init;
+		R_max = R_max_init;
+		a = a_init;
+		vec3 d = scene_bounds.Diagnal();
+		root.center = (scene_bounds.pMin + scene_bounds.pMax) * 0.5;
+		root.half_size = 0.5 * std::max(d[0], std::max(d[1], d[2])) + 1e-3;
+	}
+
+	size_t size() const {
+		std::shared_lock<std::shared_mutex> lock(cache_mutex);
+		return records.size();
+	}
+
+	// 获取辐照度
+	// 如果缓存中没有可用的记录，使用incoming_radiance计算一条新记录并插入缓存
+	// incoming_radiance(ray, hit_surface, rec)返回沿该光线方向射入的radiance，hit_surface与rec为该光线求交的结果
+	template <typename radiance_function>
+	vec3 get_irradiance(const vec3& position, const vec3& normal, const shared_ptr<hittable>& world, radiance_function&& incoming_radiance) {
+		vec3 E;
+		if (lookup(position, normal, E)) return E;
+
+		irradiance_record record = compute_record(position, normal, world, incoming_radiance);
+		insert(record);
+		return record.E;
+	}
+
+	// 在缓存中插值，成功返回true
+	bool lookup(const vec3& position, const vec3& normal, vec3& E) const {
+		std::shared_lock<std::shared_mutex> lock(cache_mutex);
+
+		vec3 E_sum(0, 0, 0);
+		double weight_sum = 0;
+		const octree_node* node = &root;
+		while (node) {
+			for (int index : node->record_index) {
+				const irradiance_record& rec = records[index];
+				vec3 d = position - rec.position;
+				double dist = d.length();
+
+				// 着色点位于记录前方时不使用该记录
+				double front = dot(d, unit_vector(normal + rec.normal));
+				if (front < -0.01 * rec.R) continue;
+
+				// Ward误差估计
+				double error = dist / rec.R + sqrt(std::max(0.0, 1 - dot(normal, rec.normal)));
+				if (error >= a) continue;
+				double weight = 1 / std::max(error, 1e-6) - 1 / a;
+
+				// 使用梯度外推
+				vec3 n_cross = cross(rec.normal, normal);
+				vec3 E_i = rec.E;
+				for (int c = 0; c < 3; c++) {
+					E_i[c] += dot(n_cross, rec.grad_r[c]) + dot(d, rec.grad_t[c]);
+				}
+				E_sum += clamp(E_i, 0, infinity) * weight;
+				weight_sum += weight;
+			}
+			// 进入包含该点的子节点
+			const octree_node* next = nullptr;
+			int child = child_index(*node, position);
+			if (node->children[child]) next = node->children[child].get();
+			node = next;
+		}
+
+		if (weight_sum <= 0) return false;
+		E = E_sum / weight_sum;
+		return true;
+	}
+
+	// 计算一条新记录
+	// 在半球上进行M * N分层的cos-weighted采样，同时计算平移和旋转梯度
+	// 每个方向只求交一次，击中距离用于调和平均距离与梯度，求交结果交给incoming_radiance继续着色
+	template <typename radiance_function>
+	irradiance_record compute_record(const vec3& position, const vec3& normal, const shared_ptr<hittable>& world, radiance_function&& incoming_radiance) const {
+		vec3 b1, b2;
+		build_basis(normal, b1, b2);
+
+		vector<vec3> L(M * N);
+		vector<double> dist(M * N);
+		double inv_dist_sum = 0;
+
+		for (int j = 0; j < M; j++) {
+			for (int k = 0; k < N; k++) {
+				// 在第(j, k)个分层内采样
+				double sin_theta = sqrt((j + random_double()) / M);
+				double cos_theta = sqrt(std::max(0.0, 1 - sin_theta * sin_theta));
+				double phi = pi2 * (k + random_double()) / N;
+				vec3 wi = normal * cos_theta + b1 * cos(phi) * sin_theta + b2 * sin(phi) * sin_theta;
+
+				ray r(position, wi);
+				hit_record rec;
+				bool hit_surface = world->hit(r, 0.000001, infinity, rec);
+				double t = hit_surface ? rec.t : infinity;
+				dist[j * N + k] = t;
+				inv_dist_sum += 1 / t;
+				L[j * N + k] = incoming_radiance(r, hit_surface, rec);
+			}
+		}
+
+		irradiance_record record;
+		record.position = position;
+		record.normal = normal;
+
+		// 辐照度
+		vec3 E(0, 0, 0);
+		for (const vec3& l : L) E += l;
+		record.E = E * (pi / (M * N));
+
+		// 调和平均距离
+		double R = inv_dist_sum > 0 ? M * N / inv_dist_sum : R_max;
+		record.R = clamp(R, R_min, R_max);
+
+		// 梯度
+		for (int c = 0; c < 3; c++) {
+			record.grad_t[c] = vec3(0, 0, 0);
+			record.grad_r[c] = vec3(0, 0, 0);
+		}
+		for (int k = 0; k < N; k++) {
+			double phi = pi2 * (k + 0.5) / N;
+			vec3 u_k = b1 * cos(phi) + b2 * sin(phi);
+			vec3 v_k = b1 * cos(phi + 0.5 * pi) + b2 * sin(phi + 0.5 * pi);
+			int k_prev = (k + N - 1) % N;
+
+			for (int j = 0; j < M; j++) {
+				double sin_minus = sqrt(double(j) / M);
+				double sin_plus = sqrt(double(j + 1) / M);
+				double cos2_minus = 1 - sin_minus * sin_minus;
+				double theta_center = asin(sqrt((j + 0.5) / M));
+
+				for (int c = 0; c < 3; c++) {
+					// 旋转梯度
+					record.grad_r[c] += v_k * (-tan(theta_center) * L[j * N + k][c]);
+
+					// 平移梯度：theta方向相邻分层之间的变化
+					if (j > 0) {
+						double r_min = std::min(dist[j * N + k], dist[(j - 1) * N + k]);
+						record.grad_t[c] += u_k * (pi2 / N * sin_minus * cos2_minus / r_min * (L[j * N + k][c] - L[(j - 1) * N + k][c]));
+					}
+					// 平移梯度：phi方向相邻分层之间的变化
+					double r_min = std::min(dist[j * N + k], dist[j * N + k_prev]);
+					record.grad_t[c] += v_k * ((sin_plus - sin_minus) / r_min * (L[j * N + k][c] - L[j * N + k_prev][c]));
+				}
+			}
+		}
+		for (int c = 0; c < 3; c++) {
+			record.grad_r[c] = record.grad_r[c] * (pi / (M * N));
+		}
+
+		// 根据平移梯度进一步限制有效半径，避免梯度外推出明显错误的值
+		for (int c = 0; c < 3; c++) {
+			double grad_len = record.grad_t[c].length();
+			if (grad_len > 0 and record.E[c] > 0) {
+				record.R = std::max(R_min, std::min(record.R, record.E[c] / grad_len));
+			}
+		}
+
+		return record;
+	}
+
+	// 插入记录
+	// 记录会被放进所有与其影响范围相交、且大小与影响范围相当的节点中
+	void insert(const irradiance_record& record) {
+		std::unique_lock<std::shared_mutex> lock(cache_mutex);
+		int index = static_cast<int>(records.size());
+		records.push_back(record);
+
+		double radius = record.R * a;
+		insert_node(root, index, record.position, radius);
+	}
+
+private:
+	static int child_index(const octree_node& node, const vec3& p) {
+		return (p[0] > node.center[0] ? 1 : 0) | (p[1] > node.center[1] ? 2 : 0) | (p[2] > node.center[2] ? 4 : 0);
+	}
+
+	void insert_node(octree_node& node, int index, const vec3& p, double radius) {
+		// 节点尺寸小于影响直径的两倍时存放在当前节点
+		if (node.half_size < 2 * radius) {
+			node.record_index.push_back(index);
+			return;
+		}
+
+		double child_half = node.half_size * 0.5;
+		for (int child = 0; child < 8; child++) {
+			vec3 child_center = node.center + vec3(child & 1 ? child_half : -child_half, child & 2 ? child_half : -child_half, child & 4 ? child_half : -child_half);
+
+			// 影响范围与子节点不相交时跳过
+			bool overlap = true;
+			for (int axis = 0; axis < 3; axis++) {
+				if (p[axis] + radius < child_center[axis] - child_half or p[axis] - radius > child_center[axis] + child_half) overlap = false;
+			}
+			if (not overlap) continue;
+
+			if (not node.children[child]) {
+				node.children[child] = std::make_unique<octree_node>();
+				node.children[child]->center = child_center;
+				node.children[child]->half_size = child_half;
+			}
+			insert_node(*node.children[child], index, p, radius);
+		}
+	}
+};
+
+#endif
@@ -1,89 +1,131 @@
-#pragma once
-#ifndef LIGHT_H
-#define LIGHT_H
-
-#include "vec3.h"
-#include "global.h"
-
-class light {
-public:
-	// һԴϵĵ㣬ŵp
-	// زڹԴϵpdf
-	virtual double sample_p(vec3 &p, vec3 &light_radiance, vec3 &light_normal) const = 0;
-};
-
-
-class circle_light : public light {
-public:
-	vec3 center;
-	vec3 normal;
-	double radius;
-	vec3 radiance;
-	vec3 b1, b2; // 
-	double pdf;
-
-public:
-	circle_light(const vec3 &center_init, const vec3 &normal_init, double radius_init, const vec3 &radiance_init) {
-		center = center_init;
-		normal = unit_vector(normal_init);
-		radius = radius_init;
-		radiance = radiance_init;
-		build_basis(normal, b1, b2);
-		pdf = 1 / (pi * radius * radius);
-	}
-
-	// ԲϾȲ
-	virtual double sample_p(vec3 &p, vec3 &light_radiance, vec3 &light_normal) const override
-	{
-		double r = sqrt(random_double()) * radius;
-		double phi = pi2 * random_double();
-		p = center + b1 * r * sin(phi) + b2 * r * cos(phi);
-		light_radiance = radiance;
-		light_normal = normal;
-
-		return pdf;
-	}
-};
-
-
-class triangle_light : public light {
-public:
-	vec3 vertex[3];
-	vec3 normal;
-	vec3 radiance;
-	double pdf;
-
-public:
-	triangle_light(const vec3 &vertex_1, const vec3 &vertex_2, const vec3 &vertex_3, const vec3 &radiance_init) {
-		
-		vertex[0] = vertex_1;
-		vertex[1] = vertex_2;
-		vertex[2] = vertex_3;
-		vec3 tmp_vec = cross(vertex[1] - vertex[0], vertex[2] - vertex[0]);
-		pdf = 1 / (tmp_vec.length() * 0.5);
-		normal = unit_vector(tmp_vec);
-		radiance = radiance_init;
-	}
-
-	// ϾȲ
-	virtual double sample_p(vec3 &p, vec3 &light_radiance, vec3 &light_normal) const override {
-		
-		// ƽıڲȻⲿĵ
-		double x = random_double();
-		double y = random_double();
-
-		if (x + y > 1) {
-			x = 1 - x;
-			y = 1 - y;
-		}
-
-		p = vertex[0] + x * (vertex[1] - vertex[0]) + y * (vertex[2] - vertex[0]);
-		light_radiance = radiance;
-		light_normal = normal;
-
-		return pdf;
-	}
-};
-
-
+#pragma once
+#ifndef LIGHT_H
+#define LIGHT_H
+
+#include "vec3.h"
+#include "ray.h"
+#include "global.h"
+
+class light {
+public:
+	// 采样一个光源上的点，坐标存放到p中
+	// 返回采样点在光源上的pdf
+	virtual double sample_p(vec3 &p, vec3 &light_radiance, vec3 &light_normal) const = 0;
+
+	// 光线与光源求交，只考虑(0, t_max)内从法线一侧射来的光线
+	// 击中时返回true，t为击中位置的参数，pdf_light为sample_p采样到该点的pdf
+	// 光源不是场景中的几何体，不会遮挡光线，只有双向路径追踪用来计算光线击中光源的策略
+	virtual bool hit(const ray &r, double t_max, double &t, vec3 &light_radiance, vec3 &light_normal, double &pdf_light) const = 0;
+};
+
+
+class circle_light : public light {
+public:
+	vec3 center;
+	vec3 normal;
+	double radius;
+	vec3 radiance;
+	vec3 b1, b2; // 切向基向量
+	double pdf;
+
+public:
+	circle_light(const vec3 &center_init, const vec3 &normal_init, double radius_init, const vec3 &radiance_init) {
+		center = center_init;
+		normal = unit_vector(normal_init);
+		radius = radius_init;
+		radiance = radiance_init;
+		build_basis(normal, b1, b2);
+		pdf = 1 / (pi * radius * radius);
+	}
+
+	// 在圆上均匀采样
+	virtual double sample_p(vec3 &p, vec3 &light_radiance, vec3 &light_normal) const override
+	{
+		double r = sqrt(random_double()) * radius;
+		double phi = pi2 * random_double();
+		p = center + b1 * r * sin(phi) + b2 * r * cos(phi);
+		light_radiance = radiance;
+		light_normal = normal;
+
+		return pdf;
+	}
+
+	virtual bool hit(const ray &r, double t_max, double &t, vec3 &light_radiance, vec3 &light_normal, double &pdf_light) const override {
+		double cos_d = dot(r.dir, normal);
+		if (cos_d >= 0) return false;
+		t = dot(center - r.orig, normal) / cos_d;
+		if (t <= 0 or t >= t_max) return false;
+		if ((r.at(t) - center).length_squared() > radius * radius) return false;
+		light_radiance = radiance;
+		light_normal = normal;
+		pdf_light = pdf;
+		return true;
+	}
+};
+
+
+class triangle_light : public light {
+public:
+	vec3 vertex[3];
+	vec3 normal;
+	vec3 radiance;
+	double pdf;
+
+public:
+	triangle_light(const vec3 &vertex_1, const vec3 &vertex_2, const vec3 &vertex_3, const vec3 &radiance_init) {
+		
+		vertex[0] = vertex_1;
+		vertex[1] = vertex_2;
+		vertex[2] = vertex_3;
+		vec3 tmp_vec = cross(vertex[1] - vertex[0], vertex[2] - vertex[0]);
+		pdf = 1 / (tmp_vec.length() * 0.5);
+		normal = unit_vector(tmp_vec);
+		radiance = radiance_init;
+	}
+
+	// 在三角形上均匀采样
+	virtual double sample_p(vec3 &p, vec3 &light_radiance, vec3 &light_normal) const override {
+		
+		// 先在平行四边形内采样，然后调整外部的点
+		double x = random_double();
+		double y = random_double();
+
+		if (x + y > 1) {
+			x = 1 - x;
+			y = 1 - y;
+		}
+
+		p = vertex[0] + x * (vertex[1] - vertex[0]) + y * (vertex[2] - vertex[0]);
+		light_radiance = radiance;
+		light_normal = normal;
+
+		return pdf;
+	}
+
+	virtual bool hit(const ray &r, double t_max, double &t, vec3 &light_radiance, vec3 &light_normal, double &pdf_light) const override {
+		if (dot(r.dir, normal) >= 0) return false;
+
+		// Moller-Trumbore
+		vec3 e1 = vertex[1] - vertex[0];
+		vec3 e2 = vertex[2] - vertex[0];
+		vec3 q = cross(r.dir, e2);
+		double det = dot(e1, q);
+		if (det == 0) return false;
+		double det_inv = 1 / det;
+		vec3 s = r.orig - vertex[0];
+		double u = dot(s, q) * det_inv;
+		if (u < 0 or u > 1) return false;
+		vec3 k = cross(s, e1);
+		double v = dot(r.dir, k) * det_inv;
+		if (v < 0 or u + v > 1) return false;
+		t = dot(e2, k) * det_inv;
+		if (t <= 0 or t >= t_max) return false;
+		light_radiance = radiance;
+		light_normal = normal;
+		pdf_light = pdf;
+		return true;
+	}
+};
+
+
 #endif
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX // 避免min、max宏与std::min、std::max冲突
+#endif
+#ifndef NOGDI
+#define NOGDI // 避免RGB宏与变量名冲突
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 只读映射到内存的文件
+class mapped_file {
+public:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+
+private:
+#ifdef _WIN32
+	HANDLE file_handle = INVALID_HANDLE_VALUE;
+	HANDLE mapping_handle = nullptr;
+#endif
+
+public:
+	mapped_file() {}
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	~mapped_file() {
+		close();
+	}
+
+	bool open(const std::string& path) {
+		close();
+#ifdef _WIN32
+		file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file_handle == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER file_size;
+		if (not GetFileSizeEx(file_handle, &file_size) or file_size.QuadPart == 0) {
+			close();
+			return false;
+		}
+		mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping_handle == nullptr) {
+			close();
+			return false;
+		}
+		data = static_cast<const uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+		if (data == nullptr) {
+			close();
+			return false;
+		}
+		size = static_cast<size_t>(file_size.QuadPart);
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 or st.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+		void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd); // 映射建立后可以关闭文件
+		if (p == MAP_FAILED) return false;
+		data = static_cast<const uint8_t*>(p);
+		size = static_cast<size_t>(st.st_size);
+#endif
+		return true;
+	}
+
+	void close() {
+#ifdef _WIN32
+		if (data) UnmapViewOfFile(data);
+		if (mapping_handle) CloseHandle(mapping_handle);
+		if (file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+		mapping_handle = nullptr;
+		file_handle = INVALID_HANDLE_VALUE;
+#else
+		if (data) munmap(const_cast<uint8_t*>(data), size);
+#endif
+		data = nullptr;
+		size = 0;
+	}
+};
+
+
+// 生成缓存文件时使用的临时文件名，包含进程号与进程内的序号
+// 多个线程或多个进程（如渲染农场上同时载入同一个场景的任务）生成同一个文件时各写各的临时文件，完成后再重命名
+inline std::string unique_temp_path(const std::string& path) {
+	static std::atomic<uint32_t> temp_count{ 0 };
+#ifdef _WIN32
+	unsigned long pid = GetCurrentProcessId();
+#else
+	unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+	return path + "." + std::to_string(pid) + "." + std::to_string(temp_count++) + ".tmp";
+}
+
+#endif
@@ -1,1196 +1,1503 @@
-#pragma once
-#ifndef MATERIAL_H
-#define MATERIAL_H
-
-#include "global.h"
-#include "texture.h"
-#include "hittable.h"
-
-struct hit_record;
-using std::tuple;
-using std::make_tuple;
-using std::tie;
-
-class material {
-public:
-	// 
-	// ֵΪ{pdfǣ䷽Ƿͷͬ}
-	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front) const = 0;
-
-	// 
-	// ֵΪ{pdf㷨ߣ}
-	virtual tuple<double, vec3, vec3> sample_positioni(const vec3& normalo, const vec3& positiono, shared_ptr<hittable> world) const = 0;
-
-	// bsdf
-	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const vec3& uv,
-		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const = 0;
-
-	// ȡԷǿ
-	virtual vec3 get_radiance() const = 0;
-
-	// ȡͼָ
-	virtual shared_ptr<texture> get_normal_map_ptr() const = 0;
-
-	// ȡͼָ
-	virtual shared_ptr<texture> get_color_map_ptr() const = 0;
-
-	// ȡûͼָ
-	virtual shared_ptr<texture> get_displacement_map_ptr() const = 0;
-
-	// ȡ
-	// ܷؿָ
-	virtual shared_ptr<medium> get_medium_outside_ptr() const = 0;
-	virtual shared_ptr<medium> get_medium_inside_ptr() const = 0;
-
-	// ǷҪԹԴ
-	virtual bool sample_light() const = 0;
-
-	// ȡʱ
-	virtual int get_material_number() const = 0;
-};
-
-
-// Blinn-Phong 
-class phong_material : public material {
-public:
-	vec3 radiance; // Էǿ
-	shared_ptr<texture> color_map_ptr = nullptr;
-	shared_ptr<texture> normal_map_ptr = nullptr;
-	shared_ptr<texture> displacement_map_ptr = nullptr;
-	shared_ptr<medium> medium_outside_ptr = default_medium_ptr;
-	shared_ptr<medium> medium_inside_ptr = default_medium_ptr;
-	double kd = 0.9; // ϵ
-	double ks = 0.1; // 淴ϵ
-	double a = 0; // ߹Խ߹ԽСĬa = 0
-
-public:
-	// ʹһɫ
-	// ԶΪsimple_color_texture
-	phong_material(vec3 albedo_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0)) {
-		radiance = radiance_init;
-		color_map_ptr = make_shared<simple_color_texture>(albedo_init);
-		normal_map_ptr = nullptr;
-		medium_outside_ptr = default_medium_ptr;
-		medium_inside_ptr = default_medium_ptr;
-	}
-
-	// ʹø߹һɫ
-	// ԶΪsimple_color_texture
-	phong_material(double a_init, vec3 albedo_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0)) {
-		radiance = radiance_init;
-		color_map_ptr = make_shared<simple_color_texture>(albedo_init);
-		a = a_init;
-		normal_map_ptr = nullptr;
-		medium_outside_ptr = default_medium_ptr;
-		medium_inside_ptr = default_medium_ptr;
-	}
-
-	// ʹcolor_map
-	phong_material(shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
-		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
-		radiance = radiance_init;
-		color_map_ptr = color_map_ptr_init;
-		normal_map_ptr = normal_map_ptr_init;
-		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
-		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
-		displacement_map_ptr = displacement_map_ptr_init;
-	}
-
-	// ʹø߹color_map
-	phong_material(double a_init, shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
-		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
-		radiance = radiance_init;
-		color_map_ptr = color_map_ptr_init;
-		a = a_init;
-		normal_map_ptr = normal_map_ptr_init;
-		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
-		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
-		displacement_map_ptr = displacement_map_ptr_init;
-	}
-
-	// www.cs.princeton.edu/courses/archive/fall08/cos526/assign3/lawrence.pdf
-	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front) const {
-
-		// cos-weighted͸߹ҪԲ
-		// ֲƵʵıֵkdks֮
-		vec3 wi;
-		double pdf;
-
-		if (random_double() < kd / (kd + ks)) {
-
-			// cos-weighted
-			double rand1 = random_double();
-			double rand2 = random_double();
-
-			double theta = acos(sqrt(1 - rand1));
-			double phi = pi2 * rand2;
-
-			// ÷߹ϵ
-			vec3 b1, b2;
-			build_basis(normali, b1, b2);
-
-			// õwi
-			wi = normali * cos(theta) + b1 * sin(phi) * sin(theta) + b2 * cos(phi) * sin(theta);
-
-			pdf = cos(theta) * pi_inv;
-		}
-		else {
-
-			// ߹ҪԲ
-			double rand1 = random_double();
-			double rand2 = random_double();
-
-			// 
-			double theta = acos(pow(rand1, 1.0 / (a + 1)));
-			double phi = pi2 * rand2;
-
-			vec3 b1, b2;
-			build_basis(normali, b1, b2);
-
-			vec3 h = normali * cos(theta) + b1 * sin(phi) * sin(theta) + b2 * cos(phi) * sin(theta);
-
-			// ݾ淴wi
-			wi = 2 * h * dot(wo, h) - wo;
-
-			if (dot(wi, normali) < 0) {
-				// ߴ͸һܴpdfʹý޹
-				pdf = 10000000;
-			}
-			else {
-				// pdf
-				pdf = (a + 1) * pi2_inv * pow(cos(theta), a);
-			}
-		}
-
-		return make_tuple(pdf, wi, wo_front);
-
-	}
-
-	virtual tuple<double, vec3, vec3>
-		sample_positioni(const vec3& normalo, const vec3& positiono, shared_ptr<hittable> world) const {
-		return make_tuple(1, normalo, positiono);
-	}
-
-	// phong brdf
-	// zhuanlan.zhihu.com/p/500811555
-	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const vec3& uv,
-		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const override {
-		//auto ret1 = color_map_ptr->get_value(uv) * pi_inv;
-		vec3 ret_d = color_map_ptr->get_value(uv) * kd * pi_inv;
-		vec3 ret_s = vec3(ks, ks, ks) * (a + 2) * pi2_inv * pow(std::max(0.0, dot(normalo, unit_vector(wi + wo))), a);
-
-		return ret_d + ret_s;
-	}
-
-	virtual vec3 get_radiance() const override {
-		return radiance;
-	}
-
-	virtual shared_ptr<texture> get_normal_map_ptr() const override {
-		return normal_map_ptr;
-	}
-
-	virtual shared_ptr<texture> get_color_map_ptr() const override {
-		return color_map_ptr;
-	}
-
-	virtual shared_ptr<texture> get_displacement_map_ptr() const override {
-		return displacement_map_ptr;
-	}
-
-	virtual shared_ptr<medium> get_medium_outside_ptr() const override {
-		return medium_outside_ptr;
-	};
-
-	virtual shared_ptr<medium> get_medium_inside_ptr() const override {
-		return medium_inside_ptr;
-	};
-
-	virtual bool sample_light() const override {
-		return true;
-	}
-
-	virtual int get_material_number() const override {
-		return 0;
-	}
-};
-
-
-// GGX
-class ggx_metal_material : public material {
-public:
-	double a; // ֲڶȣ[0,1]
-	vec3 radiance; // Էǿ
-	shared_ptr<medium> medium_outside_ptr = default_medium_ptr;
-	shared_ptr<medium> medium_inside_ptr = default_medium_ptr;
-	shared_ptr<texture> color_map_ptr = nullptr; // ʼֵɫ
-	shared_ptr<texture> normal_map_ptr = nullptr;
-	shared_ptr<texture> displacement_map_ptr = nullptr;
-
-public:
-	// һɫmaterial
-	ggx_metal_material(const double& a_init, const vec3& F0_init = vec3(1, 0.582, 0.0956), vec3 radiance_init = vec3(0.0, 0.0, 0.0)) {
-		a = a_init;
-		color_map_ptr = make_shared<simple_color_texture>(F0_init);
-		radiance = radiance_init;
-		medium_outside_ptr = default_medium_ptr;
-		medium_inside_ptr = default_medium_ptr;
-	}
-
-	// color_mapmaterialͬʱҲַ֧ͼ
-	ggx_metal_material(const double& a_init, shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
-		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
-
-		a = a_init;
-		radiance = radiance_init;
-		color_map_ptr = color_map_ptr_init;
-		normal_map_ptr = normal_map_ptr_init;
-		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
-		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
-		displacement_map_ptr = displacement_map_ptr_init;
-	}
-
-	// 뵥λ!!!!!!!!
-	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front) const override {
-
-		// ҪԲ΢淨ߣʹõķֲΪggx NDF
-		double pdf;
-		vec3 wi;
-
-		double rand1, rand2, theta, phi;
-		vec3 h;
-
-		rand1 = random_double();
-		rand2 = random_double();
-		theta = atan(a * sqrt(rand1 / (1 - rand1))); // ΢۷۷ߵļн
-		phi = pi2 * rand2; // ΢۷ƽĽǶ
-
-		// ÷߹ϵ
-		vec3 b1, b2;
-		build_basis(normali, b1, b2);
-
-		// õ΢۷(wiwoİ)
-		h = normali * cos(theta) + b1 * sin(phi) * sin(theta) + b2 * cos(phi) * sin(theta); // ŪһΣע⡣
-
-		// ݾ淴wi
-		wi = 2 * h * dot(wo, h) - wo;
-
-		// ߴ͸һܴpdfʹý޹
-		if (dot(wi, normali) < 0) {
-			pdf = 1000000;
-		}
-		else {
-			// pdfNDFƳ
-			double a2 = a * a;
-			pdf = a2 * cos(theta) * pi_inv / pow(pow(cos(theta), 2) * (a2 - 1) + 1, 2) * 0.25 / dot(wo, h);
-		}
-
-		return make_tuple(pdf, wi, wo_front);
-	}
-
-	virtual tuple<double, vec3, vec3>
-		sample_positioni(const vec3& normalo, const vec3& positiono, shared_ptr<hittable> world) const {
-		return make_tuple(1, normalo, positiono);
-	}
-
-	// 뵥λ!!!!!!!!
-	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const vec3& uv,
-		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const override {
-		// F 
-		vec3 h = unit_vector(wi + wo);
-		vec3 F = color_map_ptr->get_value(uv) + (vec3(1.0, 1.0, 1.0) - color_map_ptr->get_value(uv)) * pow(1 - dot(wo, h), 5);
-
-		// D NDF
-		double a2 = a * a;
-		double D = a2 / (pi * pow(pow(dot(normalo, h), 2) * (a2 - 1) + 1, 2));
-
-		// G ڵ
-		double dot_n_v = dot(normalo, wo);
-		double dot_n_l = dot(normalo, wi);
-		double k = a * 0.5;
-		double G = dot_n_v / (dot_n_v * (1 - k) + k) * dot_n_l / (dot_n_l * (1 - k) + k);
-
-		return D * F * G / (4 * dot_n_v * dot_n_l);
-	}
-
-	virtual vec3 get_radiance() const override {
-		return radiance;
-	}
-
-	virtual shared_ptr<texture> get_normal_map_ptr() const override {
-		return normal_map_ptr;
-	}
-
-	virtual shared_ptr<texture> get_color_map_ptr() const override {
-		return color_map_ptr;
-	}
-
-	virtual shared_ptr<texture> get_displacement_map_ptr() const override {
-		return displacement_map_ptr;
-	}
-
-	virtual shared_ptr<medium> get_medium_outside_ptr() const override {
-		return medium_outside_ptr;
-	};
-
-	virtual shared_ptr<medium> get_medium_inside_ptr() const override {
-		return medium_inside_ptr;
-	};
-
-	virtual bool sample_light() const override {
-		return true;
-	}
-
-	virtual int get_material_number() const override {
-		return 1;
-	}
-};
-
-
-// GGXǽ
-class ggx_nonmetal_material : public material {
-public:
-	double a; // ߹ֲڶȣ[0,1]
-	vec3 radiance; // Էǿ
-	double F0; // ϵ˸߹ı
-	shared_ptr<medium> medium_outside_ptr = default_medium_ptr;
-	shared_ptr<medium> medium_inside_ptr = default_medium_ptr;
-	shared_ptr<texture> color_map_ptr = nullptr; // ɫ
-	shared_ptr<texture> normal_map_ptr = nullptr;
-	shared_ptr<texture> displacement_map_ptr = nullptr;
-
-public:
-	// color_mapmaterialͬʱҲַ֧ͼ
-	ggx_nonmetal_material(const double& a_init, const double& F0_init, shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
-		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
-
-		a = a_init;
-		F0 = F0_init;
-		radiance = radiance_init;
-		color_map_ptr = color_map_ptr_init;
-		normal_map_ptr = normal_map_ptr_init;
-		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
-		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
-		displacement_map_ptr = displacement_map_ptr_init;
-	}
-
-	// ҪbrdfͲ
-
-	// 뵥λ!!!!!!!!
-	// ʹggxҪԲҪԲcos-weighted
-	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front) const override {
-
-		double pdf;
-		vec3 wi;
-
-		// ֲȨظݷΪ˸߹
-		if (random_double() < F0) {
-
-			// ҪԲ΢淨ߣʹõķֲΪggx NDF
-			double rand1, rand2, theta, phi;
-			vec3 h;
-
-			rand1 = random_double();
-			rand2 = random_double();
-			theta = atan(a * sqrt(rand1 / (1 - rand1))); // ΢۷۷ߵļн
-			phi = pi2 * rand2; // ΢۷ƽĽǶ
-
-			// ÷߹ϵ
-			vec3 b1, b2;
-			build_basis(normali, b1, b2);
-
-			// õ΢۷(wiwoİ)
-			h = normali * cos(theta) + b1 * sin(phi) * sin(theta) + b2 * cos(phi) * sin(theta); // ŪһΣע⡣
-
-			// ݾ淴wi
-			wi = 2 * h * dot(wo, h) - wo;
-
-			// ߴ͸һܴpdfʹý޹
-			if (dot(wi, normali) < 0) {
-				pdf = 1000000;
-			}
-			else {
-				// pdfNDFƳ
-				double a2 = a * a;
-				pdf = a2 * cos(theta) * pi_inv / pow(pow(cos(theta), 2) * (a2 - 1) + 1, 2) * 0.25 / dot(wo, h);
-			}
-		}
-		else {
-
-			// cos-weighted
-			double rand1 = random_double();
-			double rand2 = random_double();
-
-			double theta = acos(sqrt(1 - rand1));
-			double phi = pi2 * rand2;
-
-			// ÷߹ϵ
-			vec3 b1, b2;
-			build_basis(normali, b1, b2);
-
-			// õwi
-			wi = normali * cos(theta) + b1 * sin(phi) * sin(theta) + b2 * cos(phi) * sin(theta);
-
-			pdf = cos(theta) * pi_inv;
-		}
-
-		return make_tuple(pdf, wi, wo_front);
-	}
-
-	virtual tuple<double, vec3, vec3>
-		sample_positioni(const vec3& normalo, const vec3& positiono, shared_ptr<hittable> world) const {
-		return make_tuple(1, normalo, positiono);
-	}
-
-	// 뵥λ!!!!!!!!
-	// brdf߹ĺ
-	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const vec3& uv,
-		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const override {
-
-		// ߹ʹggxģͣ
-
-		// F 
-		// ڷǽRGBֵ
-		vec3 h = unit_vector(wi + wo);
-		double F_value = F0 + (1.0 - F0) * pow(1 - dot(wo, h), 5);
-		vec3 F(F_value, F_value, F_value);
-		// D NDF
-		double a2 = a * a;
-		double D = a2 / (pi * pow(pow(dot(normalo, h), 2) * (a2 - 1) + 1, 2));
-		// G ڵ
-		double dot_n_v = dot(normalo, wo);
-		double dot_n_l = dot(normalo, wi);
-		double k = a * 0.5;
-		double G = dot_n_v / (dot_n_v * (1 - k) + k) * dot_n_l / (dot_n_l * (1 - k) + k);
-
-		vec3 component_ggx = F * D * G / (4 * dot_n_v * dot_n_l);
-		component_ggx = clamp(component_ggx, 0, infinity);
-
-		// 
-		vec3 component_diffuse = (vec3(1 - F0, 1 - F0, 1 - F0)) * color_map_ptr->get_value(uv) * pi_inv;
-		//vec3 component_diffuse = (vec3(1 - F_value, 1 - F_value, 1 - F_value)) * color_map_ptr->get_value(uv) * pi_inv;
-
-		return component_ggx + component_diffuse;
-	}
-
-	virtual vec3 get_radiance() const override {
-		return radiance;
-	}
-
-	virtual shared_ptr<texture> get_normal_map_ptr() const override {
-		return normal_map_ptr;
-	}
-
-	virtual shared_ptr<texture> get_color_map_ptr() const override {
-		return color_map_ptr;
-	}
-
-	virtual shared_ptr<texture> get_displacement_map_ptr() const override {
-		return displacement_map_ptr;
-	}
-
-	virtual shared_ptr<medium> get_medium_outside_ptr() const override {
-		return medium_outside_ptr;
-	};
-
-	virtual shared_ptr<medium> get_medium_inside_ptr() const override {
-		return medium_inside_ptr;
-	};
-
-	virtual bool sample_light() const override {
-		return true;
-	}
-
-	virtual int get_material_number() const override {
-		return 2;
-	}
-};
-
-
-// αɢ
-constexpr double V = 0.1;
-class sss_material : public material {
-public:
-	vec3 radiance; // Էǿ
-	double F0;
-	double v = V; // ɢ̶ȣʱܸıֵ TODO
-	double v_inv = 1.0 / V; // ɢ̶ȣʱܸıֵ TODO
-	double Rm = 10; // Բ̲뾶ʱܸıֵ TODO
-	double Rm2 = 100; // Բ̲뾶ʱܸıֵ TODO
-	shared_ptr<medium> medium_outside_ptr = default_medium_ptr;
-	shared_ptr<medium> medium_inside_ptr = default_medium_ptr;
-	shared_ptr<texture> color_map_ptr = nullptr;
-	shared_ptr<texture> normal_map_ptr = nullptr;
-	shared_ptr<texture> displacement_map_ptr = nullptr;
-
-public:
-	// ʹһɫ
-	// ԶΪsimple_color_texture
-	sss_material(double F0_init, vec3 albedo_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0)) {
-		color_map_ptr = make_shared<simple_color_texture>(albedo_init);
-		radiance = radiance_init;
-		F0 = F0_init;
-		medium_outside_ptr = default_medium_ptr;
-		medium_inside_ptr = default_medium_ptr;
-	}
-
-
-	// ʹcolor_map
-	sss_material(double F0_init, shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
-		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
-		color_map_ptr = color_map_ptr_init;
-		radiance = radiance_init;
-		normal_map_ptr = normal_map_ptr_init;
-		F0 = F0_init;
-		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
-		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
-		displacement_map_ptr = displacement_map_ptr_init;
-	}
-
-	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front) const override {
-
-		// cos-weighted
-		double rand1 = random_double();
-		double rand2 = random_double();
-
-		double theta = acos(sqrt(1 - rand1));
-		double phi = pi2 * rand2;
-
-		// ÷߹ϵ
-		vec3 b1, b2;
-		build_basis(normali, b1, b2);
-
-		// õwi
-		vec3 wi = normali * cos(theta) + b1 * sin(phi) * sin(theta) + b2 * cos(phi) * sin(theta);
-
-		double pdf = cos(theta) * pi_inv;
-
-		return make_tuple(pdf, wi, wo_front);
-	}
-
-	virtual tuple<double, vec3, vec3>
-		sample_positioni(const vec3& normalo, const vec3& positiono, shared_ptr<hittable> world) const override {
-
-		// ԲͶӰ
-		// woֱԲϲ
-		double rand1 = random_double();
-		double rand2 = random_double();
-		double r = sqrt(-2 * v * log(1 - rand1 * (1 - exp(-Rm2 * v_inv * 0.5))));
-		double phi = pi2 * rand2;
-
-		// ÷߹ϵ
-		vec3 b1, b2;
-		build_basis(normalo, b1, b2);
-
-		// ȡͶӰǰλ
-		vec3 positioni_0 = positiono + b1 * r * cos(phi) + b2 * r * sin(phi);
-
-		// ͶӰ
-		hit_record rec1, rec2;
-		bool hit1 = world->hit(ray(positioni_0, normalo), 0.000001, infinity, rec1);
-		bool hit2 = world->hit(ray(positioni_0, -normalo), 0.000001, infinity, rec2);
-		vec3 positioni, normali;
-		if (hit1) {
-			if (hit2) {
-				if (rec1.t < rec2.t) {
-					positioni = rec1.p;
-					normali = rec1.normal;
-				}
-				else {
-					positioni = rec2.p;
-					normali = rec2.normal;
-				}
-			}
-			else {
-				positioni = rec1.p;
-				normali = rec1.normal;
-			}
-		}
-		else {
-			if (hit2) {
-				positioni = rec2.p;
-				normali = rec2.normal;
-			}
-			else {
-				positioni = positioni_0;
-				normali = normalo;
-			}
-		}
-
-		// pdf
-		double pdf = exp(-r * r * v_inv * 0.5) * v_inv * pi2_inv / (1 - exp(-Rm2 * v_inv * 0.5)) * abs(dot(normali, normalo));
-
-		return make_tuple(pdf, normali, positioni);
-	}
-
-	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const vec3& uv,
-		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const override {
-
-		// 
-		double F_value_o = F0 + (1.0 - F0) * pow(1 - std::max(dot(wo, normalo), 0.0), 5);
-		vec3 F_o(1 - F_value_o, 1 - F_value_o, 1 - F_value_o);
-
-		// 
-		double F_value_i = F0 + (1.0 - F0) * pow(1 - std::max(dot(wi, normali), 0.0), 5);
-		vec3 F_i(1 - F_value_i, 1 - F_value_i, 1 - F_value_i);
-
-		// Rd
-		// ʹõǶά˹ֲ
-		double r2 = (positiono - positioni).length_squared();
-		double Rd = exp(-r2 * v_inv * 0.5) * v_inv * pi2_inv;
-
-		//return pi_inv * Rd * F_o * F_i * color_map_ptr->get_value(uv);
-		return pi_inv * Rd * color_map_ptr->get_value(uv);
-	}
-
-	virtual vec3 get_radiance() const override {
-		return radiance;
-	}
-
-	virtual shared_ptr<texture> get_normal_map_ptr() const override {
-		return normal_map_ptr;
-	}
-
-	virtual shared_ptr<texture> get_color_map_ptr() const override {
-		return color_map_ptr;
-	}
-
-	virtual shared_ptr<texture> get_displacement_map_ptr() const override {
-		return displacement_map_ptr;
-	}
-
-	virtual shared_ptr<medium> get_medium_outside_ptr() const override {
-		return medium_outside_ptr;
-	};
-
-	virtual shared_ptr<medium> get_medium_inside_ptr() const override {
-		return medium_inside_ptr;
-	};
-
-	virtual bool sample_light() const override {
-		return true;
-	}
-
-	virtual int get_material_number() const override {
-		return 3;
-	}
-};
-
-
-// ggx
-class ggx_translucent_material : public material {
-public:
-	double a = 0.001; // ֲڶ
-	double m = 200; // ߹ϵڵbsdfۼ
-	vec3 radiance; // Էǿ
-	shared_ptr<medium> medium_outside_ptr = default_medium_ptr;
-	shared_ptr<medium> medium_inside_ptr = default_medium_ptr;
-	shared_ptr<texture> color_map_ptr = nullptr;
-	shared_ptr<texture> normal_map_ptr = nullptr;
-	shared_ptr<texture> displacement_map_ptr = nullptr;
-
-public:
-
-	ggx_translucent_material(double a_init, shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
-		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
-		a = a_init;
-		radiance = radiance_init;
-		color_map_ptr = color_map_ptr_init;
-		normal_map_ptr = normal_map_ptr_init;
-		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
-		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
-		displacement_map_ptr = displacement_map_ptr_init;
-	}
-
-	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front) const override {
-		vec3 wi;
-
-		// Ȩϵ
-		//double F_value = F0 + (1.0 - F0) * pow(1 - dot(wo, normali), 5);
-		double F_value;
-		double n_o = wo_front ? get_medium_outside_ptr()->n : get_medium_inside_ptr()->n;
-		double n_i = wo_front ? get_medium_inside_ptr()->n : get_medium_outside_ptr()->n;
-		double cos_theta_o = dot(wo, normali);
-		double cos_theta_i_2 = 1 - pow(n_o / n_i, 2) * (1 - pow(cos_theta_o, 2));
-		if (cos_theta_i_2 < 0) {
-			F_value = 1;
-		}
-		else {
-			double cos_theta_i = sqrt(cos_theta_i_2);
-			double Rs_value_1 = n_o * cos_theta_o;
-			double Rs_value_2 = n_i * cos_theta_i;
-			double Rs = pow((Rs_value_1 - Rs_value_2) / (Rs_value_1 + Rs_value_2), 2);
-			double Rp_value_1 = n_o * cos_theta_i;
-			double Rp_value_2 = n_i * cos_theta_o;
-			double Rp = pow((Rp_value_1 - Rp_value_2) / (Rp_value_1 + Rp_value_2), 2);
-			F_value = 0.5 * (Rs + Rp);
-		}
-
-		if (random_double() < F_value) { //TODO
-
-			// ݾ淴wi
-			wi = 2 * normali * dot(wo, normali) - wo;
-
-			double pdf = (m + 1) * pi2_inv * dot(wi, normali);
-			return make_tuple(pdf, wi, wo_front);
-		}
-		else {
-			// wi
-
-			// sinֵ
-			double sin_theta_i = sqrt(1 - cos_theta_i_2);
-			// 
-			if (sin_theta_i > 1) {
-				//return make_tuple(10000000, normali, wo_front);
-				// ݾ淴wi
-				wi = 2 * normali * dot(wo, normali) - wo;
-
-				double pdf = (m + 1) * pi2_inv * dot(wi, normali);
-				return make_tuple(pdf, wi, wo_front);
-			}
-			// 
-			double theta_i = asin(sin_theta_i);
-
-			// λڱʾ䷽עuv岻ͬ
-			vec3 tan_vec = -unit_vector(wo - dot(wo, normali) * normali);
-			// ䷽
-			vec3 wi = unit_vector(tan_vec * sin_theta_i - normali * cos(theta_i));
-
-			double pdf = (m + 1) * pi2_inv * dot(wi, normali);
-			return make_tuple(pdf, wi, not wo_front);
-		}
-	}
-
-	virtual tuple<double, vec3, vec3>
-		sample_positioni(const vec3& normalo, const vec3& positiono, shared_ptr<hittable> world) const override {
-
-		return make_tuple(1, normalo, positiono);
-	}
-
-	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const vec3& uv,
-		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const override {
-
-		if (wi_front == wo_front) { // wiwoͬ࣬ݷ
-
-			// ʱΪ1
-			// D NDF
-			double a2 = a * a;
-			vec3 h = unit_vector(wo + wi);
-			double D = a2 / (pi * pow(pow(dot(normalo, h), 2) * (a2 - 1) + 1, 2));
-
-			// G ڵ
-			double dot_n_v = dot(normalo, wo);
-			double dot_n_l = dot(normalo, wi);
-			double k = a * 0.5;
-			double G = dot_n_v / (dot_n_v * (1 - k) + k) * dot_n_l / (dot_n_l * (1 - k) + k);
-			double bsdf_value = 0.0001 * D * G / (4 * dot_n_v * dot_n_l);
-			return vec3(bsdf_value, bsdf_value, bsdf_value);
-		}
-		else { // wiwoͬ࣬
-			// ȸwiָwo
-			vec3 wo_re;
-
-			double n_i = wi_front ? get_medium_outside_ptr()->n : get_medium_inside_ptr()->n;
-			double n_o = wo_front ? get_medium_outside_ptr()->n : get_medium_inside_ptr()->n;
-			double sin_theta_o = n_i / n_o * sqrt(1 - pow(dot(wi, normali), 2));
-
-			if (sin_theta_o > 1) {
-				return vec3(0, 0, 0); // 䣬bsdfΪ0
-			}
-			double theta_o = asin(sin_theta_o);
-			vec3 tan_vec = -unit_vector(wi - dot(normali, wi) * normali);
-			wo_re = tan_vec * sin(theta_o) + normali * cos(theta_o);
-			vec3 wi_re = -tan_vec * sin(theta_o) + normali * cos(theta_o);
-
-			// bsdf
-			// D NDF
-			double a2 = a * a;
-			vec3 h = unit_vector(wo + wi_re);
-			double D = a2 / (pi * pow(pow(dot(normalo, h), 2) * (a2 - 1) + 1, 2));
-			// G ڵ
-			double dot_n_v = dot(normalo, wo);
-			double dot_n_l = dot(normalo, wi_re);
-			double k = a * 0.5;
-			double G = dot_n_v / (dot_n_v * (1 - k) + k) * dot_n_l / (dot_n_l * (1 - k) + k);
-			double bsdf_value = 0.0001 * D * G / (4 * dot_n_v * dot_n_l);
-
-			// ʣΪⷽȡֵΧͬ
-			double arcsin_max = std::min(n_i / n_o, n_o / n_i);
-			if (n_o < n_i) {
-				bsdf_value /= 1 - sqrt(1 - pow(arcsin_max, 2));
-			}
-			else {
-				bsdf_value *= 1 - sqrt(1 - pow(arcsin_max, 2));
-			}
-
-			return vec3(bsdf_value, bsdf_value, bsdf_value);
-		}
-	}
-
-	virtual vec3 get_radiance() const override {
-		return radiance;
-	}
-
-	virtual shared_ptr<texture> get_normal_map_ptr() const override {
-		return normal_map_ptr;
-	}
-
-	virtual shared_ptr<texture> get_color_map_ptr() const override {
-		return color_map_ptr;
-	}
-
-	virtual shared_ptr<medium> get_medium_outside_ptr() const override {
-		return medium_outside_ptr;
-	};
-
-	virtual shared_ptr<medium> get_medium_inside_ptr() const override {
-		return medium_inside_ptr;
-	};
-
-	virtual bool sample_light() const override {
-		return true;
-	}
-
-	virtual int get_material_number() const override {
-		return 5;
-	}
-};
-
-
-// 
-class translucent_material : public material {
-public:
-	double m = 2000; // ߹ϵڵbsdfۼ
-	vec3 radiance; // Էǿ
-	shared_ptr<medium> medium_outside_ptr = default_medium_ptr;
-	shared_ptr<medium> medium_inside_ptr = default_medium_ptr;
-	shared_ptr<texture> color_map_ptr = nullptr;
-	shared_ptr<texture> normal_map_ptr = nullptr;
-	shared_ptr<texture> displacement_map_ptr = nullptr;
-
-public:
-
-	translucent_material(shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
-		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
-		radiance = radiance_init;
-		color_map_ptr = color_map_ptr_init;
-		normal_map_ptr = normal_map_ptr_init;
-		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
-		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
-		displacement_map_ptr = displacement_map_ptr_init;
-	}
-
-	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front) const override {
-		vec3 wi;
-
-		// Ȩϵ
-		//double F_value = F0 + (1.0 - F0) * pow(1 - dot(wo, normali), 5);
-		double F_value;
-		double n_o = wo_front ? get_medium_outside_ptr()->n : get_medium_inside_ptr()->n;
-		double n_i = wo_front ? get_medium_inside_ptr()->n : get_medium_outside_ptr()->n;
-		double cos_theta_o = dot(wo, normali);
-		double cos_theta_i_2 = 1 - pow(n_o / n_i, 2) * (1 - pow(cos_theta_o, 2));
-		if (cos_theta_i_2 < 0) {
-			F_value = 1;
-		}
-		else {
-			double cos_theta_i = sqrt(cos_theta_i_2);
-			double Rs_value_1 = n_o * cos_theta_o;
-			double Rs_value_2 = n_i * cos_theta_i;
-			double Rs = pow((Rs_value_1 - Rs_value_2) / (Rs_value_1 + Rs_value_2), 2);
-			double Rp_value_1 = n_o * cos_theta_i;
-			double Rp_value_2 = n_i * cos_theta_o;
-			double Rp = pow((Rp_value_1 - Rp_value_2) / (Rp_value_1 + Rp_value_2), 2);
-			F_value = 0.5 * (Rs + Rp);
-		}
-
-		if (random_double() < F_value) { //TODO
-
-			// ݾ淴wi
-			wi = 2 * normali * dot(wo, normali) - wo;
-
-			double pdf = (m + 1) * pi2_inv * dot(wi, normali);
-			return make_tuple(pdf, wi, wo_front);
-		}
-		else {
-			// wi
-
-			// sinֵ
-			double sin_theta_i = sqrt(1 - cos_theta_i_2);
-			// 
-			if (sin_theta_i > 1) {
-				//return make_tuple(10000000, normali, wo_front);
-				// ݾ淴wi
-				wi = 2 * normali * dot(wo, normali) - wo;
-
-				double pdf = (m + 1) * pi2_inv * dot(wi, normali);
-				return make_tuple(pdf, wi, wo_front);
-			}
-			// 
-			double theta_i = asin(sin_theta_i);
-
-			// λڱʾ䷽עuv岻ͬ
-			vec3 tan_vec = -unit_vector(wo - dot(wo, normali) * normali);
-			// ䷽
-			vec3 wi = unit_vector(tan_vec * sin_theta_i - normali * cos(theta_i));
-
-			double pdf = (m + 1) * pi2_inv * dot(wi, normali);
-			return make_tuple(pdf, wi, not wo_front);
-		}
-	}
-
-	virtual tuple<double, vec3, vec3>
-		sample_positioni(const vec3& normalo, const vec3& positiono, shared_ptr<hittable> world) const override {
-
-		return make_tuple(1, normalo, positiono);
-	}
-
-	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const vec3& uv,
-		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const override {
-
-
-		if (wi_front == wo_front) { // wiwoͬ࣬ݷ
-			//wo_re = (2.0 * dot(normali, wi) * normali - wo);
-			double bsdf_value = (m + 1) * pi2_inv * pow(dot(normali, unit_vector(wi + wo)), m);
-			return vec3(bsdf_value, bsdf_value, bsdf_value);
-		}
-		else { // wiwoͬ࣬
-			// ȸwiָwo
-			vec3 wo_re;
-
-			double n_i = wi_front ? get_medium_outside_ptr()->n : get_medium_inside_ptr()->n;
-			double n_o = wo_front ? get_medium_outside_ptr()->n : get_medium_inside_ptr()->n;
-			double sin_theta_o = n_i / n_o * sqrt(1 - pow(dot(wi, normali), 2));
-
-			if (sin_theta_o > 1) {
-				return vec3(0, 0, 0); // 䣬bsdfΪ0
-			}
-			double theta_o = asin(sin_theta_o);
-			vec3 tan_vec = -unit_vector(wi - dot(normali, wi) * normali);
-			wo_re = tan_vec * sin(theta_o) + normali * cos(theta_o);
-			vec3 wi_re = -tan_vec * sin(theta_o) + normali * cos(theta_o);
-
-			double bsdf_value = (m + 1) * pi2_inv * pow(dot(normali, unit_vector(wi_re + wo)), m);
-
-			// ΪⷽȡֵΧͬ
-			double arcsin_max = std::min(n_i / n_o, n_o / n_i);
-			if (n_o < n_i) {
-				bsdf_value /= 1 - sqrt(1 - pow(arcsin_max, 2));
-			}
-			else {
-				bsdf_value *= 1 - sqrt(1 - pow(arcsin_max, 2));
-			}
-
-			return vec3(bsdf_value, bsdf_value, bsdf_value);
-		}
-	}
-
-	virtual vec3 get_radiance() const override {
-		return radiance;
-	}
-
-	virtual shared_ptr<texture> get_normal_map_ptr() const override {
-		return normal_map_ptr;
-	}
-
-	virtual shared_ptr<texture> get_color_map_ptr() const override {
-		return color_map_ptr;
-	}
-
-	virtual shared_ptr<texture> get_displacement_map_ptr() const override {
-		return displacement_map_ptr;
-	}
-
-	virtual shared_ptr<medium> get_medium_outside_ptr() const override {
-		return medium_outside_ptr;
-	};
-
-	virtual shared_ptr<medium> get_medium_inside_ptr() const override {
-		return medium_inside_ptr;
-	};
-
-	virtual bool sample_light() const override {
-		return true;
-	}
-
-	virtual int get_material_number() const override {
-		return 5;
-	}
-};
-
-
-struct disney_brdf_property {
-	double metallic = 0;
-	double subsurface = 0;
-	double specular = 0.5;
-	double roughness = 0.5;
-	double specularTint = 0;
-	double anisotropic = 0;
-	double sheen = 0;
-	double sheenTint = 0.5;
-	double clearcoat = 0;
-	double clearcoatGloss = 1;
-};
-
-// disney brdf
-class disney_material : public material {
-
-public:
-
-	disney_brdf_property property; // brdf
-	vec3 radiance; // Էǿ
-	shared_ptr<medium> medium_outside_ptr = default_medium_ptr;
-	shared_ptr<medium> medium_inside_ptr = default_medium_ptr;
-	shared_ptr<texture> color_map_ptr = nullptr;
-	shared_ptr<texture> normal_map_ptr = nullptr;
-	shared_ptr<texture> displacement_map_ptr = nullptr;
-
-public:
-
-	disney_material(disney_brdf_property property_init, shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
-		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
-		property = property_init;
-		radiance = radiance_init;
-		color_map_ptr = color_map_ptr_init;
-		normal_map_ptr = normal_map_ptr_init;
-		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
-		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
-		displacement_map_ptr = displacement_map_ptr_init;
-	}
-
-	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front) const override {
-
-		vec3 wi;
-		double pdf;
-
-		// cos-weighted
-		double rand1 = random_double();
-		double rand2 = random_double();
-
-		double theta = acos(sqrt(1 - rand1));
-		double phi = pi2 * rand2;
-
-		// ÷߹ϵ
-		vec3 b1, b2;
-		build_basis(normali, b1, b2);
-
-		// õwi
-		wi = normali * cos(theta) + b1 * sin(phi) * sin(theta) + b2 * cos(phi) * sin(theta);
-
-		pdf = cos(theta) * pi_inv;
-
-		return make_tuple(pdf, wi, wo_front);
-	}
-
-	virtual tuple<double, vec3, vec3>
-		sample_positioni(const vec3& normalo, const vec3& positiono, shared_ptr<hittable> world) const override {
-
-		return make_tuple(1, normalo, positiono);
-	}
-
-	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const vec3& uv,
-		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const override {
-		
-		vec3 X, Y;
-		build_basis(normalo, X, Y);
-
-		double NdotL = dot(normalo, wi);
-		double NdotV = dot(normalo, wo);
-		if (NdotL < 0 || NdotV < 0) return vec3(0, 0, 0);
-
-		vec3 H = unit_vector(wi + wo);
-		double NdotH = dot(normalo, H);
-		double LdotH = dot(wi, H);
-
-		vec3 Cdlin = color_map_ptr->get_value(uv);
-		double Cdlum = .3 * Cdlin[0] + .6 * Cdlin[1] + .1 * Cdlin[2]; // luminance approx.
-
-		vec3 Ctint = Cdlum > 0 ? Cdlin / Cdlum : vec3(1, 1, 1); // normalize lum. to isolate hue+sat
-		vec3 Cspec0 = mix(property.specular * .08 * mix(vec3(1, 1, 1), Ctint, property.specularTint), Cdlin, property.metallic);
-		vec3 Csheen = mix(vec3(1, 1, 1), Ctint, property.sheenTint);
-
-		// Diffuse fresnel - go from 1 at normal incidence to .5 at grazing
-		// and mix in diffuse retro-reflection based on roughness
-		double FL = SchlickFresnel(NdotL), FV = SchlickFresnel(NdotV);
-		double Fd90 = 0.5 + 2 * LdotH * LdotH * property.roughness;
-		double Fd = mix(1.0, Fd90, FL) * mix(1.0, Fd90, FV);
-
-		// Based on Hanrahan-Krueger brdf approximation of isotropic bssrdf
-		// 1.25 scale is used to (roughly) preserve albedo
-		// Fss90 used to "flatten" retroreflection based on roughness
-		double Fss90 = LdotH * LdotH * property.roughness;
-		double Fss = mix(1.0, Fss90, FL) * mix(1.0, Fss90, FV);
-		double ss = 1.25 * (Fss * (1 / (NdotL + NdotV) - .5) + .5);
-
-		// specular
-		double aspect = sqrt(1 - property.anisotropic * .9);
-		double ax = std::max(.001, sqr(property.roughness) / aspect);
-		double ay = std::max(.001, sqr(property.roughness) * aspect);
-		double Ds = GTR2_aniso(NdotH, dot(H, X), dot(H, Y), ax, ay);
-		double FH = SchlickFresnel(LdotH);
-		vec3 Fs = mix(Cspec0, vec3(1, 1, 1), FH);
-		double Gs;
-		Gs = smithG_GGX_aniso(NdotL, dot(wi, X), dot(wi, Y), ax, ay);
-		Gs *= smithG_GGX_aniso(NdotV, dot(wo, X), dot(wo, Y), ax, ay);
-
-		// sheen
-		vec3 Fsheen = FH * property.sheen * Csheen;
-
-		// clearcoat (ior = 1.5 -> F0 = 0.04)
-		double Dr = GTR1(NdotH, mix(.1, .001, property.clearcoatGloss));
-		double Fr = mix(.04, 1.0, FH);
-		double Gr = smithG_GGX(NdotL, .25) * smithG_GGX(NdotV, .25);
-
-		vec3 ret = ((1 / pi) * mix(Fd, ss, property.subsurface) * Cdlin + Fsheen)
-			* (1 - property.metallic)
-			+ vec3(Gs * Fs * Ds) + vec3(.25 * property.clearcoat * Gr * Fr * Dr);
-
-		return ret;
-	}
-
-	virtual vec3 get_radiance() const override {
-		return radiance;
-	}
-
-	virtual shared_ptr<texture> get_normal_map_ptr() const override {
-		return normal_map_ptr;
-	}
-
-	virtual shared_ptr<texture> get_color_map_ptr() const override {
-		return color_map_ptr;
-	}
-
-	virtual shared_ptr<texture> get_displacement_map_ptr() const override {
-		return displacement_map_ptr;
-	}
-
-	virtual shared_ptr<medium> get_medium_outside_ptr() const override {
-		return medium_outside_ptr;
-	};
-
-	virtual shared_ptr<medium> get_medium_inside_ptr() const override {
-		return medium_inside_ptr;
-	};
-
-	virtual bool sample_light() const override {
-		return true;
-	}
-
-	virtual int get_material_number() const override {
-		return 6;
-	}
-};
-
-template <typename material_name>
-constexpr int get_material_number() {
-	if (std::is_same_v<material_name, phong_material>) return 0;
-	if (std::is_same_v<material_name, ggx_metal_material>) return 1;
-	if (std::is_same_v<material_name, ggx_nonmetal_material>) return 2;
-	if (std::is_same_v<material_name, sss_material>) return 3;
-	if (std::is_same_v<material_name, ggx_translucent_material>) return 4;
-	if (std::is_same_v<material_name, translucent_material>) return 5;
-	if (std::is_same_v<material_name, disney_material>) return 6;
-}
-
-
+#pragma once
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include "global.h"
+#include "texture.h"
+#include "hittable.h"
+#include "sss_profile.h"
+#include "microfacet.h"
+
+struct hit_record;
+using std::tuple;
+using std::make_tuple;
+using std::tie;
+
+// 着色上下文
+// 每个着色点的纹理输入只读取一次，该着色点的所有bsdf计算都从这里读取，不再重复查询纹理
+struct shading_context {
+	vec3 uv;
+	vec3 color = vec3(1, 1, 1); // 图像纹理的RGB
+	double alpha = 1; // 图像纹理的alpha
+	double cone_width = 0; // 击中点处光锥的宽度，反弹后的光线从这个宽度继续扩散
+	double footprint = 0; // 纹理查找的足迹宽度（uv单位），用于选择mipmap层级
+	int lobe = 0; // 混合材质在该着色点选中的子材质（见mixed_material::init_context），其他材质不使用
+};
+
+class material {
+public:
+	// 采样入射角
+	// 返回值为{pdf，入射角，入射方向是否和法线同向}
+	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx) const = 0;
+
+	// 采样入射点
+	// 返回值为{pdf，入射点法线，入射点坐标}
+	virtual tuple<double, vec3, vec3> sample_positioni(const vec3& normalo, const vec3& positiono, const hittable& world) const = 0;
+
+	// 计算bsdf项
+	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const shading_context& ctx,
+		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const = 0;
+
+	// 给定wo时sample_wi采样到wi的pdf（立体角）
+	// 用于多重重要性采样的权重计算
+	virtual double pdf_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx, const vec3& wi, bool wi_front) const = 0;
+
+	// 获取材质自发光强度
+	virtual vec3 get_radiance(const shading_context& ctx) const = 0;
+
+	// 以下获取贴图与介质的函数都返回非持有指针，所有权在材质中
+	// 获取法线贴图指针
+	virtual const texture* get_normal_map_ptr() const = 0;
+
+	// 获取图像纹理指针
+	virtual const texture* get_color_map_ptr() const = 0;
+
+	// 获取置换贴图指针
+	virtual const texture* get_displacement_map_ptr() const = 0;
+
+	// 获取介质
+	// 可能返回空指针
+	virtual medium* get_medium_outside_ptr() const = 0;
+	virtual medium* get_medium_inside_ptr() const = 0;
+
+	// 是否为介质边界（两侧的介质不同），光线只在穿过介质边界时切换介质
+	bool is_medium_boundary() const {
+		return get_medium_outside_ptr() != get_medium_inside_ptr();
+	}
+
+	// 是否需要对光源采样
+	virtual bool sample_light() const = 0;
+
+	// 是否为镜面（或接近镜面）材质
+	// 光子追踪时光子会穿过这类材质继续传播，用于生成焦散
+	virtual bool is_specular() const = 0;
+
+	// 采样方向是否为delta分布（不能用pdf_wi表示，只能通过sample_wi得到）
+	// 双向路径追踪不在这类顶点上连接子路径；接近镜面但有连续pdf的材质不是delta
+	virtual bool is_delta() const = 0;
+
+	// 是否可以近似为漫反射材质
+	// 近似为漫反射的表面可以使用辐照度缓存计算间接光
+	virtual bool is_diffuse() const = 0;
+
+	// 获取漫反射部分的反照率，漫反射brdf为albedo / pi
+	virtual vec3 get_diffuse_albedo(const shading_context& ctx) const = 0;
+
+	// 获取材质编号
+	virtual int get_material_number() const = 0;
+
+	// 生成着色点上下文的最后一步，材质可以在这里做每个着色点只做一次的随机选择
+	// 之后该着色点上的所有调用（包括ReSTIR的目标函数和最终着色）都使用同一个上下文，结果一致
+	virtual void init_context(shading_context& ctx) const {}
+};
+
+// 对击中点应用法线贴图
+// 法线贴图只对最终的着色点计算一次，求交过程（包括阴影光线）中不再计算
+// 只有提供了切线的图元（三角形）支持法线贴图
+template <typename mat_type>
+void apply_normal_map(const mat_type& mat, hit_record& rec, const ray& r) {
+	const texture* normal_map_ptr = mat.get_normal_map_ptr();
+	if (normal_map_ptr == nullptr or rec.tangent.length_squared() == 0) return;
+
+	// 插值得到的法线（朝外）
+	vec3 normal = rec.front_face ? rec.normal : -rec.normal;
+	// 根据切线来计算正交且单位的切线基向量
+	vec3 basis_t = unit_vector(rec.tangent - dot(rec.tangent, normal) * normal);
+	// 计算副切线基向量
+	vec3 basis_b = cross(normal, basis_t);
+	// 从法线贴图获取切线空间坐标
+	vec3 tangent_coord = normal_map_ptr->get_value(rec.uv);
+	// 计算法线
+	normal = basis_t * tangent_coord[0] + basis_b * tangent_coord[1] + normal * tangent_coord[2];
+	rec.set_face_normal(r, normal);
+}
+
+// 生成着色点的上下文：应用法线贴图，根据光线的光锥计算纹理足迹，并一次读取图像纹理的颜色与alpha
+template <typename mat_type>
+shading_context make_shading_context(const mat_type& mat, hit_record& rec, const ray& r) {
+	apply_normal_map(mat, rec, r);
+	shading_context ctx;
+	ctx.uv = rec.uv;
+	// 光锥投影到表面上的宽度，倾斜入射时足迹按1 / cos拉长（各向同性近似，取长轴）
+	double distance = rec.t * r.dir.length();
+	ctx.cone_width = r.cone_width_at(distance);
+	double cos_theta = std::abs(dot(unit_vector(r.dir), rec.normal));
+	ctx.footprint = ctx.cone_width * rec.uv_density / std::max(cos_theta, 1e-3);
+	mat.get_color_map_ptr()->get_rgba(rec.uv, ctx.footprint, ctx.color, ctx.alpha);
+	mat.init_context(ctx);
+	return ctx;
+}
+
+// 粗糙度低于该值的金属材质视为镜面
+constexpr double specular_roughness_threshold = 0.05;
+
+// 菲涅尔系数不高于该值的ggx非金属材质近似为漫反射材质
+constexpr double diffuse_F0_threshold = 0.1;
+
+
+// Blinn-Phong 材质
+class phong_material final : public material {
+public:
+	vec3 radiance; // 自发光强度
+	shared_ptr<texture> color_map_ptr = nullptr;
+	shared_ptr<texture> normal_map_ptr = nullptr;
+	shared_ptr<texture> displacement_map_ptr = nullptr;
+	shared_ptr<medium> medium_outside_ptr = default_medium_ptr;
+	shared_ptr<medium> medium_inside_ptr = default_medium_ptr;
+	double kd = 0.9; // 漫反射系数
+	double ks = 0.1; // 镜面反射系数
+	double a = 0; // 高光参数，越大则高光越小。默认a = 0，即漫反射材质
+
+public:
+	// 使用一个颜色来构造材质
+	// 自动生成类型为simple_color_texture的纹理
+	phong_material(vec3 albedo_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0)) {
+		radiance = radiance_init;
+		color_map_ptr = make_shared<simple_color_texture>(albedo_init);
+		normal_map_ptr = nullptr;
+		medium_outside_ptr = default_medium_ptr;
+		medium_inside_ptr = default_medium_ptr;
+	}
+
+	// 使用高光参数和一个颜色来构造材质
+	// 自动生成类型为simple_color_texture的纹理
+	phong_material(double a_init, vec3 albedo_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0)) {
+		radiance = radiance_init;
+		color_map_ptr = make_shared<simple_color_texture>(albedo_init);
+		a = a_init;
+		normal_map_ptr = nullptr;
+		medium_outside_ptr = default_medium_ptr;
+		medium_inside_ptr = default_medium_ptr;
+	}
+
+	// 使用color_map来构造材质
+	phong_material(shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
+		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
+		radiance = radiance_init;
+		color_map_ptr = color_map_ptr_init;
+		normal_map_ptr = normal_map_ptr_init;
+		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
+		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
+		displacement_map_ptr = displacement_map_ptr_init;
+	}
+
+	// 使用高光参数和color_map来构造材质
+	phong_material(double a_init, shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
+		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
+		radiance = radiance_init;
+		color_map_ptr = color_map_ptr_init;
+		a = a_init;
+		normal_map_ptr = normal_map_ptr_init;
+		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
+		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
+		displacement_map_ptr = displacement_map_ptr_init;
+	}
+
+	// www.cs.princeton.edu/courses/archive/fall08/cos526/assign3/lawrence.pdf
+	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx) const {
+
+		// 混合cos-weighted采样和高光项重要性采样
+		// 两种采样的频率的比值等于kd与ks之比
+		vec3 wi;
+		double pdf;
+
+		if (random_double() < kd / (kd + ks)) {
+
+			// cos-weighted采样
+			double rand1 = random_double();
+			double rand2 = random_double();
+
+			double theta = acos(sqrt(1 - rand1));
+			double phi = pi2 * rand2;
+
+			// 利用法线构建坐标系
+			vec3 b1, b2;
+			build_basis(normali, b1, b2);
+
+			// 得到wi
+			wi = normali * cos(theta) + b1 * sin(phi) * sin(theta) + b2 * cos(phi) * sin(theta);
+
+			pdf = cos(theta) * pi_inv;
+		}
+		else {
+
+			// 高光项重要性采样
+			double rand1 = random_double();
+			double rand2 = random_double();
+
+			// 随机采样半程向量
+			double theta = acos(pow(rand1, 1.0 / (a + 1)));
+			double phi = pi2 * rand2;
+
+			vec3 b1, b2;
+			build_basis(normali, b1, b2);
+
+			vec3 h = normali * cos(theta) + b1 * sin(phi) * sin(theta) + b2 * cos(phi) * sin(theta);
+
+			// 根据镜面反射计算wi
+			wi = 2 * h * dot(wo, h) - wo;
+
+			if (dot(wi, normali) < 0) {
+				// 如果光线穿透，返回一个很大的pdf使该结果无贡献
+				pdf = 10000000;
+			}
+			else {
+				// 计算pdf
+				pdf = (a + 1) * pi2_inv * pow(cos(theta), a);
+			}
+		}
+
+		return make_tuple(pdf, wi, wo_front);
+
+	}
+
+	virtual tuple<double, vec3, vec3>
+		sample_positioni(const vec3& normalo, const vec3& positiono, const hittable& world) const {
+		return make_tuple(1, normalo, positiono);
+	}
+
+	// phong brdf
+	// zhuanlan.zhihu.com/p/500811555
+	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const shading_context& ctx,
+		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const override {
+		//auto ret1 = ctx.color * pi_inv;
+		vec3 ret_d = ctx.color * kd * pi_inv;
+		vec3 ret_s = vec3(ks, ks, ks) * (a + 2) * pi2_inv * pow(std::max(0.0, dot(normalo, unit_vector(wi + wo))), a);
+
+		return ret_d + ret_s;
+	}
+
+	virtual double pdf_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx, const vec3& wi, bool wi_front) const override {
+		double cos_theta = dot(wi, normali);
+		if (cos_theta <= 0) return 0;
+
+		// 与sample_wi一致，为cos-weighted采样和高光项采样的混合
+		// 高光项采样的是半程向量，转换到wi需要乘上雅可比行列式1 / (4 * dot(wo, h))
+		double pdf_d = cos_theta * pi_inv;
+		vec3 h = unit_vector(wi + wo);
+		double cos_oh = dot(wo, h);
+		double pdf_s = cos_oh > 0 ? (a + 1) * pi2_inv * pow(std::max(0.0, dot(normali, h)), a) * 0.25 / cos_oh : 0;
+		return (kd * pdf_d + ks * pdf_s) / (kd + ks);
+	}
+
+	virtual vec3 get_radiance(const shading_context& ctx) const override {
+		return radiance;
+	}
+
+	virtual const texture* get_normal_map_ptr() const override {
+		return normal_map_ptr.get();
+	}
+
+	virtual const texture* get_color_map_ptr() const override {
+		return color_map_ptr.get();
+	}
+
+	virtual const texture* get_displacement_map_ptr() const override {
+		return displacement_map_ptr.get();
+	}
+
+	virtual medium* get_medium_outside_ptr() const override {
+		return medium_outside_ptr.get();
+	};
+
+	virtual medium* get_medium_inside_ptr() const override {
+		return medium_inside_ptr.get();
+	};
+
+	virtual bool sample_light() const override {
+		return true;
+	}
+
+	virtual bool is_specular() const override {
+		return false;
+	}
+
+	virtual bool is_delta() const override {
+		return false;
+	}
+
+	virtual bool is_diffuse() const override {
+		return a == 0;
+	}
+
+	virtual vec3 get_diffuse_albedo(const shading_context& ctx) const override {
+		return ctx.color * kd + vec3(ks, ks, ks);
+	}
+
+	virtual int get_material_number() const override {
+		return 0;
+	}
+};
+
+
+// GGX金属材质
+class ggx_metal_material final : public material {
+public:
+	double a; // 粗糙度，[0,1]
+	vec3 radiance; // 自发光强度
+	shared_ptr<medium> medium_outside_ptr = default_medium_ptr;
+	shared_ptr<medium> medium_inside_ptr = default_medium_ptr;
+	shared_ptr<texture> color_map_ptr = nullptr; // 菲涅尔项初始值（颜色）
+	shared_ptr<texture> normal_map_ptr = nullptr;
+	shared_ptr<texture> displacement_map_ptr = nullptr;
+
+public:
+	// 用一种颜色构造material
+	ggx_metal_material(const double& a_init, const vec3& F0_init = vec3(1, 0.582, 0.0956), vec3 radiance_init = vec3(0.0, 0.0, 0.0)) {
+		a = a_init;
+		color_map_ptr = make_shared<simple_color_texture>(F0_init);
+		radiance = radiance_init;
+		medium_outside_ptr = default_medium_ptr;
+		medium_inside_ptr = default_medium_ptr;
+	}
+
+	// 用color_map构造material，同时也支持法线贴图
+	ggx_metal_material(const double& a_init, shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
+		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
+
+		a = a_init;
+		radiance = radiance_init;
+		color_map_ptr = color_map_ptr_init;
+		normal_map_ptr = normal_map_ptr_init;
+		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
+		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
+		displacement_map_ptr = displacement_map_ptr_init;
+	}
+
+	// 必须输入单位向量!!!!!!!!
+	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx) const override {
+
+		// 按可见法线分布采样微表面法线(即wi和wo的半程向量)
+		vec3 h = sample_ggx_vndf(wo, normali, a, random_double(), random_double());
+
+		// 根据镜面反射计算wi
+		// 极少数情况下wi仍会低于表面，此时bsdf为0
+		vec3 wi = 2 * h * dot(wo, h) - wo;
+		double pdf = ggx_vndf_reflection_pdf(wo, wi, normali, a);
+
+		return make_tuple(pdf, wi, wo_front);
+	}
+
+	virtual tuple<double, vec3, vec3>
+		sample_positioni(const vec3& normalo, const vec3& positiono, const hittable& world) const {
+		return make_tuple(1, normalo, positiono);
+	}
+
+	// 必须输入单位向量!!!!!!!!
+	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const shading_context& ctx,
+		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const override {
+		double dot_n_v = dot(normalo, wo);
+		double dot_n_l = dot(normalo, wi);
+		if (dot_n_v <= 0 or dot_n_l <= 0) return vec3(0, 0, 0);
+
+		// F 菲涅尔项
+		vec3 h = unit_vector(wi + wo);
+		vec3 F0 = ctx.color;
+		vec3 F = F0 + (vec3(1.0, 1.0, 1.0) - F0) * pow(1 - dot(wo, h), 5);
+
+		// D NDF项
+		double D = ggx_D(dot(normalo, h), a);
+
+		// G 几何项（考虑遮挡）
+		double G = ggx_schlick_G(dot_n_v, dot_n_l, a);
+
+		// 单次散射项之外加上多次散射的能量补偿
+		return D * F * G / (4 * dot_n_v * dot_n_l) + ggx_albedo().multiple_scattering(dot_n_v, dot_n_l, a, F0);
+	}
+
+	virtual double pdf_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx, const vec3& wi, bool wi_front) const override {
+		if (dot(wi, normali) <= 0) return 0;
+		return ggx_vndf_reflection_pdf(wo, wi, normali, a);
+	}
+
+	virtual vec3 get_radiance(const shading_context& ctx) const override {
+		return radiance;
+	}
+
+	virtual const texture* get_normal_map_ptr() const override {
+		return normal_map_ptr.get();
+	}
+
+	virtual const texture* get_color_map_ptr() const override {
+		return color_map_ptr.get();
+	}
+
+	virtual const texture* get_displacement_map_ptr() const override {
+		return displacement_map_ptr.get();
+	}
+
+	virtual medium* get_medium_outside_ptr() const override {
+		return medium_outside_ptr.get();
+	};
+
+	virtual medium* get_medium_inside_ptr() const override {
+		return medium_inside_ptr.get();
+	};
+
+	virtual bool sample_light() const override {
+		return true;
+	}
+
+	virtual bool is_specular() const override {
+		return a < specular_roughness_threshold;
+	}
+
+	virtual bool is_delta() const override {
+		return false;
+	}
+
+	virtual bool is_diffuse() const override {
+		return false;
+	}
+
+	virtual vec3 get_diffuse_albedo(const shading_context& ctx) const override {
+		return vec3(0, 0, 0);
+	}
+
+	virtual int get_material_number() const override {
+		return 1;
+	}
+};
+
+
+// GGX非金属材质
+class ggx_nonmetal_material final : public material {
+public:
+	double a; // 高光项粗糙度，[0,1]
+	vec3 radiance; // 自发光强度
+	double F0; // 菲涅尔系数，决定了高光项和漫反射项的比例
+	shared_ptr<medium> medium_outside_ptr = default_medium_ptr;
+	shared_ptr<medium> medium_inside_ptr = default_medium_ptr;
+	shared_ptr<texture> color_map_ptr = nullptr; // 漫反射项颜色
+	shared_ptr<texture> normal_map_ptr = nullptr;
+	shared_ptr<texture> displacement_map_ptr = nullptr;
+
+public:
+	// 用color_map构造material，同时也支持法线贴图
+	ggx_nonmetal_material(const double& a_init, const double& F0_init, shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
+		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
+
+		a = a_init;
+		F0 = F0_init;
+		radiance = radiance_init;
+		color_map_ptr = color_map_ptr_init;
+		normal_map_ptr = normal_map_ptr_init;
+		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
+		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
+		displacement_map_ptr = displacement_map_ptr_init;
+	}
+
+	// 接下来需要完成brdf和采样函数
+
+	// 必须输入单位向量!!!!!!!!
+	// 随机使用ggx可见法线采样或漫反射重要性采样（cos-weighted采样）
+	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx) const override {
+
+		vec3 wi;
+
+		// 两种采样方法的权重根据高光项与漫反射项在wo方向的反照率决定
+		double p_specular = specular_probability(dot(wo, normali));
+		if (random_double() < p_specular) {
+			// 按可见法线分布采样微表面法线，根据镜面反射计算wi
+			vec3 h = sample_ggx_vndf(wo, normali, a, random_double(), random_double());
+			wi = 2 * h * dot(wo, h) - wo;
+		}
+		else {
+
+			// cos-weighted采样
+			double rand1 = random_double();
+			double rand2 = random_double();
+
+			double theta = acos(sqrt(1 - rand1));
+			double phi = pi2 * rand2;
+
+			// 利用法线构建坐标系
+			vec3 b1, b2;
+			build_basis(normali, b1, b2);
+
+			// 得到wi
+			wi = normali * cos(theta) + b1 * sin(phi) * sin(theta) + b2 * cos(phi) * sin(theta);
+		}
+
+		// 混合pdf
+		double pdf = p_specular * ggx_vndf_reflection_pdf(wo, wi, normali, a) + (1 - p_specular) * std::max(dot(wi, normali), 0.0) * pi_inv;
+
+		return make_tuple(pdf, wi, wo_front);
+	}
+
+	virtual tuple<double, vec3, vec3>
+		sample_positioni(const vec3& normalo, const vec3& positiono, const hittable& world) const {
+		return make_tuple(1, normalo, positiono);
+	}
+
+	// 必须输入单位向量!!!!!!!!
+	// brdf是漫反射项与高光项的和
+	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const shading_context& ctx,
+		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const override {
+
+		// 高光项（使用ggx模型）
+
+		// wo或wi低于表面时高光项为0
+		vec3 component_ggx = vec3(0, 0, 0);
+		double dot_n_v = dot(normalo, wo);
+		double dot_n_l = dot(normalo, wi);
+		if (dot_n_v > 0 and dot_n_l > 0) {
+			// F 菲涅尔项
+			// 对于非金属，菲涅尔项的RGB值相等
+			vec3 h = unit_vector(wi + wo);
+			double F_value = F0 + (1.0 - F0) * pow(1 - dot(wo, h), 5);
+			vec3 F(F_value, F_value, F_value);
+			// D NDF项
+			double D = ggx_D(dot(normalo, h), a);
+			// G 几何项（考虑遮挡）
+			double G = ggx_schlick_G(dot_n_v, dot_n_l, a);
+
+			component_ggx = F * D * G / (4 * dot_n_v * dot_n_l);
+		}
+
+		// 漫反射项
+		vec3 component_diffuse = (vec3(1 - F0, 1 - F0, 1 - F0)) * ctx.color * pi_inv;
+		//vec3 component_diffuse = (vec3(1 - F_value, 1 - F_value, 1 - F_value)) * ctx.color * pi_inv;
+
+		return component_ggx + component_diffuse;
+	}
+
+	virtual double pdf_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx, const vec3& wi, bool wi_front) const override {
+		double cos_theta = dot(wi, normali);
+		if (cos_theta <= 0) return 0;
+
+		// ggx可见法线采样与cos-weighted采样按反照率混合
+		double p_specular = specular_probability(dot(wo, normali));
+		return p_specular * ggx_vndf_reflection_pdf(wo, wi, normali, a) + (1 - p_specular) * cos_theta * pi_inv;
+	}
+
+	// 选择高光项采样的概率
+	// 高光项的反照率来自预计算的表，漫反射项的反照率取上限1 - F0（采样时不知道纹理颜色）
+	double specular_probability(double cos_o) const {
+		double albedo_specular = ggx_albedo().albedo(cos_o, a, F0);
+		double albedo_diffuse = 1 - F0;
+		if (albedo_specular + albedo_diffuse <= 0) return 0;
+		return albedo_specular / (albedo_specular + albedo_diffuse);
+	}
+
+	virtual vec3 get_radiance(const shading_context& ctx) const override {
+		return radiance;
+	}
+
+	virtual const texture* get_normal_map_ptr() const override {
+		return normal_map_ptr.get();
+	}
+
+	virtual const texture* get_color_map_ptr() const override {
+		return color_map_ptr.get();
+	}
+
+	virtual const texture* get_displacement_map_ptr() const override {
+		return displacement_map_ptr.get();
+	}
+
+	virtual medium* get_medium_outside_ptr() const override {
+		return medium_outside_ptr.get();
+	};
+
+	virtual medium* get_medium_inside_ptr() const override {
+		return medium_inside_ptr.get();
+	};
+
+	virtual bool sample_light() const override {
+		return true;
+	}
+
+	virtual bool is_specular() const override {
+		return false;
+	}
+
+	virtual bool is_delta() const override {
+		return false;
+	}
+
+	virtual bool is_diffuse() const override {
+		return F0 <= diffuse_F0_threshold;
+	}
+
+	virtual vec3 get_diffuse_albedo(const shading_context& ctx) const override {
+		return ctx.color * (1 - F0);
+	}
+
+	virtual int get_material_number() const override {
+		return 2;
+	}
+};
+
+
+// 次表面散射材质
+// 扩散剖面在构造时预计算为CDF表，RGB三个通道可以使用不同的散射半径
+// 入射点采样时随机选择颜色通道与投影轴（法线方向及两个切线方向），pdf为所有通道与投影轴组合的混合（one-sample MIS）
+class sss_material final : public material {
+public:
+	vec3 radiance; // 自发光强度
+	double F0;
+	vec3 scatter_radius = vec3(0.15, 0.15, 0.15); // 各通道的散射半径（剖面尺度d）
+	sss_profile_table profile; // 扩散剖面表
+	shared_ptr<hittable> probe_root = nullptr; // 投影时使用的局部bvh，只包含使用该材质的物体，为空时投影到整个场景
+	static constexpr bool per_object_state = true; // probe_root属于使用该材质的物体，参数相同的材质也不能合并（见resource_manager::get_material）
+	shared_ptr<medium> medium_outside_ptr = default_medium_ptr;
+	shared_ptr<medium> medium_inside_ptr = default_medium_ptr;
+	shared_ptr<texture> color_map_ptr = nullptr;
+	shared_ptr<texture> normal_map_ptr = nullptr;
+	shared_ptr<texture> displacement_map_ptr = nullptr;
+
+public:
+	// 使用一个颜色来构造材质
+	// 自动生成类型为simple_color_texture的纹理
+	sss_material(double F0_init, vec3 albedo_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0)) {
+		color_map_ptr = make_shared<simple_color_texture>(albedo_init);
+		radiance = radiance_init;
+		F0 = F0_init;
+		medium_outside_ptr = default_medium_ptr;
+		medium_inside_ptr = default_medium_ptr;
+	}
+
+
+	// 使用color_map来构造材质
+	sss_material(double F0_init, shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
+		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
+		color_map_ptr = color_map_ptr_init;
+		radiance = radiance_init;
+		normal_map_ptr = normal_map_ptr_init;
+		F0 = F0_init;
+		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
+		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
+		displacement_map_ptr = displacement_map_ptr_init;
+	}
+
+	// 设置扩散剖面与各通道的散射半径，重新生成剖面表
+	void set_profile(sss_profile_type type, const vec3& scatter_radius_init) {
+		profile = sss_profile_table(type);
+		scatter_radius = scatter_radius_init;
+	}
+
+	// 采样球半径，取各通道中最大的截断半径
+	double max_radius() const {
+		return std::max(scatter_radius[0], std::max(scatter_radius[1], scatter_radius[2])) * profile.r_max;
+	}
+
+	// 沿投影轴axis穿过point的投影线段（在以positiono为球心的采样球内）上属于该材质的交点数
+	// 与采样时的投影相同，point本身也在线段上，结果至少为1
+	int probe_hit_num(const hittable& probe, const vec3& positiono, const vec3& point, const vec3& axis) const {
+		vec3 d = point - positiono;
+		double h = dot(d, axis);
+		double r_max = max_radius();
+		double l2 = r_max * r_max - (d.length_squared() - h * h);
+		if (l2 <= 0) return 1;
+		double l = sqrt(l2);
+		static thread_local std::vector<hit_record> axis_hits;
+		axis_hits.clear();
+		probe.hit_all(ray(point + axis * (l - h), -axis), 0, 2 * l, axis_hits);
+		int hit_num = 0;
+		for (const hit_record& rec : axis_hits) {
+			if (rec.mat_ptr() == this) hit_num++;
+		}
+		return std::max(hit_num, 1);
+	}
+
+	// 入射点的面积pdf
+	// 对3个投影轴与3个颜色通道求和，每个组合的pdf为该通道剖面在投影平面上的pdf乘以投影的cos，再乘以在该轴的投影线段上选中这个交点的概率1 / hit_num[a]
+	double position_pdf(const vec3& normalo, const vec3& positiono, const vec3& normali, const vec3& positioni, const int hit_num[3]) const {
+		vec3 b1, b2;
+		build_basis(normalo, b1, b2);
+		const vec3 axes[3] = { normalo, b1, b2 };
+		const double axis_probability[3] = { 0.5, 0.25, 0.25 };
+
+		vec3 d = positioni - positiono;
+		double pdf = 0;
+		for (int a = 0; a < 3; a++) {
+			double h = dot(d, axes[a]);
+			double r = sqrt(std::max(0.0, d.length_squared() - h * h));
+			double pdf_axis = 0;
+			for (int c = 0; c < 3; c++) pdf_axis += profile.eval(r, scatter_radius[c]);
+			pdf += axis_probability[a] * pdf_axis / 3 * fabs(dot(normali, axes[a])) / hit_num[a];
+		}
+		return pdf;
+	}
+
+	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx) const override {
+
+		// cos-weighted采样
+		double rand1 = random_double();
+		double rand2 = random_double();
+
+		double theta = acos(sqrt(1 - rand1));
+		double phi = pi2 * rand2;
+
+		// 利用法线构建坐标系
+		vec3 b1, b2;
+		build_basis(normali, b1, b2);
+
+		// 得到wi
+		vec3 wi = normali * cos(theta) + b1 * sin(phi) * sin(theta) + b2 * cos(phi) * sin(theta);
+
+		double pdf = cos(theta) * pi_inv;
+
+		return make_tuple(pdf, wi, wo_front);
+	}
+
+	virtual tuple<double, vec3, vec3>
+		sample_positioni(const vec3& normalo, const vec3& positiono, const hittable& world) const override {
+
+		// 选择投影轴，法线方向的概率为0.5，两个切线方向各为0.25
+		vec3 b1, b2;
+		build_basis(normalo, b1, b2);
+		vec3 axis, u1, u2;
+		int axis_index;
+		double rand_axis = random_double();
+		if (rand_axis < 0.5) {
+			axis = normalo; u1 = b1; u2 = b2; axis_index = 0;
+		}
+		else if (rand_axis < 0.75) {
+			axis = b1; u1 = b2; u2 = normalo; axis_index = 1;
+		}
+		else {
+			axis = b2; u1 = normalo; u2 = b1; axis_index = 2;
+		}
+
+		// 选择颜色通道，按该通道的剖面采样半径
+		int channel = std::min(static_cast<int>(random_double() * 3), 2);
+		double r = scatter_radius[channel] * profile.sample(random_double());
+		double phi = pi2 * random_double();
+
+		// 获取投影前点的位置（在与投影轴垂直的圆盘上）
+		vec3 positioni_0 = positiono + u1 * r * cos(phi) + u2 * r * sin(phi);
+
+		// 进行投影
+		// 沿投影轴在采样球内的线段上一次性收集所有交点，只保留属于该材质的交点，然后随机选择其中一个
+		const hittable& probe = probe_root ? *probe_root : world;
+		double r_max = max_radius();
+		double l = sqrt(std::max(0.0, r_max * r_max - r * r));
+		// 交点数组每个线程只分配一次，避免每次采样都分配内存
+		static thread_local std::vector<hit_record> probe_hits;
+		probe_hits.clear();
+		ray probe_ray(positioni_0 + axis * l, -axis);
+		probe.hit_all(probe_ray, 0, 2 * l, probe_hits);
+		int hit_num = 0;
+		for (const hit_record& rec : probe_hits) {
+			if (rec.mat_ptr() == this) probe_hits[hit_num++] = rec;
+		}
+
+		vec3 positioni, normali;
+		int axis_hit_num[3] = { 1, 1, 1 }; // 各投影轴穿过入射点的线段上的交点数
+		if (hit_num > 0) {
+			hit_record& rec = probe_hits[std::min(static_cast<int>(random_double() * hit_num), hit_num - 1)];
+			apply_normal_map(*this, rec, probe_ray); // 求交时不计算法线贴图，只对选中的交点计算
+			positioni = rec.p;
+			normali = rec.front_face ? rec.normal : -rec.normal; // 使用向外的法线
+
+			// 其它两个投影轴也可能采样到这个点，它们的选择概率取决于各自线段上的交点数，需要再各投影一次
+			const vec3 axes[3] = { normalo, b1, b2 };
+			for (int a = 0; a < 3; a++) {
+				axis_hit_num[a] = a == axis_index ? hit_num : probe_hit_num(probe, positiono, positioni, axes[a]);
+			}
+		}
+		else {
+			positioni = positioni_0;
+			normali = normalo;
+		}
+
+		// 计算pdf，每个投影轴上随机选择交点的概率为1 / hit_num
+		double pdf = position_pdf(normalo, positiono, normali, positioni, axis_hit_num);
+
+		return make_tuple(pdf, normali, positioni);
+	}
+
+	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const shading_context& ctx,
+		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const override {
+
+		// 出射折射菲涅尔项
+		double F_value_o = F0 + (1.0 - F0) * pow(1 - std::max(dot(wo, normalo), 0.0), 5);
+		vec3 F_o(1 - F_value_o, 1 - F_value_o, 1 - F_value_o);
+
+		// 入射折射菲涅尔项
+		double F_value_i = F0 + (1.0 - F0) * pow(1 - std::max(dot(wi, normali), 0.0), 5);
+		vec3 F_i(1 - F_value_i, 1 - F_value_i, 1 - F_value_i);
+
+		// Rd项，各通道使用各自的散射半径
+		double r = (positiono - positioni).length();
+		vec3 Rd(profile.eval(r, scatter_radius[0]), profile.eval(r, scatter_radius[1]), profile.eval(r, scatter_radius[2]));
+
+		//return pi_inv * Rd * F_o * F_i * ctx.color;
+		return pi_inv * Rd * ctx.color;
+	}
+
+	virtual double pdf_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx, const vec3& wi, bool wi_front) const override {
+		double cos_theta = dot(wi, normali);
+		if (cos_theta <= 0) return 0;
+		return cos_theta * pi_inv;
+	}
+
+	virtual vec3 get_radiance(const shading_context& ctx) const override {
+		return radiance;
+	}
+
+	virtual const texture* get_normal_map_ptr() const override {
+		return normal_map_ptr.get();
+	}
+
+	virtual const texture* get_color_map_ptr() const override {
+		return color_map_ptr.get();
+	}
+
+	virtual const texture* get_displacement_map_ptr() const override {
+		return displacement_map_ptr.get();
+	}
+
+	virtual medium* get_medium_outside_ptr() const override {
+		return medium_outside_ptr.get();
+	};
+
+	virtual medium* get_medium_inside_ptr() const override {
+		return medium_inside_ptr.get();
+	};
+
+	virtual bool sample_light() const override {
+		return true;
+	}
+
+	virtual bool is_specular() const override {
+		return false;
+	}
+
+	virtual bool is_delta() const override {
+		return false;
+	}
+
+	virtual bool is_diffuse() const override {
+		return false;
+	}
+
+	virtual vec3 get_diffuse_albedo(const shading_context& ctx) const override {
+		return vec3(0, 0, 0);
+	}
+
+	virtual int get_material_number() const override {
+		return 3;
+	}
+};
+
+
+// ggx玻璃材质
+class ggx_translucent_material final : public material {
+public:
+	double a = 0.001; // 表面粗糙度
+	vec3 radiance; // 自发光强度
+	shared_ptr<medium> medium_outside_ptr = default_medium_ptr;
+	shared_ptr<medium> medium_inside_ptr = default_medium_ptr;
+	shared_ptr<texture> color_map_ptr = nullptr;
+	shared_ptr<texture> normal_map_ptr = nullptr;
+	shared_ptr<texture> displacement_map_ptr = nullptr;
+
+public:
+
+	ggx_translucent_material(double a_init, shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
+		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
+		a = a_init;
+		radiance = radiance_init;
+		color_map_ptr = color_map_ptr_init;
+		normal_map_ptr = normal_map_ptr_init;
+		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
+		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
+		displacement_map_ptr = displacement_map_ptr_init;
+	}
+
+	// 粗糙电介质，参考 Walter 2007, Microfacet Models for Refraction through Rough Surfaces
+	// 按可见法线分布采样微表面法线，再按微表面上的菲涅尔项随机选择反射或折射
+	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx) const override {
+		double n_o = wo_front ? get_medium_outside_ptr()->n : get_medium_inside_ptr()->n;
+		double n_i = wo_front ? get_medium_inside_ptr()->n : get_medium_outside_ptr()->n;
+
+		vec3 h = sample_ggx_vndf(wo, normali, a, random_double(), random_double());
+		double cos_oh = dot(wo, h);
+		double pdf_h = ggx_vndf_pdf(wo, h, normali, a);
+		double F_value = fresnel_dielectric(cos_oh, n_o, n_i);
+
+		if (random_double() < F_value) {
+			// 根据镜面反射计算wi
+			vec3 wi = 2 * h * cos_oh - wo;
+			double pdf = F_value * pdf_h * 0.25 / cos_oh;
+			return make_tuple(pdf, wi, wo_front);
+		}
+		else {
+			// 根据折射计算wi（F_value < 1，所以一定存在折射光）
+			double eta = n_o / n_i;
+			double cos_ih = -sqrt(std::max(0.0, 1 - eta * eta * (1 - cos_oh * cos_oh)));
+			vec3 wi = (eta * cos_oh + cos_ih) * h - eta * wo;
+
+			// 微表面法线到wi的雅可比行列式
+			double denom = n_o * cos_oh + n_i * cos_ih;
+			double pdf = (1 - F_value) * pdf_h * n_i * n_i * fabs(cos_ih) / (denom * denom);
+
+			// 折射时pdf取负值，与cos相除后为正
+			return make_tuple(-pdf, wi, not wo_front);
+		}
+	}
+
+	virtual tuple<double, vec3, vec3>
+		sample_positioni(const vec3& normalo, const vec3& positiono, const hittable& world) const override {
+
+		return make_tuple(1, normalo, positiono);
+	}
+
+	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const shading_context& ctx,
+		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const override {
+
+		double n_o = wo_front ? get_medium_outside_ptr()->n : get_medium_inside_ptr()->n;
+		double n_i = wo_front ? get_medium_inside_ptr()->n : get_medium_outside_ptr()->n;
+		double cos_o = dot(normalo, wo);
+		double cos_i = dot(normalo, wi);
+		if (cos_o <= 0) return vec3(0, 0, 0);
+
+		if (wi_front == wo_front) { // 如果wi和wo同侧，则根据反射计算
+			if (cos_i <= 0) return vec3(0, 0, 0);
+			vec3 h = unit_vector(wo + wi);
+			double F_value = fresnel_dielectric(dot(wo, h), n_o, n_i);
+			double D = ggx_D(dot(normalo, h), a);
+			double G = ggx_G1(cos_o, a) * ggx_G1(cos_i, a);
+			double bsdf_value = F_value * D * G / (4 * cos_o * cos_i);
+			return vec3(bsdf_value, bsdf_value, bsdf_value);
+		}
+		else { // 如果wi和wo不同侧，则根据折射计算
+			if (cos_i >= 0) return vec3(0, 0, 0);
+
+			// 折射的半程向量，朝向wo一侧
+			vec3 h = -unit_vector(n_o * wo + n_i * wi);
+			if (dot(h, normalo) < 0) h = -h;
+			double cos_oh = dot(wo, h);
+			double cos_ih = dot(wi, h);
+			if (cos_oh <= 0 or cos_ih >= 0) return vec3(0, 0, 0);
+
+			double F_value = fresnel_dielectric(cos_oh, n_o, n_i);
+			double D = ggx_D(dot(normalo, h), a);
+			double G = ggx_G1(cos_o, a) * ggx_G1(cos_i, a);
+			double denom = n_o * cos_oh + n_i * cos_ih;
+			double bsdf_value = fabs(cos_ih) * cos_oh / (cos_o * fabs(cos_i)) * n_o * n_o * (1 - F_value) * D * G / (denom * denom);
+			return vec3(bsdf_value, bsdf_value, bsdf_value);
+		}
+	}
+
+	// 与sample_wi一致：可见法线分布的pdf乘上选择反射或折射的概率，再乘上半程向量到wi的雅可比行列式
+	// 折射的pdf也返回正值
+	virtual double pdf_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx, const vec3& wi, bool wi_front) const override {
+		double n_o = wo_front ? get_medium_outside_ptr()->n : get_medium_inside_ptr()->n;
+		double n_i = wo_front ? get_medium_inside_ptr()->n : get_medium_outside_ptr()->n;
+		double cos_o = dot(normali, wo);
+		double cos_i = dot(normali, wi);
+		if (cos_o <= 0) return 0;
+
+		if (wi_front == wo_front) {
+			if (cos_i <= 0) return 0;
+			vec3 h = unit_vector(wo + wi);
+			double cos_oh = dot(wo, h);
+			if (cos_oh <= 0) return 0;
+			return fresnel_dielectric(cos_oh, n_o, n_i) * ggx_vndf_pdf(wo, h, normali, a) * 0.25 / cos_oh;
+		}
+		else {
+			if (cos_i >= 0) return 0;
+			vec3 h = -unit_vector(n_o * wo + n_i * wi);
+			if (dot(h, normali) < 0) h = -h;
+			double cos_oh = dot(wo, h);
+			double cos_ih = dot(wi, h);
+			if (cos_oh <= 0 or cos_ih >= 0) return 0;
+			double denom = n_o * cos_oh + n_i * cos_ih;
+			return (1 - fresnel_dielectric(cos_oh, n_o, n_i)) * ggx_vndf_pdf(wo, h, normali, a) * n_i * n_i * fabs(cos_ih) / (denom * denom);
+		}
+	}
+
+	virtual vec3 get_radiance(const shading_context& ctx) const override {
+		return radiance;
+	}
+
+	virtual const texture* get_normal_map_ptr() const override {
+		return normal_map_ptr.get();
+	}
+
+	virtual const texture* get_color_map_ptr() const override {
+		return color_map_ptr.get();
+	}
+
+	virtual const texture* get_displacement_map_ptr() const override {
+		return displacement_map_ptr.get();
+	}
+
+	virtual medium* get_medium_outside_ptr() const override {
+		return medium_outside_ptr.get();
+	};
+
+	virtual medium* get_medium_inside_ptr() const override {
+		return medium_inside_ptr.get();
+	};
+
+	virtual bool sample_light() const override {
+		return true;
+	}
+
+	virtual bool is_specular() const override {
+		return true;
+	}
+
+	virtual bool is_delta() const override {
+		return false;
+	}
+
+	virtual bool is_diffuse() const override {
+		return false;
+	}
+
+	virtual vec3 get_diffuse_albedo(const shading_context& ctx) const override {
+		return vec3(0, 0, 0);
+	}
+
+	virtual int get_material_number() const override {
+		return 5;
+	}
+};
+
+
+// 玻璃材质
+class translucent_material final : public material {
+public:
+	double m = 2000; // 高光项系数，用于调整bsdf的能量聚集度
+	vec3 radiance; // 自发光强度
+	shared_ptr<medium> medium_outside_ptr = default_medium_ptr;
+	shared_ptr<medium> medium_inside_ptr = default_medium_ptr;
+	shared_ptr<texture> color_map_ptr = nullptr;
+	shared_ptr<texture> normal_map_ptr = nullptr;
+	shared_ptr<texture> displacement_map_ptr = nullptr;
+
+public:
+
+	translucent_material(shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
+		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
+		radiance = radiance_init;
+		color_map_ptr = color_map_ptr_init;
+		normal_map_ptr = normal_map_ptr_init;
+		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
+		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
+		displacement_map_ptr = displacement_map_ptr_init;
+	}
+
+	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx) const override {
+		vec3 wi;
+
+		// 计算菲涅尔加权系数
+		//double F_value = F0 + (1.0 - F0) * pow(1 - dot(wo, normali), 5);
+		double F_value;
+		double n_o = wo_front ? get_medium_outside_ptr()->n : get_medium_inside_ptr()->n;
+		double n_i = wo_front ? get_medium_inside_ptr()->n : get_medium_outside_ptr()->n;
+		double cos_theta_o = dot(wo, normali);
+		double cos_theta_i_2 = 1 - pow(n_o / n_i, 2) * (1 - pow(cos_theta_o, 2));
+		if (cos_theta_i_2 < 0) {
+			F_value = 1;
+		}
+		else {
+			double cos_theta_i = sqrt(cos_theta_i_2);
+			double Rs_value_1 = n_o * cos_theta_o;
+			double Rs_value_2 = n_i * cos_theta_i;
+			double Rs = pow((Rs_value_1 - Rs_value_2) / (Rs_value_1 + Rs_value_2), 2);
+			double Rp_value_1 = n_o * cos_theta_i;
+			double Rp_value_2 = n_i * cos_theta_o;
+			double Rp = pow((Rp_value_1 - Rp_value_2) / (Rp_value_1 + Rp_value_2), 2);
+			F_value = 0.5 * (Rs + Rp);
+		}
+
+		if (random_double() < F_value) { //TODO
+
+			// 根据镜面反射计算wi
+			wi = 2 * normali * dot(wo, normali) - wo;
+
+			double pdf = (m + 1) * pi2_inv * dot(wi, normali);
+			return make_tuple(pdf, wi, wo_front);
+		}
+		else {
+			// 根据折射计算wi
+
+			// 获得折射角sin值
+			double sin_theta_i = sqrt(1 - cos_theta_i_2);
+			// 处理不存在折射光的情况
+			if (sin_theta_i > 1) {
+				//return make_tuple(10000000, normali, wo_front);
+				// 根据镜面反射计算wi
+				wi = 2 * normali * dot(wo, normali) - wo;
+
+				double pdf = (m + 1) * pi2_inv * dot(wi, normali);
+				return make_tuple(pdf, wi, wo_front);
+			}
+			// 计算折射角
+			double theta_i = asin(sin_theta_i);
+
+			// 切向单位向量（用于表示入射方向，注意与uv的切向含义不同）
+			vec3 tan_vec = -unit_vector(wo - dot(wo, normali) * normali);
+			// 计算出射方向
+			vec3 wi = unit_vector(tan_vec * sin_theta_i - normali * cos(theta_i));
+
+			double pdf = (m + 1) * pi2_inv * dot(wi, normali);
+			return make_tuple(pdf, wi, not wo_front);
+		}
+	}
+
+	virtual tuple<double, vec3, vec3>
+		sample_positioni(const vec3& normalo, const vec3& positiono, const hittable& world) const override {
+
+		return make_tuple(1, normalo, positiono);
+	}
+
+	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const shading_context& ctx,
+		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const override {
+
+
+		if (wi_front == wo_front) { // 如果wi和wo同侧，则根据反射计算
+			//wo_re = (2.0 * dot(normali, wi) * normali - wo);
+			double bsdf_value = (m + 1) * pi2_inv * pow(dot(normali, unit_vector(wi + wo)), m);
+			return vec3(bsdf_value, bsdf_value, bsdf_value);
+		}
+		else { // 如果wi和wo不同侧，则根据折射计算
+			// 先根据wi恢复出wo
+			vec3 wo_re;
+
+			double n_i = wi_front ? get_medium_outside_ptr()->n : get_medium_inside_ptr()->n;
+			double n_o = wo_front ? get_medium_outside_ptr()->n : get_medium_inside_ptr()->n;
+			double sin_theta_o = n_i / n_o * sqrt(1 - pow(dot(wi, normali), 2));
+
+			if (sin_theta_o > 1) {
+				return vec3(0, 0, 0); // 如果不存在折射，bsdf为0
+			}
+			double theta_o = asin(sin_theta_o);
+			vec3 tan_vec = -unit_vector(wi - dot(normali, wi) * normali);
+			wo_re = tan_vec * sin(theta_o) + normali * cos(theta_o);
+			vec3 wi_re = -tan_vec * sin(theta_o) + normali * cos(theta_o);
+
+			double bsdf_value = (m + 1) * pi2_inv * pow(dot(normali, unit_vector(wi_re + wo)), m);
+
+			// 计算能量补偿项（因为入射光和折射光方向取值范围不同）
+			double arcsin_max = std::min(n_i / n_o, n_o / n_i);
+			if (n_o < n_i) {
+				bsdf_value /= 1 - sqrt(1 - pow(arcsin_max, 2));
+			}
+			else {
+				bsdf_value *= 1 - sqrt(1 - pow(arcsin_max, 2));
+			}
+
+			return vec3(bsdf_value, bsdf_value, bsdf_value);
+		}
+	}
+
+	virtual double pdf_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx, const vec3& wi, bool wi_front) const override {
+		// 镜面材质的方向分布接近delta，无法通过连接得到，pdf视为0
+		return 0;
+	}
+
+	virtual vec3 get_radiance(const shading_context& ctx) const override {
+		return radiance;
+	}
+
+	virtual const texture* get_normal_map_ptr() const override {
+		return normal_map_ptr.get();
+	}
+
+	virtual const texture* get_color_map_ptr() const override {
+		return color_map_ptr.get();
+	}
+
+	virtual const texture* get_displacement_map_ptr() const override {
+		return displacement_map_ptr.get();
+	}
+
+	virtual medium* get_medium_outside_ptr() const override {
+		return medium_outside_ptr.get();
+	};
+
+	virtual medium* get_medium_inside_ptr() const override {
+		return medium_inside_ptr.get();
+	};
+
+	virtual bool sample_light() const override {
+		return true;
+	}
+
+	virtual bool is_specular() const override {
+		return true;
+	}
+
+	virtual bool is_delta() const override {
+		return true;
+	}
+
+	virtual bool is_diffuse() const override {
+		return false;
+	}
+
+	virtual vec3 get_diffuse_albedo(const shading_context& ctx) const override {
+		return vec3(0, 0, 0);
+	}
+
+	virtual int get_material_number() const override {
+		return 5;
+	}
+};
+
+
+struct disney_brdf_property {
+	double metallic = 0;
+	double subsurface = 0;
+	double specular = 0.5;
+	double roughness = 0.5;
+	double specularTint = 0;
+	double anisotropic = 0;
+	double sheen = 0;
+	double sheenTint = 0.5;
+	double clearcoat = 0;
+	double clearcoatGloss = 1;
+};
+
+// disney brdf
+class disney_material final : public material {
+
+public:
+
+	disney_brdf_property property; // brdf参数
+	vec3 radiance; // 自发光强度
+	shared_ptr<medium> medium_outside_ptr = default_medium_ptr;
+	shared_ptr<medium> medium_inside_ptr = default_medium_ptr;
+	shared_ptr<texture> color_map_ptr = nullptr;
+	shared_ptr<texture> normal_map_ptr = nullptr;
+	shared_ptr<texture> displacement_map_ptr = nullptr;
+
+public:
+
+	disney_material(disney_brdf_property property_init, shared_ptr<texture> color_map_ptr_init, vec3 radiance_init = vec3(0.0, 0.0, 0.0), shared_ptr<texture> normal_map_ptr_init = nullptr,
+		shared_ptr<medium> medium_outside_ptr_init = nullptr, shared_ptr<medium> medium_inside_ptr_init = nullptr, shared_ptr<texture> displacement_map_ptr_init = nullptr) {
+		property = property_init;
+		radiance = radiance_init;
+		color_map_ptr = color_map_ptr_init;
+		normal_map_ptr = normal_map_ptr_init;
+		medium_outside_ptr = medium_outside_ptr_init ? medium_outside_ptr_init : default_medium_ptr;
+		medium_inside_ptr = medium_inside_ptr_init ? medium_inside_ptr_init : default_medium_ptr;
+		displacement_map_ptr = displacement_map_ptr_init;
+	}
+
+	// 按lobe重要性采样：漫反射项（cos-weighted），高光项（各向异性GTR2可见法线），清漆层（GTR1）
+	// 返回的pdf是三种采样方法按选择概率混合后的pdf
+	virtual tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx) const override {
+
+		vec3 wi;
+
+		// 切线方向与bsdf中各向异性高光项使用的一致
+		vec3 X, Y;
+		build_basis(normali, X, Y);
+		double ax, ay;
+		specular_alpha(ax, ay);
+
+		double p_diffuse, p_specular, p_clearcoat;
+		lobe_probabilities(dot(wo, normali), p_diffuse, p_specular, p_clearcoat);
+
+		double rand_lobe = random_double();
+		double rand1 = random_double();
+		double rand2 = random_double();
+		if (rand_lobe < p_specular) {
+			vec3 h = sample_ggx_vndf_aniso(wo, normali, X, Y, ax, ay, rand1, rand2);
+			wi = 2 * h * dot(wo, h) - wo;
+		}
+		else if (rand_lobe < p_specular + p_clearcoat) {
+			vec3 h = sample_gtr1(normali, clearcoat_alpha(), rand1, rand2);
+			wi = 2 * h * dot(wo, h) - wo;
+		}
+		else {
+			// cos-weighted采样
+			double theta = acos(sqrt(1 - rand1));
+			double phi = pi2 * rand2;
+			wi = normali * cos(theta) + X * sin(phi) * sin(theta) + Y * cos(phi) * sin(theta);
+		}
+
+		// 极少数情况下高光项或清漆层采样得到的wi低于表面，此时bsdf为0，pdf仍取混合pdf以避免除以0
+		return make_tuple(mixture_pdf(wo, normali, wi), wi, wo_front);
+	}
+
+	virtual tuple<double, vec3, vec3>
+		sample_positioni(const vec3& normalo, const vec3& positiono, const hittable& world) const override {
+
+		return make_tuple(1, normalo, positiono);
+	}
+
+	virtual vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const shading_context& ctx,
+		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const override {
+		
+		vec3 X, Y;
+		build_basis(normalo, X, Y);
+
+		double NdotL = dot(normalo, wi);
+		double NdotV = dot(normalo, wo);
+		if (NdotL < 0 || NdotV < 0) return vec3(0, 0, 0);
+
+		vec3 H = unit_vector(wi + wo);
+		double NdotH = dot(normalo, H);
+		double LdotH = dot(wi, H);
+
+		vec3 Cdlin = ctx.color;
+		double Cdlum = .3 * Cdlin[0] + .6 * Cdlin[1] + .1 * Cdlin[2]; // luminance approx.
+
+		vec3 Ctint = Cdlum > 0 ? Cdlin / Cdlum : vec3(1, 1, 1); // normalize lum. to isolate hue+sat
+		vec3 Cspec0 = mix(property.specular * .08 * mix(vec3(1, 1, 1), Ctint, property.specularTint), Cdlin, property.metallic);
+		vec3 Csheen = mix(vec3(1, 1, 1), Ctint, property.sheenTint);
+
+		// Diffuse fresnel - go from 1 at normal incidence to .5 at grazing
+		// and mix in diffuse retro-reflection based on roughness
+		double FL = SchlickFresnel(NdotL), FV = SchlickFresnel(NdotV);
+		double Fd90 = 0.5 + 2 * LdotH * LdotH * property.roughness;
+		double Fd = mix(1.0, Fd90, FL) * mix(1.0, Fd90, FV);
+
+		// Based on Hanrahan-Krueger brdf approximation of isotropic bssrdf
+		// 1.25 scale is used to (roughly) preserve albedo
+		// Fss90 used to "flatten" retroreflection based on roughness
+		double Fss90 = LdotH * LdotH * property.roughness;
+		double Fss = mix(1.0, Fss90, FL) * mix(1.0, Fss90, FV);
+		double ss = 1.25 * (Fss * (1 / (NdotL + NdotV) - .5) + .5);
+
+		// specular
+		double aspect = sqrt(1 - property.anisotropic * .9);
+		double ax = std::max(.001, sqr(property.roughness) / aspect);
+		double ay = std::max(.001, sqr(property.roughness) * aspect);
+		double Ds = GTR2_aniso(NdotH, dot(H, X), dot(H, Y), ax, ay);
+		double FH = SchlickFresnel(LdotH);
+		vec3 Fs = mix(Cspec0, vec3(1, 1, 1), FH);
+		double Gs;
+		Gs = smithG_GGX_aniso(NdotL, dot(wi, X), dot(wi, Y), ax, ay);
+		Gs *= smithG_GGX_aniso(NdotV, dot(wo, X), dot(wo, Y), ax, ay);
+
+		// sheen
+		vec3 Fsheen = FH * property.sheen * Csheen;
+
+		// clearcoat (ior = 1.5 -> F0 = 0.04)
+		double Dr = GTR1(NdotH, mix(.1, .001, property.clearcoatGloss));
+		double Fr = mix(.04, 1.0, FH);
+		double Gr = smithG_GGX(NdotL, .25) * smithG_GGX(NdotV, .25);
+
+		vec3 ret = ((1 / pi) * mix(Fd, ss, property.subsurface) * Cdlin + Fsheen)
+			* (1 - property.metallic)
+			+ vec3(Gs * Fs * Ds) + vec3(.25 * property.clearcoat * Gr * Fr * Dr);
+
+		return ret;
+	}
+
+	virtual double pdf_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx, const vec3& wi, bool wi_front) const override {
+		if (dot(wi, normali) <= 0) return 0;
+		return mixture_pdf(wo, normali, wi);
+	}
+
+	// 三种采样方法按选择概率混合后的pdf
+	double mixture_pdf(const vec3& wo, const vec3& normali, const vec3& wi) const {
+		vec3 X, Y;
+		build_basis(normali, X, Y);
+		double ax, ay;
+		specular_alpha(ax, ay);
+
+		double p_diffuse, p_specular, p_clearcoat;
+		lobe_probabilities(dot(wo, normali), p_diffuse, p_specular, p_clearcoat);
+
+		double pdf = p_diffuse * std::max(dot(wi, normali), 0.0) * pi_inv;
+		if (p_specular > 0) pdf += p_specular * ggx_vndf_reflection_pdf_aniso(wo, wi, normali, X, Y, ax, ay);
+		if (p_clearcoat > 0) pdf += p_clearcoat * gtr1_reflection_pdf(wo, wi, normali, clearcoat_alpha());
+		return pdf;
+	}
+
+	// 各向异性高光项的粗糙度，与bsdf中的计算相同
+	void specular_alpha(double& ax, double& ay) const {
+		double aspect = sqrt(1 - property.anisotropic * .9);
+		ax = std::max(.001, sqr(property.roughness) / aspect);
+		ay = std::max(.001, sqr(property.roughness) * aspect);
+	}
+
+	double clearcoat_alpha() const {
+		return mix(.1, .001, property.clearcoatGloss);
+	}
+
+	// 各lobe的选择概率，按各lobe在wo方向的反照率估计
+	// 采样时不知道纹理颜色：漫反射项取上限1 - metallic，高光项的F0忽略颜色，反照率来自预计算的GGX反照率表（各向异性时取ax、ay的几何平均）
+	void lobe_probabilities(double cos_o, double& p_diffuse, double& p_specular, double& p_clearcoat) const {
+		double ax, ay;
+		specular_alpha(ax, ay);
+		double F0 = mix(property.specular * .08, 1.0, property.metallic);
+		double albedo_specular = ggx_albedo().albedo(cos_o, sqrt(ax * ay), F0);
+		double albedo_diffuse = 1 - property.metallic;
+		double albedo_clearcoat = .25 * property.clearcoat * mix(.04, 1.0, SchlickFresnel(cos_o));
+
+		double total = albedo_diffuse + albedo_specular + albedo_clearcoat;
+		if (total <= 0) {
+			p_diffuse = 1;
+			p_specular = p_clearcoat = 0;
+			return;
+		}
+		p_diffuse = albedo_diffuse / total;
+		p_specular = albedo_specular / total;
+		p_clearcoat = albedo_clearcoat / total;
+	}
+
+	virtual vec3 get_radiance(const shading_context& ctx) const override {
+		return radiance;
+	}
+
+	virtual const texture* get_normal_map_ptr() const override {
+		return normal_map_ptr.get();
+	}
+
+	virtual const texture* get_color_map_ptr() const override {
+		return color_map_ptr.get();
+	}
+
+	virtual const texture* get_displacement_map_ptr() const override {
+		return displacement_map_ptr.get();
+	}
+
+	virtual medium* get_medium_outside_ptr() const override {
+		return medium_outside_ptr.get();
+	};
+
+	virtual medium* get_medium_inside_ptr() const override {
+		return medium_inside_ptr.get();
+	};
+
+	virtual bool sample_light() const override {
+		return true;
+	}
+
+	virtual bool is_specular() const override {
+		return false;
+	}
+
+	virtual bool is_delta() const override {
+		return false;
+	}
+
+	virtual bool is_diffuse() const override {
+		return false;
+	}
+
+	virtual vec3 get_diffuse_albedo(const shading_context& ctx) const override {
+		return vec3(0, 0, 0);
+	}
+
+	virtual int get_material_number() const override {
+		return 6;
+	}
+};
+
+template <typename material_name>
+constexpr int get_material_number() {
+	if (std::is_same_v<material_name, phong_material>) return 0;
+	if (std::is_same_v<material_name, ggx_metal_material>) return 1;
+	if (std::is_same_v<material_name, ggx_nonmetal_material>) return 2;
+	if (std::is_same_v<material_name, sss_material>) return 3;
+	if (std::is_same_v<material_name, ggx_translucent_material>) return 4;
+	if (std::is_same_v<material_name, translucent_material>) return 5;
+	if (std::is_same_v<material_name, disney_material>) return 6;
+}
+
+
 #endif
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef MATERIAL_VARIANT_H
+#define MATERIAL_VARIANT_H
+
+#include <variant>
+#include <vector>
+#include "hittable.h"
+#include "material.h"
+
+using std::vector;
+
+
+// 封闭集合的材质表示
+// 每个可选类型是指向具体材质类的指针，std::visit之后着色代码在具体类型上实例化，材质的函数可以内联
+// 第一个可选类型是基类指针，用于不在集合中的材质，此时仍然通过虚函数调用
+using material_variant = std::variant<
+	const material*,
+	const phong_material*,
+	const ggx_metal_material*,
+	const ggx_nonmetal_material*,
+	const sss_material*,
+	const ggx_translucent_material*,
+	const translucent_material*,
+	const disney_material*>;
+
+// 与scene_materials中的材质编号一一对应
+vector<material_variant> scene_material_variants;
+
+
+// 将材质转换为对应的可选类型
+inline material_variant make_material_variant(const material* mat_ptr) {
+	if (auto p = dynamic_cast<const phong_material*>(mat_ptr)) return p;
+	if (auto p = dynamic_cast<const ggx_metal_material*>(mat_ptr)) return p;
+	if (auto p = dynamic_cast<const ggx_nonmetal_material*>(mat_ptr)) return p;
+	if (auto p = dynamic_cast<const sss_material*>(mat_ptr)) return p;
+	if (auto p = dynamic_cast<const ggx_translucent_material*>(mat_ptr)) return p;
+	if (auto p = dynamic_cast<const translucent_material*>(mat_ptr)) return p;
+	if (auto p = dynamic_cast<const disney_material*>(mat_ptr)) return p;
+	return mat_ptr;
+}
+
+
+// 根据材质表生成scene_material_variants，需要在场景构建完成后调用
+void build_material_variants() {
+	scene_material_variants.clear();
+	for (uint32_t id = 0; id < scene_materials.size(); id++) {
+		scene_material_variants.push_back(make_material_variant(scene_materials.get(id)));
+	}
+}
+
+#endif
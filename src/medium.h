@@ -1,21 +1,338 @@
-#pragma once
-#ifndef MEDIUM_H
-#define MEDIUM_H
-
-#include <memory>
-using std::shared_ptr;
-
-class medium {
-public:
-	// 
-	double n = 1;
-
-public:
-	medium(double n_init = 1) {
-		n = n_init;
-	}
-};
-
-shared_ptr<medium> default_medium_ptr = make_shared<medium>(1);
-
-#endif
\ No newline at end of file
+#pragma once
+#ifndef MEDIUM_H
+#define MEDIUM_H
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include "global.h"
+#include "vec3.h"
+using std::shared_ptr;
+using std::vector;
+
+// 介质
+// 基类只有折射率，不吸收也不散射光线
+// 参与介质通过材质的get_medium_inside_ptr挂到物体内部，光线穿过物体表面（折射或完全透明）时切换所在介质
+// 所有函数中的方向d都是单位向量，距离t_max以世界空间长度计
+class medium {
+public:
+	// 折射率
+	double n = 1;
+
+public:
+	medium(double n_init = 1) {
+		n = n_init;
+	}
+
+	virtual ~medium() = default;
+
+	// 是否为参与介质（会吸收或散射光线）
+	virtual bool is_participating() const {
+		return false;
+	}
+
+	// 自由程采样（delta tracking）
+	// 在[0, t_max)内寻找下一次真实碰撞，碰撞时返回true，t为碰撞点的距离，weight为路径权重需要乘上的系数（单次散射反照率）
+	// 返回false时光线没有发生碰撞，路径权重不变
+	virtual bool sample_free_flight(const point3& o, const vec3& d, double t_max, double& t, vec3& weight) const {
+		return false;
+	}
+
+	// 从o沿d前进t_max距离的透射率（ratio tracking）
+	virtual vec3 transmittance(const point3& o, const vec3& d, double t_max) const {
+		return vec3(1, 1, 1);
+	}
+
+	// 相函数，wo与wi都指向远离散射点的方向
+	virtual double phase(const vec3& wo, const vec3& wi) const {
+		return 0.25 * pi_inv;
+	}
+
+	// 按相函数采样wi，返回值为pdf
+	// 相函数是归一化的，因此采样权重phase / pdf始终为1
+	virtual double sample_phase(const vec3& wo, vec3& wi) const {
+		return 0;
+	}
+};
+
+shared_ptr<medium> default_medium_ptr = make_shared<medium>(1);
+
+
+// Henyey-Greenstein相函数
+// g为平均散射余弦，大于0时向前散射
+inline double henyey_greenstein(double cos_theta, double g) {
+	double denom = 1 + g * g + 2 * g * cos_theta;
+	return 0.25 * pi_inv * (1 - g * g) / (denom * sqrt(denom));
+}
+
+// wo指向远离散射点的方向，因此前进方向为-wo
+inline double sample_henyey_greenstein(const vec3& wo, double g, vec3& wi) {
+	double rand1 = random_double();
+	double rand2 = random_double();
+
+	// 相对前进方向的散射角
+	double cos_theta;
+	if (fabs(g) < 1e-3) {
+		cos_theta = 1 - 2 * rand1;
+	}
+	else {
+		double s = (1 - g * g) / (1 - g + 2 * g * rand1);
+		cos_theta = (1 + g * g - s * s) / (2 * g);
+	}
+	cos_theta = clamp(cos_theta, -1, 1);
+	double sin_theta = sqrt(std::max(0.0, 1 - cos_theta * cos_theta));
+	double phi = pi2 * rand2;
+
+	vec3 forward = -wo;
+	vec3 b1, b2;
+	build_basis(forward, b1, b2);
+	wi = forward * cos_theta + b1 * sin_theta * cos(phi) + b2 * sin_theta * sin(phi);
+
+	return henyey_greenstein(dot(wo, wi), g);
+}
+
+
+// 均匀介质
+// 消光系数sigma_t对各通道相同，颜色由单次散射反照率albedo决定（sigma_s = albedo * sigma_t）
+class homogeneous_medium : public medium {
+public:
+	double sigma_t; // 消光系数
+	vec3 albedo; // 单次散射反照率
+	double g; // HG相函数参数
+
+public:
+	homogeneous_medium(double sigma_t_init, const vec3& albedo_init, double g_init = 0, double n_init = 1) : medium(n_init) {
+		sigma_t = sigma_t_init;
+		albedo = albedo_init;
+		g = g_init;
+	}
+
+	virtual bool is_participating() const override {
+		return sigma_t > 0;
+	}
+
+	// 均匀介质中的自由程服从指数分布，可以直接解析采样
+	virtual bool sample_free_flight(const point3& o, const vec3& d, double t_max, double& t, vec3& weight) const override {
+		t = -log(1 - random_double()) / sigma_t;
+		if (t >= t_max) return false;
+		weight = albedo;
+		return true;
+	}
+
+	virtual vec3 transmittance(const point3& o, const vec3& d, double t_max) const override {
+		double T = exp(-sigma_t * t_max);
+		return vec3(T, T, T);
+	}
+
+	virtual double phase(const vec3& wo, const vec3& wi) const override {
+		return henyey_greenstein(dot(wo, wi), g);
+	}
+
+	virtual double sample_phase(const vec3& wo, vec3& wi) const override {
+		return sample_henyey_greenstein(wo, g, wi);
+	}
+};
+
+
+// 体素网格非均匀介质
+// 密度保存在覆盖[p_min, p_max]的nx * ny * nz网格中，在体素中心之间三线性插值，网格外密度为0
+// 另外维护一个粗糙的majorant网格，保存每个粗网格单元内密度的上界
+// delta tracking与ratio tracking沿光线逐个遍历粗网格单元（3D DDA），每个单元使用局部上界作为虚拟碰撞的密度
+// 这样稀疏的烟雾只在有密度的区域产生虚拟碰撞，空白区域直接跳过
+class grid_medium : public medium {
+public:
+	vec3 p_min, p_max; // 网格范围
+	int nx, ny, nz;
+	vector<double> density; // 按x、y、z的顺序存放，x变化最快
+	double sigma_t_scale; // 密度为1时的消光系数
+	vec3 albedo; // 单次散射反照率
+	double g; // HG相函数参数
+
+private:
+	int mx, my, mz; // majorant网格分辨率
+	vector<double> majorant; // 每个粗网格单元的消光系数上界
+
+public:
+	grid_medium(const vec3& p_min_init, const vec3& p_max_init, int nx_init, int ny_init, int nz_init, const vector<double>& density_init,
+		double sigma_t_scale_init, const vec3& albedo_init, double g_init = 0, int majorant_resolution = 16, double n_init = 1) : medium(n_init) {
+		p_min = p_min_init;
+		p_max = p_max_init;
+		nx = nx_init;
+		ny = ny_init;
+		nz = nz_init;
+		density = density_init;
+		sigma_t_scale = sigma_t_scale_init;
+		albedo = albedo_init;
+		g = g_init;
+
+		mx = std::max(1, std::min(majorant_resolution, nx));
+		my = std::max(1, std::min(majorant_resolution, ny));
+		mz = std::max(1, std::min(majorant_resolution, nz));
+		build_majorant();
+	}
+
+	virtual bool is_participating() const override {
+		return true;
+	}
+
+	// 世界坐标处的消光系数
+	double sigma_t(const point3& p) const {
+		// 转换到体素坐标，体素中心位于整数 + 0.5处
+		double x = (p.x() - p_min.x()) / (p_max.x() - p_min.x()) * nx - 0.5;
+		double y = (p.y() - p_min.y()) / (p_max.y() - p_min.y()) * ny - 0.5;
+		double z = (p.z() - p_min.z()) / (p_max.z() - p_min.z()) * nz - 0.5;
+		if (x < -0.5 or y < -0.5 or z < -0.5 or x > nx - 0.5 or y > ny - 0.5 or z > nz - 0.5) return 0;
+
+		int x0 = static_cast<int>(std::floor(x)), y0 = static_cast<int>(std::floor(y)), z0 = static_cast<int>(std::floor(z));
+		double fx = x - x0, fy = y - y0, fz = z - z0;
+
+		double value = 0;
+		for (int k = 0; k < 8; k++) {
+			int xi = x0 + (k & 1), yi = y0 + ((k >> 1) & 1), zi = z0 + ((k >> 2) & 1);
+			double w = ((k & 1) ? fx : 1 - fx) * (((k >> 1) & 1) ? fy : 1 - fy) * (((k >> 2) & 1) ? fz : 1 - fz);
+			value += w * voxel(xi, yi, zi);
+		}
+		return value * sigma_t_scale;
+	}
+
+	virtual bool sample_free_flight(const point3& o, const vec3& d, double t_max, double& t, vec3& weight) const override {
+		bool scattered = false;
+		traverse_majorant(o, d, t_max, [&](double t_begin, double t_end, double sigma_maj) {
+			double t_cur = t_begin;
+			while (true) {
+				t_cur += -log(1 - random_double()) / sigma_maj;
+				if (t_cur >= t_end) return false; // 指数分布无记忆，直接进入下一个单元
+				// 以sigma_t / sigma_maj的概率为真实碰撞，否则为虚拟碰撞
+				if (random_double() * sigma_maj < sigma_t(o + d * t_cur)) {
+					t = t_cur;
+					weight = albedo;
+					scattered = true;
+					return true;
+				}
+			}
+		});
+		return scattered;
+	}
+
+	virtual vec3 transmittance(const point3& o, const vec3& d, double t_max) const override {
+		double T = 1;
+		traverse_majorant(o, d, t_max, [&](double t_begin, double t_end, double sigma_maj) {
+			double t_cur = t_begin;
+			while (true) {
+				t_cur += -log(1 - random_double()) / sigma_maj;
+				if (t_cur >= t_end) return false;
+				T *= 1 - sigma_t(o + d * t_cur) / sigma_maj;
+
+				// 透射率很小时使用俄罗斯轮盘赌提前结束
+				if (T < 0.1) {
+					if (random_double() < 0.5) {
+						T = 0;
+						return true;
+					}
+					T *= 2;
+				}
+			}
+		});
+		return vec3(T, T, T);
+	}
+
+	virtual double phase(const vec3& wo, const vec3& wi) const override {
+		return henyey_greenstein(dot(wo, wi), g);
+	}
+
+	virtual double sample_phase(const vec3& wo, vec3& wi) const override {
+		return sample_henyey_greenstein(wo, g, wi);
+	}
+
+private:
+	double voxel(int x, int y, int z) const {
+		x = std::max(0, std::min(x, nx - 1));
+		y = std::max(0, std::min(y, ny - 1));
+		z = std::max(0, std::min(z, nz - 1));
+		return density[(static_cast<size_t>(z) * ny + y) * nx + x];
+	}
+
+	// 每个粗网格单元的上界取所有可能参与该单元内插值的体素的最大值
+	void build_majorant() {
+		majorant.assign(static_cast<size_t>(mx) * my * mz, 0);
+		for (int cz = 0; cz < mz; cz++) {
+			for (int cy = 0; cy < my; cy++) {
+				for (int cx = 0; cx < mx; cx++) {
+					// 单元在体素坐标下的范围，向外扩展一个体素以覆盖三线性插值
+					int x_begin = std::max(0, cx * nx / mx - 1), x_end = std::min(nx - 1, (cx + 1) * nx / mx);
+					int y_begin = std::max(0, cy * ny / my - 1), y_end = std::min(ny - 1, (cy + 1) * ny / my);
+					int z_begin = std::max(0, cz * nz / mz - 1), z_end = std::min(nz - 1, (cz + 1) * nz / mz);
+					double max_density = 0;
+					for (int z = z_begin; z <= z_end; z++)
+						for (int y = y_begin; y <= y_end; y++)
+							for (int x = x_begin; x <= x_end; x++)
+								max_density = std::max(max_density, voxel(x, y, z));
+					majorant[(static_cast<size_t>(cz) * my + cy) * mx + cx] = max_density * sigma_t_scale;
+				}
+			}
+		}
+	}
+
+	// 沿光线遍历与[0, t_max)相交的粗网格单元，对上界大于0的单元调用f(t_begin, t_end, sigma_maj)
+	// f返回true时停止遍历
+	template <typename segment_function>
+	void traverse_majorant(const point3& o, const vec3& d, double t_max, segment_function&& f) const {
+		// 与网格包围盒求交
+		double t0 = 0, t1 = t_max;
+		for (int i = 0; i < 3; i++) {
+			double inv_d = 1.0 / d[i];
+			double t_near = (p_min[i] - o[i]) * inv_d;
+			double t_far = (p_max[i] - o[i]) * inv_d;
+			if (inv_d < 0) std::swap(t_near, t_far);
+			t0 = std::max(t0, t_near);
+			t1 = std::min(t1, t_far);
+			if (t1 <= t0) return;
+		}
+
+		// 初始化DDA
+		const int res[3] = { mx, my, mz };
+		int cell[3], step[3], exit[3];
+		double t_next[3], t_delta[3];
+		vec3 p = o + d * t0;
+		for (int i = 0; i < 3; i++) {
+			double extent = p_max[i] - p_min[i];
+			double cell_size = extent / res[i];
+			cell[i] = std::max(0, std::min(res[i] - 1, static_cast<int>((p[i] - p_min[i]) / extent * res[i])));
+			if (d[i] > 0) {
+				step[i] = 1;
+				exit[i] = res[i];
+				t_next[i] = t0 + (p_min[i] + (cell[i] + 1) * cell_size - p[i]) / d[i];
+				t_delta[i] = cell_size / d[i];
+			}
+			else if (d[i] < 0) {
+				step[i] = -1;
+				exit[i] = -1;
+				t_next[i] = t0 + (p_min[i] + cell[i] * cell_size - p[i]) / d[i];
+				t_delta[i] = -cell_size / d[i];
+			}
+			else {
+				step[i] = 0;
+				exit[i] = -1;
+				t_next[i] = infinity;
+				t_delta[i] = infinity;
+			}
+		}
+
+		double t_begin = t0;
+		while (true) {
+			// 下一个穿过的坐标轴
+			int axis = t_next[0] < t_next[1] ? (t_next[0] < t_next[2] ? 0 : 2) : (t_next[1] < t_next[2] ? 1 : 2);
+			double t_end = std::min(t_next[axis], t1);
+			double sigma_maj = majorant[(static_cast<size_t>(cell[2]) * my + cell[1]) * mx + cell[0]];
+			if (sigma_maj > 0 and t_end > t_begin and f(t_begin, t_end, sigma_maj)) return;
+			if (t_end >= t1) return;
+
+			t_begin = t_end;
+			cell[axis] += step[axis];
+			if (cell[axis] == exit[axis]) return;
+			t_next[axis] += t_delta[axis];
+		}
+	}
+};
+
+#endif
@@ -1,373 +1,521 @@
-#pragma once
-#ifndef MESH_TRIANGLE_H
-#define MESH_TRIANGLE_H
-
-#include "material.h"
-#include "triangle.h"
-#include "OBJ_Loader.h"
-#include <unordered_map>
-
-using std::vector;
-using std::string;
-using std::unordered_map;
-
-class mesh_triangle {
-public:
-	virtual vector<shared_ptr<triangle>> unpack() const = 0;
-	virtual void set_scale(const vec3 &vec) = 0;
-	virtual void set_rotate(const vec3 &vec) = 0;
-	virtual void set_translate(const vec3 &vec) = 0;
-};
-
-
-// 
-class cuboid : public mesh_triangle {
-public:
-	// x, y, zĳ
-	double length[3];
-	// materialָ
-	shared_ptr<material> mat_ptr;
-
-	// 任Ⱥ˳
-	vec3 scale_vec;
-	vec3 rotate_vec; // ֱΪx,y,zתĻ
-	vec3 translate_vec;
-
-public:
-	cuboid(double length_x, double length_y, double length_z, shared_ptr<material> mat_ptr_init) {
-		length[0] = length_x;
-		length[1] = length_y;
-		length[2] = length_z;
-		mat_ptr = mat_ptr_init;
-		scale_vec = vec3(1, 1, 1);
-		rotate_vec = vec3(0, 0, 0);
-		translate_vec = vec3(0, 0, 0);
-	}
-
-	void set_scale(const vec3 &vec) override {
-		scale_vec = vec;
-	}
-
-	void set_rotate(const vec3 &vec) override {
-		rotate_vec = vec;
-	}
-
-	void set_translate(const vec3 &vec) override {
-		translate_vec = vec;
-	}
-
-	virtual vector<shared_ptr<triangle>> unpack() const override {
-		vec3 vertex_1 = vec3(-0.5 * length[0], -0.5 * length[1], -0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
-		vec3 vertex_2 = vec3(0.5 * length[0], -0.5 * length[1], -0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
-		vec3 vertex_3 = vec3(0.5 * length[0], -0.5 * length[1], 0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
-		vec3 vertex_4 = vec3(-0.5 * length[0], -0.5 * length[1], 0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
-		vec3 vertex_5 = vec3(-0.5 * length[0], 0.5 * length[1], -0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
-		vec3 vertex_6 = vec3(0.5 * length[0], 0.5 * length[1], -0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
-		vec3 vertex_7 = vec3(0.5 * length[0], 0.5 * length[1], 0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
-		vec3 vertex_8 = vec3(-0.5 * length[0], 0.5 * length[1], 0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
-
-		vector<shared_ptr<triangle>> triangle_ptr_list;
-		triangle_ptr_list.resize(12);
-
-		triangle_ptr_list[0] = make_shared<triangle>(vertex_1, vertex_2, vertex_3, mat_ptr);
-		triangle_ptr_list[1] = make_shared<triangle>(vertex_1, vertex_3, vertex_4, mat_ptr);
-		triangle_ptr_list[2] = make_shared<triangle>(vertex_2, vertex_5, vertex_6, mat_ptr);
-		triangle_ptr_list[3] = make_shared<triangle>(vertex_1, vertex_5, vertex_2, mat_ptr);
-		triangle_ptr_list[4] = make_shared<triangle>(vertex_1, vertex_4, vertex_8, mat_ptr);
-		triangle_ptr_list[5] = make_shared<triangle>(vertex_1, vertex_8, vertex_5, mat_ptr);
-		triangle_ptr_list[6] = make_shared<triangle>(vertex_7, vertex_3, vertex_2, mat_ptr);
-		triangle_ptr_list[7] = make_shared<triangle>(vertex_6, vertex_7, vertex_2, mat_ptr);
-		triangle_ptr_list[8] = make_shared<triangle>(vertex_8, vertex_6, vertex_5, mat_ptr);
-		triangle_ptr_list[9] = make_shared<triangle>(vertex_8, vertex_7, vertex_6, mat_ptr);
-		triangle_ptr_list[10] = make_shared<triangle>(vertex_4, vertex_3, vertex_8, mat_ptr);
-		triangle_ptr_list[11] = make_shared<triangle>(vertex_3, vertex_7, vertex_8, mat_ptr);
-
-		return triangle_ptr_list;
-	}
-};
-
-
-// .objļжȡ
-// ȡλáuvͷ
-// Զblenderб任
-// meshôֻʹһֲ
-class simple_obj_mesh : public mesh_triangle
-{
-public:
-	// materialָ
-	shared_ptr<material> mat_ptr;
-
-	// 任Ⱥ˳
-	vec3 scale_vec;
-	vec3 rotate_vec; // ֱΪx,y,zתĻ
-	vec3 translate_vec;
-
-	// OBJLoaderĶȡ
-	vector<objl::Mesh> mesh_list;
-	
-
-public:
-	simple_obj_mesh(const char file_name[], shared_ptr<material> mat_ptr_init)
-	{
-		objl::Loader loader;
-		loader.LoadFile(file_name);
-
-		// ȡmeshб
-		// һmeshӦblenderһаһϵжϢ
-		mesh_list = loader.LoadedMeshes;
-
-		// ûԱ
-		mat_ptr = mat_ptr_init;
-		scale_vec = vec3(1, 1, 1);
-		rotate_vec = vec3(0, 0, 0);
-		translate_vec = vec3(0, 0, 0);
-	}
-
-	void set_scale(const vec3 &vec) override {
-		scale_vec = vec;
-	}
-
-	void set_rotate(const vec3 &vec) override {
-		rotate_vec = vec;
-	}
-
-	void set_translate(const vec3 &vec) override {
-		translate_vec = vec;
-	}
-
-	virtual vector<shared_ptr<triangle>> unpack() const override {
-		// ʼֵ
-		vector<shared_ptr<triangle>> triangle_ptr_list;
-		
-		// θ
-		int num_triangle = 0;
-		for (objl::Mesh mesh : mesh_list) {
-			num_triangle += mesh.Indices.size() / 3;
-		}
-		// Ԥ趨triangle_ptr_list
-		triangle_ptr_list.resize(num_triangle);
-		
-		// ÿmeshֱжȡ
-		int triangle_ptr_index = 0;
-		for (objl::Mesh mesh : mesh_list) {
-			
-			// ȼ¼Ϣ
-			// λתΪvec3ʽposition_list
-			vector<vec3> position_list;
-			// uvתΪvec3ʽuv_list
-			vector<vec3> uv_list;
-			// 㷨תΪvec3ʽnormal_list
-			vector<vec3> normal_list;
-
-			// Ԥ趨position_listuv_listnormal_listĳ
-			int vertex_num = mesh.Vertices.size();
-			position_list.resize(vertex_num);
-			uv_list.resize(vertex_num);
-			normal_list.resize(vertex_num);
-			
-			for (int index = 0; index < vertex_num; index++) {
-				// ¼λʱԶblenderӦϵ任
-				// blenderеyӦx
-				// blenderеzӦy
-				// blenderеxӦz
-				// ֱʹӳûеõȷĽʵʴʹһhackʱ֪ԭ
-				//position_list[index] = vec3(mesh.Vertices[index].Position.Y, mesh.Vertices[index].Position.Z, mesh.Vertices[index].Position.X); // ȷ
-				position_list[index] = vec3(-mesh.Vertices[index].Position.Z, mesh.Vertices[index].Position.Y, mesh.Vertices[index].Position.X); // ʵȷ
-				// Ӧmesh_triangleԴı任
-				position_list[index].scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
-
-				// normalʹͬhack
-				normal_list[index] = vec3(-mesh.Vertices[index].Normal.Z, mesh.Vertices[index].Normal.Y, mesh.Vertices[index].Normal.X);
-				// Ӧmesh_triangleԴı任ʹtranslatescale任Ƕλscale任棩
-				normal_list[index].scale(vec3(1 / scale_vec[0], 1 / scale_vec[1], 1 / scale_vec[2])).rotate(rotate_vec);
-
-				// ¼uv
-				uv_list[index] = vec3(mesh.Vertices[index].TextureCoordinate.X, mesh.Vertices[index].TextureCoordinate.Y, 0);
-			}
-			
-			// Σtriangle_ptr_list
-			int index_num = mesh.Indices.size();
-			// ÿindexһӦһ
-			//std::cout << triangle_ptr_list.size() << ' ' << position_list.size() << '\n';
-			for (int index = 0; index < index_num ; index += 3) {
-				//std::cout << triangle_ptr_index << ' ' << index << '\n';
-				triangle_ptr_list[triangle_ptr_index] = make_shared<triangle>(
-					position_list[mesh.Indices[index]],
-					position_list[mesh.Indices[index + 1]], 
-					position_list[mesh.Indices[index + 2]],
-					mat_ptr,
-					uv_list[mesh.Indices[index]],
-					uv_list[mesh.Indices[index + 1]],
-					uv_list[mesh.Indices[index + 2]],
-					normal_list[mesh.Indices[index]],
-					normal_list[mesh.Indices[index + 1]],
-					normal_list[mesh.Indices[index + 2]]);
-				triangle_ptr_index++;
-			}
-		}
-
-		return triangle_ptr_list;
-	}
-};
-
-
-// .objļжȡ
-// ȡλáuvͷ
-// Զblenderб任
-// Ըͬmesh䲻ͬĲ
-// {mesh : material_ptr}mapУݶȡmeshƽз
-class dict_material_obj_mesh : public mesh_triangle
-{
-public:
-	// {mesh : material_ptr}ֵ
-	unordered_map<string, shared_ptr<material>> material_dict;
-
-	// Ĭmaterial_ptr
-	shared_ptr<material> default_mat_ptr;
-
-	// 任Ⱥ˳
-	vec3 scale_vec;
-	vec3 rotate_vec; // ֱΪx,y,zתĻ
-	vec3 translate_vec;
-
-	// OBJLoaderĶȡ
-	vector<objl::Mesh> mesh_list;
-
-
-public:
-	dict_material_obj_mesh(const char file_name[], unordered_map<string, shared_ptr<material>> material_dict_init, shared_ptr<material> default_mat_ptr_init)
-	{
-		objl::Loader loader;
-		loader.LoadFile(file_name);
-
-		// ȡmeshб
-		// һmeshӦblenderһаһϵжϢ
-		mesh_list = loader.LoadedMeshes;
-
-		// ûԱ
-		material_dict = material_dict_init;
-		default_mat_ptr = default_mat_ptr_init;
-		scale_vec = vec3(1, 1, 1);
-		rotate_vec = vec3(0, 0, 0);
-		translate_vec = vec3(0, 0, 0);
-	}
-
-	void set_scale(const vec3 &vec) override {
-		scale_vec = vec;
-	}
-
-	void set_rotate(const vec3 &vec) override {
-		rotate_vec = vec;
-	}
-
-	void set_translate(const vec3 &vec) override {
-		translate_vec = vec;
-	}
-
-	virtual vector<shared_ptr<triangle>> unpack() const override {
-		// ʼֵ
-		vector<shared_ptr<triangle>> triangle_ptr_list;
-
-		// θ
-		int num_triangle = 0;
-		for (objl::Mesh mesh : mesh_list) {
-			num_triangle += mesh.Indices.size() / 3;
-		}
-		// Ԥ趨triangle_ptr_list
-		triangle_ptr_list.resize(num_triangle);
-
-		// ÿmeshֱжȡ
-		int triangle_ptr_index = 0;
-		for (objl::Mesh mesh : mesh_list) {
-			
-			// ȷmeshӦmaterial_ptr
-			shared_ptr<material> current_mat_ptr = nullptr; // ָ
-
-			std::cout << "loading " << mesh.MeshName << "   material found: ";
-			auto itr = material_dict.find(mesh.MeshName);
-			if (itr == material_dict.end()) { // ûָmeshmaterialʹĬmaterial
-				current_mat_ptr = default_mat_ptr;
-				std::cout << "false\n";
-			}
-			else { // Ѿָ˸meshmaterial
-				current_mat_ptr = itr->second;
-				std::cout << "true\n";
-			}
-
-			// ȼ¼Ϣ
-			// λתΪvec3ʽposition_list
-			vector<vec3> position_list;
-			// uvתΪvec3ʽuv_list
-			vector<vec3> uv_list;
-			// 㷨תΪvec3ʽnormal_list
-			vector<vec3> normal_list;
-
-			// Ԥ趨position_listuv_listnormal_listĳ
-			int vertex_num = mesh.Vertices.size();
-			position_list.resize(vertex_num);
-			uv_list.resize(vertex_num);
-			normal_list.resize(vertex_num);
-
-			for (int index = 0; index < vertex_num; index++) {
-				// ¼λʱԶblenderӦϵ任
-				// blenderеyӦx
-				// blenderеzӦy
-				// blenderеxӦz
-				// ֱʹӳûеõȷĽʵʴʹһhackʱ֪ԭ
-				//position_list[index] = vec3(mesh.Vertices[index].Position.Y, mesh.Vertices[index].Position.Z, mesh.Vertices[index].Position.X); // ȷ
-				position_list[index] = vec3(-mesh.Vertices[index].Position.Z, mesh.Vertices[index].Position.Y, mesh.Vertices[index].Position.X); // ʵȷ
-				// Ӧmesh_triangleԴı任
-				position_list[index].scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
-
-				// normalʹͬhack
-				normal_list[index] = vec3(-mesh.Vertices[index].Normal.Z, mesh.Vertices[index].Normal.Y, mesh.Vertices[index].Normal.X);
-				// Ӧmesh_triangleԴı任ʹtranslatescale任Ƕλscale任棩
-				normal_list[index].scale(vec3(1 / scale_vec[0], 1 / scale_vec[1], 1 / scale_vec[2])).rotate(rotate_vec);
-
-				// ¼uv
-				uv_list[index] = vec3(mesh.Vertices[index].TextureCoordinate.X, mesh.Vertices[index].TextureCoordinate.Y, 0);
-			}
-
-			// Σtriangle_ptr_list
-			int index_num = mesh.Indices.size();
-			std::cout << "num of triangles = " << index_num / 3 << std::endl;
-			// ÿindexһӦһ
-			if (shared_ptr<texture> displacement_map_ptr = current_mat_ptr->get_displacement_map_ptr()) { // ûͼ
-				for (int index = 0; index < index_num; index += 3) {
-					triangle_ptr_list[triangle_ptr_index] = make_shared<triangle>(
-						position_list[mesh.Indices[index]] + normal_list[mesh.Indices[index]] * displacement_map_ptr->get_value(uv_list[mesh.Indices[index]]),
-						position_list[mesh.Indices[index + 1]] + normal_list[mesh.Indices[index + 1]] * displacement_map_ptr->get_value(uv_list[mesh.Indices[index + 1]]),
-						position_list[mesh.Indices[index + 2]] + normal_list[mesh.Indices[index + 2]] * displacement_map_ptr->get_value(uv_list[mesh.Indices[index + 2]]),
-						current_mat_ptr,
-						uv_list[mesh.Indices[index]],
-						uv_list[mesh.Indices[index + 1]],
-						uv_list[mesh.Indices[index + 2]],
-						normal_list[mesh.Indices[index]],
-						normal_list[mesh.Indices[index + 1]],
-						normal_list[mesh.Indices[index + 2]]);
-					triangle_ptr_index++;
-				}
-			}
-			else { // ûûͼ
-				for (int index = 0; index < index_num; index += 3) {
-					triangle_ptr_list[triangle_ptr_index] = make_shared<triangle>(
-						position_list[mesh.Indices[index]],
-						position_list[mesh.Indices[index + 1]],
-						position_list[mesh.Indices[index + 2]],
-						current_mat_ptr,
-						uv_list[mesh.Indices[index]],
-						uv_list[mesh.Indices[index + 1]],
-						uv_list[mesh.Indices[index + 2]],
-						normal_list[mesh.Indices[index]],
-						normal_list[mesh.Indices[index + 1]],
-						normal_list[mesh.Indices[index + 2]]);
-					triangle_ptr_index++;
-				}
-			}
-		}
-
-		return triangle_ptr_list;
-	}
-};
-
+#pragma once
+#ifndef MESH_TRIANGLE_H
+#define MESH_TRIANGLE_H
+
+#include "material.h"
+#include "triangle.h"
+#include "transform.h"
+#include "obj_parser.h"
+#include "ply_loader.h"
+#include <map>
+#include <sstream>
+#include <iomanip>
+#include <unordered_map>
+
+using std::vector;
+using std::string;
+using std::unordered_map;
+
+// 网格的描述，用于网格快照（见scene_snapshot.h）
+// 描述相同（且文件内容相同）时unpack的结果相同
+struct mesh_description {
+	std::ostringstream params; // 类型、构造参数与变换
+	vector<string> files; // 读取的文件
+	vector<std::pair<string, shared_ptr<material>>> materials; // 可能使用的材质及其名称，快照按这里的顺序记录材质
+
+	mesh_description() {
+		params << std::setprecision(17);
+	}
+};
+
+class mesh_triangle {
+public:
+	virtual vector<shared_ptr<triangle>> unpack() const = 0;
+	// 只使用一种材质的网格可以直接生成三角形数据，不为每个三角形创建triangle对象，由调用者构建展平的bvh（见scene_snapshot.h中的make_flat_mesh）
+	// 微图与材质有关，不在这里生成。不支持时返回false，调用者使用unpack
+	virtual bool unpack_faces(vector<triangle_data> &faces, shared_ptr<material> &mat_ptr_out) const { return false; }
+	virtual void set_scale(const vec3 &vec) = 0;
+	virtual void set_rotate(const vec3 &vec) = 0;
+	virtual void set_translate(const vec3 &vec) = 0;
+	// 填写描述，不需要快照的网格（例如只有几个三角形）返回false
+	virtual bool describe(mesh_description &desc) const = 0;
+};
+
+
+// 长方体类
+class cuboid : public mesh_triangle {
+public:
+	// x, y, z轴的长度
+	double length[3];
+	// material指针
+	shared_ptr<material> mat_ptr;
+
+	// 变换，按先后顺序排列
+	vec3 scale_vec;
+	vec3 rotate_vec; // 分别为绕x,y,z轴旋转的弧度
+	vec3 translate_vec;
+
+public:
+	cuboid(double length_x, double length_y, double length_z, shared_ptr<material> mat_ptr_init) {
+		length[0] = length_x;
+		length[1] = length_y;
+		length[2] = length_z;
+		mat_ptr = mat_ptr_init;
+		scale_vec = vec3(1, 1, 1);
+		rotate_vec = vec3(0, 0, 0);
+		translate_vec = vec3(0, 0, 0);
+	}
+
+	void set_scale(const vec3 &vec) override {
+		scale_vec = vec;
+	}
+
+	void set_rotate(const vec3 &vec) override {
+		rotate_vec = vec;
+	}
+
+	void set_translate(const vec3 &vec) override {
+		translate_vec = vec;
+	}
+
+	bool describe(mesh_description &desc) const override {
+		return false;
+	}
+
+	virtual vector<shared_ptr<triangle>> unpack() const override {
+		vec3 vertex_1 = vec3(-0.5 * length[0], -0.5 * length[1], -0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
+		vec3 vertex_2 = vec3(0.5 * length[0], -0.5 * length[1], -0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
+		vec3 vertex_3 = vec3(0.5 * length[0], -0.5 * length[1], 0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
+		vec3 vertex_4 = vec3(-0.5 * length[0], -0.5 * length[1], 0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
+		vec3 vertex_5 = vec3(-0.5 * length[0], 0.5 * length[1], -0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
+		vec3 vertex_6 = vec3(0.5 * length[0], 0.5 * length[1], -0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
+		vec3 vertex_7 = vec3(0.5 * length[0], 0.5 * length[1], 0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
+		vec3 vertex_8 = vec3(-0.5 * length[0], 0.5 * length[1], 0.5 * length[2]).scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
+
+		vector<shared_ptr<triangle>> triangle_ptr_list;
+		triangle_ptr_list.resize(12);
+
+		triangle_ptr_list[0] = make_shared<triangle>(vertex_1, vertex_2, vertex_3, mat_ptr);
+		triangle_ptr_list[1] = make_shared<triangle>(vertex_1, vertex_3, vertex_4, mat_ptr);
+		triangle_ptr_list[2] = make_shared<triangle>(vertex_2, vertex_5, vertex_6, mat_ptr);
+		triangle_ptr_list[3] = make_shared<triangle>(vertex_1, vertex_5, vertex_2, mat_ptr);
+		triangle_ptr_list[4] = make_shared<triangle>(vertex_1, vertex_4, vertex_8, mat_ptr);
+		triangle_ptr_list[5] = make_shared<triangle>(vertex_1, vertex_8, vertex_5, mat_ptr);
+		triangle_ptr_list[6] = make_shared<triangle>(vertex_7, vertex_3, vertex_2, mat_ptr);
+		triangle_ptr_list[7] = make_shared<triangle>(vertex_6, vertex_7, vertex_2, mat_ptr);
+		triangle_ptr_list[8] = make_shared<triangle>(vertex_8, vertex_6, vertex_5, mat_ptr);
+		triangle_ptr_list[9] = make_shared<triangle>(vertex_8, vertex_7, vertex_6, mat_ptr);
+		triangle_ptr_list[10] = make_shared<triangle>(vertex_4, vertex_3, vertex_8, mat_ptr);
+		triangle_ptr_list[11] = make_shared<triangle>(vertex_3, vertex_7, vertex_8, mat_ptr);
+
+		return triangle_ptr_list;
+	}
+};
+
+
+// 从.obj文件中读取
+// 读取顶点位置、uv和法线
+// 顶点坐标根据自定blender坐标进行变换
+// 如果读进来多个mesh，那么只能使用一种材质
+class simple_obj_mesh : public mesh_triangle
+{
+public:
+	// material指针
+	shared_ptr<material> mat_ptr;
+
+	// 变换，按先后顺序排列
+	vec3 scale_vec;
+	vec3 rotate_vec; // 分别为绕x,y,z轴旋转的弧度
+	vec3 translate_vec;
+
+	// .obj文件路径，在unpack时读取
+	string file_name;
+	
+
+public:
+	simple_obj_mesh(const char file_name_init[], shared_ptr<material> mat_ptr_init)
+	{
+		file_name = file_name_init;
+
+		// 设置基本成员变量
+		mat_ptr = mat_ptr_init;
+		scale_vec = vec3(1, 1, 1);
+		rotate_vec = vec3(0, 0, 0);
+		translate_vec = vec3(0, 0, 0);
+	}
+
+	void set_scale(const vec3 &vec) override {
+		scale_vec = vec;
+	}
+
+	void set_rotate(const vec3 &vec) override {
+		rotate_vec = vec;
+	}
+
+	void set_translate(const vec3 &vec) override {
+		translate_vec = vec;
+	}
+
+	bool describe(mesh_description &desc) const override {
+		desc.params << "simple_obj_mesh|" << file_name << '|' << scale_vec << '|' << rotate_vec << '|' << translate_vec;
+		desc.files.push_back(file_name);
+		desc.materials.emplace_back("", mat_ptr);
+		return true;
+	}
+
+	virtual vector<shared_ptr<triangle>> unpack() const override {
+		// 读取.obj文件
+		// 一个mesh对应blender中一个独立的网格（或网格中使用同一材质的部分），其中包含一系列顶点和索引信息
+		obj_model model;
+		load_obj(file_name.c_str(), model);
+		const vector<obj_mesh>& mesh_list = model.meshes;
+
+		// 初始化返回值
+		vector<shared_ptr<triangle>> triangle_ptr_list;
+		
+		// 计算三角形个数
+		int num_triangle = 0;
+		for (const obj_mesh& mesh : mesh_list) {
+			num_triangle += mesh.indices.size() / 3;
+		}
+		// 预先设定triangle_ptr_list长度
+		triangle_ptr_list.resize(num_triangle);
+		
+		// 对每个mesh分别进行读取
+		int triangle_ptr_index = 0;
+		for (const obj_mesh& mesh : mesh_list) {
+			
+			// 首先记录顶点信息
+			// 将顶点位置转换为vec3格式，存放在position_list中
+			vector<vec3> position_list;
+			// 将顶点uv坐标转换为vec3格式，存放在uv_list中
+			vector<vec3> uv_list;
+			// 将顶点法线转换为vec3格式，存放在normal_list中
+			vector<vec3> normal_list;
+
+			// 预先设定position_list，uv_list和normal_list的长度
+			int vertex_num = mesh.positions.size();
+			position_list.resize(vertex_num);
+			uv_list.resize(vertex_num);
+			normal_list.resize(vertex_num);
+			
+			for (int index = 0; index < vertex_num; index++) {
+				// 记录顶点位置时，根据自定的blender对应坐标系进行坐标变换
+				// blender中的y对应这里的x
+				// blender中的z对应这里的y
+				// blender中的x对应这里的z
+				// 但是直接使用上述映射没有得到正确的结果，所以实际代码使用了一个hack，暂时不知道原理
+				//position_list[index] = vec3(mesh.positions[index][1], mesh.positions[index][2], mesh.positions[index][0]); // 理论正确
+				position_list[index] = vec3(-mesh.positions[index][2], mesh.positions[index][1], mesh.positions[index][0]); // 实际正确
+				// 应用mesh_triangle自带的变换
+				position_list[index].scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
+
+				// 对normal使用相同的hack
+				normal_list[index] = vec3(-mesh.normals[index][2], mesh.normals[index][1], mesh.normals[index][0]);
+				// 应用mesh_triangle自带的变换（不使用translate，且scale变换是顶点位置scale变换的逆）
+				normal_list[index].scale(vec3(1 / scale_vec[0], 1 / scale_vec[1], 1 / scale_vec[2])).rotate(rotate_vec);
+
+				// 记录uv
+				uv_list[index] = mesh.uvs[index];
+			}
+			
+			// 生成三角形，并放入triangle_ptr_list
+			int index_num = mesh.indices.size();
+			// 每三个index一组对应一个三角形
+			//std::cout << triangle_ptr_list.size() << ' ' << position_list.size() << '\n';
+			for (int index = 0; index < index_num ; index += 3) {
+				//std::cout << triangle_ptr_index << ' ' << index << '\n';
+				triangle_ptr_list[triangle_ptr_index] = make_shared<triangle>(
+					position_list[mesh.indices[index]],
+					position_list[mesh.indices[index + 1]], 
+					position_list[mesh.indices[index + 2]],
+					mat_ptr,
+					uv_list[mesh.indices[index]],
+					uv_list[mesh.indices[index + 1]],
+					uv_list[mesh.indices[index + 2]],
+					normal_list[mesh.indices[index]],
+					normal_list[mesh.indices[index + 1]],
+					normal_list[mesh.indices[index + 2]]);
+				triangle_ptr_index++;
+			}
+		}
+
+		return triangle_ptr_list;
+	}
+};
+
+
+// 从.obj文件中读取
+// 读取顶点位置、uv和法线
+// 顶点坐标根据自定blender坐标进行变换
+// 可以给不同的mesh分配不同的材质
+// 将{mesh名称 : material_ptr}存放在map中，并根据读取到的mesh名称进行分配
+class dict_material_obj_mesh : public mesh_triangle
+{
+public:
+	// {mesh名称 : material_ptr}字典
+	unordered_map<string, shared_ptr<material>> material_dict;
+
+	// 默认material_ptr
+	shared_ptr<material> default_mat_ptr;
+
+	// 变换，按先后顺序排列
+	vec3 scale_vec;
+	vec3 rotate_vec; // 分别为绕x,y,z轴旋转的弧度
+	vec3 translate_vec;
+
+	// .obj文件路径，在unpack时读取
+	string file_name;
+
+
+public:
+	dict_material_obj_mesh(const char file_name_init[], unordered_map<string, shared_ptr<material>> material_dict_init, shared_ptr<material> default_mat_ptr_init)
+	{
+		file_name = file_name_init;
+
+		// 设置基本成员变量
+		material_dict = material_dict_init;
+		default_mat_ptr = default_mat_ptr_init;
+		scale_vec = vec3(1, 1, 1);
+		rotate_vec = vec3(0, 0, 0);
+		translate_vec = vec3(0, 0, 0);
+	}
+
+	void set_scale(const vec3 &vec) override {
+		scale_vec = vec;
+	}
+
+	void set_rotate(const vec3 &vec) override {
+		rotate_vec = vec;
+	}
+
+	void set_translate(const vec3 &vec) override {
+		translate_vec = vec;
+	}
+
+	bool describe(mesh_description &desc) const override {
+		desc.params << "dict_material_obj_mesh|" << file_name << '|' << scale_vec << '|' << rotate_vec << '|' << translate_vec;
+		desc.files.push_back(file_name);
+		// 按名称排序，描述与字典的遍历顺序无关
+		std::map<string, shared_ptr<material>> sorted_dict(material_dict.begin(), material_dict.end());
+		for (const auto& item : sorted_dict) desc.materials.push_back(item);
+		desc.materials.emplace_back("", default_mat_ptr);
+		return true;
+	}
+
+	virtual vector<shared_ptr<triangle>> unpack() const override {
+		// 读取.obj文件
+		// 一个mesh对应blender中一个独立的网格（或网格中使用同一材质的部分），其中包含一系列顶点和索引信息
+		obj_model model;
+		load_obj(file_name.c_str(), model);
+		const vector<obj_mesh>& mesh_list = model.meshes;
+
+		// 初始化返回值
+		vector<shared_ptr<triangle>> triangle_ptr_list;
+
+		// 计算三角形个数
+		int num_triangle = 0;
+		for (const obj_mesh& mesh : mesh_list) {
+			num_triangle += mesh.indices.size() / 3;
+		}
+		// 预先设定triangle_ptr_list长度
+		triangle_ptr_list.resize(num_triangle);
+
+		// 对每个mesh分别进行读取
+		int triangle_ptr_index = 0;
+		for (const obj_mesh& mesh : mesh_list) {
+			
+			// 确定该mesh所对应的material_ptr
+			shared_ptr<material> current_mat_ptr = nullptr; // 存在这个指针里
+
+			auto itr = material_dict.find(mesh.name);
+			bool material_found = itr != material_dict.end();
+			if (not material_found) { // 如果没有指定该mesh的material，使用默认material
+				current_mat_ptr = default_mat_ptr;
+			}
+			else { // 已经指定了该mesh的material
+				current_mat_ptr = itr->second;
+			}
+			// 整行一次输出，多个网格在加载线程中同时展开时不会交错
+			std::cout << "loading " + mesh.name + "   material found: " + (material_found ? "true" : "false") + "   num of triangles = " + std::to_string(mesh.indices.size() / 3) + "\n";
+
+			// 首先记录顶点信息
+			// 将顶点位置转换为vec3格式，存放在position_list中
+			vector<vec3> position_list;
+			// 将顶点uv坐标转换为vec3格式，存放在uv_list中
+			vector<vec3> uv_list;
+			// 将顶点法线转换为vec3格式，存放在normal_list中
+			vector<vec3> normal_list;
+
+			// 预先设定position_list，uv_list和normal_list的长度
+			int vertex_num = mesh.positions.size();
+			position_list.resize(vertex_num);
+			uv_list.resize(vertex_num);
+			normal_list.resize(vertex_num);
+
+			for (int index = 0; index < vertex_num; index++) {
+				// 记录顶点位置时，根据自定的blender对应坐标系进行坐标变换
+				// blender中的y对应这里的x
+				// blender中的z对应这里的y
+				// blender中的x对应这里的z
+				// 但是直接使用上述映射没有得到正确的结果，所以实际代码使用了一个hack，暂时不知道原理
+				//position_list[index] = vec3(mesh.positions[index][1], mesh.positions[index][2], mesh.positions[index][0]); // 理论正确
+				position_list[index] = vec3(-mesh.positions[index][2], mesh.positions[index][1], mesh.positions[index][0]); // 实际正确
+				// 应用mesh_triangle自带的变换
+				position_list[index].scale(scale_vec).rotate(rotate_vec).translate(translate_vec);
+
+				// 对normal使用相同的hack
+				normal_list[index] = vec3(-mesh.normals[index][2], mesh.normals[index][1], mesh.normals[index][0]);
+				// 应用mesh_triangle自带的变换（不使用translate，且scale变换是顶点位置scale变换的逆）
+				normal_list[index].scale(vec3(1 / scale_vec[0], 1 / scale_vec[1], 1 / scale_vec[2])).rotate(rotate_vec);
+
+				// 记录uv
+				uv_list[index] = mesh.uvs[index];
+			}
+
+			// 生成三角形，并放入triangle_ptr_list
+			int index_num = mesh.indices.size();
+			// 每三个index一组对应一个三角形
+			if (const texture* displacement_map_ptr = current_mat_ptr->get_displacement_map_ptr()) { // 有置换贴图的情况
+				for (int index = 0; index < index_num; index += 3) {
+					triangle_ptr_list[triangle_ptr_index] = make_shared<triangle>(
+						position_list[mesh.indices[index]] + normal_list[mesh.indices[index]] * displacement_map_ptr->get_value(uv_list[mesh.indices[index]]),
+						position_list[mesh.indices[index + 1]] + normal_list[mesh.indices[index + 1]] * displacement_map_ptr->get_value(uv_list[mesh.indices[index + 1]]),
+						position_list[mesh.indices[index + 2]] + normal_list[mesh.indices[index + 2]] * displacement_map_ptr->get_value(uv_list[mesh.indices[index + 2]]),
+						current_mat_ptr,
+						uv_list[mesh.indices[index]],
+						uv_list[mesh.indices[index + 1]],
+						uv_list[mesh.indices[index + 2]],
+						normal_list[mesh.indices[index]],
+						normal_list[mesh.indices[index + 1]],
+						normal_list[mesh.indices[index + 2]]);
+					triangle_ptr_index++;
+				}
+			}
+			else { // 没有置换贴图的情况
+				for (int index = 0; index < index_num; index += 3) {
+					triangle_ptr_list[triangle_ptr_index] = make_shared<triangle>(
+						position_list[mesh.indices[index]],
+						position_list[mesh.indices[index + 1]],
+						position_list[mesh.indices[index + 2]],
+						current_mat_ptr,
+						uv_list[mesh.indices[index]],
+						uv_list[mesh.indices[index + 1]],
+						uv_list[mesh.indices[index + 2]],
+						normal_list[mesh.indices[index]],
+						normal_list[mesh.indices[index + 1]],
+						normal_list[mesh.indices[index + 2]]);
+					triangle_ptr_index++;
+				}
+			}
+		}
+
+		return triangle_ptr_list;
+	}
+};
+
+
+// 从二进制.ply文件中读取
+// 读取顶点位置，以及文件中提供的uv和法线
+// 扫描数据一般不是从blender导出的，顶点坐标不做坐标系转换，只应用mesh_triangle自带的变换
+// 只能使用一种材质
+class ply_mesh : public mesh_triangle
+{
+public:
+	// material指针
+	shared_ptr<material> mat_ptr;
+
+	// 变换，按先后顺序排列
+	vec3 scale_vec;
+	vec3 rotate_vec; // 分别为绕x,y,z轴旋转的弧度
+	vec3 translate_vec;
+
+	// .ply文件路径，在unpack时读取
+	string file_name;
+
+
+public:
+	ply_mesh(const char file_name_init[], shared_ptr<material> mat_ptr_init)
+	{
+		file_name = file_name_init;
+
+		// 设置基本成员变量
+		mat_ptr = mat_ptr_init;
+		scale_vec = vec3(1, 1, 1);
+		rotate_vec = vec3(0, 0, 0);
+		translate_vec = vec3(0, 0, 0);
+	}
+
+	void set_scale(const vec3 &vec) override {
+		scale_vec = vec;
+	}
+
+	void set_rotate(const vec3 &vec) override {
+		rotate_vec = vec;
+	}
+
+	void set_translate(const vec3 &vec) override {
+		translate_vec = vec;
+	}
+
+	bool describe(mesh_description &desc) const override {
+		desc.params << "ply_mesh|" << file_name << '|' << scale_vec << '|' << rotate_vec << '|' << translate_vec;
+		desc.files.push_back(file_name);
+		desc.materials.emplace_back("", mat_ptr);
+		return true;
+	}
+
+	// 直接由.ply中的数组生成三角形数据
+	// 扫描数据中常有面积为0的三角形，它们不会被光线击中，面法线也没有定义（归一化得到NaN），直接跳过
+	bool unpack_faces(vector<triangle_data> &faces, shared_ptr<material> &mat_ptr_out) const override {
+		ply_data data;
+		load_ply(file_name.c_str(), data);
+		vertex_transform transform(scale_vec, rotate_vec, translate_vec);
+		bool has_normal = not data.normals.empty();
+		bool has_uv = not data.uvs.empty();
+		auto position = [&](size_t i) { return transform.point(&data.positions[i * 3]); };
+		auto normal = [&](size_t i) { return transform.normal(&data.normals[i * 3]); };
+		auto uv = [&](size_t i) { return has_uv ? vec3(data.uvs[i * 2], data.uvs[i * 2 + 1], 0) : vec3(0, 0, 0); };
+
+		// 每三个index一组对应一个三角形
+		size_t index_num = data.indices.size();
+		faces.clear();
+		faces.reserve(index_num / 3);
+		for (size_t index = 0; index + 2 < index_num; index += 3) {
+			uint32_t i0 = data.indices[index];
+			uint32_t i1 = data.indices[index + 1];
+			uint32_t i2 = data.indices[index + 2];
+			vec3 p0 = position(i0);
+			vec3 p1 = position(i1);
+			vec3 p2 = position(i2);
+			vec3 face_cross = cross(p1 - p0, p2 - p0);
+			if (face_cross.length_squared() == 0) continue;
+
+			faces.emplace_back();
+			if (has_normal) {
+				init_triangle_data(faces.back(), p0, p1, p2, uv(i0), uv(i1), uv(i2),
+					normal(i0), normal(i1), normal(i2));
+				continue;
+			}
+			// 没有法线时使用面法线
+			vec3 face_normal = unit_vector(face_cross);
+			init_triangle_data(faces.back(), p0, p1, p2, uv(i0), uv(i1), uv(i2), face_normal, face_normal, face_normal);
+			if (not has_uv) faces.back().tangent = vec3(0, 0, 0); // 没有uv时用不了法线贴图，与triangle不带uv的构造相同
+		}
+
+		mat_ptr_out = mat_ptr;
+		return true;
+	}
+
+	virtual vector<shared_ptr<triangle>> unpack() const override {
+		vector<triangle_data> faces;
+		shared_ptr<material> face_mat_ptr;
+		unpack_faces(faces, face_mat_ptr);
+		vector<shared_ptr<triangle>> triangle_ptr_list;
+		triangle_ptr_list.reserve(faces.size());
+		for (const triangle_data& face : faces) triangle_ptr_list.push_back(make_shared<triangle>(face, face_mat_ptr));
+		return triangle_ptr_list;
+	}
+};
+
 #endif
\ No newline at end of file
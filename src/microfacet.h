@@ -0,0 +1,342 @@
+#pragma once
+#ifndef MICROFACET_H
+#define MICROFACET_H
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <random>
+#include <fstream>
+#include <cstdint>
+#include <filesystem>
+#include "global.h"
+#include "mapped_file.h"
+
+using std::vector;
+
+
+// GGX微表面模型的公共函数
+// a为粗糙度（即GGX分布的alpha），n为宏观法线，所有方向都是单位向量
+
+// GGX NDF
+inline double ggx_D(double cos_h, double a) {
+	double a2 = a * a;
+	double t = cos_h * cos_h * (a2 - 1) + 1;
+	return a2 / (pi * t * t);
+}
+
+// Smith遮挡函数G1（与可见法线分布采样对应）
+inline double ggx_G1(double cos_v, double a) {
+	cos_v = fabs(cos_v);
+	if (cos_v == 0) return 0;
+	double a2 = a * a;
+	return 2 * cos_v / (cos_v + sqrt(a2 + (1 - a2) * cos_v * cos_v));
+}
+
+// 金属与非金属材质使用的几何项（Schlick-GGX，k = a / 2）
+inline double ggx_schlick_G(double dot_n_v, double dot_n_l, double a) {
+	double k = a * 0.5;
+	return dot_n_v / (dot_n_v * (1 - k) + k) * dot_n_l / (dot_n_l * (1 - k) + k);
+}
+
+// 电介质的菲涅尔反射率
+// cos_o为入射侧方向与法线（或微表面法线）的夹角余弦，n_o、n_i为入射侧与折射侧的折射率
+inline double fresnel_dielectric(double cos_o, double n_o, double n_i) {
+	cos_o = clamp(cos_o, 0, 1);
+	double sin_i_2 = (n_o / n_i) * (n_o / n_i) * (1 - cos_o * cos_o);
+	if (sin_i_2 >= 1) return 1; // 全反射
+	double cos_i = sqrt(1 - sin_i_2);
+	double Rs = (n_o * cos_o - n_i * cos_i) / (n_o * cos_o + n_i * cos_i);
+	double Rp = (n_o * cos_i - n_i * cos_o) / (n_o * cos_i + n_i * cos_o);
+	return 0.5 * (Rs * Rs + Rp * Rp);
+}
+
+
+// 各向异性GGX的可见法线分布（VNDF）采样
+// 参考 Heitz 2018, Sampling the GGX Distribution of Visible Normals
+// 只采样从wo方向可见的微表面法线，反射方向几乎不会落到宏观表面以下
+// x、y为切线方向（与ax、ay对应），n为宏观法线
+inline vec3 sample_ggx_vndf_aniso(const vec3& wo, const vec3& n, const vec3& x, const vec3& y, double ax, double ay, double rand1, double rand2) {
+	vec3 wo_local(dot(wo, x), dot(wo, y), std::max(dot(wo, n), 1e-6));
+
+	// 拉伸到a = 1的半球
+	vec3 vh = unit_vector(vec3(ax * wo_local.x(), ay * wo_local.y(), wo_local.z()));
+
+	// 在投影圆盘上采样
+	double len2 = vh.x() * vh.x() + vh.y() * vh.y();
+	vec3 t1 = len2 > 0 ? vec3(-vh.y(), vh.x(), 0) / sqrt(len2) : vec3(1, 0, 0);
+	vec3 t2 = cross(vh, t1);
+	double r = sqrt(rand1);
+	double phi = pi2 * rand2;
+	double p1 = r * cos(phi);
+	double p2 = r * sin(phi);
+	double s = 0.5 * (1 + vh.z());
+	p2 = (1 - s) * sqrt(1 - p1 * p1) + s * p2;
+	vec3 nh = p1 * t1 + p2 * t2 + sqrt(std::max(0.0, 1 - p1 * p1 - p2 * p2)) * vh;
+
+	// 还原拉伸
+	vec3 h_local = unit_vector(vec3(ax * nh.x(), ay * nh.y(), std::max(1e-6, nh.z())));
+	return x * h_local.x() + y * h_local.y() + n * h_local.z();
+}
+
+// 各向同性GGX的VNDF采样
+inline vec3 sample_ggx_vndf(const vec3& wo, const vec3& n, double a, double rand1, double rand2) {
+	vec3 b1, b2;
+	build_basis(n, b1, b2);
+	return sample_ggx_vndf_aniso(wo, n, b1, b2, a, a, rand1, rand2);
+}
+
+// 可见法线分布下采样到微表面法线h的pdf
+inline double ggx_vndf_pdf(const vec3& wo, const vec3& h, const vec3& n, double a) {
+	double cos_o = std::max(dot(wo, n), 1e-6);
+	double cos_oh = dot(wo, h);
+	if (cos_oh <= 0) return 0;
+	return ggx_G1(cos_o, a) * cos_oh * ggx_D(dot(n, h), a) / cos_o;
+}
+
+// 使用VNDF采样时反射方向wi的pdf（立体角）
+inline double ggx_vndf_reflection_pdf(const vec3& wo, const vec3& wi, const vec3& n, double a) {
+	vec3 h = unit_vector(wo + wi);
+	double cos_oh = dot(wo, h);
+	if (cos_oh <= 0) return 0;
+	return ggx_vndf_pdf(wo, h, n, a) * 0.25 / cos_oh;
+}
+
+// 各向异性VNDF采样时反射方向wi的pdf（立体角）
+// 与disney brdf一致，D为GTR2_aniso，G1由smithG_GGX_aniso得到（smithG_GGX_aniso = G1 / (2 * cos)）
+inline double ggx_vndf_reflection_pdf_aniso(const vec3& wo, const vec3& wi, const vec3& n, const vec3& x, const vec3& y, double ax, double ay) {
+	vec3 h = unit_vector(wo + wi);
+	double cos_o = std::max(dot(wo, n), 1e-6);
+	if (dot(wo, h) <= 0) return 0;
+	double D = GTR2_aniso(dot(n, h), dot(h, x), dot(h, y), ax, ay);
+	double G1 = 2 * cos_o * smithG_GGX_aniso(cos_o, dot(wo, x), dot(wo, y), ax, ay);
+	return G1 * D * 0.25 / cos_o;
+}
+
+
+// GTR1（清漆层）分布的微表面法线采样，pdf为 D(h) * cos_h
+inline vec3 sample_gtr1(const vec3& n, double a, double rand1, double rand2) {
+	double cos_h = 1;
+	if (a < 1) {
+		double a2 = a * a;
+		cos_h = sqrt(std::max(0.0, (1 - pow(a2, 1 - rand1)) / (1 - a2)));
+	}
+	else {
+		cos_h = sqrt(1 - rand1);
+	}
+	double sin_h = sqrt(std::max(0.0, 1 - cos_h * cos_h));
+	double phi = pi2 * rand2;
+	vec3 b1, b2;
+	build_basis(n, b1, b2);
+	return n * cos_h + b1 * sin_h * cos(phi) + b2 * sin_h * sin(phi);
+}
+
+// GTR1采样时反射方向wi的pdf（立体角）
+inline double gtr1_reflection_pdf(const vec3& wo, const vec3& wi, const vec3& n, double a) {
+	vec3 h = unit_vector(wo + wi);
+	double cos_h = dot(n, h);
+	double cos_oh = dot(wo, h);
+	if (cos_h <= 0 or cos_oh <= 0) return 0;
+	return GTR1(cos_h, a) * cos_h * 0.25 / cos_oh;
+}
+
+
+// GGX高光项（Schlick-GGX几何项，Schlick菲涅尔）的方向反照率表
+// 反照率可以拆分为 E(cos_o, a) = F0 * A(cos_o, a) + B(cos_o, a)，对A、B分别预计算
+// 同时保存对cos_o积分得到的平均反照率 E_avg(a) = 2 ∫ E(cos_o, a) cos_o dcos_o
+// 采样时用于按各个lobe的能量选择lobe，渲染时用于多次散射的能量补偿（Kulla-Conty）
+// 表项以float保存，生成一次后写入二进制缓存文件，之后启动时直接读取（见load_ggx_albedo）
+class ggx_albedo_table {
+public:
+	static constexpr int resolution = 32; // cos_o与a方向的分辨率
+	static constexpr int sample_num = 1024; // 每个表项的采样数
+	static constexpr uint32_t file_magic = 0x41584747; // "GGXA"
+	static constexpr uint32_t file_version = 1;
+
+private:
+	vector<float> A;
+	vector<float> B;
+	vector<float> A_avg;
+	vector<float> B_avg;
+
+public:
+	// cache_path为空时不使用缓存文件
+	ggx_albedo_table(const char* cache_path = nullptr) {
+		if (cache_path and load(cache_path)) return;
+		build();
+		if (cache_path) save(cache_path);
+	}
+
+	// 反照率，F0为法线方向的菲涅尔反射率
+	double albedo(double cos_o, double a, double F0) const {
+		double fa, fb;
+		lookup(cos_o, a, fa, fb);
+		return F0 * fa + fb;
+	}
+
+	vec3 albedo(double cos_o, double a, const vec3& F0) const {
+		double fa, fb;
+		lookup(cos_o, a, fa, fb);
+		return F0 * fa + vec3(fb, fb, fb);
+	}
+
+	// 平均反照率
+	double average_albedo(double a, double F0) const {
+		double fa, fb;
+		lookup_average(a, fa, fb);
+		return F0 * fa + fb;
+	}
+
+	// 多次散射补偿项（Kulla-Conty 2017）
+	// f_ms = F_ms * (1 - E(cos_o)) * (1 - E(cos_i)) / (pi * (1 - E_avg))，其中E、E_avg为F = 1时的反照率
+	// F_ms = F_avg^2 * E_avg / (1 - F_avg * (1 - E_avg))，用于补偿多次散射中菲涅尔项造成的吸收
+	vec3 multiple_scattering(double cos_o, double cos_i, double a, const vec3& F0) const {
+		double E_o = clamp(albedo(cos_o, a, 1.0), 0, 1);
+		double E_i = clamp(albedo(cos_i, a, 1.0), 0, 1);
+		double E_avg = clamp(average_albedo(a, 1.0), 0, 1);
+		if (E_avg >= 1) return vec3(0, 0, 0);
+
+		// Schlick菲涅尔项的半球平均 F_avg = F0 + (1 - F0) / 21
+		vec3 F_ms;
+		for (int c = 0; c < 3; c++) {
+			double F_avg = F0[c] + (1 - F0[c]) / 21;
+			F_ms[c] = F_avg * F_avg * E_avg / (1 - F_avg * (1 - E_avg));
+		}
+		return F_ms * ((1 - E_o) * (1 - E_i) / (pi * (1 - E_avg)));
+	}
+
+	// 从二进制缓存文件读取，文件不存在或者格式不匹配时返回false
+	bool load(const char* path) {
+		std::ifstream file(path, std::ios::binary);
+		if (not file) return false;
+		uint32_t header[4];
+		if (not file.read(reinterpret_cast<char*>(header), sizeof(header))) return false;
+		if (header[0] != file_magic or header[1] != file_version or header[2] != resolution or header[3] != sample_num) return false;
+
+		vector<float> A_file(resolution * resolution), B_file(resolution * resolution), A_avg_file(resolution), B_avg_file(resolution);
+		for (vector<float>* t : { &A_file, &B_file, &A_avg_file, &B_avg_file }) {
+			if (not file.read(reinterpret_cast<char*>(t->data()), t->size() * sizeof(float))) return false;
+		}
+		A = std::move(A_file);
+		B = std::move(B_file);
+		A_avg = std::move(A_avg_file);
+		B_avg = std::move(B_avg_file);
+		return true;
+	}
+
+	// 先写到临时文件再重命名，同时启动的多个进程不会读到不完整的文件。写入失败时不使用缓存
+	void save(const char* path) const {
+		std::string temp_path = unique_temp_path(path);
+		std::ofstream file(temp_path, std::ios::binary);
+		if (not file) return;
+		uint32_t header[4] = { file_magic, file_version, resolution, sample_num };
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		for (const vector<float>* t : { &A, &B, &A_avg, &B_avg }) {
+			file.write(reinterpret_cast<const char*>(t->data()), t->size() * sizeof(float));
+		}
+		file.close();
+
+		std::error_code ec;
+		if (file) std::filesystem::rename(temp_path, path, ec);
+		if (not file or ec) std::filesystem::remove(temp_path, ec);
+	}
+
+private:
+	void build() {
+		A.assign(resolution * resolution, 0);
+		B.assign(resolution * resolution, 0);
+		A_avg.assign(resolution, 0);
+		B_avg.assign(resolution, 0);
+
+		// 使用固定种子的分层采样，不占用渲染时的随机数
+		std::mt19937 rng(0);
+		std::uniform_real_distribution<double> uniform(0.0, 1.0);
+		int strata = static_cast<int>(sqrt(static_cast<double>(sample_num)));
+		vec3 n(0, 0, 1);
+		for (int j = 0; j < resolution; j++) {
+			double a = std::max(1e-3, static_cast<double>(j) / (resolution - 1));
+			for (int i = 0; i < resolution; i++) {
+				double cos_o = std::max(1e-3, static_cast<double>(i) / (resolution - 1));
+				vec3 wo(sqrt(1 - cos_o * cos_o), 0, cos_o);
+				double sum_A = 0, sum_B = 0;
+				for (int k = 0; k < strata * strata; k++) {
+					double rand1 = (k % strata + uniform(rng)) / strata;
+					double rand2 = (k / strata + uniform(rng)) / strata;
+					vec3 h = sample_ggx_vndf(wo, n, a, rand1, rand2);
+					vec3 wi = 2 * h * dot(wo, h) - wo;
+					double cos_i = wi.z();
+					if (cos_i <= 0) continue;
+
+					// f * cos / pdf = G / G1(wo)
+					double weight = ggx_schlick_G(cos_o, cos_i, a) / ggx_G1(cos_o, a);
+					double Fc = pow(1 - clamp(dot(wo, h), 0, 1), 5);
+					sum_A += weight * (1 - Fc);
+					sum_B += weight * Fc;
+				}
+				A[j * resolution + i] = static_cast<float>(sum_A / (strata * strata));
+				B[j * resolution + i] = static_cast<float>(sum_B / (strata * strata));
+			}
+
+			// 梯形积分得到平均反照率
+			double sum_A_avg = 0, sum_B_avg = 0;
+			double d_cos = 1.0 / (resolution - 1);
+			for (int i = 0; i + 1 < resolution; i++) {
+				double c0 = i * d_cos, c1 = (i + 1) * d_cos;
+				sum_A_avg += 0.5 * (A[j * resolution + i] * c0 + A[j * resolution + i + 1] * c1) * d_cos;
+				sum_B_avg += 0.5 * (B[j * resolution + i] * c0 + B[j * resolution + i + 1] * c1) * d_cos;
+			}
+			A_avg[j] = static_cast<float>(2 * sum_A_avg);
+			B_avg[j] = static_cast<float>(2 * sum_B_avg);
+		}
+	}
+
+	// 双线性插值
+	void lookup(double cos_o, double a, double& fa, double& fb) const {
+		double x = clamp(cos_o, 0, 1) * (resolution - 1);
+		double y = clamp(a, 0, 1) * (resolution - 1);
+		int x0 = std::min(static_cast<int>(x), resolution - 2);
+		int y0 = std::min(static_cast<int>(y), resolution - 2);
+		double tx = x - x0, ty = y - y0;
+		auto bilerp = [&](const vector<float>& t) {
+			double v0 = t[y0 * resolution + x0] * (1 - tx) + t[y0 * resolution + x0 + 1] * tx;
+			double v1 = t[(y0 + 1) * resolution + x0] * (1 - tx) + t[(y0 + 1) * resolution + x0 + 1] * tx;
+			return v0 * (1 - ty) + v1 * ty;
+		};
+		fa = bilerp(A);
+		fb = bilerp(B);
+	}
+
+	// 线性插值
+	void lookup_average(double a, double& fa, double& fb) const {
+		double y = clamp(a, 0, 1) * (resolution - 1);
+		int y0 = std::min(static_cast<int>(y), resolution - 2);
+		double ty = y - y0;
+		fa = A_avg[y0] * (1 - ty) + A_avg[y0 + 1] * ty;
+		fb = B_avg[y0] * (1 - ty) + B_avg[y0 + 1] * ty;
+	}
+};
+
+// 反照率表的缓存文件，为空时不读写缓存文件，每次启动时生成。需要在load_ggx_albedo之前设置
+inline std::string ggx_albedo_cache_path = "ggx_albedo.bin";
+
+namespace microfacet_detail {
+	inline std::unique_ptr<ggx_albedo_table> albedo_table;
+	inline std::once_flag albedo_table_once;
+}
+
+// 读取缓存文件或生成全局反照率表
+// 在程序启动时（渲染线程开始之前）调用，生成表与写入缓存文件不会发生在渲染中
+inline void load_ggx_albedo() {
+	std::call_once(microfacet_detail::albedo_table_once, [] {
+		microfacet_detail::albedo_table = std::make_unique<ggx_albedo_table>(ggx_albedo_cache_path.empty() ? nullptr : ggx_albedo_cache_path.c_str());
+	});
+}
+
+// 全局反照率表，没有调用过load_ggx_albedo时在这里加载
+inline const ggx_albedo_table& ggx_albedo() {
+	load_ggx_albedo();
+	return *microfacet_detail::albedo_table;
+}
+
+#endif
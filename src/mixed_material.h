@@ -1,57 +1,131 @@
-#pragma once
-#ifndef MIXED_MATERIAL_H
-#define MIXED_MATERIAL_H
-#include "material.h"
-using std::vector;
-
-class mixed_material : public material {
-public:
-	shared_ptr<material> mat_ptr_1;
-	shared_ptr<material> mat_ptr_2;
-
-public:
-	// 
-	// ֵΪ{pdfǣ䷽Ƿͷͬ}
-	tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front) const override {
-
-	};
-
-	// 
-	// ֵΪ{pdf㷨ߣ}
-	tuple<double, vec3, vec3> sample_positioni(const vec3& normalo, const vec3& positiono, shared_ptr<hittable> world) const override {
-		
-	}
-
-
-	// brdf
-	vec3 bsdf(const vec3 & wo, const vec3 & normalo, const vec3 & positiono, bool wo_front, const vec3 & uv,
-		const vec3 & wi, const vec3 & normali, const vec3 & positioni, bool wi_front) const override {
-
-	}
-
-	// ȡԷǿ
-	vec3 get_radiance() const override {
-
-	}
-
-	// ȡͼָ
-	shared_ptr<texture> get_normal_map_ptr() const override;
-
-	// ȡͼָ
-	shared_ptr<texture> get_color_map_ptr() const override;
-
-	// ȡ
-	// ܷؿָ
-	shared_ptr<medium> get_medium_outside_ptr() const override;
-	shared_ptr<medium> get_medium_inside_ptr() const override;
-
-	// ǷҪԹԴ
-	bool sample_light() const override;
-
-	// ȡʱ
-	int get_material_number() const override;
-	
-};
-
-
-#endif
\ No newline at end of file
+#pragma once
+#ifndef MIXED_MATERIAL_H
+#define MIXED_MATERIAL_H
+#include "material.h"
+using std::vector;
+
+// 混合材质
+// bsdf为两个子材质的线性混合：f = (1 - w) * f1 + w * f2，w为混合权重，可以由纹理控制
+// 每个着色点只按uv处的权重随机选择一次子材质（见init_context），选择结果保存在shading_context中，
+// 之后的sample_wi、pdf_wi、bsdf、get_radiance都只计算选中的子材质，权重为1。对选择取期望即为线性混合，因此无偏
+// ReSTIR的目标函数与最终着色使用同一个上下文，两者计算的是同一个子材质
+// 子材质不能是镜面材质（pdf为delta分布时与按点选择的方式不兼容），也不支持次表面散射材质和嵌套的混合材质
+class mixed_material final : public material {
+public:
+	shared_ptr<material> mat_ptr_1;
+	shared_ptr<material> mat_ptr_2;
+	double weight = 0.5; // 子材质2的权重，[0,1]
+	shared_ptr<texture> weight_map_ptr = nullptr; // 权重贴图，使用第一个通道。为空时使用weight
+
+public:
+	mixed_material(shared_ptr<material> mat_ptr_1_init, shared_ptr<material> mat_ptr_2_init, double weight_init = 0.5, shared_ptr<texture> weight_map_ptr_init = nullptr) {
+		mat_ptr_1 = mat_ptr_1_init;
+		mat_ptr_2 = mat_ptr_2_init;
+		weight = clamp(weight_init, 0, 1);
+		weight_map_ptr = weight_map_ptr_init;
+	}
+
+	// 按uv处的权重选择子材质，选中子材质2时读取它的纹理颜色（alpha仍使用子材质1的）
+	void init_context(shading_context& ctx) const override {
+		if (random_double() < get_weight(ctx.uv)) {
+			ctx.lobe = 2;
+			double alpha;
+			mat_ptr_2->get_color_map_ptr()->get_rgba(ctx.uv, ctx.footprint, ctx.color, alpha);
+		}
+		else ctx.lobe = 1;
+	}
+
+	// 采样入射角
+	// 返回值为{pdf，入射角，入射方向是否和法线同向}
+	tuple<double, vec3, bool> sample_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx) const override {
+		return chosen(ctx).sample_wi(wo, normali, wo_front, ctx);
+	}
+
+	// 采样入射点
+	// 返回值为{pdf，入射点法线，入射点坐标}
+	tuple<double, vec3, vec3> sample_positioni(const vec3& normalo, const vec3& positiono, const hittable& world) const override {
+		return make_tuple(1, normalo, positiono);
+	}
+
+	// 计算bsdf项
+	vec3 bsdf(const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const shading_context& ctx,
+		const vec3& wi, const vec3& normali, const vec3& positioni, bool wi_front) const override {
+		return chosen(ctx).bsdf(wo, normalo, positiono, wo_front, ctx, wi, normali, positioni, wi_front);
+	}
+
+	double pdf_wi(const vec3& wo, const vec3& normali, bool wo_front, const shading_context& ctx, const vec3& wi, bool wi_front) const override {
+		return chosen(ctx).pdf_wi(wo, normali, wo_front, ctx, wi, wi_front);
+	}
+
+	// 着色点选中的子材质
+	const material& chosen(const shading_context& ctx) const {
+		return ctx.lobe == 2 ? *mat_ptr_2 : *mat_ptr_1;
+	}
+
+	// uv处子材质2的权重
+	double get_weight(const vec3& uv) const {
+		if (weight_map_ptr) return clamp(weight_map_ptr->get_value(uv).x(), 0, 1);
+		return weight;
+	}
+
+	// 获取材质自发光强度
+	vec3 get_radiance(const shading_context& ctx) const override {
+		return chosen(ctx).get_radiance(ctx);
+	}
+
+	// 贴图、介质都使用子材质1的
+	// 获取法线贴图指针
+	const texture* get_normal_map_ptr() const override {
+		return mat_ptr_1->get_normal_map_ptr();
+	}
+
+	// 获取图像纹理指针
+	const texture* get_color_map_ptr() const override {
+		return mat_ptr_1->get_color_map_ptr();
+	}
+
+	// 获取置换贴图指针
+	const texture* get_displacement_map_ptr() const override {
+		return mat_ptr_1->get_displacement_map_ptr();
+	}
+
+	// 获取介质
+	// 可能返回空指针
+	medium* get_medium_outside_ptr() const override {
+		return mat_ptr_1->get_medium_outside_ptr();
+	}
+
+	medium* get_medium_inside_ptr() const override {
+		return mat_ptr_1->get_medium_inside_ptr();
+	}
+
+	// 是否需要对光源采样
+	bool sample_light() const override {
+		return mat_ptr_1->sample_light() or mat_ptr_2->sample_light();
+	}
+
+	bool is_delta() const override {
+		return mat_ptr_1->is_delta() or mat_ptr_2->is_delta();
+	}
+
+	bool is_specular() const override {
+		return false;
+	}
+
+	// 两个子材质都近似为漫反射时，混合材质也近似为漫反射
+	bool is_diffuse() const override {
+		return mat_ptr_1->is_diffuse() and mat_ptr_2->is_diffuse();
+	}
+
+	vec3 get_diffuse_albedo(const shading_context& ctx) const override {
+		return chosen(ctx).get_diffuse_albedo(ctx);
+	}
+
+	// 获取材质编号
+	int get_material_number() const override {
+		return 7;
+	}
+};
+
+
+#endif
@@ -0,0 +1,655 @@
+#pragma once
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cctype>
+#include <iostream>
+#include <algorithm>
+#include "global.h"
+#include "vec3.h"
+#include "mapped_file.h"
+
+// .obj/.mtl文件读取
+// 把文件映射到内存后按行边界切成若干块，每块由一个线程解析，数值使用手写的解析函数，不构造临时字符串
+// 解析完成后按o/g与usemtl划分网格，每个网格由一个线程生成带索引的顶点缓冲：
+// - 位置、uv、法线都相同的角点共用一个顶点
+// - 多边形按耳切法（ear clipping）三角化，三角形直接输出
+// - 没有法线的面使用面法线，方向与OBJ_Loader一致
+// 网格的划分规则：
+// - 每个o/g开始一个新的网格，名称为o/g后的文本
+// - 同一个o/g中usemtl切换材质时开始一个新的网格，名称依次加上后缀_2、_3……
+
+using std::vector;
+using std::string;
+
+// .mtl中的材质
+struct obj_material {
+	string name;
+	vec3 Ka, Kd, Ks, Ke;
+	double Ns = 0;
+	double Ni = 1;
+	double d = 1;
+	int illum = 0;
+	string map_Ka, map_Kd, map_Ks, map_Ns, map_d, map_bump;
+};
+
+// 一个网格的顶点缓冲与索引
+struct obj_mesh {
+	string name;
+	string material_name; // usemtl指定的材质名称，没有指定时为空
+	vector<vec3> positions;
+	vector<vec3> uvs;
+	vector<vec3> normals;
+	vector<unsigned int> indices; // 每三个一组对应一个三角形
+};
+
+// 读取结果
+struct obj_model {
+	vector<obj_mesh> meshes;
+	vector<obj_material> materials; // mtllib中的所有材质
+};
+
+
+namespace obj_detail {
+	// 每块至少这么多字节，小文件不值得多线程解析
+	constexpr size_t min_chunk_size = 1 << 20;
+
+	inline bool is_space(char c) {
+		return c == ' ' or c == '\t' or c == '\r';
+	}
+
+	inline bool is_digit(char c) {
+		return c >= '0' and c <= '9';
+	}
+
+	inline void skip_space(const char*& p, const char* end) {
+		while (p < end and is_space(*p)) p++;
+	}
+
+	// 行中剩余的文本（去掉首尾空白）
+	inline string rest_of_line(const char* p, const char* end) {
+		skip_space(p, end);
+		while (end > p and is_space(end[-1])) end--;
+		return string(p, end);
+	}
+
+	// 当前的单词是否为word，且其后是空白或行尾
+	inline bool match_word(const char* p, const char* end, const char* word) {
+		size_t length = strlen(word);
+		return static_cast<size_t>(end - p) >= length and memcmp(p, word, length) == 0 and (p + length == end or is_space(p[length]));
+	}
+
+	// 解析浮点数
+	// 有效数字不超过15位且指数较小时mantissa与10的幂都能精确表示，一次乘除得到正确舍入的结果
+	// 其余情况（很长的小数、大指数、inf、nan等）交给strtod
+	inline bool parse_double(const char*& p, const char* end, double& value) {
+		static const double pow10[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+		const char* start = p;
+		bool negative = false;
+		if (p < end and (*p == '-' or *p == '+')) negative = *p++ == '-';
+
+		uint64_t mantissa = 0;
+		int digit_num = 0; // mantissa中的有效数字位数
+		int exponent = 0;
+		bool has_digit = false;
+		bool exact = true;
+		for (; p < end and is_digit(*p); p++) {
+			has_digit = true;
+			if (digit_num < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa) digit_num++;
+			}
+			else {
+				exponent++;
+				exact = false;
+			}
+		}
+		if (p < end and *p == '.') {
+			for (p++; p < end and is_digit(*p); p++) {
+				has_digit = true;
+				if (digit_num < 19) {
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa) digit_num++;
+					exponent--;
+				}
+				else {
+					exact = false;
+				}
+			}
+		}
+		if (has_digit and p < end and (*p == 'e' or *p == 'E')) {
+			const char* q = p + 1;
+			bool exponent_negative = false;
+			if (q < end and (*q == '-' or *q == '+')) exponent_negative = *q++ == '-';
+			if (q < end and is_digit(*q)) {
+				int e = 0;
+				for (; q < end and is_digit(*q); q++) {
+					if (e < 10000) e = e * 10 + (*q - '0');
+				}
+				exponent += exponent_negative ? -e : e;
+				p = q;
+			}
+		}
+
+		if (has_digit and exact and digit_num <= 15 and exponent >= -22 and exponent <= 22 and (p == end or not isalpha(static_cast<unsigned char>(*p)))) {
+			double result = static_cast<double>(mantissa);
+			result = exponent < 0 ? result / pow10[-exponent] : result * pow10[exponent];
+			value = negative ? -result : result;
+			return true;
+		}
+
+		// 复制到以0结尾的缓冲区中再交给strtod
+		p = start;
+		const char* token_end = p;
+		while (token_end < end and not is_space(*token_end) and *token_end != '\n' and *token_end != '/') token_end++;
+		char buffer[128];
+		size_t length = std::min(static_cast<size_t>(token_end - p), sizeof(buffer) - 1);
+		memcpy(buffer, p, length);
+		buffer[length] = '\0';
+		char* parsed_end;
+		value = strtod(buffer, &parsed_end);
+		if (parsed_end == buffer) return false;
+		p += parsed_end - buffer;
+		return true;
+	}
+
+	inline bool parse_int(const char*& p, const char* end, long long& value) {
+		bool negative = false;
+		if (p < end and (*p == '-' or *p == '+')) negative = *p++ == '-';
+		if (p == end or not is_digit(*p)) return false;
+		long long result = 0;
+		for (; p < end and is_digit(*p); p++) result = result * 10 + (*p - '0');
+		value = negative ? -result : result;
+		return true;
+	}
+
+	// o/g、usemtl、mtllib语句，记录在它之前块中已有的面数
+	struct statement {
+		enum kind_type { group, use_material, material_library } kind;
+		string name;
+		size_t face_index;
+	};
+
+	// 一个块的解析结果
+	// 角点的索引已转换为从0开始的全局索引；负数（相对）索引先转换为块内索引，记录在relative_slots中，合并时加上块的偏移
+	struct chunk {
+		vector<vec3> positions;
+		vector<vec3> uvs;
+		vector<vec3> normals;
+		vector<long long> corners; // 每个角点3个索引（v、vt、vn），缺失为-1
+		vector<size_t> face_offsets = { 0 }; // 第i个面的角点为[face_offsets[i], face_offsets[i + 1])
+		vector<size_t> relative_slots; // corners中需要加上偏移的位置
+		vector<statement> statements;
+		size_t bad_line_num = 0;
+
+		size_t face_num() const {
+			return face_offsets.size() - 1;
+		}
+	};
+
+	// 解析一个面的角点
+	inline bool parse_face(const char* p, const char* end, chunk& c) {
+		size_t corner_begin = c.corners.size();
+		size_t relative_begin = c.relative_slots.size();
+		auto discard = [&]() {
+			c.corners.resize(corner_begin);
+			c.relative_slots.resize(relative_begin);
+			return false;
+		};
+		size_t counts[3] = { c.positions.size(), c.uvs.size(), c.normals.size() };
+		while (true) {
+			skip_space(p, end);
+			if (p == end) break;
+			long long index[3] = { -1, -1, -1 };
+			for (int k = 0; k < 3; k++) {
+				if (k > 0) {
+					if (p == end or *p != '/') break;
+					p++;
+					if (k == 1 and p < end and *p == '/') continue; // v//vn
+				}
+				long long value;
+				if (not parse_int(p, end, value) or value == 0) return discard();
+				if (value > 0) {
+					index[k] = value - 1;
+				}
+				else {
+					index[k] = static_cast<long long>(counts[k]) + value;
+					c.relative_slots.push_back(c.corners.size() + k);
+				}
+			}
+			if (p < end and not is_space(*p)) return discard();
+			c.corners.insert(c.corners.end(), index, index + 3);
+		}
+		if (c.corners.size() - corner_begin < 3 * 3) return discard();
+		c.face_offsets.push_back(c.corners.size() / 3);
+		return true;
+	}
+
+	// 解析[begin, end)，范围以行边界开始与结束
+	inline void parse_chunk(const char* begin, const char* end, chunk& c) {
+		const char* p = begin;
+		while (p < end) {
+			const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (line_end == nullptr) line_end = end;
+			skip_space(p, line_end);
+			if (p < line_end and *p != '#') {
+				bool ok = true;
+				if (match_word(p, line_end, "v")) {
+					const char* q = p + 1;
+					double xyz[3];
+					for (int k = 0; k < 3 and ok; k++) {
+						skip_space(q, line_end);
+						ok = parse_double(q, line_end, xyz[k]);
+					}
+					if (ok) c.positions.push_back(vec3(xyz[0], xyz[1], xyz[2]));
+				}
+				else if (match_word(p, line_end, "vt")) {
+					const char* q = p + 2;
+					double uv[2];
+					for (int k = 0; k < 2 and ok; k++) {
+						skip_space(q, line_end);
+						ok = parse_double(q, line_end, uv[k]);
+					}
+					if (ok) c.uvs.push_back(vec3(uv[0], uv[1], 0));
+				}
+				else if (match_word(p, line_end, "vn")) {
+					const char* q = p + 2;
+					double xyz[3];
+					for (int k = 0; k < 3 and ok; k++) {
+						skip_space(q, line_end);
+						ok = parse_double(q, line_end, xyz[k]);
+					}
+					if (ok) c.normals.push_back(vec3(xyz[0], xyz[1], xyz[2]));
+				}
+				else if (match_word(p, line_end, "f")) {
+					ok = parse_face(p + 1, line_end, c);
+				}
+				else if (match_word(p, line_end, "o") or match_word(p, line_end, "g")) {
+					string name = rest_of_line(p + 1, line_end);
+					c.statements.push_back({ statement::group, name.empty() ? string("unnamed") : name, c.face_num() });
+				}
+				else if (match_word(p, line_end, "usemtl")) {
+					c.statements.push_back({ statement::use_material, rest_of_line(p + 6, line_end), c.face_num() });
+				}
+				else if (match_word(p, line_end, "mtllib")) {
+					c.statements.push_back({ statement::material_library, rest_of_line(p + 6, line_end), c.face_num() });
+				}
+				// 其它语句（s、l、vp等）忽略
+				if (not ok) c.bad_line_num++;
+			}
+			p = line_end + 1;
+		}
+	}
+
+	// 一个网格由若干块中连续的面组成
+	struct face_range {
+		size_t chunk_index;
+		size_t face_begin, face_end;
+	};
+
+	struct mesh_source {
+		string name;
+		string material_name;
+		vector<face_range> ranges;
+	};
+
+	// 角点(v, vt, vn)到网格顶点编号的开放寻址哈希表
+	class vertex_table {
+	private:
+		vector<unsigned int> slots; // 顶点编号 + 1，0表示空
+		vector<long long> keys; // 每个顶点3个索引
+		size_t mask = 0;
+
+		static size_t hash(const long long* key) {
+			uint64_t h = static_cast<uint64_t>(key[0]) * 0x9e3779b97f4a7c15ULL;
+			h ^= static_cast<uint64_t>(key[1]) * 0xc2b2ae3d27d4eb4fULL;
+			h ^= static_cast<uint64_t>(key[2]) * 0x165667b19e3779f9ULL;
+			return static_cast<size_t>(h ^ (h >> 29));
+		}
+
+	public:
+		explicit vertex_table(size_t corner_num) {
+			size_t capacity = 16;
+			while (capacity < corner_num * 2) capacity *= 2;
+			slots.assign(capacity, 0);
+			mask = capacity - 1;
+		}
+
+		// 查找角点对应的顶点，不存在时插入编号为next_index的新顶点
+		unsigned int find_or_insert(const long long* key, unsigned int next_index, bool& inserted) {
+			size_t i = hash(key) & mask;
+			while (slots[i] != 0) {
+				const long long* existing = &keys[static_cast<size_t>(slots[i] - 1) * 3];
+				if (existing[0] == key[0] and existing[1] == key[1] and existing[2] == key[2]) {
+					inserted = false;
+					return slots[i] - 1;
+				}
+				i = (i + 1) & mask;
+			}
+			slots[i] = next_index + 1;
+			keys.insert(keys.end(), key, key + 3);
+			inserted = true;
+			return next_index;
+		}
+	};
+
+	// 按耳切法三角化多边形，polygon为网格顶点编号
+	inline void triangulate(const vector<unsigned int>& polygon, const vector<vec3>& positions, vector<unsigned int>& indices) {
+		size_t n = polygon.size();
+		if (n == 3) {
+			indices.insert(indices.end(), polygon.begin(), polygon.end());
+			return;
+		}
+
+		// Newell法计算多边形法线，用于判断凸顶点
+		vec3 polygon_normal(0, 0, 0);
+		for (size_t i = 0; i < n; i++) {
+			polygon_normal += cross(positions[polygon[i]], positions[polygon[(i + 1) % n]]);
+		}
+
+		auto same_position = [](const vec3& u, const vec3& v) {
+			return u[0] == v[0] and u[1] == v[1] and u[2] == v[2];
+		};
+
+		vector<unsigned int> remaining = polygon;
+		while (remaining.size() > 3) {
+			size_t m = remaining.size();
+			bool clipped = false;
+			for (size_t i = 0; i < m and not clipped; i++) {
+				const vec3& a = positions[remaining[(i + m - 1) % m]];
+				const vec3& b = positions[remaining[i]];
+				const vec3& c = positions[remaining[(i + 1) % m]];
+				if (dot(cross(b - a, c - b), polygon_normal) <= 0) continue; // 凹顶点
+				bool contains_other = false;
+				for (size_t j = 0; j < m and not contains_other; j++) {
+					if (j == i or j == (i + m - 1) % m or j == (i + 1) % m) continue;
+					const vec3& q = positions[remaining[j]];
+					if (same_position(q, a) or same_position(q, b) or same_position(q, c)) continue;
+					contains_other = dot(cross(b - a, q - a), polygon_normal) >= 0
+						and dot(cross(c - b, q - b), polygon_normal) >= 0
+						and dot(cross(a - c, q - c), polygon_normal) >= 0;
+				}
+				if (contains_other) continue;
+				indices.push_back(remaining[(i + m - 1) % m]);
+				indices.push_back(remaining[i]);
+				indices.push_back(remaining[(i + 1) % m]);
+				remaining.erase(remaining.begin() + i);
+				clipped = true;
+			}
+			if (not clipped) break; // 退化的多边形，剩余部分按扇形三角化
+		}
+		for (size_t i = 1; i + 1 < remaining.size(); i++) {
+			indices.push_back(remaining[0]);
+			indices.push_back(remaining[i]);
+			indices.push_back(remaining[i + 1]);
+		}
+	}
+
+	// 由若干块中的面生成网格
+	// 块中的角点索引已经是全局索引，positions、uvs、normals为所有块合并后的数据
+	inline void build_mesh(const mesh_source& source, const vector<chunk>& chunks,
+		const vector<vec3>& positions, const vector<vec3>& uvs, const vector<vec3>& normals, obj_mesh& mesh, size_t& bad_face_num) {
+		mesh.name = source.name;
+		mesh.material_name = source.material_name;
+
+		size_t corner_num = 0;
+		for (const face_range& range : source.ranges) {
+			const chunk& c = chunks[range.chunk_index];
+			corner_num += c.face_offsets[range.face_end] - c.face_offsets[range.face_begin];
+		}
+		vertex_table table(corner_num);
+		mesh.indices.reserve(corner_num);
+		vector<unsigned int> polygon;
+
+		for (const face_range& range : source.ranges) {
+			const chunk& c = chunks[range.chunk_index];
+			for (size_t face = range.face_begin; face < range.face_end; face++) {
+				const long long* corners = &c.corners[c.face_offsets[face] * 3];
+				size_t n = c.face_offsets[face + 1] - c.face_offsets[face];
+
+				// 检查索引范围
+				bool valid = true;
+				bool has_normal = true;
+				for (size_t i = 0; i < n; i++) {
+					const long long* corner = corners + i * 3;
+					valid = valid and corner[0] >= 0 and corner[0] < static_cast<long long>(positions.size())
+						and corner[1] < static_cast<long long>(uvs.size()) and corner[2] < static_cast<long long>(normals.size())
+						and corner[1] >= -1 and corner[2] >= -1;
+					has_normal = has_normal and corner[2] >= 0;
+				}
+				if (not valid) {
+					bad_face_num++;
+					continue;
+				}
+
+				// 没有法线时使用面法线，方向与OBJ_Loader相同
+				vec3 face_normal;
+				if (not has_normal) {
+					const vec3& p0 = positions[corners[0]];
+					const vec3& p1 = positions[corners[3]];
+					const vec3& p2 = positions[corners[6]];
+					face_normal = cross(p0 - p1, p2 - p1);
+					if (face_normal.length() > 0) face_normal = unit_vector(face_normal);
+				}
+
+				polygon.clear();
+				for (size_t i = 0; i < n; i++) {
+					const long long* corner = corners + i * 3;
+					unsigned int next_index = static_cast<unsigned int>(mesh.positions.size());
+					unsigned int index = next_index;
+					bool inserted = true;
+					// 使用面法线的顶点不与其它面共用
+					if (has_normal) index = table.find_or_insert(corner, next_index, inserted);
+					if (inserted) {
+						mesh.positions.push_back(positions[corner[0]]);
+						mesh.uvs.push_back(corner[1] >= 0 ? uvs[corner[1]] : vec3(0, 0, 0));
+						mesh.normals.push_back(has_normal ? normals[corner[2]] : face_normal);
+					}
+					polygon.push_back(index);
+				}
+				triangulate(polygon, mesh.positions, mesh.indices);
+			}
+		}
+	}
+
+	// 读取.mtl文件
+	inline bool load_materials(const string& path, vector<obj_material>& materials) {
+		mapped_file file;
+		if (not file.open(path)) return false;
+		const char* p = reinterpret_cast<const char*>(file.data);
+		const char* end = p + file.size;
+
+		auto read_vec3 = [](const char* q, const char* line_end) {
+			double xyz[3] = { 0, 0, 0 };
+			for (int k = 0; k < 3; k++) {
+				skip_space(q, line_end);
+				if (not parse_double(q, line_end, xyz[k])) break;
+			}
+			return vec3(xyz[0], xyz[1], xyz[2]);
+		};
+		auto read_double = [](const char* q, const char* line_end) {
+			double value = 0;
+			skip_space(q, line_end);
+			parse_double(q, line_end, value);
+			return value;
+		};
+
+		obj_material* current = nullptr;
+		while (p < end) {
+			const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (line_end == nullptr) line_end = end;
+			skip_space(p, line_end);
+			if (match_word(p, line_end, "newmtl")) {
+				materials.emplace_back();
+				current = &materials.back();
+				current->name = rest_of_line(p + 6, line_end);
+			}
+			else if (current != nullptr and p < line_end and *p != '#') {
+				const char* word_end = p;
+				while (word_end < line_end and not is_space(*word_end)) word_end++;
+				string word(p, word_end);
+				if (word == "Ka") current->Ka = read_vec3(word_end, line_end);
+				else if (word == "Kd") current->Kd = read_vec3(word_end, line_end);
+				else if (word == "Ks") current->Ks = read_vec3(word_end, line_end);
+				else if (word == "Ke") current->Ke = read_vec3(word_end, line_end);
+				else if (word == "Ns") current->Ns = read_double(word_end, line_end);
+				else if (word == "Ni") current->Ni = read_double(word_end, line_end);
+				else if (word == "d") current->d = read_double(word_end, line_end);
+				else if (word == "illum") current->illum = static_cast<int>(read_double(word_end, line_end));
+				else if (word == "map_Ka") current->map_Ka = rest_of_line(word_end, line_end);
+				else if (word == "map_Kd") current->map_Kd = rest_of_line(word_end, line_end);
+				else if (word == "map_Ks") current->map_Ks = rest_of_line(word_end, line_end);
+				else if (word == "map_Ns") current->map_Ns = rest_of_line(word_end, line_end);
+				else if (word == "map_d") current->map_d = rest_of_line(word_end, line_end);
+				else if (word == "map_Bump" or word == "map_bump" or word == "bump") current->map_bump = rest_of_line(word_end, line_end);
+			}
+			p = line_end + 1;
+		}
+		return true;
+	}
+}
+
+
+// 读取.obj文件，thread_num为0时使用所有硬件线程，在加载任务中为0时只用当前线程
+inline bool load_obj(const char* file_name, obj_model& model, int thread_num = 0) {
+	using namespace obj_detail;
+	model = obj_model();
+
+	mapped_file file;
+	if (not file.open(file_name)) {
+		std::cout << "failed to open " << file_name << '\n';
+		return false;
+	}
+	const char* data = reinterpret_cast<const char*>(file.data);
+	size_t size = file.size;
+
+	// 按行边界切块
+	if (thread_num <= 0) thread_num = running_asset_job ? 1 : std::max(1u, std::thread::hardware_concurrency());
+	size_t chunk_num = std::max<size_t>(1, std::min<size_t>(thread_num, size / min_chunk_size));
+	vector<size_t> boundaries = { 0 };
+	for (size_t k = 1; k < chunk_num; k++) {
+		size_t position = std::max(size * k / chunk_num, boundaries.back());
+		const char* newline = static_cast<const char*>(memchr(data + position, '\n', size - position));
+		position = newline ? newline - data + 1 : size;
+		if (position > boundaries.back() and position < size) boundaries.push_back(position);
+	}
+	boundaries.push_back(size);
+	chunk_num = boundaries.size() - 1;
+
+	vector<chunk> chunks(chunk_num);
+	vector<std::thread> threads;
+	for (size_t k = 1; k < chunk_num; k++) {
+		threads.emplace_back([&, k]() {
+			parse_chunk(data + boundaries[k], data + boundaries[k + 1], chunks[k]);
+		});
+	}
+	parse_chunk(data + boundaries[0], data + boundaries[1], chunks[0]);
+	for (std::thread& t : threads) t.join();
+	threads.clear();
+
+	// 合并顶点数据，并把相对索引转换为全局索引
+	vector<vec3> positions, uvs, normals;
+	size_t bad_line_num = 0;
+	for (chunk& c : chunks) {
+		long long offsets[3] = { static_cast<long long>(positions.size()), static_cast<long long>(uvs.size()), static_cast<long long>(normals.size()) };
+		for (size_t slot : c.relative_slots) c.corners[slot] += offsets[slot % 3];
+		positions.insert(positions.end(), c.positions.begin(), c.positions.end());
+		uvs.insert(uvs.end(), c.uvs.begin(), c.uvs.end());
+		normals.insert(normals.end(), c.normals.begin(), c.normals.end());
+		vector<vec3>().swap(c.positions);
+		vector<vec3>().swap(c.uvs);
+		vector<vec3>().swap(c.normals);
+		bad_line_num += c.bad_line_num;
+	}
+
+	// 按o/g与usemtl划分网格
+	vector<mesh_source> sources;
+	vector<string> material_libraries;
+	mesh_source current;
+	current.name = "unnamed";
+	string group_name = "unnamed"; // 第一个o/g之前的面
+	int group_part = 1; // 当前o/g中的第几个网格
+	bool has_faces = false;
+	auto close_current = [&]() {
+		if (has_faces) sources.push_back(current);
+		current.ranges.clear();
+		has_faces = false;
+	};
+	for (size_t k = 0; k < chunk_num; k++) {
+		const chunk& c = chunks[k];
+		size_t face_begin = 0;
+		auto add_faces = [&](size_t face_end) {
+			if (face_end > face_begin) {
+				current.ranges.push_back({ k, face_begin, face_end });
+				has_faces = true;
+			}
+			face_begin = face_end;
+		};
+		for (const statement& s : c.statements) {
+			add_faces(s.face_index);
+			if (s.kind == statement::group) {
+				close_current();
+				group_name = s.name;
+				group_part = 1;
+				current.name = group_name;
+			}
+			else if (s.kind == statement::use_material) {
+				if (has_faces) {
+					close_current();
+					group_part++;
+					current.name = group_name + "_" + std::to_string(group_part);
+				}
+				current.material_name = s.name;
+			}
+			else {
+				material_libraries.push_back(s.name);
+			}
+		}
+		add_faces(c.face_num());
+	}
+	close_current();
+
+	// 每个网格由一个线程生成
+	model.meshes.resize(sources.size());
+	vector<size_t> bad_face_nums(sources.size(), 0);
+	std::atomic<size_t> next_mesh(0);
+	auto build_meshes = [&]() {
+		for (size_t i = next_mesh++; i < sources.size(); i = next_mesh++) {
+			build_mesh(sources[i], chunks, positions, uvs, normals, model.meshes[i], bad_face_nums[i]);
+		}
+	};
+	int build_thread_num = static_cast<int>(std::min<size_t>(thread_num, sources.size()));
+	for (int t = 1; t < build_thread_num; t++) threads.emplace_back(build_meshes);
+	build_meshes();
+	for (std::thread& t : threads) t.join();
+
+	size_t bad_face_num = 0;
+	for (size_t n : bad_face_nums) bad_face_num += n;
+	if (bad_line_num > 0 or bad_face_num > 0) {
+		std::cout << file_name << ": skipped " << bad_line_num << " malformed lines and " << bad_face_num << " faces with invalid indices\n";
+	}
+
+	// 材质文件的路径相对于.obj文件
+	string directory(file_name);
+	size_t slash = directory.find_last_of("/\\");
+	directory = slash == string::npos ? string() : directory.substr(0, slash + 1);
+	for (const string& library : material_libraries) {
+		if (not load_materials(directory + library, model.materials)) {
+			std::cout << "failed to open " << directory + library << '\n';
+		}
+	}
+
+	return not model.meshes.empty();
+}
+
+#endif
@@ -0,0 +1,79 @@
+#pragma once
+#ifndef OPACITY_MICROMAP_H
+#define OPACITY_MICROMAP_H
+
+#include <cstdint>
+#include <algorithm>
+#include "vec3.h"
+
+// 不透明度微图（opacity micromap）
+// 把三角形在重心坐标上均匀细分为4^level个微三角形，每个微三角形记录一个不透明度状态：
+// 完全不透明、完全透明或未知（包含半透明或透明与不透明的交界）。状态在加载时由纹理的alpha保守地计算
+// 求交时完全透明的微三角形直接剔除，完全不透明的不需要读取纹理，只有未知的区域才做alpha测试
+
+enum class opacity_state : uint8_t {
+	opaque = 0,
+	transparent = 1,
+	unknown = 2
+};
+
+class opacity_micromap {
+public:
+	static constexpr int level = 3; // 细分层数
+	static constexpr int subdivision = 1 << level; // 每条边细分的段数
+	static constexpr int micro_num = subdivision * subdivision; // 微三角形数
+
+private:
+	// 每个微三角形2位，全0表示全部不透明
+	uint64_t bits[micro_num * 2 / 64] = {};
+
+public:
+	opacity_state get(int index) const {
+		return static_cast<opacity_state>((bits[index >> 5] >> ((index & 31) * 2)) & 3);
+	}
+
+	void set(int index, opacity_state state) {
+		uint64_t& word = bits[index >> 5];
+		int shift = (index & 31) * 2;
+		word = (word & ~(static_cast<uint64_t>(3) << shift)) | (static_cast<uint64_t>(state) << shift);
+	}
+
+	// 所有微三角形的状态相同时返回该状态，否则返回unknown
+	opacity_state uniform_state() const {
+		opacity_state first = get(0);
+		for (int i = 1; i < micro_num; i++) {
+			if (get(i) != first) return opacity_state::unknown;
+		}
+		return first;
+	}
+
+	// 重心坐标(b1, b2)所在的微三角形编号
+	// 重心坐标空间按b2分为subdivision行，第j行有subdivision - j个下三角形与subdivision - j - 1个上三角形
+	static int micro_index(double b1, double b2) {
+		int i = std::min(static_cast<int>(b1 * subdivision), subdivision - 1);
+		int j = std::min(static_cast<int>(b2 * subdivision), subdivision - 1);
+		if (i + j > subdivision - 1) i = subdivision - 1 - j; // 舍入误差
+		int upper = (b1 * subdivision - i) + (b2 * subdivision - j) >= 1 and i + j < subdivision - 1;
+		return 2 * subdivision * j - j * j + 2 * i + upper;
+	}
+
+	// 生成微图，state_of(b)根据微三角形三个顶点的重心坐标(b1, b2)返回状态
+	template <typename state_function>
+	static opacity_micromap build(state_function state_of) {
+		opacity_micromap omm;
+		double step = 1.0 / subdivision;
+		for (int j = 0; j < subdivision; j++) {
+			for (int i = 0; i + j < subdivision; i++) {
+				vec3 lower[3] = { vec3(i * step, j * step, 0), vec3((i + 1) * step, j * step, 0), vec3(i * step, (j + 1) * step, 0) };
+				omm.set(2 * subdivision * j - j * j + 2 * i, state_of(lower));
+				if (i + j < subdivision - 1) {
+					vec3 upper[3] = { vec3((i + 1) * step, j * step, 0), vec3((i + 1) * step, (j + 1) * step, 0), vec3(i * step, (j + 1) * step, 0) };
+					omm.set(2 * subdivision * j - j * j + 2 * i + 1, state_of(upper));
+				}
+			}
+		}
+		return omm;
+	}
+};
+
+#endif
@@ -0,0 +1,265 @@
+#pragma once
+#ifndef PHOTON_MAP_H
+#define PHOTON_MAP_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include "global.h"
+#include "hittable.h"
+#include "material.h"
+#include "light.h"
+#include "transmittance.h"
+
+using std::vector;
+using std::thread;
+
+
+// 光子
+// 使用float存储以减小内存占用，使查询时更多光子能留在缓存中
+struct photon {
+	float position[3]; // 光子位置
+	float wi[3]; // 入射方向（指向光子来的方向）
+	float power[3]; // 光子能量（flux）
+};
+
+
+// 焦散光子图
+// 只记录 光源 -> 镜面/折射材质(一次或多次) -> 漫反射表面 这类路径上的光子
+// 光子存放在哈希网格中：所有光子按网格哈希值排序后连续存放，cell_start记录每个哈希桶的起始位置
+class photon_map {
+public:
+	// 光子列表（按哈希桶排序）
+	vector<photon> photons;
+	// 每个哈希桶在photons中的起始位置，长度为table_size + 1
+	vector<unsigned> cell_start;
+	// 哈希表大小
+	unsigned table_size = 1;
+	// 查询半径，同时也是网格边长
+	double radius;
+	double radius2;
+	// 光子最大弹射次数，与渲染的最大深度相同
+	int max_photon_depth;
+	// 发射的光子总数，用于归一化
+	long long emitted_num = 0;
+
+public:
+	photon_map(double radius_init, int max_photon_depth_init) {
+		radius = radius_init;
+		radius2 = radius * radius;
+		max_photon_depth = max_photon_depth_init;
+	}
+
+	// 发射光子并构建哈希网格
+	// photon_num为发射的光子总数，thread_num为使用的线程数
+	void build(shared_ptr<hittable> world, const vector<shared_ptr<light>>& light_ptr_list, long long photon_num, int thread_num = 8) {
+		photons.clear();
+		if (light_ptr_list.empty() or photon_num <= 0) return;
+		emitted_num = photon_num;
+
+		// 各线程分别追踪光子，结果先存放在各自的列表中
+		vector<vector<photon>> photon_lists(thread_num);
+		vector<thread> threads;
+		for (int t = 0; t < thread_num; t++) {
+			long long begin = photon_num * t / thread_num;
+			long long end = photon_num * (t + 1) / thread_num;
+			threads.emplace_back([&, t, begin, end]() {
+				for (long long i = begin; i < end; i++) {
+					trace_photon(world, light_ptr_list, photon_lists[t]);
+				}
+			});
+		}
+		for (thread& t : threads) t.join();
+
+		// 合并光子列表
+		vector<photon> unsorted;
+		size_t total = 0;
+		for (const vector<photon>& list : photon_lists) total += list.size();
+		unsorted.reserve(total);
+		for (const vector<photon>& list : photon_lists) unsorted.insert(unsorted.end(), list.begin(), list.end());
+
+		build_grid(unsorted, thread_num);
+		std::cout << photons.size() << " caustic photons stored\n";
+	}
+
+	// 估计焦散radiance
+	// 在半径为radius的圆盘内对光子能量求和：L = sum(f * flux) / (pi * r^2)
+	vec3 estimate(const material& mat, const vec3& wo, const vec3& normalo, const vec3& positiono, bool wo_front, const shading_context& ctx) const {
+		vec3 ret(0, 0, 0);
+		if (photons.empty()) return ret;
+
+		int cx = cell_coord(positiono[0]);
+		int cy = cell_coord(positiono[1]);
+		int cz = cell_coord(positiono[2]);
+
+		// 网格边长等于查询半径，所以只需要检查相邻的27个格子
+		// 不同的格子可能映射到同一个哈希桶，每个桶只访问一次，否则其中的光子会被重复计入
+		unsigned buckets[27];
+		int bucket_num = 0;
+		for (int dx = -1; dx <= 1; dx++) {
+			for (int dy = -1; dy <= 1; dy++) {
+				for (int dz = -1; dz <= 1; dz++) {
+					unsigned h = hash(cx + dx, cy + dy, cz + dz);
+					if (std::find(buckets, buckets + bucket_num, h) == buckets + bucket_num) buckets[bucket_num++] = h;
+				}
+			}
+		}
+
+		for (int b = 0; b < bucket_num; b++) {
+			unsigned h = buckets[b];
+			for (unsigned i = cell_start[h]; i < cell_start[h + 1]; i++) {
+				const photon& p = photons[i];
+				vec3 d = vec3(p.position[0], p.position[1], p.position[2]) - positiono;
+				if (d.length_squared() > radius2) continue;
+
+				// 只接受来自表面同侧的光子
+				vec3 wi(p.wi[0], p.wi[1], p.wi[2]);
+				if (dot(wi, normalo) <= 0) continue;
+
+				vec3 f = mat.bsdf(wo, normalo, positiono, wo_front, ctx, wi, normalo, positiono, wo_front);
+				ret += f * vec3(p.power[0], p.power[1], p.power[2]);
+			}
+		}
+
+		return clamp(ret * (pi_inv / radius2), 0, infinity);
+	}
+
+private:
+	int cell_coord(double x) const {
+		return static_cast<int>(std::floor(x / radius));
+	}
+
+	unsigned hash(int x, int y, int z) const {
+		unsigned h = (unsigned(x) * 73856093u) ^ (unsigned(y) * 19349663u) ^ (unsigned(z) * 83492791u);
+		return h % table_size;
+	}
+
+	// 追踪一个光子
+	// 在漫反射表面上只有经过了至少一次镜面材质的光子才会被记录
+	void trace_photon(const shared_ptr<hittable>& world, const vector<shared_ptr<light>>& light_ptr_list, vector<photon>& out) const {
+		// 均匀选择一个光源
+		int light_num = static_cast<int>(light_ptr_list.size());
+		int light_index = std::min(static_cast<int>(random_double() * light_num), light_num - 1);
+
+		vec3 position_light, radiance_light, normal_light;
+		double pdf_light = light_ptr_list[light_index]->sample_p(position_light, radiance_light, normal_light);
+
+		// 在光源法线方向的半球上cos-weighted采样出射方向
+		double rand1 = random_double();
+		double rand2 = random_double();
+		double theta = acos(sqrt(1 - rand1));
+		double phi = pi2 * rand2;
+		vec3 b1, b2;
+		build_basis(normal_light, b1, b2);
+		vec3 dir = normal_light * cos(theta) + b1 * sin(phi) * sin(theta) + b2 * cos(phi) * sin(theta);
+
+		// flux = L * cos / (pdf_p * pdf_w * pdf_light_select) = L * pi * light_num / pdf_p
+		// 再除以发射光子总数
+		vec3 power = radiance_light * (pi * light_num / (pdf_light * emitted_num));
+
+		ray r(position_light, dir);
+		bool through_specular = false;
+		for (int depth = 0; depth < max_photon_depth; depth++) {
+			hit_record rec;
+			bool hit_surface = world->hit(r, 0.000001, infinity, rec);
+
+			// 在参与介质中散射的光子不再是焦散光子（路径追踪中介质散射之后的光线也不在焦散路径上）
+			// 没有散射时按透射率的概率穿过介质，权重不变
+			if (r.med and r.med->is_participating()) {
+				double dir_length = r.dir.length();
+				double t_scatter;
+				vec3 weight;
+				if (r.med->sample_free_flight(r.orig, r.dir / dir_length, hit_surface ? rec.t * dir_length : infinity, t_scatter, weight)) return;
+			}
+			if (not hit_surface) return;
+
+			shading_context ctx = make_shading_context(*rec.mat_ptr(), rec, r);
+
+			// 透明部分直接穿过
+			if (not rec.alpha_resolved and random_double() > ctx.alpha) {
+				r = ray(rec.p, r.dir, r.med);
+				continue;
+			}
+
+			if (not rec.mat_ptr()->is_specular()) {
+				// 到达漫反射表面，记录焦散光子并结束
+				if (through_specular) {
+					vec3 wi = unit_vector(-r.dir);
+					photon p;
+					for (int k = 0; k < 3; k++) {
+						p.position[k] = static_cast<float>(rec.p[k]);
+						p.wi[k] = static_cast<float>(wi[k]);
+						p.power[k] = static_cast<float>(power[k]);
+					}
+					out.push_back(p);
+				}
+				return;
+			}
+
+			// 在镜面材质上按bsdf继续传播
+			vec3 normalo = unit_vector(rec.normal);
+			vec3 wo = unit_vector(-r.dir);
+			bool wo_front = rec.front_face;
+			double pdf_w;
+			vec3 wi;
+			bool wi_front;
+			tie(pdf_w, wi, wi_front) = rec.mat_ptr()->sample_wi(wo, normalo, wo_front, ctx);
+			vec3 f = rec.mat_ptr()->bsdf(wo, normalo, rec.p, wo_front, ctx, wi, normalo, rec.p, wi_front);
+
+			// 与ray_color相同，折射时pdf与cos同为负值，相除后为正
+			power = clamp(power * f * dot(normalo, wi) / pdf_w, 0, infinity);
+			if (power.length_squared() == 0) return;
+
+			through_specular = true;
+			r = ray(rec.p, wi, medium_after(*rec.mat_ptr(), r.med, wo_front, wi_front));
+		}
+	}
+
+	// 将光子按哈希值排序存放
+	// 先并行计算每个光子的哈希值并统计桶大小，前缀和之后再并行写入对应位置
+	void build_grid(const vector<photon>& unsorted, int thread_num) {
+		size_t n = unsorted.size();
+		table_size = static_cast<unsigned>(std::max<size_t>(1, 2 * n));
+		photons.resize(n);
+		cell_start.assign(table_size + 1, 0);
+
+		vector<unsigned> photon_hash(n);
+		vector<std::atomic<unsigned>> cursor(table_size);
+		for (std::atomic<unsigned>& c : cursor) c.store(0, std::memory_order_relaxed);
+
+		// 计算哈希值并统计
+		vector<thread> threads;
+		for (int t = 0; t < thread_num; t++) {
+			threads.emplace_back([&, t]() {
+				for (size_t i = n * t / thread_num; i < n * (t + 1) / thread_num; i++) {
+					const photon& p = unsorted[i];
+					unsigned h = hash(cell_coord(p.position[0]), cell_coord(p.position[1]), cell_coord(p.position[2]));
+					photon_hash[i] = h;
+					cursor[h].fetch_add(1, std::memory_order_relaxed);
+				}
+			});
+		}
+		for (thread& t : threads) t.join();
+		threads.clear();
+
+		// 前缀和
+		for (unsigned h = 0; h < table_size; h++) {
+			cell_start[h + 1] = cell_start[h] + cursor[h].load(std::memory_order_relaxed);
+			cursor[h].store(cell_start[h], std::memory_order_relaxed);
+		}
+
+		// 写入对应的桶
+		for (int t = 0; t < thread_num; t++) {
+			threads.emplace_back([&, t]() {
+				for (size_t i = n * t / thread_num; i < n * (t + 1) / thread_num; i++) {
+					unsigned index = cursor[photon_hash[i]].fetch_add(1, std::memory_order_relaxed);
+					photons[index] = unsorted[i];
+				}
+			});
+		}
+		for (thread& t : threads) t.join();
+	}
+};
+
+#endif
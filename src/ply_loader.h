@@ -0,0 +1,345 @@
+#pragma once
+#ifndef PLY_LOADER_H
+#define PLY_LOADER_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include "mapped_file.h"
+
+// 二进制PLY文件读取（binary_little_endian）
+// 文件映射到内存后只解析文本的文件头，数据部分按属性在记录中的偏移直接复制：
+// - 顶点的位置、法线、uv为连续的float时每个顶点一次memcpy，记录中只有这些属性时整块复制
+// - 面全部为“list uchar int/uint”的三角形时每个面一次memcpy，否则逐个读取多边形并按扇形三角化
+// 其它类型（double、short等）的属性也能读取，但需要逐个转换
+
+using std::vector;
+using std::string;
+
+// 读取结果，未提供的属性为空
+struct ply_data {
+	size_t vertex_num = 0;
+	vector<float> positions; // 每个顶点3个
+	vector<float> normals; // 每个顶点3个
+	vector<float> uvs; // 每个顶点2个
+	vector<uint32_t> indices; // 每三个一组对应一个三角形
+};
+
+
+namespace ply_detail {
+	enum class scalar_type { int8, uint8, int16, uint16, int32, uint32, float32, float64, invalid };
+
+	inline scalar_type parse_type(const string& name) {
+		if (name == "char" or name == "int8") return scalar_type::int8;
+		if (name == "uchar" or name == "uint8") return scalar_type::uint8;
+		if (name == "short" or name == "int16") return scalar_type::int16;
+		if (name == "ushort" or name == "uint16") return scalar_type::uint16;
+		if (name == "int" or name == "int32") return scalar_type::int32;
+		if (name == "uint" or name == "uint32") return scalar_type::uint32;
+		if (name == "float" or name == "float32") return scalar_type::float32;
+		if (name == "double" or name == "float64") return scalar_type::float64;
+		return scalar_type::invalid;
+	}
+
+	inline size_t type_size(scalar_type type) {
+		switch (type) {
+		case scalar_type::int8: case scalar_type::uint8: return 1;
+		case scalar_type::int16: case scalar_type::uint16: return 2;
+		case scalar_type::int32: case scalar_type::uint32: case scalar_type::float32: return 4;
+		case scalar_type::float64: return 8;
+		default: return 0;
+		}
+	}
+
+	// 读取一个标量（小端）
+	inline double read_scalar(const uint8_t* p, scalar_type type) {
+		switch (type) {
+		case scalar_type::int8: { int8_t v; memcpy(&v, p, 1); return v; }
+		case scalar_type::uint8: return *p;
+		case scalar_type::int16: { int16_t v; memcpy(&v, p, 2); return v; }
+		case scalar_type::uint16: { uint16_t v; memcpy(&v, p, 2); return v; }
+		case scalar_type::int32: { int32_t v; memcpy(&v, p, 4); return v; }
+		case scalar_type::uint32: { uint32_t v; memcpy(&v, p, 4); return v; }
+		case scalar_type::float32: { float v; memcpy(&v, p, 4); return v; }
+		case scalar_type::float64: { double v; memcpy(&v, p, 8); return v; }
+		default: return 0;
+		}
+	}
+
+	struct property {
+		string name;
+		scalar_type type = scalar_type::invalid;
+		bool is_list = false;
+		scalar_type count_type = scalar_type::invalid; // 列表长度的类型
+		size_t offset = 0; // 在记录中的偏移，只对定长记录有效
+	};
+
+	struct element {
+		string name;
+		size_t count = 0;
+		vector<property> properties;
+		bool fixed_size = true; // 不含列表时记录长度固定
+		size_t stride = 0; // 定长记录的长度
+
+		const property* find(const char* name_1, const char* name_2 = nullptr, const char* name_3 = nullptr) const {
+			for (const property& prop : properties) {
+				if (prop.name == name_1 or (name_2 and prop.name == name_2) or (name_3 and prop.name == name_3)) return &prop;
+			}
+			return nullptr;
+		}
+	};
+
+	// 一条记录的长度，变长记录需要读取其中的列表长度
+	inline size_t record_size(const element& e, const uint8_t* p, const uint8_t* end) {
+		if (e.fixed_size) return e.stride;
+		size_t size = 0;
+		for (const property& prop : e.properties) {
+			if (prop.is_list) {
+				size_t count_size = type_size(prop.count_type);
+				if (p + size + count_size > end) return 0;
+				size_t count = static_cast<size_t>(read_scalar(p + size, prop.count_type));
+				size += count_size + count * type_size(prop.type);
+			}
+			else {
+				size += type_size(prop.type);
+			}
+		}
+		return size;
+	}
+
+	// p到end之间是否还有count条长度为stride的记录，先比较再移动指针，count很大时乘法也不会溢出
+	inline bool fits(const uint8_t* p, const uint8_t* end, size_t count, size_t stride) {
+		return stride == 0 or count <= static_cast<size_t>(end - p) / stride;
+	}
+
+	// 复制components个分量，它们在记录中的偏移为props[i]->offset
+	// 所有分量都是float且连续时每条记录一次memcpy
+	inline void copy_attribute(const uint8_t* base, const element& e, const property* const* props, int components, vector<float>& out) {
+		out.resize(e.count * components);
+		bool contiguous_float = true;
+		for (int k = 0; k < components; k++) {
+			contiguous_float = contiguous_float and props[k]->type == scalar_type::float32 and props[k]->offset == props[0]->offset + 4 * k;
+		}
+		if (contiguous_float) {
+			size_t bytes = 4 * components;
+			if (e.stride == bytes) {
+				memcpy(out.data(), base, e.count * bytes);
+				return;
+			}
+			const uint8_t* p = base + props[0]->offset;
+			float* dst = out.data();
+			for (size_t i = 0; i < e.count; i++, p += e.stride, dst += components) memcpy(dst, p, bytes);
+			return;
+		}
+		for (size_t i = 0; i < e.count; i++) {
+			for (int k = 0; k < components; k++) {
+				out[i * components + k] = static_cast<float>(read_scalar(base + i * e.stride + props[k]->offset, props[k]->type));
+			}
+		}
+	}
+
+	// 读取文件头，返回数据部分的起始位置，失败时返回0
+	inline size_t parse_header(const uint8_t* data, size_t size, vector<element>& elements, string& error) {
+		const char* text = reinterpret_cast<const char*>(data);
+		const char marker[] = "end_header";
+		const size_t marker_size = sizeof(marker) - 1;
+		const char* header_end = nullptr;
+		for (size_t i = 0; i + marker_size <= size and i < (1 << 20); i++) {
+			if (memcmp(text + i, marker, marker_size) == 0) {
+				header_end = text + i + marker_size;
+				break;
+			}
+		}
+		if (size < 3 or memcmp(text, "ply", 3) != 0 or header_end == nullptr) {
+			error = "not a ply file";
+			return 0;
+		}
+		const char* data_begin = static_cast<const char*>(memchr(header_end, '\n', text + size - header_end));
+		if (data_begin == nullptr) {
+			error = "truncated header";
+			return 0;
+		}
+		data_begin++;
+
+		std::istringstream header(string(text, header_end));
+		string line;
+		bool binary_little_endian = false;
+		while (std::getline(header, line)) {
+			std::istringstream words(line);
+			string keyword;
+			words >> keyword;
+			if (keyword == "format") {
+				string format;
+				words >> format;
+				binary_little_endian = format == "binary_little_endian";
+			}
+			else if (keyword == "element") {
+				element e;
+				words >> e.name >> e.count;
+				elements.push_back(e);
+			}
+			else if (keyword == "property") {
+				if (elements.empty()) {
+					error = "property before element";
+					return 0;
+				}
+				property prop;
+				string type;
+				words >> type;
+				if (type == "list") {
+					string count_type;
+					words >> count_type >> type;
+					prop.is_list = true;
+					prop.count_type = parse_type(count_type);
+					if (prop.count_type == scalar_type::invalid) {
+						error = "unknown type " + count_type;
+						return 0;
+					}
+				}
+				words >> prop.name;
+				prop.type = parse_type(type);
+				if (prop.type == scalar_type::invalid) {
+					error = "unknown type " + type;
+					return 0;
+				}
+				elements.back().properties.push_back(prop);
+			}
+		}
+		if (not binary_little_endian) {
+			error = "only binary_little_endian is supported";
+			return 0;
+		}
+
+		for (element& e : elements) {
+			for (property& prop : e.properties) {
+				if (prop.is_list) {
+					e.fixed_size = false;
+					continue;
+				}
+				prop.offset = e.stride;
+				e.stride += type_size(prop.type);
+			}
+		}
+		return data_begin - text;
+	}
+
+	// 读取面并三角化，p移动到面数据之后
+	inline bool read_faces(const uint8_t*& p, const uint8_t* end, const element& e, vector<uint32_t>& indices) {
+		const property* list = e.find("vertex_indices", "vertex_index");
+		if (list == nullptr or not list->is_list or type_size(list->type) == 0) return false;
+		size_t count_size = type_size(list->count_type);
+		size_t index_size = type_size(list->type);
+
+		// 只有一个“list uchar int/uint”属性且全部为三角形时，每个面为13字节的定长记录
+		bool triangles_only = e.properties.size() == 1 and count_size == 1 and index_size == 4;
+		if (triangles_only) {
+			size_t stride = 1 + 3 * 4;
+			if (not fits(p, end, e.count, stride)) return false;
+			for (size_t i = 0; i < e.count and triangles_only; i++) triangles_only = p[i * stride] == 3;
+		}
+		if (triangles_only) {
+			size_t stride = 1 + 3 * 4;
+			indices.resize(e.count * 3);
+			uint32_t* dst = indices.data();
+			for (size_t i = 0; i < e.count; i++, p += stride, dst += 3) memcpy(dst, p + 1, 3 * 4);
+		}
+		else {
+			indices.reserve(e.count * 3);
+			for (size_t i = 0; i < e.count; i++) {
+				size_t size = record_size(e, p, end);
+				if (size == 0 or size > static_cast<size_t>(end - p)) return false;
+				const uint8_t* q = p;
+				for (const property& prop : e.properties) {
+					if (not prop.is_list) {
+						q += type_size(prop.type);
+						continue;
+					}
+					size_t n = static_cast<size_t>(read_scalar(q, prop.count_type));
+					q += type_size(prop.count_type);
+					if (&prop == list and n >= 3) {
+						// 扇形三角化，顶点数不限
+						uint32_t first = static_cast<uint32_t>(read_scalar(q, prop.type));
+						uint32_t previous = static_cast<uint32_t>(read_scalar(q + index_size, prop.type));
+						for (size_t k = 2; k < n; k++) {
+							uint32_t current = static_cast<uint32_t>(read_scalar(q + k * index_size, prop.type));
+							indices.push_back(first);
+							indices.push_back(previous);
+							indices.push_back(current);
+							previous = current;
+						}
+					}
+					q += n * type_size(prop.type);
+				}
+				p += size;
+			}
+		}
+		return true;
+	}
+}
+
+
+// 读取二进制PLY文件
+inline bool load_ply(const char* file_name, ply_data& data) {
+	using namespace ply_detail;
+	data = ply_data();
+	auto fail = [&](const string& error) {
+		std::cout << file_name << ": " << error << '\n';
+		data = ply_data();
+		return false;
+	};
+
+	mapped_file file;
+	if (not file.open(file_name)) return fail("failed to open");
+	vector<element> elements;
+	string error;
+	size_t offset = parse_header(file.data, file.size, elements, error);
+	if (offset == 0) return fail(error);
+
+	const uint8_t* p = file.data + offset;
+	const uint8_t* end = file.data + file.size;
+	bool has_faces = false;
+	for (const element& e : elements) {
+		if (e.name == "vertex") {
+			if (not e.fixed_size) return fail("list properties in vertex element are not supported");
+			if (not fits(p, end, e.count, e.stride)) return fail("truncated vertex data");
+			const property* position[3] = { e.find("x"), e.find("y"), e.find("z") };
+			const property* normal[3] = { e.find("nx"), e.find("ny"), e.find("nz") };
+			const property* uv[2] = { e.find("u", "s", "texture_u"), e.find("v", "t", "texture_v") };
+			if (not position[0] or not position[1] or not position[2]) return fail("missing vertex positions");
+			data.vertex_num = e.count;
+			copy_attribute(p, e, position, 3, data.positions);
+			if (normal[0] and normal[1] and normal[2]) copy_attribute(p, e, normal, 3, data.normals);
+			if (uv[0] and uv[1]) copy_attribute(p, e, uv, 2, data.uvs);
+			p += e.count * e.stride;
+		}
+		else if (e.name == "face") {
+			if (not read_faces(p, end, e, data.indices)) return fail("invalid face data");
+			has_faces = true;
+		}
+		else {
+			// 跳过其它元素
+			if (e.fixed_size) {
+				if (not fits(p, end, e.count, e.stride)) return fail("truncated data");
+				p += e.count * e.stride;
+			}
+			else {
+				for (size_t i = 0; i < e.count; i++) {
+					size_t size = record_size(e, p, end);
+					if (size == 0 or size > static_cast<size_t>(end - p)) return fail("truncated data");
+					p += size;
+				}
+			}
+		}
+		if (p > end) return fail("truncated data");
+	}
+	if (data.vertex_num == 0 or not has_faces) return fail("no vertex or face data");
+	for (uint32_t index : data.indices) {
+		if (index >= data.vertex_num) return fail("vertex index out of range");
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,238 @@
+#pragma once
+#ifndef PSSMLT_H
+#define PSSMLT_H
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <iostream>
+#include "global.h"
+#include "hittable.h"
+#include "light.h"
+#include "camera.h"
+#include "film.h"
+#include "renderer.h"
+
+using std::vector;
+using std::thread;
+
+
+// 主样本空间采样器
+// 参考 Kelemen 2002 / PBRT 16.4.5
+// 样本向量按需扩展，每次迭代以large_step_probability的概率进行大变异（重新均匀采样），否则对每一维进行小的高斯扰动
+// 每一维的变异都是懒执行的：只有在被使用时才补上之前跳过的迭代
+class pss_sampler : public sampler {
+public:
+	double sigma;
+	double large_step_probability;
+
+private:
+	struct primary_sample {
+		double value = 0;
+		long long last_modification_iteration = 0;
+		// 拒绝时恢复
+		double value_backup = 0;
+		long long modify_backup = 0;
+	};
+
+	vector<primary_sample> X;
+	std::mt19937_64 rng;
+	std::uniform_real_distribution<double> uniform{ 0.0, 1.0 };
+	std::normal_distribution<double> normal{ 0.0, 1.0 };
+	long long current_iteration = 0;
+	long long last_large_step_iteration = 0;
+	bool large_step = true;
+	int sample_index = 0;
+
+public:
+	pss_sampler(unsigned long long seed, double sigma_init = 0.01, double large_step_probability_init = 0.3) : rng(seed) {
+		sigma = sigma_init;
+		large_step_probability = large_step_probability_init;
+	}
+
+	// 开始一次新的变异
+	void start_iteration() {
+		current_iteration++;
+		large_step = uniform(rng) < large_step_probability;
+		sample_index = 0;
+	}
+
+	// 接受本次变异
+	void accept() {
+		if (large_step) last_large_step_iteration = current_iteration;
+	}
+
+	// 拒绝本次变异，恢复被修改过的维度
+	void reject() {
+		for (primary_sample& Xi : X) {
+			if (Xi.last_modification_iteration == current_iteration) {
+				Xi.value = Xi.value_backup;
+				Xi.last_modification_iteration = Xi.modify_backup;
+			}
+		}
+		current_iteration--;
+	}
+
+	virtual double next_1d() override {
+		int index = sample_index++;
+		ensure_ready(index);
+		return X[index].value;
+	}
+
+private:
+	void ensure_ready(int index) {
+		if (index >= static_cast<int>(X.size())) X.resize(index + 1);
+		primary_sample& Xi = X[index];
+
+		// 上一次大变异之后没有被使用过的维度需要重新均匀采样
+		if (Xi.last_modification_iteration < last_large_step_iteration) {
+			Xi.value = uniform(rng);
+			Xi.last_modification_iteration = last_large_step_iteration;
+		}
+
+		Xi.value_backup = Xi.value;
+		Xi.modify_backup = Xi.last_modification_iteration;
+		if (large_step) {
+			Xi.value = uniform(rng);
+		}
+		else {
+			// 跳过的n次小变异合并为一次方差为n * sigma^2的扰动
+			long long n_small = current_iteration - Xi.last_modification_iteration;
+			Xi.value += normal(rng) * sigma * sqrt(static_cast<double>(n_small));
+			Xi.value -= std::floor(Xi.value);
+		}
+		Xi.last_modification_iteration = current_iteration;
+	}
+};
+
+
+// 主样本空间Metropolis光线传输（PSSMLT）
+// 用于光源被遮挡、只能通过狭缝或镜面到达的场景
+// 包装ray_color：路径追踪中所有的随机数都来自pss_sampler，前两维决定像素位置
+// 先用bootstrap_num条独立路径估计图像的平均亮度b并选出马尔可夫链的起点，之后每个线程运行一条链，结果splat到film中
+class pssmlt_integrator {
+public:
+	shared_ptr<hittable> world;
+	vector<shared_ptr<light>> light_ptr_list;
+	camera cam;
+	int image_width;
+	int image_height;
+	int max_depth;
+	int bootstrap_num = 100000;
+	int chain_num = 8;
+	double sigma = 0.01;
+	double large_step_probability = 0.3;
+
+public:
+	pssmlt_integrator(shared_ptr<hittable> world_init, const vector<shared_ptr<light>>& light_ptr_list_init, const camera& cam_init,
+		int image_width_init, int image_height_init, int max_depth_init)
+		: world(world_init), light_ptr_list(light_ptr_list_init), cam(cam_init) {
+		image_width = image_width_init;
+		image_height = image_height_init;
+		max_depth = max_depth_init;
+	}
+
+	// 渲染并写入framebuffer
+	// 变异总次数为 像素数 * samples_per_pixel
+	void render(vector<vec3>* framebuffer, int samples_per_pixel) {
+		film target(image_width, image_height);
+
+		// bootstrap，估计归一化常数b
+		vector<double> bootstrap_weights(bootstrap_num, 0);
+		vector<thread> threads;
+		for (int t = 0; t < chain_num; t++) {
+			threads.emplace_back([&, t]() {
+				for (int i = t; i < bootstrap_num; i += chain_num) {
+					pss_sampler s(i, sigma, large_step_probability);
+					int pixel_index;
+					bootstrap_weights[i] = luminance(evaluate(s, pixel_index));
+				}
+			});
+		}
+		for (thread& t : threads) t.join();
+		threads.clear();
+
+		double b = 0;
+		for (double w : bootstrap_weights) b += w;
+		b /= bootstrap_num;
+		std::cout << "pssmlt: b = " << b << "\n";
+		if (b <= 0) {
+			target.develop(framebuffer, samples_per_pixel);
+			return;
+		}
+
+		// 每个线程运行一条马尔可夫链
+		long long mutation_num = static_cast<long long>(image_width) * image_height * samples_per_pixel;
+		for (int t = 0; t < chain_num; t++) {
+			long long begin = mutation_num * t / chain_num;
+			long long end = mutation_num * (t + 1) / chain_num;
+			threads.emplace_back([&, t, begin, end]() {
+				run_chain(target, bootstrap_weights, t, end - begin);
+			});
+		}
+		for (thread& t : threads) t.join();
+
+		// splat值的期望为 I / b，乘回b后再除以每像素的变异次数
+		target.develop(framebuffer, samples_per_pixel, b);
+	}
+
+private:
+	// 使用采样器s计算一条路径，返回贡献以及对应的像素
+	vec3 evaluate(pss_sampler& s, int& pixel_index) {
+		current_sampler = &s;
+
+		double x = random_double() * image_width;
+		double y = random_double() * image_height;
+		int i = std::min(static_cast<int>(x), image_width - 1);
+		int j = std::min(static_cast<int>(y), image_height - 1);
+		pixel_index = (image_height - 1 - j) * image_width + i;
+
+		// 与render_bvh一致，u = (i + rand) / (width - 1)，每个样本的贡献截断到[0, 1]
+		ray r = cam.get_ray(x / (image_width - 1), y / (image_height - 1));
+		vec3 L = clamp(ray_color(r, world, max_depth, light_ptr_list), 0, 1);
+
+		current_sampler = nullptr;
+		return L;
+	}
+
+	void run_chain(film& target, const vector<double>& bootstrap_weights, int chain_index, long long mutation_num) {
+		// 按bootstrap权重选择链的起点，用相同的种子重放得到起点的样本向量
+		std::mt19937_64 rng(chain_index);
+		std::discrete_distribution<int> bootstrap_distribution(bootstrap_weights.begin(), bootstrap_weights.end());
+		int bootstrap_index = bootstrap_distribution(rng);
+
+		pss_sampler s(bootstrap_index, sigma, large_step_probability);
+		int pixel_current;
+		vec3 L_current = evaluate(s, pixel_current);
+		double I_current = luminance(L_current);
+
+		std::uniform_real_distribution<double> uniform(0.0, 1.0);
+		for (long long k = 0; k < mutation_num; k++) {
+			if (chain_index == 0 and k % 1000000 == 0) {
+				std::cerr << "\rMutations remaining: " << mutation_num - k << ' ' << std::flush; // 进度显示
+			}
+
+			s.start_iteration();
+			int pixel_proposed;
+			vec3 L_proposed = evaluate(s, pixel_proposed);
+			double I_proposed = luminance(L_proposed);
+			double accept = I_current > 0 ? std::min(1.0, I_proposed / I_current) : 1.0;
+
+			// 使用期望值进行splat，当前样本与候选样本都有贡献
+			if (accept > 0 and I_proposed > 0) target.splat(pixel_proposed, L_proposed * (accept / I_proposed));
+			if (accept < 1) target.splat(pixel_current, L_current * ((1 - accept) / I_current));
+
+			if (uniform(rng) < accept) {
+				pixel_current = pixel_proposed;
+				L_current = L_proposed;
+				I_current = I_proposed;
+				s.accept();
+			}
+			else {
+				s.reject();
+			}
+		}
+	}
+};
+
+#endif
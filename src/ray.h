@@ -1,34 +1,46 @@
-#pragma once
-#ifndef RAY_H
-#define RAY_H
-
-#include "vec3.h"
-#include "medium.h"
-
-class ray {
-public:
-	point3 orig; // 
-	vec3 dir; // 򣬲һǵλ
-	medium med; // 
-
-public:
-	ray() {}
-	ray(const point3& origin, const vec3& direction, const medium& med_init = medium(1))
-	{
-		orig = origin;
-		dir = direction;
-		med = med_init;      
-	}
-
-	point3 origin() const { return orig; }
-	vec3 direction() const { return dir; }
-	
-	// t
-	point3 at(double t) const {
-		return orig + t * dir;
-	}
-
-
-};
-
+#pragma once
+#ifndef RAY_H
+#define RAY_H
+
+#include "vec3.h"
+#include "medium.h"
+
+class ray {
+public:
+	point3 orig; // 起点
+	vec3 dir; // 方向，不一定是单位向量
+	const medium* med = nullptr; // 光线所在的介质，为空时视为真空
+	// 光锥，近似表示光线微分，用于估计纹理查找的足迹
+	// 参考：Akenine-Moller et al. 2021, Improved Shader and Texture Level of Detail Using Ray Cones
+	// 两者都为0时足迹为0，纹理使用原始分辨率
+	double cone_width = 0; // 起点处光锥的宽度
+	double cone_spread = 0; // 光锥的扩散角（弧度）
+	// 光线来自估计了焦散的非镜面着色点，之后只经过了镜面反射、折射（见renderer.h中的next_caustic_path）
+	bool caustic = false;
+
+public:
+	ray() {}
+	ray(const point3& origin, const vec3& direction, const medium* med_init = nullptr)
+	{
+		orig = origin;
+		dir = direction;
+		med = med_init;      
+	}
+
+	point3 origin() const { return orig; }
+	vec3 direction() const { return dir; }
+	
+	// 距离起点t距离的坐标
+	point3 at(double t) const {
+		return orig + t * dir;
+	}
+
+	// 距离起点distance处（按长度计，不是参数t）光锥的宽度
+	double cone_width_at(double distance) const {
+		return cone_width + cone_spread * distance;
+	}
+
+
+};
+
 #endif
\ No newline at end of file
@@ -1,189 +1,348 @@
-#pragma once
-#ifndef RENDERER_H
-#define RENDERER_H
-
-#include <fstream>
-#include <iostream>
-#include <mutex>
-#include "global.h"
-#include "color.h"
-#include "sphere.h"
-#include "cylinder.h"
-#include "cone.h"
-#include "triangle.h"
-#include "hittable_list.h"
-#include "camera.h"
-#include "material.h"
-#include "light.h"
-#include "material_samples.h"
-
-using std::mutex;
-
-const double P_RR = 1; // ˹̶ĸ
-
-
-// ׷ٺ
-// ȱʾʣɷ
-// ӶԹԴ
-// ʹbvh
-// ֧͸
-color ray_color(const ray& r, shared_ptr<hittable>& bvh_root, int depth, vector<shared_ptr<light>> light_ptr_list) {
-	hit_record rec;
-
-	if (depth <= 0)
-		return color(0, 0, 0);
-
-	if (bvh_root->hit(r, 0.00000001, infinity, rec)) {
-		// ȡ͸
-		double alpha = rec.mat_ptr->get_color_map_ptr()->get_alpha(rec.uv);
-
-		// Ǵ͸ǲ͸ȡ͸
-		if (random_double() > alpha) { // ͸
-			// ֱһ߼ǰ
-			ray new_ray(rec.p, r.dir, r.med);
-			// ºdepthֵ
-			if (random_double() > 0.9)
-				return ray_color(new_ray, bvh_root, depth - 1, light_ptr_list);
-			else
-				return ray_color(new_ray, bvh_root, depth, light_ptr_list);
-		}
-		else {
-			// Ϣ
-			vec3 normalo = unit_vector(rec.normal); // 㷨
-			vec3 wo = unit_vector(-r.direction()); // ䷽
-			vec3 positiono = rec.p; // 
-
-			// ֱӹ
-			vec3 radiance_direct = vec3(0, 0, 0);
-			bool include_direct_light = false;
-			if (rec.mat_ptr->sample_light()) {
-				for (shared_ptr<light> light_ptr : light_ptr_list)
-				{
-					// ȡԴϢ
-					vec3 position_light; // Դ
-					vec3 radiance_light; // Դradiance
-					vec3 normal_light; // Դ㷨
-					double pdf_light = light_ptr->sample_p(position_light, radiance_light, normal_light); // Դpdf
-
-					// 
-					double pdf_p; // pdf
-					vec3 normali; // 㷨
-					vec3 positioni; // 
-					tie(pdf_p, normali, positioni) = rec.mat_ptr->sample_positioni(normalo, positiono, bvh_root); // ȡpdf㷨ߣ䷽
-
-					// õ䷽򣨵Դ㣩
-					vec3 wi_light = unit_vector(position_light - positioni);
-
-					// ԴĹ
-					ray ray_to_light(positioni, wi_light);
-					hit_record rec_check_block;
-
-					bool wo_front = rec.front_face;
-					bool wi_front = dot(normali, wi_light) > 0 ? wo_front : not wo_front;
-
-					if (bvh_root->hit(ray_to_light, 0.000001, infinity, rec_check_block) and rec_check_block.t < (position_light - positioni).length())
-					{
-						radiance_direct += vec3(0, 0, 0); // ڵֱӹΪ0
-						include_direct_light = true;
-
-					}
-					else
-					{
-						double distance_light_square = (position_light - positioni).length_squared(); // shading pointԴƽ
-						sample_light_flag = true;
-						vec3 brdf_light = rec.mat_ptr->bsdf(wo, normalo, positiono, wo_front, rec.uv, wi_light, normali, positioni, wi_front); // 㵽Դbsdf
-						vec3 radiance_direct_delta;
-						if (wi_front == wo_front) {
-							radiance_direct_delta = radiance_light * brdf_light * dot(normalo, wi_light) * dot(normal_light, -wi_light) / (distance_light_square * pdf_light * pdf_p); // ֱӹ⣨䣩
-						}
-						else {
-							radiance_direct_delta = -radiance_light * brdf_light * dot(normalo, wi_light) * dot(normal_light, -wi_light) / (distance_light_square * pdf_light * pdf_p); // ֱӹ⣨䣩
-						}
-						radiance_direct += clamp(radiance_direct_delta, 0, std::numeric_limits<double>::infinity()); // ʹradianceǸӹԴ⣩
-
-					}
-				}
-			}
-
-			// ȷǷҪӹ
-			bool scatter = random_double() < P_RR;
-			if (scatter)
-			{
-				// ⷽȡӹ
-				vec3 wi; // ䷽
-				double pdf_w; // ䷽ܶ
-				double pdf_p; // λòܶ
-				vec3 normali; // 㷨
-				vec3 positioni; // 
-				bool wo_front = rec.front_face;
-				bool wi_front;
-				tie(pdf_p, normali, positioni) = rec.mat_ptr->sample_positioni(normalo, positiono, bvh_root); // ȡpdf㷨ߣ䷽
-				tie(pdf_w, wi, wi_front) = rec.mat_ptr->sample_wi(wo, normali, wo_front);
-#ifdef test_mode
-				std::cout << "depth = " << depth << '\n';
-#endif
-				sample_light_flag = false;
-				vec3 brdf = rec.mat_ptr->bsdf(wo, normalo, positiono, wo_front, rec.uv, wi, normali, positioni, wi_front);
-
-				ray new_ray(positioni, wi); // µĹߴ
-				vec3 radiance_indirect;
-				// ߴ͸ôdepth
-				if (wo_front == wi_front) {
-					radiance_indirect = ray_color(new_ray, bvh_root, depth - 1, light_ptr_list) * brdf * dot(normalo, wi) / (pdf_w * pdf_p * P_RR);
-				}
-				else
-				{
-					radiance_indirect = ray_color(new_ray, bvh_root, depth, light_ptr_list) * brdf * dot(normalo, wi) / (pdf_w * pdf_p * P_RR);
-				}
-				radiance_indirect = clamp(radiance_indirect, 0, std::numeric_limits<double>::infinity());
-
-				// õradiance
-				vec3 radiance = rec.mat_ptr->get_radiance();
-				if (include_direct_light) {
-					return radiance + radiance_direct + radiance_indirect;
-				}
-				else {
-					return radiance + radiance_direct + radiance_indirect;
-				}
-			}
-			else
-			{
-				// õradiance
-				vec3 radiance = rec.mat_ptr->get_radiance();
-				return radiance + radiance_direct;
-			}
-		}
-	}
-
-	// ʲôûУ򷵻ػ
-	return vec3(0, 0, 0);
-}
-
-
-mutex framebuffer_mutex;
-void render_bvh(int image_height, int image_width, int samples_per_pixel, int max_depth,
-	shared_ptr<hittable> bvh_root, camera cam, vector<vec3>* framebuffer, vector<shared_ptr<light>> light_ptr_list, int step, int bias)
-{
-	for (int j = image_height - 1; j >= 0; --j) {
-		std::cerr << "\rScanlines remaining: " << j << ' ' << std::flush; // ʾ
-		for (int i = bias; i < image_width; i += step) {
-			color pixel_color(0, 0, 0);
-			// βƽֵ
-			// ͬʱôҲʹrayķָ
-			for (int s = 0; s < samples_per_pixel; ++s) {
-				auto u = (i + random_double()) / (image_width - 1);
-				auto v = (j + random_double()) / (image_height - 1);
-				ray r = cam.get_ray(u, v);
-				//pixel_color += ray_color(r, world, max_depth);
-				//pixel_color += ray_color(r, world, max_depth, light_ptr);
-				pixel_color += clamp(ray_color(r, bvh_root, max_depth, light_ptr_list), 0, 1);
-			}
-			// ֪û
-			framebuffer_mutex.lock();
-			write_color_to_framebuffer(framebuffer, pixel_color, samples_per_pixel, (image_height - 1 - j) * image_width + i);
-			framebuffer_mutex.unlock();
-		}
-	}
-}
-
+#pragma once
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include "global.h"
+#include "color.h"
+#include "sphere.h"
+#include "cylinder.h"
+#include "cone.h"
+#include "triangle.h"
+#include "hittable_list.h"
+#include "camera.h"
+#include "material.h"
+#include "light.h"
+#include "material_samples.h"
+#include "photon_map.h"
+#include "irradiance_cache.h"
+#include "reservoir.h"
+#include "transmittance.h"
+#include "material_variant.h"
+
+using std::mutex;
+
+const double P_RR = 1; // 俄罗斯轮盘赌概率
+
+// 焦散光子图，为空指针时不使用
+shared_ptr<photon_map> caustic_map_ptr = nullptr;
+
+// 辐照度缓存，为空指针时不使用
+shared_ptr<irradiance_cache> irradiance_cache_ptr = nullptr;
+
+// 直接光的候选光源样本数
+// 大于0时使用蓄水池重采样（RIS），只发出一条阴影光线；为0时对每个光源各采样一次
+int ris_candidate_num = 0;
+
+// 表面着色使用std::variant分发到具体材质类型（见material_variant.h），为false时使用虚函数
+// 两种方式在同一个程序中切换，便于对比性能
+bool use_material_variant = false;
+
+// 非镜面反弹后光锥的最小扩散角（弧度）
+// 漫反射、光泽反射的出射方向分布很宽，相邻像素的光线在反弹后会分散到很大的范围，这里用一个固定的扩散角近似
+// 镜面反射、折射以及透明穿透保持原来的扩散角（忽略表面曲率）
+double bounce_cone_spread = 0.1;
+
+// 从着色点继续传播的光线继承光锥：起点宽度为击中点处的宽度
+inline void continue_cone(ray& new_ray, const ray& r, const shading_context& ctx, bool specular) {
+	new_ray.cone_width = ctx.cone_width;
+	new_ray.cone_spread = specular ? r.cone_spread : std::max(r.cone_spread, bounce_cone_spread);
+}
+
+
+// 从着色点继续传播的光线是否在焦散路径上
+// 非镜面着色点估计了焦散，之后的镜面反射、折射延续这条路径，其它情况下不在焦散路径上
+inline bool next_caustic_path(const ray& r, bool specular) {
+	if (not caustic_map_ptr) return false;
+	return not specular or r.caustic;
+}
+
+// 焦散路径上的镜面着色点不再采样光源
+// 光源 -> 这里 -> 镜面反射、折射（零次或多次） -> 非镜面表面 的路径已经包含在焦散光子图中
+template <typename mat_type>
+inline bool caustic_direct_in_photon_map(const mat_type& mat, const ray& r) {
+	return r.caustic and mat.is_specular();
+}
+
+
+color ray_color(const ray& r, shared_ptr<hittable>& bvh_root, int depth, const vector<shared_ptr<light>>& light_ptr_list, int bounce = 0);
+color ray_color(const ray& r, bool hit_surface, hit_record& rec, shared_ptr<hittable>& bvh_root, int depth, const vector<shared_ptr<light>>& light_ptr_list, int bounce);
+
+
+// 表面着色，计算光线r在击中点rec处的radiance
+// mat_type为material时通过虚函数调用材质；为具体的材质类（均为final）时编译器可以去掉虚函数调用并内联
+// rec按值传递，着色前在其上应用法线贴图
+template <typename mat_type>
+color shade_surface(const mat_type& mat, const ray& r, hit_record rec, shared_ptr<hittable>& bvh_root, int depth,
+	const vector<shared_ptr<light>>& light_ptr_list, int bounce) {
+	// 着色点的纹理输入只读取一次
+	shading_context ctx = make_shading_context(mat, rec, r);
+
+	// 获取透明度
+	double alpha = ctx.alpha;
+
+	// 随机决定是穿透还是不穿透，概率取决于透明度
+	// 求交时已经完成alpha测试的交点不再穿透
+	if (not rec.alpha_resolved and random_double() > alpha) { // 穿透
+		// 直接生成一束光线继续向前传播
+		// 穿过介质边界时切换介质，其它表面保持原来的介质
+		ray new_ray(rec.p, r.dir, medium_after_pass_through(mat, r.med, rec.front_face));
+		continue_cone(new_ray, r, ctx, true);
+		new_ray.caustic = r.caustic;
+		// 传入新函数的depth值不会减少
+		if (random_double() > 0.9)
+			return ray_color(new_ray, bvh_root, depth - 1, light_ptr_list, bounce);
+		else
+			return ray_color(new_ray, bvh_root, depth, light_ptr_list, bounce);
+	}
+	else {
+		// 计算基本信息
+		vec3 normalo = unit_vector(rec.normal); // 出射点法线
+		vec3 wo = unit_vector(-r.direction()); // 出射方向
+		vec3 positiono = rec.p; // 出射点坐标
+
+		// 随机采样入射点
+		// 直接光的所有光源以及间接光共用同一个入射点，次表面散射材质每个着色点只需要一次投影
+		double pdf_p; // 入射点采样pdf
+		vec3 normali; // 入射点法线
+		vec3 positioni; // 入射点坐标
+		tie(pdf_p, normali, positioni) = mat.sample_positioni(normalo, positiono, *bvh_root); // 获取入射点采样pdf，入射点法线，入射方向
+
+		// 计算直接光
+		vec3 radiance_direct = vec3(0, 0, 0);
+		bool include_direct_light = false;
+		bool sample_light = mat.sample_light() and not caustic_direct_in_photon_map(mat, r);
+		if (sample_light and ris_candidate_num > 0) {
+			// 按不考虑遮挡的贡献在多个候选样本中重采样，然后只对选中的样本发出一条阴影光线
+			direct_light_point sp;
+			sp.mat_ptr = &mat;
+			sp.wo = wo;
+			sp.normalo = normalo;
+			sp.positiono = positiono;
+			sp.wo_front = rec.front_face;
+			sp.ctx = ctx;
+			sp.normali = normali;
+			sp.positioni = positioni;
+			sp.med = r.med;
+
+			reservoir res = sample_direct_reservoir(sp, light_ptr_list, ris_candidate_num);
+			radiance_direct = shade_direct_reservoir(sp, res, bvh_root) / pdf_p;
+		}
+		else if (sample_light) {
+			for (const shared_ptr<light>& light_ptr : light_ptr_list)
+			{
+				// 获取光源的信息
+				vec3 position_light; // 光源采样点坐标
+				vec3 radiance_light; // 光源采样点radiance
+				vec3 normal_light; // 光源采样点法线
+				double pdf_light = light_ptr->sample_p(position_light, radiance_light, normal_light); // 光源采样点pdf
+
+				// 得到入射方向（到光源采样点）
+				vec3 wi_light = unit_vector(position_light - positioni);
+
+				// 计算光源的贡献
+				bool wo_front = rec.front_face;
+				bool wi_front = dot(normali, wi_light) > 0 ? wo_front : not wo_front;
+
+				// 到光源的透射率，穿过介质边界以及参与介质
+				vec3 T = shadow_transmittance(positioni, position_light, medium_after(mat, r.med, wo_front, wi_front), bvh_root);
+
+				if (luminance(T) <= 0)
+				{
+					radiance_direct += vec3(0, 0, 0); // 有遮挡物则直接光为0
+					include_direct_light = true;
+
+				}
+				else
+				{
+					double distance_light_square = (position_light - positioni).length_squared(); // shading point到光源采样点距离的平方
+					sample_light_flag = true;
+					vec3 brdf_light = mat.bsdf(wo, normalo, positiono, wo_front, ctx, wi_light, normali, positioni, wi_front); // 计算到光源的bsdf
+					vec3 radiance_direct_delta;
+					if (wi_front == wo_front) {
+						radiance_direct_delta = radiance_light * brdf_light * dot(normalo, wi_light) * dot(normal_light, -wi_light) / (distance_light_square * pdf_light * pdf_p); // 直接光（反射）
+					}
+					else {
+						radiance_direct_delta = -radiance_light * brdf_light * dot(normalo, wi_light) * dot(normal_light, -wi_light) / (distance_light_square * pdf_light * pdf_p); // 直接光（折射）
+					}
+					radiance_direct += clamp(radiance_direct_delta * T, 0, std::numeric_limits<double>::infinity()); // 使radiance非负（解决从光源反向射出的问题）
+
+				}
+			}
+		}
+
+		// 在漫反射表面上通过光子图估计焦散
+		vec3 radiance_caustic = vec3(0, 0, 0);
+		if (caustic_map_ptr and not mat.is_specular()) {
+			radiance_caustic = caustic_map_ptr->estimate(mat, wo, normalo, positiono, rec.front_face, ctx);
+		}
+
+		// 确定是否需要反弹，如果反弹则计算间接光
+		bool scatter = random_double() < P_RR;
+		if (scatter and irradiance_cache_ptr and bounce == 1 and mat.is_diffuse())
+		{
+			// 第一次反弹之后的漫反射表面直接从辐照度缓存中插值得到间接光，不再继续追踪
+			// 计算新记录时的光线不再使用缓存，保证每条记录都使用完整的剩余深度
+			vec3 E = irradiance_cache_ptr->get_irradiance(positiono, normalo, bvh_root, [&](const ray& r_cache, bool hit_cache, hit_record& rec_cache) {
+				ray cache_ray = r_cache;
+				cache_ray.caustic = next_caustic_path(r, false);
+				return ray_color(cache_ray, hit_cache, rec_cache, bvh_root, depth - 1, light_ptr_list, bounce + 1);
+			});
+			vec3 radiance_indirect = mat.get_diffuse_albedo(ctx) * E * pi_inv;
+
+			vec3 radiance = mat.get_radiance(ctx);
+			return radiance + radiance_direct + radiance_caustic + radiance_indirect;
+		}
+		else if (scatter)
+		{
+			// 随机采样入射光方向获取间接光照
+			vec3 wi; // 入射方向（随机采样）
+			double pdf_w; // 入射方向采样点概率密度
+			bool wo_front = rec.front_face;
+			bool wi_front;
+			tie(pdf_w, wi, wi_front) = mat.sample_wi(wo, normali, wo_front, ctx);
+#ifdef test_mode
+			std::cout << "depth = " << depth << '\n';
+#endif
+			sample_light_flag = false;
+			vec3 brdf = mat.bsdf(wo, normalo, positiono, wo_front, ctx, wi, normali, positioni, wi_front);
+
+			ray new_ray(positioni, wi, medium_after(mat, r.med, wo_front, wi_front)); // 新的光线从入射点射出
+			continue_cone(new_ray, r, ctx, mat.is_specular());
+			new_ray.caustic = next_caustic_path(r, mat.is_specular());
+			vec3 radiance_indirect;
+			// 如果光线穿透，那么depth不减少
+			if (wo_front == wi_front) {
+				radiance_indirect = ray_color(new_ray, bvh_root, depth - 1, light_ptr_list, bounce + 1) * brdf * dot(normalo, wi) / (pdf_w * pdf_p * P_RR);
+			}
+			else
+			{
+				radiance_indirect = ray_color(new_ray, bvh_root, depth, light_ptr_list, bounce + 1) * brdf * dot(normalo, wi) / (pdf_w * pdf_p * P_RR);
+			}
+			radiance_indirect = clamp(radiance_indirect, 0, std::numeric_limits<double>::infinity());
+
+			// 得到最终radiance
+			vec3 radiance = mat.get_radiance(ctx);
+			if (include_direct_light) {
+				return radiance + radiance_direct + radiance_caustic + radiance_indirect;
+			}
+			else {
+				return radiance + radiance_direct + radiance_caustic + radiance_indirect;
+			}
+		}
+		else
+		{
+			// 得到最终radiance
+			vec3 radiance = mat.get_radiance(ctx);
+			return radiance + radiance_direct + radiance_caustic;
+		}
+	}
+}
+
+
+// 光线追踪函数
+// 深度表示剩余可反弹次数
+// 增加对光源采样功能
+// 使用bvh
+// 支持透明材质
+// bounce为光线已经反弹的次数，相机直接发出的光线为0
+// 第一次反弹之后的漫反射着色点（bounce == 1）使用辐照度缓存
+// 光线位于参与介质中时，先用delta tracking采样到达表面之前的自由程，发生碰撞时在介质中散射
+color ray_color(const ray& r, shared_ptr<hittable>& bvh_root, int depth, const vector<shared_ptr<light>>& light_ptr_list, int bounce) {
+	hit_record rec;
+
+	if (depth <= 0)
+		return color(0, 0, 0);
+
+	bool hit_surface = bvh_root->hit(r, 0.00000001, infinity, rec);
+	return ray_color(r, hit_surface, rec, bvh_root, depth, light_ptr_list, bounce);
+}
+
+// 已经求交的光线，hit_surface与rec为求交的结果
+// 辐照度缓存计算新记录时用求交的距离估计记录半径，这里复用同一次求交
+color ray_color(const ray& r, bool hit_surface, hit_record& rec, shared_ptr<hittable>& bvh_root, int depth, const vector<shared_ptr<light>>& light_ptr_list, int bounce) {
+	if (depth <= 0)
+		return color(0, 0, 0);
+
+	if (r.med and r.med->is_participating()) {
+		double dir_length = r.dir.length();
+		vec3 d = r.dir / dir_length;
+		double t_scatter; // 散射点到光线起点的距离
+		vec3 weight; // 单次散射反照率
+		if (r.med->sample_free_flight(r.orig, d, hit_surface ? rec.t * dir_length : infinity, t_scatter, weight)) {
+			point3 p = r.orig + d * t_scatter;
+			vec3 wo = -d;
+
+			// 直接光，对每个光源采样一次
+			vec3 radiance_direct = vec3(0, 0, 0);
+			for (const shared_ptr<light>& light_ptr : light_ptr_list) {
+				vec3 position_light; // 光源采样点坐标
+				vec3 radiance_light; // 光源采样点radiance
+				vec3 normal_light; // 光源采样点法线
+				double pdf_light = light_ptr->sample_p(position_light, radiance_light, normal_light); // 光源采样点pdf
+
+				double distance_light_square = (position_light - p).length_squared();
+				vec3 wi_light = unit_vector(position_light - p);
+				double cos_light = dot(normal_light, -wi_light);
+				if (cos_light <= 0) continue;
+
+				vec3 T = shadow_transmittance(p, position_light, r.med, bvh_root);
+				radiance_direct += radiance_light * T * r.med->phase(wo, wi_light) * cos_light / (distance_light_square * pdf_light);
+			}
+
+			// 间接光，按相函数采样方向，采样权重为1
+			vec3 wi;
+			r.med->sample_phase(wo, wi);
+			ray new_ray(p, wi, r.med);
+			new_ray.cone_width = r.cone_width_at(t_scatter);
+			new_ray.cone_spread = std::max(r.cone_spread, bounce_cone_spread);
+			vec3 radiance_indirect = ray_color(new_ray, bvh_root, depth - 1, light_ptr_list, bounce + 1);
+
+			return weight * (radiance_direct + radiance_indirect);
+		}
+	}
+
+	if (hit_surface) {
+		// 整个表面着色过程在具体材质类型上展开，材质的函数调用可以内联
+		if (use_material_variant and rec.mat_id < scene_material_variants.size()) {
+			return std::visit([&](auto mat_ptr) {
+				return shade_surface(*mat_ptr, r, rec, bvh_root, depth, light_ptr_list, bounce);
+			}, scene_material_variants[rec.mat_id]);
+		}
+		return shade_surface(*rec.mat_ptr(), r, rec, bvh_root, depth, light_ptr_list, bounce);
+	}
+
+	// 如果什么都没打中，则返回环境光
+	return vec3(0, 0, 0);
+}
+
+
+mutex framebuffer_mutex;
+void render_bvh(int image_height, int image_width, int samples_per_pixel, int max_depth,
+	shared_ptr<hittable> bvh_root, camera cam, vector<vec3>* framebuffer, vector<shared_ptr<light>> light_ptr_list, int step, int bias)
+{
+	for (int j = image_height - 1; j >= 0; --j) {
+		std::cerr << "\rScanlines remaining: " << j << ' ' << std::flush; // 进度显示
+		for (int i = bias; i < image_width; i += step) {
+			color pixel_color(0, 0, 0);
+			// 多次采样计算平均值
+			// 同时这么做也使得ray的方向的期望近似指向像素中心
+			for (int s = 0; s < samples_per_pixel; ++s) {
+				auto u = (i + random_double()) / (image_width - 1);
+				auto v = (j + random_double()) / (image_height - 1);
+				ray r = cam.get_ray(u, v);
+				//pixel_color += ray_color(r, world, max_depth);
+				//pixel_color += ray_color(r, world, max_depth, light_ptr);
+				pixel_color += clamp(ray_color(r, bvh_root, max_depth, light_ptr_list), 0, 1);
+			}
+			// 不知道上锁有没有用
+			framebuffer_mutex.lock();
+			write_color_to_framebuffer(framebuffer, pixel_color, samples_per_pixel, (image_height - 1 - j) * image_width + i);
+			framebuffer_mutex.unlock();
+		}
+	}
+}
+
 #endif
\ No newline at end of file
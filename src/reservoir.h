@@ -0,0 +1,128 @@
+#pragma once
+#ifndef RESERVOIR_H
+#define RESERVOIR_H
+
+#include <vector>
+#include "global.h"
+#include "color.h"
+#include "hittable.h"
+#include "material.h"
+#include "light.h"
+#include "transmittance.h"
+
+using std::vector;
+
+
+// 光源样本
+struct light_sample {
+	vec3 position; // 光源上的采样点
+	vec3 radiance; // 采样点radiance
+	vec3 normal; // 采样点法线
+};
+
+
+// 加权蓄水池
+// 参考 Bitterli 2020 (ReSTIR)
+// 在候选样本流中按权重保留一个样本，W为被保留样本的无偏贡献权重
+struct reservoir {
+	light_sample y; // 被保留的样本
+	double w_sum = 0; // 权重和
+	double M = 0; // 已处理的候选数
+	double p_hat = 0; // 被保留样本的目标函数值
+	double W = 0; // 无偏贡献权重
+
+	// 加入一个候选样本，w为重采样权重，p_hat_x为该样本的目标函数值
+	bool update(const light_sample& x, double w, double p_hat_x) {
+		w_sum += w;
+		M += 1;
+		if (w > 0 and random_double() * w_sum < w) {
+			y = x;
+			p_hat = p_hat_x;
+			return true;
+		}
+		return false;
+	}
+
+	// 合并另一个蓄水池，p_hat_x为other.y在当前着色点的目标函数值
+	bool merge(const reservoir& other, double p_hat_x) {
+		double M_before = M;
+		bool selected = update(other.y, p_hat_x * other.W * other.M, p_hat_x);
+		M = M_before + other.M;
+		return selected;
+	}
+
+	// 计算无偏贡献权重
+	void finalize() {
+		W = (p_hat > 0 and M > 0) ? w_sum / (M * p_hat) : 0;
+	}
+};
+
+
+// 直接光着色点
+// 保存计算直接光需要的信息，参数含义与material::bsdf相同
+struct direct_light_point {
+	const material* mat_ptr = nullptr;
+	vec3 wo;
+	vec3 normalo;
+	vec3 positiono;
+	bool wo_front;
+	shading_context ctx; // 着色点的纹理输入
+	vec3 normali;
+	vec3 positioni;
+	const medium* med = nullptr; // 出射光线所在的介质
+
+	// 不考虑遮挡时光源样本x的贡献，与ray_color中直接光的计算方式一致
+	vec3 unshadowed(const light_sample& x) const {
+		vec3 d = x.position - positioni;
+		double distance_light_square = d.length_squared();
+		vec3 wi_light = unit_vector(d);
+		bool wi_front = dot(normali, wi_light) > 0 ? wo_front : not wo_front;
+
+		vec3 brdf_light = mat_ptr->bsdf(wo, normalo, positiono, wo_front, ctx, wi_light, normali, positioni, wi_front);
+		vec3 radiance = x.radiance * brdf_light * dot(normalo, wi_light) * dot(x.normal, -wi_light) / distance_light_square;
+		if (wi_front != wo_front) radiance = -radiance;
+		return clamp(radiance, 0, infinity);
+	}
+
+	// 目标函数
+	double target(const light_sample& x) const {
+		return luminance(unshadowed(x));
+	}
+};
+
+
+// 生成candidate_num个光源候选样本（均匀选择光源，再在光源上采样），按不考虑遮挡的贡献重采样
+reservoir sample_direct_reservoir(const direct_light_point& sp, const vector<shared_ptr<light>>& light_ptr_list, int candidate_num) {
+	reservoir r;
+	int light_num = static_cast<int>(light_ptr_list.size());
+	if (light_num == 0) return r;
+
+	for (int k = 0; k < candidate_num; k++) {
+		int light_index = std::min(static_cast<int>(random_double() * light_num), light_num - 1);
+		light_sample x;
+		double pdf_light = light_ptr_list[light_index]->sample_p(x.position, x.radiance, x.normal) / light_num;
+
+		double p_hat_x = sp.target(x);
+		r.update(x, p_hat_x / pdf_light, p_hat_x);
+	}
+	r.finalize();
+	return r;
+}
+
+
+// 着色点到蓄水池中样本之间的透射率，有遮挡时为0
+vec3 direct_sample_transmittance(const direct_light_point& sp, const light_sample& x, const shared_ptr<hittable>& world) {
+	bool wi_front = dot(sp.normali, x.position - sp.positioni) > 0 ? sp.wo_front : not sp.wo_front;
+	return shadow_transmittance(sp.positioni, x.position, medium_after(*sp.mat_ptr, sp.med, sp.wo_front, wi_front), world);
+}
+
+
+// 使用蓄水池计算直接光，只需要一条阴影光线
+vec3 shade_direct_reservoir(const direct_light_point& sp, const reservoir& r, const shared_ptr<hittable>& world) {
+	if (r.W <= 0) return vec3(0, 0, 0);
+	vec3 T = direct_sample_transmittance(sp, r.y, world);
+	if (luminance(T) <= 0) return vec3(0, 0, 0);
+	return sp.unshadowed(r.y) * T * r.W;
+}
+
+#endif
@@ -0,0 +1,277 @@
+#pragma once
+#ifndef RESOURCE_MANAGER_H
+#define RESOURCE_MANAGER_H
+
+#include <mutex>
+#include <future>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <typeinfo>
+#include <filesystem>
+#include <type_traits>
+#include <unordered_map>
+#include "global.h"
+#include "texture.h"
+#include "material.h"
+#include "asset_loader.h"
+
+// 场景资源管理
+// 同一个图像可能被多个材质、多个子网格引用，每次都构造一个新的纹理会重复占用内存。
+// 通过资源管理器创建的纹理与材质按“类型 + 构造参数”去重，参数相同时只创建一次，之后返回同一个共享指针：
+// - 纹理的参数为文件路径与加载参数（放大倍数、存储格式等）
+// - 材质的参数中的纹理、介质等指针按地址比较。纹理已经去重，引用同一个图像的材质得到相同的地址
+// 资源被多处共享，取得之后不要再修改它的成员。带有每个物体各自状态的材质（per_object_state，如sss_material）不去重
+// 键中引用的其它资源记为创建顺序编号，场景的构建过程不变时每次运行的键都相同，可以用来判断缓存的结果是否有效（见describe）
+
+namespace resource_detail {
+	template <typename T> struct is_shared_ptr : std::false_type {};
+	template <typename T> struct is_shared_ptr<shared_ptr<T>> : std::true_type {};
+
+	// 材质类型声明了per_object_state = true时，每次请求都创建新的对象
+	template <typename T, typename = void> struct has_object_state : std::false_type {};
+	template <typename T> struct has_object_state<T, std::void_t<decltype(T::per_object_state)>> : std::bool_constant<T::per_object_state> {};
+
+	// 已创建的资源
+	struct resource_info {
+		size_t id; // 创建顺序编号
+		std::string key;
+		bool stable; // 键中没有未经管理的对象地址
+		std::vector<std::string> files; // 构造参数中的文件，包括所引用资源的文件
+	};
+
+	// 构造键时的状态
+	struct key_builder {
+		std::ostringstream key;
+		bool stable = true;
+		std::vector<std::string> files;
+		const std::unordered_map<const void*, resource_info>& infos;
+
+		explicit key_builder(const std::unordered_map<const void*, resource_info>& infos_init) : infos(infos_init) {}
+	};
+
+	// 把一个构造参数追加到键中
+	template <typename T>
+	void append_key(key_builder& builder, const T& value) {
+		using type = std::decay_t<T>;
+		std::ostringstream& key = builder.key;
+		if constexpr (std::is_null_pointer_v<type>) {
+			key << "null";
+		}
+		else if constexpr (is_shared_ptr<type>::value) {
+			auto itr = builder.infos.find(value.get());
+			if (not value) {
+				key << "null";
+			}
+			else if (itr != builder.infos.end()) {
+				key << '#' << itr->second.id;
+				builder.stable = builder.stable and itr->second.stable;
+				builder.files.insert(builder.files.end(), itr->second.files.begin(), itr->second.files.end());
+			}
+			else {
+				// 不是由管理器创建的对象按地址比较
+				key << static_cast<const void*>(value.get());
+				builder.stable = false;
+			}
+		}
+		else if constexpr (std::is_convertible_v<const T&, std::string>) {
+			std::string text(value);
+			key << text;
+			std::error_code ec;
+			if (std::filesystem::is_regular_file(text, ec)) builder.files.push_back(text);
+		}
+		else if constexpr (std::is_enum_v<type>) {
+			key << static_cast<long long>(value);
+		}
+		else if constexpr (std::is_arithmetic_v<type>) {
+			key << std::setprecision(17) << value;
+		}
+		else {
+			// 其它参数（vec3、材质属性等）按字节比较
+			static_assert(std::is_trivially_copyable_v<type>, "resource_manager: unsupported constructor argument");
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+			key << std::hex;
+			for (size_t i = 0; i < sizeof(type); i++) key << std::setw(2) << std::setfill('0') << static_cast<int>(bytes[i]);
+			key << std::dec;
+		}
+		key << '|';
+	}
+}
+
+
+class resource_manager {
+private:
+	std::unordered_map<std::string, shared_ptr<texture>> textures;
+	std::unordered_map<std::string, std::shared_future<shared_ptr<texture>>> loading_textures; // 正在锁外构造的纹理
+	std::unordered_map<std::string, shared_ptr<material>> materials;
+	std::unordered_map<const void*, resource_detail::resource_info> infos;
+	std::mutex manager_mutex;
+	size_t resource_num = 0; // 已分配的创建顺序编号
+
+	// 统计信息
+	size_t texture_request_num = 0;
+	size_t material_request_num = 0;
+	std::unordered_map<const texture*, size_t> texture_reuse_num; // 每个纹理被重复请求的次数，用于统计去重节省的内存
+
+	template <typename resource_type, typename... arg_types>
+	resource_detail::key_builder make_key(const arg_types&... args) {
+		resource_detail::key_builder builder(infos);
+		builder.key << typeid(resource_type).name() << '|';
+		(resource_detail::append_key(builder, args), ...);
+		return builder;
+	}
+
+	void record(const void* resource, size_t id, resource_detail::key_builder& builder) {
+		infos[resource] = { id, builder.key.str(), builder.stable, std::move(builder.files) };
+	}
+
+	// 在锁外等待其它线程正在构造的纹理
+	shared_ptr<texture> wait_loading(std::unique_lock<std::mutex>& lock, std::shared_future<shared_ptr<texture>> result) {
+		lock.unlock();
+		shared_ptr<texture> tex = result.get();
+		lock.lock();
+		texture_reuse_num[tex.get()]++;
+		return tex;
+	}
+
+	// 复制纹理列表，调用者在锁外使用
+	std::vector<shared_ptr<texture>> texture_list() {
+		std::lock_guard<std::mutex> lock(manager_mutex);
+		std::vector<shared_ptr<texture>> list;
+		list.reserve(textures.size());
+		for (const auto& item : textures) list.push_back(item.second);
+		return list;
+	}
+
+public:
+	// 获取纹理，例如get_texture<color_map>("obj/wood_d.jpg", 1.0)
+	// 纹理在锁外构造，解码图像时不阻塞其它资源的请求。构造前在loading_textures中登记，同一个纹理的其它请求等待这里的结果，图像只读取一次
+	template <typename texture_type, typename... arg_types>
+	shared_ptr<texture> get_texture(arg_types&&... args) {
+		std::unique_lock<std::mutex> lock(manager_mutex);
+		resource_detail::key_builder builder = make_key<texture_type>(args...);
+		std::string key = builder.key.str();
+		texture_request_num++;
+		auto itr = textures.find(key);
+		if (itr != textures.end()) {
+			texture_reuse_num[itr->second.get()]++;
+			return itr->second;
+		}
+		auto loading = loading_textures.find(key);
+		if (loading != loading_textures.end()) return wait_loading(lock, loading->second);
+		std::promise<shared_ptr<texture>> promise;
+		loading_textures.emplace(key, promise.get_future().share());
+		size_t id = resource_num++; // 编号按请求顺序分配，与构造完成的顺序无关
+		lock.unlock();
+
+		shared_ptr<texture> tex;
+		try {
+			tex = make_shared<texture_type>(std::forward<arg_types>(args)...);
+		}
+		catch (...) {
+			// 构造失败时撤销登记，等待同一个纹理的请求得到同样的异常，之后的请求重新构造
+			lock.lock();
+			loading_textures.erase(key);
+			lock.unlock();
+			promise.set_exception(std::current_exception());
+			throw;
+		}
+
+		lock.lock();
+		textures.emplace(key, tex);
+		record(tex.get(), id, builder);
+		loading_textures.erase(key);
+		lock.unlock();
+		promise.set_value(tex);
+		return tex;
+	}
+
+	// 异步获取纹理，参数与get_texture相同
+	// 图像在scene_assets的工作线程中读取，立即返回一个async_texture，可以直接用来创建材质，第一次查询时等待加载完成
+	// 与get_texture共用去重表，同一个图像只读取一次
+	template <typename texture_type, typename... arg_types>
+	shared_ptr<texture> get_texture_async(const arg_types&... args) {
+		std::unique_lock<std::mutex> lock(manager_mutex);
+		resource_detail::key_builder builder = make_key<texture_type>(args...);
+		std::string key = builder.key.str();
+		texture_request_num++;
+		auto itr = textures.find(key);
+		if (itr != textures.end()) {
+			texture_reuse_num[itr->second.get()]++;
+			return itr->second;
+		}
+		auto loading = loading_textures.find(key);
+		if (loading != loading_textures.end()) return wait_loading(lock, loading->second); // get_texture正在构造同一个纹理
+		shared_ptr<texture> tex = make_shared<async_texture>(asset_detail::submit_construct<texture_type, texture>(scene_assets, args...));
+		textures.emplace(std::move(key), tex);
+		record(tex.get(), resource_num++, builder);
+		return tex;
+	}
+
+	// 获取材质，例如get_material<ggx_nonmetal_material>(0.05, 0.03, tex_wood)
+	// 带有每个物体各自状态的材质每次创建新的对象，仍然记录描述，可以用于快照的键
+	template <typename material_type, typename... arg_types>
+	shared_ptr<material> get_material(arg_types&&... args) {
+		std::lock_guard<std::mutex> lock(manager_mutex);
+		resource_detail::key_builder builder = make_key<material_type>(args...);
+		std::string key = builder.key.str();
+		material_request_num++;
+		constexpr bool shared = not resource_detail::has_object_state<material_type>::value;
+		if constexpr (shared) {
+			auto itr = materials.find(key);
+			if (itr != materials.end()) return itr->second;
+		}
+		shared_ptr<material> mat = make_shared<material_type>(std::forward<arg_types>(args)...);
+		if constexpr (shared) materials.emplace(std::move(key), mat);
+		record(mat.get(), resource_num++, builder);
+		return mat;
+	}
+
+	// 资源的描述（类型与构造参数）以及构造参数中的文件
+	// 资源不是由管理器创建的，或者参数中引用了未经管理的对象时，描述在不同的运行之间可能不同，返回false
+	bool describe(const void* resource, std::string& description, std::vector<std::string>& files) {
+		std::lock_guard<std::mutex> lock(manager_mutex);
+		auto itr = infos.find(resource);
+		if (itr == infos.end() or not itr->second.stable) return false;
+		description = itr->second.key;
+		files = itr->second.files;
+		return true;
+	}
+
+	// 所有纹理的texel内存（字节）
+	// 异步纹理的memory_size会等待加载完成，在锁外计算，等待时不阻塞其它资源的请求
+	size_t texture_memory_size() {
+		size_t bytes = 0;
+		for (const shared_ptr<texture>& tex : texture_list()) bytes += tex->memory_size();
+		return bytes;
+	}
+
+	// 输出去重的统计信息（会等待异步加载的纹理完成）
+	void print_statistics() {
+		std::vector<std::pair<shared_ptr<texture>, size_t>> reused; // 被重复请求的纹理与次数
+		size_t texture_num, texture_requests, material_num, material_requests;
+		{
+			std::lock_guard<std::mutex> lock(manager_mutex);
+			for (const auto& item : textures) {
+				auto itr = texture_reuse_num.find(item.second.get());
+				if (itr != texture_reuse_num.end()) reused.emplace_back(item.second, itr->second);
+			}
+			texture_num = textures.size();
+			texture_requests = texture_request_num;
+			material_num = materials.size();
+			material_requests = material_request_num;
+		}
+		size_t bytes = texture_memory_size();
+		size_t bytes_saved = 0;
+		for (const auto& item : reused) bytes_saved += item.first->memory_size() * item.second;
+		std::cout << texture_num << " textures for " << texture_requests << " requests, "
+			<< bytes / 1048576.0 << " MB, " << bytes_saved / 1048576.0 << " MB saved by deduplication\n";
+		std::cout << material_num << " materials for " << material_requests << " requests\n";
+	}
+};
+
+// 场景使用的资源
+resource_manager scene_resources;
+
+#endif
@@ -0,0 +1,208 @@
+#pragma once
+#ifndef RESTIR_H
+#define RESTIR_H
+
+#include <vector>
+#include <thread>
+#include <iostream>
+#include "global.h"
+#include "camera.h"
+#include "renderer.h"
+#include "reservoir.h"
+
+using std::vector;
+using std::thread;
+
+
+// 第一次击中点的信息
+struct restir_gbuffer_entry {
+	ray r; // 到达第一次击中点的光线（已经穿过透明部分）
+	bool valid = false; // 击中了需要采样光源的材质
+	direct_light_point sp;
+	double pdf_p = 1; // 入射点采样pdf
+	double distance = 0; // 到相机的距离，用于判断相邻像素是否相似
+};
+
+
+// 带空间复用的直接光重采样渲染
+// 每个采样分为三步：
+// 1. 对每个像素找到第一次击中点，生成候选光源样本并重采样得到蓄水池，然后检查选中样本的可见性
+// 2. 空间复用：与若干个几何相似的相邻像素合并蓄水池，可以重复多次
+// 3. 使用蓄水池计算第一次击中点的直接光，间接光以及更深的弹射仍使用ray_color
+class restir_renderer {
+public:
+	shared_ptr<hittable> world;
+	vector<shared_ptr<light>> light_ptr_list;
+	camera cam;
+	int image_width;
+	int image_height;
+	int max_depth;
+	int thread_num = 8;
+	int candidate_num = 32; // 每个像素的候选样本数
+	int spatial_iterations = 2; // 空间复用次数
+	int spatial_neighbor_num = 5; // 每次复用的相邻像素数
+	double spatial_radius = 16; // 相邻像素的选择范围（像素）
+
+private:
+	vector<restir_gbuffer_entry> gbuffer;
+	vector<reservoir> reservoirs;
+	vector<reservoir> reservoirs_next;
+
+public:
+	restir_renderer(shared_ptr<hittable> world_init, const vector<shared_ptr<light>>& light_ptr_list_init, const camera& cam_init,
+		int image_width_init, int image_height_init, int max_depth_init)
+		: world(world_init), light_ptr_list(light_ptr_list_init), cam(cam_init) {
+		image_width = image_width_init;
+		image_height = image_height_init;
+		max_depth = max_depth_init;
+	}
+
+	void render(vector<vec3>* framebuffer, int samples_per_pixel) {
+		int pixel_num = image_width * image_height;
+		gbuffer.assign(pixel_num, restir_gbuffer_entry());
+		reservoirs.assign(pixel_num, reservoir());
+		reservoirs_next.assign(pixel_num, reservoir());
+		vector<vec3> pixel_colors(pixel_num, vec3(0, 0, 0));
+
+		for (int s = 0; s < samples_per_pixel; s++) {
+			std::cerr << "\rSamples remaining: " << samples_per_pixel - s << ' ' << std::flush; // 进度显示
+
+			parallel_for_pixels([&](int i, int j, int index) { generate_initial(i, j, index); });
+			for (int k = 0; k < spatial_iterations; k++) {
+				parallel_for_pixels([&](int i, int j, int index) { reuse_spatial(i, j, index); });
+				reservoirs.swap(reservoirs_next);
+			}
+			parallel_for_pixels([&](int i, int j, int index) { pixel_colors[index] += clamp(shade(index), 0, 1); });
+		}
+
+		for (int index = 0; index < pixel_num; index++) {
+			write_color_to_framebuffer(framebuffer, pixel_colors[index], samples_per_pixel, index);
+		}
+	}
+
+private:
+	// 与render_bvh相同，按列交错分配给各线程
+	template <typename pixel_function>
+	void parallel_for_pixels(pixel_function&& f) {
+		vector<thread> threads;
+		for (int t = 0; t < thread_num; t++) {
+			threads.emplace_back([&, t]() {
+				for (int j = image_height - 1; j >= 0; --j) {
+					for (int i = t; i < image_width; i += thread_num) {
+						f(i, j, (image_height - 1 - j) * image_width + i);
+					}
+				}
+			});
+		}
+		for (thread& t : threads) t.join();
+	}
+
+	// 第一步：找到第一次击中点并生成初始蓄水池
+	void generate_initial(int i, int j, int index) {
+		restir_gbuffer_entry& g = gbuffer[index];
+		g.valid = false;
+		reservoirs[index] = reservoir();
+
+		auto u = (i + random_double()) / (image_width - 1);
+		auto v = (j + random_double()) / (image_height - 1);
+		g.r = cam.get_ray(u, v);
+
+		// 参与介质中的光线由ray_color处理
+		hit_record rec;
+		shading_context ctx;
+		while (true) {
+			if (g.r.med and g.r.med->is_participating()) return;
+			if (not world->hit(g.r, 0.00000001, infinity, rec)) return;
+			ctx = make_shading_context(*rec.mat_ptr(), rec, g.r);
+			// 透明部分直接穿过
+			if (rec.alpha_resolved or random_double() <= ctx.alpha) break;
+			g.r = ray(rec.p, g.r.dir, medium_after_pass_through(*rec.mat_ptr(), g.r.med, rec.front_face));
+		}
+		if (not rec.mat_ptr()->sample_light()) return;
+
+		g.valid = true;
+		g.distance = (rec.p - cam.get_origin()).length();
+		g.sp.mat_ptr = rec.mat_ptr();
+		g.sp.wo = unit_vector(-g.r.direction());
+		g.sp.normalo = unit_vector(rec.normal);
+		g.sp.positiono = rec.p;
+		g.sp.wo_front = rec.front_face;
+		g.sp.ctx = ctx;
+		g.sp.med = g.r.med;
+		tie(g.pdf_p, g.sp.normali, g.sp.positioni) = rec.mat_ptr()->sample_positioni(g.sp.normalo, g.sp.positiono, *world);
+
+		reservoir r = sample_direct_reservoir(g.sp, light_ptr_list, candidate_num);
+
+		// 被遮挡的样本不参与复用
+		if (r.W > 0 and luminance(direct_sample_transmittance(g.sp, r.y, world)) <= 0) r.W = 0;
+		reservoirs[index] = r;
+	}
+
+	// 第二步：与相邻像素合并蓄水池
+	// 只合并法线与深度接近的像素，合并时在当前着色点重新计算目标函数
+	void reuse_spatial(int i, int j, int index) {
+		const restir_gbuffer_entry& g = gbuffer[index];
+		if (not g.valid) {
+			reservoirs_next[index] = reservoirs[index];
+			return;
+		}
+
+		reservoir r;
+		const reservoir& self = reservoirs[index];
+		r.merge(self, self.p_hat);
+		for (int k = 0; k < spatial_neighbor_num; k++) {
+			double radius = spatial_radius * sqrt(random_double());
+			double phi = pi2 * random_double();
+			int ni = i + static_cast<int>(std::round(radius * cos(phi)));
+			int nj = j + static_cast<int>(std::round(radius * sin(phi)));
+			if (ni < 0 or nj < 0 or ni >= image_width or nj >= image_height) continue;
+			int neighbor_index = (image_height - 1 - nj) * image_width + ni;
+			if (neighbor_index == index) continue;
+
+			const restir_gbuffer_entry& gn = gbuffer[neighbor_index];
+			if (not gn.valid) continue;
+			if (dot(gn.sp.normalo, g.sp.normalo) < 0.9) continue;
+			if (abs(gn.distance - g.distance) > 0.1 * g.distance) continue;
+
+			const reservoir& neighbor = reservoirs[neighbor_index];
+			r.merge(neighbor, g.sp.target(neighbor.y));
+		}
+		r.finalize();
+		reservoirs_next[index] = r;
+	}
+
+	// 第三步：着色
+	// 除了直接光使用蓄水池以外，与ray_color在第一次击中点的计算相同
+	vec3 shade(int index) {
+		const restir_gbuffer_entry& g = gbuffer[index];
+		if (not g.valid) return ray_color(g.r, world, max_depth, light_ptr_list);
+
+		const direct_light_point& sp = g.sp;
+		vec3 radiance_direct = shade_direct_reservoir(sp, reservoirs[index], world) / g.pdf_p;
+
+		vec3 radiance_caustic = vec3(0, 0, 0);
+		if (caustic_map_ptr and not sp.mat_ptr->is_specular()) {
+			radiance_caustic = caustic_map_ptr->estimate(*sp.mat_ptr, sp.wo, sp.normalo, sp.positiono, sp.wo_front, sp.ctx);
+		}
+
+		vec3 radiance_indirect = vec3(0, 0, 0);
+		if (random_double() < P_RR) {
+			vec3 wi;
+			double pdf_w;
+			bool wi_front;
+			tie(pdf_w, wi, wi_front) = sp.mat_ptr->sample_wi(sp.wo, sp.normali, sp.wo_front, sp.ctx);
+			vec3 brdf = sp.mat_ptr->bsdf(sp.wo, sp.normalo, sp.positiono, sp.wo_front, sp.ctx, wi, sp.normali, sp.positioni, wi_front);
+
+			// 如果光线穿透，那么depth不减少
+			int next_depth = sp.wo_front == wi_front ? max_depth - 1 : max_depth;
+			ray new_ray(sp.positioni, wi, medium_after(*sp.mat_ptr, sp.med, sp.wo_front, wi_front));
+			new_ray.caustic = next_caustic_path(g.r, sp.mat_ptr->is_specular());
+			radiance_indirect = ray_color(new_ray, world, next_depth, light_ptr_list, 1) * brdf * dot(sp.normalo, wi) / (pdf_w * g.pdf_p * P_RR);
+			radiance_indirect = clamp(radiance_indirect, 0, infinity);
+		}
+
+		return sp.mat_ptr->get_radiance(sp.ctx) + radiance_direct + radiance_caustic + radiance_indirect;
+	}
+};
+
+#endif
@@ -0,0 +1,505 @@
+#pragma once
+#ifndef SCENE_SNAPSHOT_H
+#define SCENE_SNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include <filesystem>
+#include <type_traits>
+#include "global.h"
+#include "hittable.h"
+#include "triangle.h"
+#include "mesh_triangle.h"
+#include "mapped_file.h"
+#include "resource_manager.h"
+
+// 网格快照
+// 读取.obj/.ply、unpack（包括置换贴图与不透明度微图）和构建bvh在每次运行时都要重复，大的网格需要很长时间
+// 这里把处理完成的三角形与展平的bvh写入快照文件，下次运行时直接把文件映射到内存使用：
+// - 网格按材质分为若干个snapshot_mesh，每个是一个hittable，带有自己的bvh，场景的bvh只需要包含这几个物体
+// - 三角形的数据（triangle_data）与bvh节点原样写入文件，求交与triangle相同，渲染结果不变
+// - 快照按网格的描述区分：类型、构造参数、变换、文件内容的哈希，以及材质的描述（见resource_manager::describe）与其中文件的哈希
+//   任何一项改变时快照失效，重新生成。材质不是由scene_resources创建的网格不使用快照
+//
+// 快照文件格式：
+// 文件头{magic, version, 材质数, 描述长度}，三角形数与节点数（uint64），描述
+// 每个材质{描述中的材质序号, 保留, 第一个三角形, 三角形数, 第一个节点, 节点数}
+// 之后是三角形与节点，各自按64字节对齐
+//
+// 能直接生成三角形数据的网格（mesh_triangle::unpack_faces）不需要快照时也使用同样的展平结构（见make_flat_mesh），不为每个三角形创建triangle对象
+
+// 是否使用快照
+bool use_scene_snapshot = true;
+// 快照文件所在的目录
+const char* scene_snapshot_dir = "scene_snapshot";
+
+
+// 展平的bvh节点
+// 内部节点的左子节点紧跟在它之后，右子节点的编号为offset
+struct snapshot_node {
+	bounds3 box;
+	uint32_t offset; // 叶子节点为第一个三角形的编号，内部节点为右子节点的编号
+	uint32_t count; // 叶子节点中的三角形数，内部节点为0
+	uint32_t axis; // 内部节点的分割轴，遍历时先访问光线方向上较近的子节点
+	uint32_t reserved;
+};
+
+static_assert(std::is_trivially_copyable_v<triangle_data>, "triangle_data is written to snapshots byte by byte");
+static_assert(std::is_trivially_copyable_v<snapshot_node>, "snapshot_node is written to snapshots byte by byte");
+
+
+// 快照中使用同一材质的三角形
+class snapshot_mesh final : public hittable {
+private:
+	shared_ptr<const void> owner; // 映射的文件或内存中的数据
+	const triangle_data* faces;
+	const snapshot_node* nodes;
+	size_t face_num;
+	uint32_t mat_id;
+	uint32_t first_prim_id;
+
+public:
+	snapshot_mesh(shared_ptr<const void> owner_init, const triangle_data* faces_init, size_t face_num_init, const snapshot_node* nodes_init, const shared_ptr<material>& mat_ptr)
+		: owner(std::move(owner_init)), faces(faces_init), nodes(nodes_init), face_num(face_num_init) {
+		mat_id = scene_materials.add(mat_ptr);
+		first_prim_id = new_primitive_id(static_cast<uint32_t>(face_num));
+	}
+
+	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override {
+		bool hit_anything = false;
+		double closest = t_max;
+		uint32_t stack[64];
+		int stack_size = 0;
+		uint32_t index = 0;
+		while (true) {
+			const snapshot_node& node = nodes[index];
+			if (node.box.hit(r, t_min, closest)) {
+				if (node.count == 0) {
+					// 先访问较近的子节点
+					if (r.dir[node.axis] < 0) {
+						stack[stack_size++] = index + 1;
+						index = node.offset;
+					}
+					else {
+						stack[stack_size++] = node.offset;
+						index = index + 1;
+					}
+					continue;
+				}
+				for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+					if (hit_triangle(faces[i], mat_id, first_prim_id + i, r, t_min, closest, rec)) {
+						hit_anything = true;
+						closest = rec.t;
+					}
+				}
+			}
+			if (stack_size == 0) break;
+			index = stack[--stack_size];
+		}
+		return hit_anything;
+	}
+
+	virtual void hit_all(const ray& r, double t_min, double t_max, std::vector<hit_record>& recs) const override {
+		uint32_t stack[64];
+		int stack_size = 0;
+		uint32_t index = 0;
+		hit_record rec;
+		while (true) {
+			const snapshot_node& node = nodes[index];
+			if (node.box.hit(r, t_min, t_max)) {
+				if (node.count == 0) {
+					stack[stack_size++] = node.offset;
+					index = index + 1;
+					continue;
+				}
+				for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+					if (hit_triangle(faces[i], mat_id, first_prim_id + i, r, t_min, t_max, rec)) recs.push_back(rec);
+				}
+			}
+			if (stack_size == 0) break;
+			index = stack[--stack_size];
+		}
+	}
+
+	virtual bounds3 bounds() const override {
+		return nodes[0].box;
+	}
+
+	virtual material* get_material() const override {
+		return scene_materials.get(mat_id);
+	}
+};
+
+
+namespace snapshot_detail {
+	constexpr uint32_t file_magic = 0x50414e53; // "SNAP"
+	constexpr uint32_t file_version = 1;
+	constexpr size_t alignment = 64;
+	constexpr uint32_t leaf_size = 4; // 叶子节点中最多的三角形数
+
+	inline size_t align(size_t offset) {
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	struct slot_header {
+		uint32_t material_index; // mesh_description::materials中的序号
+		uint32_t reserved;
+		uint64_t face_begin, face_num;
+		uint64_t node_begin, node_num;
+	};
+
+	// 内存中的快照数据，写入文件失败时直接使用
+	struct snapshot_buffers {
+		vector<triangle_data> faces;
+		vector<snapshot_node> nodes;
+	};
+
+	// 文件内容的哈希，每次处理8字节
+	inline bool hash_file(const string& path, uint64_t& hash) {
+		mapped_file file;
+		hash = 0x9e3779b97f4a7c15ULL;
+		if (not file.open(path)) {
+			std::error_code ec;
+			return std::filesystem::is_regular_file(path, ec) and std::filesystem::file_size(path, ec) == 0;
+		}
+		size_t word_num = file.size / 8;
+		for (size_t i = 0; i < word_num; i++) {
+			uint64_t word;
+			memcpy(&word, file.data + i * 8, 8);
+			hash = (hash ^ word) * 0x100000001b3ULL;
+			hash ^= hash >> 32;
+		}
+		for (size_t i = word_num * 8; i < file.size; i++) hash = (hash ^ file.data[i]) * 0x100000001b3ULL;
+		hash ^= file.size;
+		return true;
+	}
+
+	// 网格快照的键：网格的描述、所有文件的哈希与材质的描述
+	// 材质的描述不稳定时返回false
+	inline bool snapshot_key(const mesh_triangle& mesh, mesh_description& desc, string& key) {
+		if (not mesh.describe(desc)) return false;
+		std::ostringstream out;
+		out << typeid(mesh).name() << '|' << desc.params.str() << '\n';
+		vector<string> files = desc.files;
+		for (const auto& item : desc.materials) {
+			string material_description;
+			vector<string> material_files;
+			if (item.second and not scene_resources.describe(item.second.get(), material_description, material_files)) return false;
+			out << item.first << '=' << material_description << '\n';
+			files.insert(files.end(), material_files.begin(), material_files.end());
+		}
+		for (const string& file : files) {
+			uint64_t hash;
+			if (not hash_file(file, hash)) return false;
+			char text[32];
+			snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+			out << file << ':' << text << '\n';
+		}
+		key = out.str();
+		return true;
+	}
+
+	// 快照文件名为键的FNV-1a哈希，键本身记录在文件中用于校验
+	inline string snapshot_path(const string& key) {
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		for (char c : key) {
+			hash ^= static_cast<uint8_t>(c);
+			hash *= 0x100000001b3ULL;
+		}
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.snapshot", static_cast<unsigned long long>(hash));
+		return (std::filesystem::path(scene_snapshot_dir) / name).string();
+	}
+
+	// 为faces[begin, end)构建bvh，order为三角形的顺序，返回节点编号
+	// 按包围盒中心最长的轴在中位数处分割
+	inline uint32_t build_nodes(vector<uint32_t>& order, size_t begin, size_t end,
+		const vector<bounds3>& face_bounds, const vector<vec3>& centroids, vector<snapshot_node>& nodes) {
+		uint32_t node_index = static_cast<uint32_t>(nodes.size());
+		nodes.emplace_back();
+
+		bounds3 box;
+		bounds3 centroid_box;
+		for (size_t i = begin; i < end; i++) {
+			box = Union(box, face_bounds[order[i]]);
+			centroid_box = Union(centroid_box, centroids[order[i]]);
+		}
+		nodes[node_index].box = box;
+		nodes[node_index].reserved = 0;
+
+		if (end - begin <= leaf_size) {
+			nodes[node_index].offset = static_cast<uint32_t>(begin);
+			nodes[node_index].count = static_cast<uint32_t>(end - begin);
+			nodes[node_index].axis = 0;
+			return node_index;
+		}
+
+		vec3 extent = centroid_box.Diagnal();
+		int axis = 0;
+		if (extent[1] > extent[axis]) axis = 1;
+		if (extent[2] > extent[axis]) axis = 2;
+		size_t mid = (begin + end) / 2;
+		std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](uint32_t a, uint32_t b) {
+			return centroids[a][axis] < centroids[b][axis];
+		});
+
+		build_nodes(order, begin, mid, face_bounds, centroids, nodes);
+		uint32_t right = build_nodes(order, mid, end, face_bounds, centroids, nodes);
+		nodes[node_index].offset = right;
+		nodes[node_index].count = 0;
+		nodes[node_index].axis = static_cast<uint32_t>(axis);
+		return node_index;
+	}
+
+	// 检查一个材质的bvh节点，保证遍历不会越界
+	// 子节点的编号大于父节点（不会成环），深度不超过遍历栈的大小，叶子节点的三角形在该材质的范围内
+	inline bool valid_nodes(const snapshot_node* nodes, uint64_t node_num, uint64_t face_num) {
+		constexpr uint32_t max_depth = 64;
+		vector<uint8_t> depth(node_num, 0);
+		for (uint64_t i = 0; i < node_num; i++) {
+			const snapshot_node& node = nodes[i];
+			if (node.count == 0) {
+				if (node.axis > 2 or node.offset <= i + 1 or node.offset >= node_num) return false;
+				if (depth[i] + 1u >= max_depth) return false;
+				depth[i + 1] = std::max<uint8_t>(depth[i + 1], depth[i] + 1);
+				depth[node.offset] = std::max<uint8_t>(depth[node.offset], depth[i] + 1);
+			}
+			else if (node.count > leaf_size or node.offset + static_cast<uint64_t>(node.count) > face_num) return false;
+		}
+		return true;
+	}
+
+	// 由snapshot_buffers或映射的文件生成各材质的snapshot_mesh
+	inline void create_meshes(shared_ptr<const void> owner, const triangle_data* faces, const snapshot_node* nodes,
+		const vector<slot_header>& slots, const mesh_description& desc, vector<shared_ptr<hittable>>& objects) {
+		for (const slot_header& slot : slots) {
+			objects.push_back(make_shared<snapshot_mesh>(owner, faces + slot.face_begin, slot.face_num, nodes + slot.node_begin, desc.materials[slot.material_index].second));
+		}
+	}
+
+	// 从快照文件读取
+	// 文件内容不完全可信（其它版本或损坏的文件），除文件头与键外还检查各项数量与bvh节点
+	inline bool load(const string& path, const string& key, const mesh_description& desc, vector<shared_ptr<hittable>>& objects) {
+		shared_ptr<mapped_file> file = make_shared<mapped_file>();
+		if (not file->open(path)) return false;
+
+		const uint8_t* p = file->data;
+		size_t size = file->size;
+		uint32_t header[4];
+		uint64_t counts[2];
+		if (size < sizeof(header) + sizeof(counts)) return false;
+		memcpy(header, p, sizeof(header));
+		memcpy(counts, p + sizeof(header), sizeof(counts));
+		size_t offset = sizeof(header) + sizeof(counts);
+		if (header[0] != file_magic or header[1] != file_version or header[3] != key.size()) return false;
+		if (size < offset + key.size() or memcmp(p + offset, key.data(), key.size()) != 0) return false;
+		offset += key.size();
+
+		uint32_t slot_num = header[2];
+		if (slot_num == 0 or size < offset + static_cast<size_t>(slot_num) * sizeof(slot_header)) return false;
+		vector<slot_header> slots(slot_num);
+		memcpy(slots.data(), p + offset, slot_num * sizeof(slot_header));
+		offset = align(offset + slot_num * sizeof(slot_header));
+
+		// 文件长度必须与三角形数、节点数一致（先检查数量，计算时不会溢出）
+		if (counts[0] > size / sizeof(triangle_data) or counts[1] > size / sizeof(snapshot_node)) return false;
+		size_t face_offset = offset;
+		size_t node_offset = align(face_offset + counts[0] * sizeof(triangle_data));
+		if (node_offset + counts[1] * sizeof(snapshot_node) != size) return false;
+
+		const triangle_data* faces = reinterpret_cast<const triangle_data*>(p + face_offset);
+		const snapshot_node* nodes = reinterpret_cast<const snapshot_node*>(p + node_offset);
+		for (const slot_header& slot : slots) {
+			if (slot.material_index >= desc.materials.size() or slot.face_num == 0 or slot.node_num == 0
+				or slot.face_begin > counts[0] or slot.face_num > counts[0] - slot.face_begin
+				or slot.node_begin > counts[1] or slot.node_num > counts[1] - slot.node_begin) return false;
+			if (not valid_nodes(nodes + slot.node_begin, slot.node_num, slot.face_num)) return false;
+		}
+
+		create_meshes(file, faces, nodes, slots, desc, objects);
+		return true;
+	}
+
+	// 写入快照文件
+	// 先写到本进程的临时文件（见unique_temp_path）再重命名，多个进程同时生成同一个快照时不会读到不完整的文件
+	inline bool save(const string& path, const string& key, const snapshot_buffers& buffers, const vector<slot_header>& slots) {
+		std::error_code ec;
+		std::filesystem::create_directories(scene_snapshot_dir, ec);
+		string temp_path = unique_temp_path(path);
+		std::ofstream out(temp_path, std::ios::binary);
+		if (not out) return false;
+
+		uint32_t header[4] = { file_magic, file_version, static_cast<uint32_t>(slots.size()), static_cast<uint32_t>(key.size()) };
+		uint64_t counts[2] = { buffers.faces.size(), buffers.nodes.size() };
+		out.write(reinterpret_cast<const char*>(header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+		out.write(key.data(), key.size());
+		out.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(slot_header));
+
+		static const char padding[alignment] = {};
+		out.write(padding, align(static_cast<size_t>(out.tellp())) - static_cast<size_t>(out.tellp()));
+		out.write(reinterpret_cast<const char*>(buffers.faces.data()), buffers.faces.size() * sizeof(triangle_data));
+		out.write(padding, align(static_cast<size_t>(out.tellp())) - static_cast<size_t>(out.tellp()));
+		out.write(reinterpret_cast<const char*>(buffers.nodes.data()), buffers.nodes.size() * sizeof(snapshot_node));
+		out.close();
+		bool ok = static_cast<bool>(out); // 包括关闭时写入缓冲区失败
+
+		if (ok) std::filesystem::rename(temp_path, path, ec);
+		if (not ok or ec) {
+			std::filesystem::remove(temp_path, ec);
+			return false;
+		}
+		return true;
+	}
+}
+
+
+// 由三角形数据构建内存中的网格，结构与快照相同，只是不写入文件
+// 纹理还在加载的三角形的微图推迟生成（不等待图像解码），finish_micromaps设为生成它们的函数，需要在渲染前调用；没有推迟时为空
+// faces按bvh的顺序原地重排（大的网格不复制一份三角形数据），为空时返回nullptr
+inline shared_ptr<hittable> make_flat_mesh(vector<triangle_data> faces, const shared_ptr<material>& mat_ptr, std::function<void()>& finish_micromaps) {
+	using namespace snapshot_detail;
+	finish_micromaps = nullptr;
+	if (faces.empty()) return nullptr;
+
+	vector<uint32_t> order(faces.size());
+	std::iota(order.begin(), order.end(), 0);
+	vector<bounds3> face_bounds(faces.size());
+	vector<vec3> centroids(faces.size());
+	for (size_t i = 0; i < faces.size(); i++) {
+		face_bounds[i] = triangle_bounds(faces[i]);
+		centroids[i] = (face_bounds[i].pMin + face_bounds[i].pMax) / 2;
+	}
+	shared_ptr<snapshot_buffers> buffers = make_shared<snapshot_buffers>();
+	build_nodes(order, 0, order.size(), face_bounds, centroids, buffers->nodes);
+
+	face_bounds.clear();
+	face_bounds.shrink_to_fit();
+	centroids.clear();
+	centroids.shrink_to_fit();
+
+	// 按环移动，使第k个三角形为原来的第order[k]个
+	buffers->faces = std::move(faces);
+	vector<triangle_data>& sorted = buffers->faces;
+	for (uint32_t start = 0; start < order.size(); start++) {
+		if (order[start] == start) continue;
+		triangle_data moved = sorted[start];
+		uint32_t k = start;
+		while (order[k] != start) {
+			uint32_t next = order[k];
+			sorted[k] = sorted[next];
+			order[k] = k;
+			k = next;
+		}
+		sorted[k] = moved;
+		order[k] = k;
+	}
+
+	vector<uint32_t> pending;
+	for (uint32_t i = 0; i < sorted.size(); i++) {
+		if (init_opacity_micromap(sorted[i], mat_ptr.get())) pending.push_back(i);
+	}
+	if (not pending.empty()) {
+		finish_micromaps = [buffers, pending, mat_ptr]() {
+			for (uint32_t i : pending) build_opacity_micromap(buffers->faces[i], mat_ptr.get());
+		};
+	}
+	return make_shared<snapshot_mesh>(buffers, buffers->faces.data(), buffers->faces.size(), buffers->nodes.data(), mat_ptr);
+}
+
+
+// 读取网格的快照，没有可用的快照时展开网格，生成并写入快照
+// 成功时objects中为各材质的snapshot_mesh；网格不需要快照或材质的描述不稳定时返回false，由调用者直接展开网格
+// 三角形使用了描述中没有的材质时不生成快照，objects中为展开的三角形
+inline bool load_mesh_snapshot(const mesh_triangle& mesh, vector<shared_ptr<hittable>>& objects) {
+	using namespace snapshot_detail;
+	if (not use_scene_snapshot) return false;
+
+	mesh_description desc;
+	string key;
+	if (not snapshot_key(mesh, desc, key)) return false;
+	string path = snapshot_path(key);
+	if (load(path, key, desc, objects)) {
+		std::cout << "mesh snapshot loaded: " << path << '\n';
+		return true;
+	}
+
+	// 展开网格，三角形按材质分组。快照中保存完整的微图，纹理还在加载时在这里等待（只在生成快照时发生）
+	auto find_slot = [&](const material* mat_ptr) {
+		size_t slot = 0;
+		while (slot < desc.materials.size() and desc.materials[slot].second.get() != mat_ptr) slot++;
+		return slot;
+	};
+	vector<triangle_data> faces;
+	vector<uint32_t> face_slots;
+	shared_ptr<material> faces_mat_ptr;
+	if (mesh.unpack_faces(faces, faces_mat_ptr)) {
+		size_t slot = find_slot(faces_mat_ptr.get());
+		if (slot == desc.materials.size()) { // 使用了描述中没有的材质，不生成快照
+			std::function<void()> finish_micromaps;
+			shared_ptr<hittable> flat_mesh = make_flat_mesh(std::move(faces), faces_mat_ptr, finish_micromaps);
+			if (finish_micromaps) finish_micromaps();
+			if (flat_mesh) objects.push_back(flat_mesh);
+			return true;
+		}
+		for (triangle_data& face : faces) {
+			if (init_opacity_micromap(face, faces_mat_ptr.get())) build_opacity_micromap(face, faces_mat_ptr.get());
+		}
+		face_slots.assign(faces.size(), static_cast<uint32_t>(slot));
+	}
+	else {
+		vector<shared_ptr<triangle>> triangle_ptr_list = mesh.unpack();
+		faces.reserve(triangle_ptr_list.size());
+		for (const shared_ptr<triangle>& triangle_ptr : triangle_ptr_list) {
+			size_t slot = find_slot(triangle_ptr->get_material());
+			if (slot == desc.materials.size()) {
+				objects.assign(triangle_ptr_list.begin(), triangle_ptr_list.end());
+				return true;
+			}
+			if (triangle_ptr->omm_pending) triangle_ptr->build_opacity_micromap();
+			faces.push_back(*triangle_ptr);
+			face_slots.push_back(static_cast<uint32_t>(slot));
+		}
+	}
+	vector<vector<uint32_t>> faces_by_slot(desc.materials.size());
+	for (uint32_t i = 0; i < faces.size(); i++) faces_by_slot[face_slots[i]].push_back(i);
+
+	// 每个材质构建一个bvh
+	shared_ptr<snapshot_buffers> buffers = make_shared<snapshot_buffers>();
+	buffers->faces.reserve(faces.size());
+	vector<slot_header> slots;
+	vector<bounds3> face_bounds(faces.size());
+	vector<vec3> centroids(faces.size());
+	for (size_t i = 0; i < faces.size(); i++) {
+		face_bounds[i] = triangle_bounds(faces[i]);
+		centroids[i] = (face_bounds[i].pMin + face_bounds[i].pMax) / 2;
+	}
+	for (uint32_t slot = 0; slot < faces_by_slot.size(); slot++) {
+		vector<uint32_t>& order = faces_by_slot[slot];
+		if (order.empty()) continue;
+		slot_header header = { slot, 0, buffers->faces.size(), order.size(), buffers->nodes.size(), 0 };
+		vector<snapshot_node> nodes;
+		build_nodes(order, 0, order.size(), face_bounds, centroids, nodes);
+		header.node_num = nodes.size();
+		for (uint32_t i : order) buffers->faces.push_back(faces[i]);
+		buffers->nodes.insert(buffers->nodes.end(), nodes.begin(), nodes.end());
+		slots.push_back(header);
+	}
+	faces.clear();
+	if (slots.empty()) return true;
+
+	if (save(path, key, *buffers, slots)) {
+		std::cout << "mesh snapshot saved: " << path << '\n';
+		if (load(path, key, desc, objects)) return true;
+	}
+	create_meshes(buffers, buffers->faces.data(), buffers->nodes.data(), slots, desc, objects);
+	return true;
+}
+
+#endif
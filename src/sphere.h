@@ -1,59 +1,68 @@
-#pragma once
-#ifndef SPHERE_H
-#define SPHERE_H
-
-#include "hittable.h"
-#include "vec3.h"
-
-class sphere : public hittable {
-public:
-	point3 center;
-	double radius;
-	shared_ptr<material> mat_ptr;
-
-public:
-	sphere() {}
-	sphere(point3 cen, double r, shared_ptr<material> m) : center(cen), radius(r), mat_ptr(m){};
-
-	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override {
-		// t
-		vec3 oc = r.origin() - center;
-		auto a = r.direction().length_squared();
-		auto half_b = dot(oc, r.direction());
-		auto c = oc.length_squared() - radius * radius;
-
-		auto discriminant = half_b * half_b - a * c;
-		// бʽС޽
-		if (discriminant < 0) return false;
-		auto sqrtd = sqrt(discriminant);
-
-		// Find the nearest root that lies in the acceptable range.
-		// עĲaԽСtֱӼ
-		// Сtô֤ϴtΪڲ
-		auto root = (-half_b - sqrtd) / a;
-		if (root < t_min || t_max < root) {
-			root = (-half_b + sqrtd) / a;
-			if (root < t_min || t_max < root)
-				return false;
-		}
-
-		rec.t = root;
-		rec.p = r.at(rec.t);
-		rec.mat_ptr = mat_ptr;
-
-		// ȼķߣٸrayķǷҪ
-		vec3 outward_normal = (rec.p - center) / radius;
-		rec.set_face_normal(r, outward_normal);
-
-		rec.uv = vec3(0, 0, 0); // ʱδ
-
-		return true;
-	}
-
-	virtual bounds3 bounds() const override {
-		vec3 tmp_vec(radius, radius, radius);
-		return bounds3(center + tmp_vec, center - tmp_vec);
-	}
-};
-
+#pragma once
+#ifndef SPHERE_H
+#define SPHERE_H
+
+#include "hittable.h"
+#include "vec3.h"
+
+class sphere : public hittable {
+public:
+	point3 center;
+	double radius;
+	uint32_t mat_id = 0; // 材质编号
+	uint32_t prim_id = 0; // 图元编号
+
+public:
+	sphere() {}
+	sphere(point3 cen, double r, shared_ptr<material> m) : center(cen), radius(r), mat_id(scene_materials.add(m)), prim_id(new_primitive_id()){};
+
+	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override {
+		// 计算t
+		vec3 oc = r.origin() - center;
+		auto a = r.direction().length_squared();
+		auto half_b = dot(oc, r.direction());
+		auto c = oc.length_squared() - radius * radius;
+
+		auto discriminant = half_b * half_b - a * c;
+		// 如果判别式小于零则无交点
+		if (discriminant < 0) return false;
+		auto sqrtd = sqrt(discriminant);
+
+		// Find the nearest root that lies in the acceptable range.
+		// 注意这里的参数a恒正，所以较小的t可以直接计算
+		// 如果较小的t不符合条件，那么再验证较大的t（发生这种情况可能是因为相机在求内部）
+		auto root = (-half_b - sqrtd) / a;
+		if (root < t_min || t_max < root) {
+			root = (-half_b + sqrtd) / a;
+			if (root < t_min || t_max < root)
+				return false;
+		}
+
+		rec.t = root;
+		rec.p = r.at(rec.t);
+		rec.mat_id = mat_id;
+		rec.prim_id = prim_id;
+
+		// 先计算出向外的法线，再根据ray的方向决定法线是否需要反向
+		vec3 outward_normal = (rec.p - center) / radius;
+		rec.set_face_normal(r, outward_normal);
+
+		rec.uv = vec3(0, 0, 0); // 暂时未启用
+		rec.tangent = vec3(0, 0, 0);
+		rec.uv_density = 0;
+		rec.alpha_resolved = false;
+
+		return true;
+	}
+
+	virtual material* get_material() const override {
+		return scene_materials.get(mat_id);
+	}
+
+	virtual bounds3 bounds() const override {
+		vec3 tmp_vec(radius, radius, radius);
+		return bounds3(center + tmp_vec, center - tmp_vec);
+	}
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+#ifndef SSS_PROFILE_H
+#define SSS_PROFILE_H
+
+#include <vector>
+#include <algorithm>
+#include "global.h"
+
+using std::vector;
+
+
+// 扩散剖面类型
+enum class sss_profile_type {
+	gaussian, // 二维高斯分布，与之前的实现相同
+	burley // Burley normalized diffusion
+};
+
+
+// 扩散剖面表
+// 对单位尺度的剖面R(r)（满足 ∫R(r) 2πr dr = 1）在[0, r_max]上分段，保存径向pdf p(r) = 2πr R(r)的CDF
+// 采样与求值都使用分段常数的p(r)，两者完全一致
+// 尺度为d的剖面通过缩放得到：R_d(r) = R(r / d) / d^2
+class sss_profile_table {
+public:
+	sss_profile_type type;
+	double r_max; // 截断半径，截断处CDF约为0.999
+	int segment_num;
+
+private:
+	double dr;
+	vector<double> cdf; // 长度为segment_num + 1
+
+public:
+	sss_profile_table(sss_profile_type type_init = sss_profile_type::burley, int segment_num_init = 512) {
+		type = type_init;
+		segment_num = segment_num_init;
+		r_max = type == sss_profile_type::gaussian ? 3.72 : 20.0;
+		dr = r_max / segment_num;
+
+		// 梯形积分得到CDF，然后归一化
+		cdf.assign(segment_num + 1, 0);
+		for (int i = 0; i < segment_num; i++) {
+			cdf[i + 1] = cdf[i] + 0.5 * (radial(i * dr) + radial((i + 1) * dr)) * dr;
+		}
+		double total = cdf[segment_num];
+		for (double& c : cdf) c /= total;
+	}
+
+	// 单位尺度剖面的径向分布（未归一化）
+	double radial(double r) const {
+		if (type == sss_profile_type::gaussian) return r * exp(-0.5 * r * r);
+		return 0.25 * (exp(-r) + exp(-r / 3));
+	}
+
+	// 按径向pdf采样半径
+	double sample(double u) const {
+		int i = static_cast<int>(std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin()) - 1;
+		i = std::max(0, std::min(i, segment_num - 1));
+		double width = cdf[i + 1] - cdf[i];
+		double t = width > 0 ? (u - cdf[i]) / width : 0.5;
+		return (i + t) * dr;
+	}
+
+	// 径向pdf
+	double pdf(double r) const {
+		if (r < 0 or r >= r_max) return 0;
+		int i = std::min(static_cast<int>(r / dr), segment_num - 1);
+		return (cdf[i + 1] - cdf[i]) / dr;
+	}
+
+	// 尺度为d时平面上的二维pdf，即R_d(r)
+	double eval(double r, double d) const {
+		// r趋近0时R(r)发散，在第一段的中点处截断
+		r = std::max(r, 0.5 * dr * d);
+		return pdf(r / d) / d * pi2_inv / r;
+	}
+};
+
+#endif
@@ -0,0 +1,171 @@
+#pragma once
+#ifndef TEXEL_CACHE_H
+#define TEXEL_CACHE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <filesystem>
+#include "global.h"
+#include "texel_image.h"
+#include "mapped_file.h"
+
+// 解码后texel的磁盘缓存
+// 纹理构造时需要解码jpg/png、做gamma转换、生成mipmap、压缩或单位化法线，每次运行都重复这些工作很慢
+// 这里把处理完成的texel_image写入缓存文件，下次直接把文件映射到内存，texel_image引用映射的数据，不再复制
+// 缓存按图像路径与加载参数区分，文件中记录图像的修改时间，图像被修改后缓存失效并重新生成
+//
+// 缓存文件格式：
+// 文件头{magic, version, 层级数, 参数字符串长度}，图像修改时间（int64），参数字符串（图像路径 + 加载参数）
+// 每个层级{行数, 列数, 格式, 保留}以及数据在文件中的位置（uint64）
+// 之后是各层级的数据，每层按64字节对齐
+
+// 是否使用缓存
+bool use_texel_cache = true;
+// 缓存文件所在的目录
+const char* texel_cache_dir = "texel_cache";
+
+
+namespace texel_cache_detail {
+	constexpr uint32_t file_magic = 0x4c584554; // "TEXL"
+	constexpr uint32_t file_version = 1;
+	constexpr size_t alignment = 64;
+
+	inline size_t align(size_t offset) {
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	// 缓存的键：图像路径与加载参数
+	inline std::string cache_key(const char* file_name, const std::string& params) {
+		std::error_code ec;
+		std::filesystem::path path = std::filesystem::absolute(file_name, ec);
+		return (ec ? std::string(file_name) : path.generic_string()) + '|' + params;
+	}
+
+	// 缓存文件名为键的FNV-1a哈希，键本身记录在文件中用于校验
+	inline std::string cache_path(const std::string& key) {
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		for (char c : key) {
+			hash ^= static_cast<uint8_t>(c);
+			hash *= 0x100000001b3ULL;
+		}
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.texels", static_cast<unsigned long long>(hash));
+		return (std::filesystem::path(texel_cache_dir) / name).string();
+	}
+
+	// 图像的修改时间，图像不存在时返回false
+	inline bool image_time(const char* file_name, int64_t& time) {
+		std::error_code ec;
+		auto t = std::filesystem::last_write_time(file_name, ec);
+		if (ec) return false;
+		time = static_cast<int64_t>(t.time_since_epoch().count());
+		return true;
+	}
+
+	struct level_header {
+		int32_t rows, cols;
+		uint32_t format, reserved;
+		uint64_t offset;
+	};
+
+	// 检查层级的描述是否有效：格式是已知的枚举值，尺寸为正，数据对齐且在文件之内（不信任文件中的数值，计算时不会溢出）
+	inline bool valid_level(const level_header& level, size_t data_begin, size_t file_size) {
+		if (level.format > static_cast<uint32_t>(texel_format::r8)) return false;
+		if (level.rows <= 0 or level.cols <= 0 or level.rows > (1 << 20) or level.cols > (1 << 20)) return false;
+		if (level.offset % alignment != 0 or level.offset < data_begin or level.offset > file_size) return false;
+		return texel_image::storage_size(level.rows, level.cols, static_cast<texel_format>(level.format)) <= file_size - level.offset;
+	}
+}
+
+
+// 从缓存读取图像file_name以参数params加载得到的各层级
+// 成功时levels中的图像直接引用映射的文件
+inline bool load_texel_cache(const char* file_name, const std::string& params, std::vector<texel_image>& levels) {
+	using namespace texel_cache_detail;
+	if (not use_texel_cache) return false;
+	int64_t time;
+	if (not image_time(file_name, time)) return false;
+	std::string key = cache_key(file_name, params);
+
+	shared_ptr<mapped_file> file = make_shared<mapped_file>();
+	if (not file->open(cache_path(key))) return false;
+
+	// 校验文件头
+	const uint8_t* p = file->data;
+	size_t size = file->size;
+	uint32_t header[4];
+	int64_t cached_time;
+	if (size < sizeof(header) + sizeof(cached_time)) return false;
+	memcpy(header, p, sizeof(header));
+	memcpy(&cached_time, p + sizeof(header), sizeof(cached_time));
+	size_t offset = sizeof(header) + sizeof(cached_time);
+	if (header[0] != file_magic or header[1] != file_version or cached_time != time or header[3] != key.size()) return false;
+	if (size < offset + key.size() or memcmp(p + offset, key.data(), key.size()) != 0) return false;
+	offset += key.size();
+
+	uint32_t level_num = header[2];
+	if (level_num == 0 or level_num > 32 or size < offset + level_num * sizeof(level_header)) return false;
+	size_t data_begin = offset + level_num * sizeof(level_header);
+	std::vector<texel_image> result(level_num);
+	size_t data_end = 0;
+	for (uint32_t i = 0; i < level_num; i++) {
+		level_header level;
+		memcpy(&level, p + offset + i * sizeof(level_header), sizeof(level_header));
+		if (not valid_level(level, data_begin, size)) return false;
+		texel_format format = static_cast<texel_format>(level.format);
+		size_t level_size = texel_image::storage_size(level.rows, level.cols, format);
+		if (level.offset < data_end) return false; // 各层级依次存放，不能重叠
+		data_end = level.offset + level_size;
+		result[i].view(p + level.offset, level.rows, level.cols, format, file);
+	}
+	if (data_end != size) return false; // 文件长度与各层级的数据量一致
+	levels = std::move(result);
+	return true;
+}
+
+// 把各层级写入缓存
+// 先写到本线程的临时文件（见unique_temp_path）再重命名，其它线程、进程不会读到不完整的缓存
+inline void save_texel_cache(const char* file_name, const std::string& params, const std::vector<texel_image>& levels) {
+	using namespace texel_cache_detail;
+	if (not use_texel_cache) return;
+	int64_t time;
+	if (not image_time(file_name, time)) return;
+	std::string key = cache_key(file_name, params);
+	std::string path = cache_path(key);
+
+	std::error_code ec;
+	std::filesystem::create_directories(texel_cache_dir, ec);
+	std::string temp_path = unique_temp_path(path);
+	std::ofstream out(temp_path, std::ios::binary);
+	if (not out) return;
+
+	uint32_t header[4] = { file_magic, file_version, static_cast<uint32_t>(levels.size()), static_cast<uint32_t>(key.size()) };
+	out.write(reinterpret_cast<const char*>(header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(&time), sizeof(time));
+	out.write(key.data(), key.size());
+
+	size_t offset = align(sizeof(header) + sizeof(time) + key.size() + levels.size() * sizeof(level_header));
+	for (const texel_image& image : levels) {
+		level_header level = { image.rows, image.cols, static_cast<uint32_t>(image.format), 0, offset };
+		out.write(reinterpret_cast<const char*>(&level), sizeof(level));
+		offset = align(offset + image.memory_size());
+	}
+
+	static const char padding[alignment] = {};
+	for (const texel_image& image : levels) {
+		out.write(padding, align(static_cast<size_t>(out.tellp())) - static_cast<size_t>(out.tellp()));
+		out.write(reinterpret_cast<const char*>(image.bytes()), image.memory_size());
+	}
+	out.close();
+	if (not out) { // 写入失败（如磁盘已满），不使用不完整的文件
+		std::filesystem::remove(temp_path, ec);
+		return;
+	}
+
+	std::filesystem::rename(temp_path, path, ec);
+	if (ec) std::filesystem::remove(temp_path, ec);
+}
+
+#endif
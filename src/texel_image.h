@@ -0,0 +1,495 @@
+#pragma once
+#ifndef TEXEL_IMAGE_H
+#define TEXEL_IMAGE_H
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <memory>
+#include <new>
+#include <algorithm>
+#include "vec3.h"
+
+
+// 纹理像素（texel）的存储格式
+enum class texel_format {
+	rgba8, // 每通道8位，RGB在采样时通过查找表解码到线性空间，4字节/texel
+	rgba16f, // 每通道半精度浮点，用于HDR图像，8字节/texel
+	bc1, // 4x4块压缩的RGB（无alpha），0.5字节/texel
+	rg8_octahedral, // 法线，八面体编码到两个8位分量，2字节/texel
+	bc5, // 法线，切线空间x、y两个通道的4x4块压缩，z由单位长度恢复，1字节/texel
+	r8 // 单通道8位，1字节/texel
+};
+
+// 格式的名字，用于缓存文件名
+inline const char* texel_format_name(texel_format format) {
+	switch (format) {
+	case texel_format::rgba8: return "rgba8";
+	case texel_format::rgba16f: return "rgba16f";
+	case texel_format::bc1: return "bc1";
+	case texel_format::rg8_octahedral: return "rg8_octahedral";
+	case texel_format::bc5: return "bc5";
+	case texel_format::r8: return "r8";
+	default: return "unknown";
+	}
+}
+
+
+// 半精度浮点与单精度浮点的转换
+inline uint16_t float_to_half(float f) {
+	uint32_t x;
+	std::memcpy(&x, &f, sizeof(x));
+	uint32_t sign = (x >> 16) & 0x8000;
+	uint32_t exp_f = (x >> 23) & 0xff;
+	uint32_t mant = x & 0x7fffff;
+	if (exp_f == 0xff) return static_cast<uint16_t>(sign | 0x7c00 | (mant ? 0x200 : 0)); // inf与nan
+	int exp = static_cast<int>(exp_f) - 127 + 15;
+	if (exp >= 31) return static_cast<uint16_t>(sign | 0x7c00); // 上溢为inf
+	if (exp <= 0) {
+		// 非规格化数
+		if (exp < -10) return static_cast<uint16_t>(sign);
+		mant |= 0x800000;
+		uint32_t shift = static_cast<uint32_t>(14 - exp);
+		uint32_t h = mant >> shift;
+		uint32_t rest = mant & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway or (rest == halfway and (h & 1))) h++; // 舍入到最近的偶数
+		return static_cast<uint16_t>(sign | h);
+	}
+	uint32_t h = sign | (static_cast<uint32_t>(exp) << 10) | (mant >> 13);
+	uint32_t rest = mant & 0x1fff;
+	if (rest > 0x1000 or (rest == 0x1000 and (h & 1))) h++; // 进位可能进入指数位，结果仍然正确
+	return static_cast<uint16_t>(h);
+}
+
+inline float half_to_float(uint16_t h) {
+	uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+	uint32_t exp = (h >> 10) & 0x1f;
+	uint32_t mant = h & 0x3ff;
+	uint32_t x;
+	if (exp == 0) {
+		if (mant == 0) {
+			x = sign;
+		}
+		else {
+			// 非规格化数，规格化之后再转换
+			exp = 127 - 15 + 1;
+			while ((mant & 0x400) == 0) {
+				mant <<= 1;
+				exp--;
+			}
+			mant &= 0x3ff;
+			x = sign | (exp << 23) | (mant << 13);
+		}
+	}
+	else if (exp == 31) {
+		x = sign | 0x7f800000 | (mant << 13);
+	}
+	else {
+		x = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+	}
+	float f;
+	std::memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+
+// 8位颜色值到线性空间的查找表，与原来的转换方式相同：pow(v / 255, 2.2)
+struct gamma_decode_table {
+	double value[256];
+
+	gamma_decode_table() {
+		for (int i = 0; i < 256; i++) value[i] = pow(i / 255.0, 2.2);
+	}
+};
+
+inline const gamma_decode_table& gamma_decode() {
+	static gamma_decode_table table;
+	return table;
+}
+
+
+// 单位向量的八面体编码，每个分量映射到8位
+inline void encode_octahedral(const vec3& n, uint8_t& u, uint8_t& v) {
+	double l1 = fabs(n.x()) + fabs(n.y()) + fabs(n.z());
+	double x = l1 > 0 ? n.x() / l1 : 0;
+	double y = l1 > 0 ? n.y() / l1 : 0;
+	if (n.z() < 0) {
+		double x_fold = (1 - fabs(y)) * (x >= 0 ? 1 : -1);
+		double y_fold = (1 - fabs(x)) * (y >= 0 ? 1 : -1);
+		x = x_fold;
+		y = y_fold;
+	}
+	u = static_cast<uint8_t>(std::lround((x * 0.5 + 0.5) * 255));
+	v = static_cast<uint8_t>(std::lround((y * 0.5 + 0.5) * 255));
+}
+
+inline vec3 decode_octahedral(uint8_t u, uint8_t v) {
+	double x = u / 255.0 * 2 - 1;
+	double y = v / 255.0 * 2 - 1;
+	double z = 1 - fabs(x) - fabs(y);
+	if (z < 0) {
+		double x_fold = (1 - fabs(y)) * (x >= 0 ? 1 : -1);
+		double y_fold = (1 - fabs(x)) * (y >= 0 ? 1 : -1);
+		x = x_fold;
+		y = y_fold;
+	}
+	return unit_vector(vec3(x, y, z));
+}
+
+
+// BC1块（8字节）：两个RGB565端点与16个2位索引
+// 参考 van Waveren 2006, Real-Time DXT Compression，端点取包围盒的一条对角线
+inline uint16_t pack_565(const int c[3]) {
+	int r = (c[0] * 31 + 127) / 255;
+	int g = (c[1] * 63 + 127) / 255;
+	int b = (c[2] * 31 + 127) / 255;
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+inline void unpack_565(uint16_t p, int c[3]) {
+	int r = (p >> 11) & 31, g = (p >> 5) & 63, b = p & 31;
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+// block为4x4个RGB值（按行存放，每个texel 3字节），输出8字节
+inline void encode_bc1_block(const uint8_t block[48], uint8_t out[8]) {
+	int min_c[3] = { 255, 255, 255 }, max_c[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++) {
+		for (int k = 0; k < 3; k++) {
+			min_c[k] = std::min(min_c[k], static_cast<int>(block[i * 3 + k]));
+			max_c[k] = std::max(max_c[k], static_cast<int>(block[i * 3 + k]));
+		}
+	}
+
+	// 根据绿色通道与其他通道的协方差符号选择包围盒的对角线
+	double center[3];
+	for (int k = 0; k < 3; k++) center[k] = 0.5 * (min_c[k] + max_c[k]);
+	double cov_rg = 0, cov_bg = 0;
+	for (int i = 0; i < 16; i++) {
+		double g = block[i * 3 + 1] - center[1];
+		cov_rg += (block[i * 3 + 0] - center[0]) * g;
+		cov_bg += (block[i * 3 + 2] - center[2]) * g;
+	}
+	if (cov_rg < 0) std::swap(min_c[0], max_c[0]);
+	if (cov_bg < 0) std::swap(min_c[2], max_c[2]);
+
+	uint16_t c0 = pack_565(max_c);
+	uint16_t c1 = pack_565(min_c);
+	uint32_t indices = 0;
+	if (c0 < c1) std::swap(c0, c1); // c0 > c1时为4色模式
+	if (c0 != c1) {
+		int p[4][3];
+		unpack_565(c0, p[0]);
+		unpack_565(c1, p[1]);
+		for (int k = 0; k < 3; k++) {
+			p[2][k] = (2 * p[0][k] + p[1][k]) / 3;
+			p[3][k] = (p[0][k] + 2 * p[1][k]) / 3;
+		}
+		for (int i = 0; i < 16; i++) {
+			int best = 0, best_d = INT32_MAX;
+			for (int j = 0; j < 4; j++) {
+				int d = 0;
+				for (int k = 0; k < 3; k++) d += (block[i * 3 + k] - p[j][k]) * (block[i * 3 + k] - p[j][k]);
+				if (d < best_d) {
+					best_d = d;
+					best = j;
+				}
+			}
+			indices |= static_cast<uint32_t>(best) << (2 * i);
+		}
+	}
+	std::memcpy(out, &c0, 2);
+	std::memcpy(out + 2, &c1, 2);
+	std::memcpy(out + 4, &indices, 4);
+}
+
+// 只解码块中第i个texel，c为8位RGB
+inline void decode_bc1_texel(const uint8_t block[8], int i, int c[3]) {
+	uint16_t c0, c1;
+	uint32_t indices;
+	std::memcpy(&c0, block, 2);
+	std::memcpy(&c1, block + 2, 2);
+	std::memcpy(&indices, block + 4, 4);
+	int index = (indices >> (2 * i)) & 3;
+	int p0[3], p1[3];
+	unpack_565(c0, p0);
+	if (index == 0) {
+		std::copy(p0, p0 + 3, c);
+		return;
+	}
+	unpack_565(c1, p1);
+	for (int k = 0; k < 3; k++) {
+		if (index == 1) c[k] = p1[k];
+		else if (c0 > c1) c[k] = index == 2 ? (2 * p0[k] + p1[k]) / 3 : (p0[k] + 2 * p1[k]) / 3;
+		else c[k] = index == 2 ? (p0[k] + p1[k]) / 2 : 0;
+	}
+}
+
+
+// BC4块（8字节）：两个8位端点与16个3位索引，e0 > e1时端点之间有6个插值
+// block为4x4个8位值，stride为相邻texel的字节间隔
+inline void encode_bc4_block(const uint8_t* block, int stride, uint8_t out[8]) {
+	int e0 = 0, e1 = 255;
+	for (int i = 0; i < 16; i++) {
+		e0 = std::max(e0, static_cast<int>(block[i * stride]));
+		e1 = std::min(e1, static_cast<int>(block[i * stride]));
+	}
+	uint64_t indices = 0;
+	if (e0 > e1) {
+		for (int i = 0; i < 16; i++) {
+			// 从e0到e1的位置，以1/7为单位
+			int s = static_cast<int>(std::lround((e0 - block[i * stride]) * 7.0 / (e0 - e1)));
+			int index = s == 0 ? 0 : (s == 7 ? 1 : s + 1);
+			indices |= static_cast<uint64_t>(index) << (3 * i);
+		}
+	}
+	out[0] = static_cast<uint8_t>(e0);
+	out[1] = static_cast<uint8_t>(e1);
+	for (int k = 0; k < 6; k++) out[2 + k] = static_cast<uint8_t>(indices >> (8 * k));
+}
+
+// 只解码块中第i个texel，返回值范围[0, 255]
+inline double decode_bc4_texel(const uint8_t block[8], int i) {
+	int e0 = block[0], e1 = block[1];
+	uint64_t indices = 0;
+	std::memcpy(&indices, block + 2, 6);
+	int index = static_cast<int>(indices >> (3 * i)) & 7;
+	if (index == 0) return e0;
+	if (index == 1) return e1;
+	if (e0 > e1) return ((8 - index) * e0 + (index - 1) * e1) / 7.0;
+	if (index == 6) return 0;
+	if (index == 7) return 255;
+	return ((6 - index) * e0 + (index - 1) * e1) / 5.0;
+}
+
+
+// 纹理图像的texel存储
+// 所有texel存放在一块64字节对齐的连续内存中，行号0为图像最下面一行
+// 块压缩格式按4x4块存放，块内按行存放，图像尺寸不是4的倍数时边缘的块用边缘texel填充
+class texel_image {
+public:
+	int rows = 0, cols = 0;
+	texel_format format = texel_format::rgba8;
+
+private:
+	struct aligned_delete {
+		void operator()(uint8_t* p) const {
+			::operator delete[](p, std::align_val_t(64));
+		}
+	};
+	std::unique_ptr<uint8_t[], aligned_delete> data;
+	const uint8_t* texels = nullptr; // 读取texel使用的数据，指向data或外部数据
+	std::shared_ptr<const void> external_owner; // 外部数据的持有者
+	size_t byte_size = 0;
+	int blocks_x = 0; // 每行的块数
+
+public:
+	// 从8位图像数据创建
+	// pixels按行存放，行号0为最下面一行，channels为通道数，通道顺序为RGB(A)
+	// rgba8、bc1为颜色；rg8_octahedral、bc5为法线，前三个通道是映射到[0, 255]的切线空间坐标；r8取各通道的平均值
+	void create(const uint8_t* pixels, int rows_init, int cols_init, int channels, texel_format format_init) {
+		rows = rows_init;
+		cols = cols_init;
+		format = format_init;
+		blocks_x = (cols + 3) / 4;
+		int blocks_y = (rows + 3) / 4;
+		auto texel = [&](int i, int j) { return pixels + (static_cast<size_t>(i) * cols + j) * channels; };
+
+		switch (format) {
+		case texel_format::rgba8:
+			allocate(static_cast<size_t>(rows) * cols * 4);
+			for (int i = 0; i < rows; i++) {
+				for (int j = 0; j < cols; j++) {
+					uint8_t* out = data.get() + (static_cast<size_t>(i) * cols + j) * 4;
+					const uint8_t* in = texel(i, j);
+					for (int k = 0; k < 3; k++) out[k] = in[std::min(k, channels - 1)];
+					out[3] = channels == 4 ? in[3] : 255;
+				}
+			}
+			break;
+		case texel_format::rg8_octahedral:
+			allocate(static_cast<size_t>(rows) * cols * 2);
+			for (int i = 0; i < rows; i++) {
+				for (int j = 0; j < cols; j++) {
+					uint8_t* out = data.get() + (static_cast<size_t>(i) * cols + j) * 2;
+					const uint8_t* in = texel(i, j);
+					vec3 n(in[0] / 255.0 * 2 - 1, in[1] / 255.0 * 2 - 1, in[2] / 255.0 * 2 - 1);
+					encode_octahedral(unit_vector(n), out[0], out[1]);
+				}
+			}
+			break;
+		case texel_format::r8:
+			allocate(static_cast<size_t>(rows) * cols);
+			for (int i = 0; i < rows; i++) {
+				for (int j = 0; j < cols; j++) {
+					const uint8_t* in = texel(i, j);
+					int sum = 0;
+					int n = std::min(channels, 3);
+					for (int k = 0; k < n; k++) sum += in[k];
+					data[static_cast<size_t>(i) * cols + j] = static_cast<uint8_t>((sum + n / 2) / n);
+				}
+			}
+			break;
+		case texel_format::bc1:
+		case texel_format::bc5: {
+			size_t block_bytes = format == texel_format::bc1 ? 8 : 16;
+			allocate(static_cast<size_t>(blocks_x) * blocks_y * block_bytes);
+			uint8_t block[48];
+			for (int by = 0; by < blocks_y; by++) {
+				for (int bx = 0; bx < blocks_x; bx++) {
+					for (int t = 0; t < 16; t++) {
+						const uint8_t* in = texel(std::min(by * 4 + t / 4, rows - 1), std::min(bx * 4 + t % 4, cols - 1));
+						for (int k = 0; k < 3; k++) block[t * 3 + k] = in[std::min(k, channels - 1)];
+					}
+					uint8_t* out = data.get() + (static_cast<size_t>(by) * blocks_x + bx) * block_bytes;
+					if (format == texel_format::bc1) {
+						encode_bc1_block(block, out);
+					}
+					else {
+						encode_bc4_block(block, 3, out);
+						encode_bc4_block(block + 1, 3, out + 8);
+					}
+				}
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	// 从线性空间的浮点图像数据创建（HDR），存储为rgba16f
+	void create(const float* pixels, int rows_init, int cols_init, int channels) {
+		rows = rows_init;
+		cols = cols_init;
+		format = texel_format::rgba16f;
+		blocks_x = (cols + 3) / 4;
+		allocate(static_cast<size_t>(rows) * cols * 8);
+		uint16_t* out = reinterpret_cast<uint16_t*>(data.get());
+		for (size_t t = 0; t < static_cast<size_t>(rows) * cols; t++) {
+			const float* in = pixels + t * channels;
+			for (int k = 0; k < 3; k++) out[t * 4 + k] = float_to_half(in[std::min(k, channels - 1)]);
+			out[t * 4 + 3] = float_to_half(channels == 4 ? in[3] : 1.0f);
+		}
+	}
+
+	// 由已编码的texel数据创建，bytes的长度为storage_size(rows, cols, format)
+	// 用于从文件中读取分块纹理
+	void assign(const uint8_t* bytes, int rows_init, int cols_init, texel_format format_init) {
+		rows = rows_init;
+		cols = cols_init;
+		format = format_init;
+		blocks_x = (cols + 3) / 4;
+		allocate(storage_size(rows, cols, format));
+		memcpy(data.get(), bytes, byte_size);
+	}
+
+	// 直接引用外部已编码的texel数据（例如映射到内存的缓存文件），不复制
+	// owner保证数据在图像的生命周期内有效
+	void view(const uint8_t* bytes, int rows_init, int cols_init, texel_format format_init, std::shared_ptr<const void> owner) {
+		rows = rows_init;
+		cols = cols_init;
+		format = format_init;
+		blocks_x = (cols + 3) / 4;
+		data.reset();
+		texels = bytes;
+		external_owner = std::move(owner);
+		byte_size = storage_size(rows, cols, format);
+	}
+
+	// 已编码的texel数据
+	const uint8_t* bytes() const {
+		return texels;
+	}
+
+	// 占用的内存（字节）
+	size_t memory_size() const {
+		return byte_size;
+	}
+
+	// 给定尺寸与格式的图像占用的字节数
+	static size_t storage_size(int rows, int cols, texel_format format) {
+		size_t texel_num = static_cast<size_t>(rows) * cols;
+		size_t block_num = static_cast<size_t>((rows + 3) / 4) * ((cols + 3) / 4);
+		switch (format) {
+		case texel_format::rgba8: return texel_num * 4;
+		case texel_format::rgba16f: return texel_num * 8;
+		case texel_format::bc1: return block_num * 8;
+		case texel_format::rg8_octahedral: return texel_num * 2;
+		case texel_format::bc5: return block_num * 16;
+		case texel_format::r8: return texel_num;
+		default: return 0;
+		}
+	}
+
+	// 线性空间的颜色与alpha
+	void fetch_color(int row, int col, vec3& color, double& alpha) const {
+		const gamma_decode_table& lut = gamma_decode();
+		switch (format) {
+		case texel_format::rgba8: {
+			const uint8_t* p = texels + (static_cast<size_t>(row) * cols + col) * 4;
+			color = vec3(lut.value[p[0]], lut.value[p[1]], lut.value[p[2]]);
+			alpha = p[3] / 255.0;
+			return;
+		}
+		case texel_format::rgba16f: {
+			const uint16_t* p = reinterpret_cast<const uint16_t*>(texels) + (static_cast<size_t>(row) * cols + col) * 4;
+			color = vec3(half_to_float(p[0]), half_to_float(p[1]), half_to_float(p[2]));
+			alpha = half_to_float(p[3]);
+			return;
+		}
+		case texel_format::bc1: {
+			int c[3];
+			decode_bc1_texel(block(row, col, 8), (row & 3) * 4 + (col & 3), c);
+			color = vec3(lut.value[c[0]], lut.value[c[1]], lut.value[c[2]]);
+			alpha = 1;
+			return;
+		}
+		default:
+			color = vec3(0, 0, 0);
+			alpha = 1;
+			return;
+		}
+	}
+
+	// 切线空间的单位法线
+	vec3 fetch_normal(int row, int col) const {
+		if (format == texel_format::rg8_octahedral) {
+			const uint8_t* p = texels + (static_cast<size_t>(row) * cols + col) * 2;
+			return decode_octahedral(p[0], p[1]);
+		}
+		if (format == texel_format::bc5) {
+			const uint8_t* b = block(row, col, 16);
+			int i = (row & 3) * 4 + (col & 3);
+			double x = decode_bc4_texel(b, i) / 255.0 * 2 - 1;
+			double y = decode_bc4_texel(b + 8, i) / 255.0 * 2 - 1;
+			double xy2 = x * x + y * y;
+			if (xy2 >= 1) return vec3(x, y, 0) / sqrt(xy2);
+			return vec3(x, y, sqrt(1 - xy2));
+		}
+		return vec3(0, 0, 1);
+	}
+
+	// 单通道的值，范围[0, 1]
+	double fetch_scalar(int row, int col) const {
+		if (format == texel_format::r8) return texels[static_cast<size_t>(row) * cols + col] / 255.0;
+		return 0;
+	}
+
+private:
+	void allocate(size_t size) {
+		byte_size = size;
+		data.reset(static_cast<uint8_t*>(::operator new[](std::max<size_t>(size, 1), std::align_val_t(64))));
+		texels = data.get();
+		external_owner = nullptr;
+	}
+
+	const uint8_t* block(int row, int col, size_t block_bytes) const {
+		return texels + (static_cast<size_t>(row >> 2) * blocks_x + (col >> 2)) * block_bytes;
+	}
+};
+
+#endif
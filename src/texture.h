@@ -1,401 +1,623 @@
-#pragma once
-#ifndef TEXTURE_H
-#define TEXTURE_H
-
-#include "vec3.h"
-#include <opencv2/core/core.hpp>
-#include <opencv2/highgui/highgui.hpp>
-
-
-class texture {
-public:
-	virtual vec3 get_value(const vec3 &uv) const = 0;
-	virtual double get_alpha(const vec3 &uv) const = 0;
-};
-
-// ɫtexture
-class simple_color_texture : public texture {
-public:
-	vec3 color;
-	double alpha;
-
-public:
-	simple_color_texture(const vec3 &color_init, double alpha_init = 1)
-	{
-		color = clamp(color_init, 0, 1);
-		alpha = alpha_init;
-	}
-
-	simple_color_texture(int R, int G, int B, double alpha_init = 1)
-	{
-		color = clamp(vec3(pow(R / 255.0, 2.2), pow(G / 255.0, 2.2), pow(B / 255.0, 2.2)), 0, 1);
-		alpha = alpha_init;
-	}
-
-	virtual vec3 get_value(const vec3 &uv) const override
-	{
-		return color;
-	}
-
-	double get_alpha(const vec3 &uv) const override
-	{
-		return alpha;
-	}
-};
-
-// ͼtexture
-class color_map : public texture {
-public:
-	// ͼRGBֵ(0.0~1.0)ľ
-	// Կռ
-	// ϣ
-	vec3 **color_mat;
-	// ͼalphaֵ(0.0~1.0)ľ
-	// 0Ϊȫ͸1Ϊȫ͸
-	// color_matԪضӦ
-	double **alpha_mat;
-	// ͼ
-	int rows, cols; 
-	// Ŵ
-	double scale = 1;
-
-public:
-	// scaleԽԽܼ
-	color_map(const char file_name[], double scale_init = 1) {
-		scale = scale_init;
-		
-		// ȡͼ
-		cv::Mat image;
-		image = cv::imread(file_name, -1); // ڶΪ-1ʾȡ͸ͨ
-
-		// ȡͼߴ
-		rows = image.rows;
-		cols = image.cols;
-
-		// 洢ռ
-		color_mat = new vec3*[rows];
-		for (int i = 0; i < rows; i++) {
-			color_mat[i] = new vec3[cols];
-		}
-		alpha_mat = new double*[rows];
-		for (int i = 0; i < rows; i++) {
-			alpha_mat[i] = new double[cols];
-		}
-
-		// ¼
-		// Ϊд
-		// ͨͼƬcv::Vec3bõݻ
-		// ͨͼƬcv::Vec4b޷ȡalphaͨ
-		if (image.channels() == 3) {
-			for (int i = 0; i < rows; i++) {
-				for (int j = 0; j < cols; j++) {
-					// opencvɫ洢˳ΪBGRҪתһ˳
-					// עҪRGBֵתԿռ
-					color_mat[i][j][0] = pow(int(image.at<cv::Vec3b>(rows - i - 1, j)[2]) / 255.0, 2.2);
-					color_mat[i][j][1] = pow(int(image.at<cv::Vec3b>(rows - i - 1, j)[1]) / 255.0, 2.2);
-					color_mat[i][j][2] = pow(int(image.at<cv::Vec3b>(rows - i - 1, j)[0]) / 255.0, 2.2);
-					alpha_mat[i][j] = 1; // 3ͨalphaΪ1
-				}
-			}
-		} 
-		else if (image.channels() == 4) {
-			for (int i = 0; i < rows; i++) {
-				for (int j = 0; j < cols; j++) {
-					// opencvɫ洢˳ΪBGRҪתһ˳
-					// עҪRGBֵתԿռ
-					color_mat[i][j][0] = pow(int(image.at<cv::Vec4b>(rows - i - 1, j)[2]) / 255.0, 2.2);
-					color_mat[i][j][1] = pow(int(image.at<cv::Vec4b>(rows - i - 1, j)[1]) / 255.0, 2.2);
-					color_mat[i][j][2] = pow(int(image.at<cv::Vec4b>(rows - i - 1, j)[0]) / 255.0, 2.2);
-					alpha_mat[i][j] = int(image.at<cv::Vec4b>(rows - i - 1, j)[3]) / 255.0;
-				}
-			}
-		}
-		else { // ͨ3Ҳ4
-			std::cout << "error in texture.h: color_map::color_map(): unsupported image channels = " << image.channels() << "\n";
-			std::cout << "file name : " << file_name << '\n';
-			exit(-1);
-		}
-	}
-
-	virtual vec3 get_value(const vec3 &uv) const override
-	{
-
-		// Ԥuv꣬ʹ䷶Χ[0,1)
-		vec3 real_uv = uv * scale;
-		real_uv[0] = real_uv[0] - std::floor(real_uv[0]);
-		real_uv[1] = real_uv[1] - std::floor(real_uv[1]);
-
-		// uvֵӳ䵽
-		// ӳֵΧΪ[0, cols - 1][0, rows - 1]
-		double row = real_uv[1] * (rows - 1);
-		double col = real_uv[0] * (cols - 1);
-
-		// ĸص
-		int row_0 = static_cast<int>(std::floor(row));
-		int row_1 = row_0 + 1;
-		int col_0 = static_cast<int>(std::floor(col));
-		int col_1 = col_0 + 1;
-
-		// ϲֵ
-		vec3 RGB_left = color_mat[row_1][col_0] * (row - row_0) + color_mat[row_0][col_0] * (row_1 - row);
-		vec3 RGB_right = color_mat[row_1][col_1] * (row - row_0) + color_mat[row_0][col_1] * (row_1 - row);
-
-		// ϲֵ
-		vec3 RGB = RGB_right * (col - col_0) + RGB_left * (col_1 - col);
-
-		return RGB;
-	}
-
-	double get_alpha(const vec3 &uv) const override {
-
-		// Ԥuv꣬ʹ䷶Χ[0,1)
-		vec3 real_uv = uv * scale;
-		real_uv[0] = real_uv[0] - std::floor(real_uv[0]);
-		real_uv[1] = real_uv[1] - std::floor(real_uv[1]);
-
-		// uvֵӳ䵽
-		// ӳֵΧΪ[0, cols - 1][0, rows - 1]
-		double row = real_uv[1] * (rows - 1);
-		double col = real_uv[0] * (cols - 1);
-
-		// ĸص
-		int row_0 = static_cast<int>(std::floor(row));
-		int row_1 = row_0 + 1;
-		int col_0 = static_cast<int>(std::floor(col));
-		int col_1 = col_0 + 1;
-
-		// ϲֵ
-		double alpha_left = alpha_mat[row_1][col_0] * (row - row_0) + alpha_mat[row_0][col_0] * (row_1 - row);
-		double alpha_right = alpha_mat[row_1][col_1] * (row - row_0) + alpha_mat[row_0][col_1] * (row_1 - row);
-
-		// ϲֵ
-		double alpha = alpha_right * (col - col_0) + alpha_left * (col_1 - col);
-		
-		return alpha;
-	}
-
-	~color_map() {
-		// ֶͷſռ
-		for (int i = 0; i < rows; i++) {
-			delete[] color_mat[i];
-			delete[] alpha_mat[i];
-		}
-		delete[] color_mat;
-		delete[] alpha_mat;
-	}
-};
-
-
-// ͼ
-class normal_map : public texture {
-public:
-	// ͼRGBֵ(0.0~1.0)ľ
-	// Կռ
-	// ϣ
-	vec3 **normal_mat;
-	// ͼ
-	int rows, cols;
-	// Ŵ
-	double scale = 1;
-
-public:
-	// scaleԽԽܼ
-	normal_map(const char file_name[], double scale_init = 1) {
-		scale = scale_init;
-		
-		// ȡͼ
-		cv::Mat image;
-		image = cv::imread(file_name);
-
-		// ȡͼߴ
-		rows = image.rows;
-		cols = image.cols;
-
-		// 洢ռ
-		normal_mat = new vec3*[rows];
-		for (int i = 0; i < rows; i++) {
-			normal_mat[i] = new vec3[cols];
-		}
-
-		// ¼
-		for (int i = 0; i < rows; i++) {
-			for (int j = 0; j < cols; j++) {
-				// opencvɫ洢˳ΪBGRҪתһ˳
-				// ݴ[0, 255]ӳ䵽[-1, 1]
-				// TODO:Ŀǰӳ䷽㵥λ֮Ҫ޸
-				normal_mat[i][j][0] = int(image.at<cv::Vec3b>(rows - i - 1, j)[2]) / 255.0 * 2 - 1; // T
-				normal_mat[i][j][1] = int(image.at<cv::Vec3b>(rows - i - 1, j)[1]) / 255.0 * 2 - 1; // B
-				normal_mat[i][j][2] = int(image.at<cv::Vec3b>(rows - i - 1, j)[0]) / 255.0 * 2 - 1; // N
-				// λ
-				normal_mat[i][j] = unit_vector(normal_mat[i][j]);
-			}
-		}
-	}
-
-	virtual vec3 get_value(const vec3 &uv) const override
-	{
-		// Ԥuv꣬ʹ䷶Χ[0,1)
-		vec3 real_uv = uv * scale;
-		real_uv[0] = real_uv[0] - std::floor(real_uv[0]);
-		real_uv[1] = real_uv[1] - std::floor(real_uv[1]);
-
-		// uvֵӳ䵽
-		// ӳֵΧΪ[0, cols - 1][0, rows - 1]
-		double row = real_uv[1] * (rows - 1);
-		double col = real_uv[0] * (cols - 1);
-
-		// ĸص
-		int row_0 = static_cast<int>(std::floor(row));
-		int row_1 = row_0 + 1;
-		int col_0 = static_cast<int>(std::floor(col));
-		int col_1 = col_0 + 1;
-
-		// ϲֵ
-		vec3 RGB_left = normal_mat[row_1][col_0] * (row - row_0) + normal_mat[row_0][col_0] * (row_1 - row);
-		vec3 RGB_right = normal_mat[row_1][col_1] * (row - row_0) + normal_mat[row_0][col_1] * (row_1 - row);
-
-		// ϲֵ
-		vec3 RGB = RGB_right * (col - col_0) + RGB_left * (col_1 - col);
-
-		// λ
-		RGB = unit_vector(RGB);
-		return RGB;
-	}
-
-	double get_alpha(const vec3 &uv) const override {
-		return 1;
-	}
-
-	~normal_map() {
-		// ֶͷſռ
-		for (int i = 0; i < rows; i++) {
-			delete[] normal_mat[i];
-		}
-		delete[] normal_mat;
-	}
-};
-
-// ûͼ
-class displacement_map : public texture {
-public:
-	// λľ
-	// ϣ
-	double** displacement_mat;
-	// ͼ
-	int rows, cols;
-	// Ŵ
-	double scale;
-	// ǿ
-	double strength;
-
-public:
-	// scaleԽԽܼ
-	displacement_map(const char file_name[], double scale_init = 1, double strength_init = 0.02) {
-		scale = scale_init;
-		strength = strength_init;
-
-		// ȡͼ
-		cv::Mat image;
-		image = cv::imread(file_name, -1); // ڶΪ-1ʾȡ͸ͨ
-		  
-		// ȡͼߴ
-		rows = image.rows;
-		cols = image.cols;
-
-		// 洢ռ
-		displacement_mat = new double *[rows];
-		for (int i = 0; i < rows; i++) {
-			displacement_mat[i] = new double[cols];
-		}
-
-		// ¼
-		// Ϊд
-		// ͨͼƬcv::Vec3bõݻ
-		// ͨͼƬcv::Vec4b޷ȡalphaͨ
-		if (image.channels() == 3) {
-			for (int i = 0; i < rows; i++) {
-				for (int j = 0; j < cols; j++) {
-					// opencvɫ洢˳ΪBGRҪתһ˳
-					// עҪRGBֵתԿռ
-					displacement_mat[i][j] = 0;
-					displacement_mat[i][j] += int(image.at<cv::Vec3b>(rows - i - 1, j)[2]) / 255.0 * 2 - 1;
-					displacement_mat[i][j] += int(image.at<cv::Vec3b>(rows - i - 1, j)[1]) / 255.0 * 2 - 1;
-					displacement_mat[i][j] += int(image.at<cv::Vec3b>(rows - i - 1, j)[0]) / 255.0 * 2 - 1;
-					displacement_mat[i][j] /= 3.0;
-				}
-			}
-		}
-		else if (image.channels() == 4) {
-			for (int i = 0; i < rows; i++) {
-				for (int j = 0; j < cols; j++) {
-					// opencvɫ洢˳ΪBGRҪתһ˳
-					// עҪRGBֵתԿռ
-					displacement_mat[i][j] = 0;
-					displacement_mat[i][j] += int(image.at<cv::Vec4b>(rows - i - 1, j)[2]) / 255.0 * 2 - 1;
-					displacement_mat[i][j] += int(image.at<cv::Vec4b>(rows - i - 1, j)[1]) / 255.0 * 2 - 1;
-					displacement_mat[i][j] += int(image.at<cv::Vec4b>(rows - i - 1, j)[0]) / 255.0 * 2 - 1;
-					displacement_mat[i][j] /= 3.0;
-				}
-			}
-		}
-		else if (image.channels() == 1) {
-			for (int i = 0; i < rows; i++) {
-				for (int j = 0; j < cols; j++) {
-					// opencvɫ洢˳ΪBGRҪתһ˳
-					// עҪRGBֵתԿռ
-					displacement_mat[i][j] = int(image.at<cv::uint8_t>(rows - i - 1, j)) / 255.0 * 2 - 1;
-				}
-			}
-		}
-		else { // ͨ3Ҳ4
-			std::cout << "error in texture.h: color_map::color_map(): unsupported image channels = " << image.channels() << "\n";
-			std::cout << "file name : " << file_name << '\n';
-			exit(-1);
-		}
-	}
-
-	virtual vec3 get_value(const vec3& uv) const override
-	{
-
-		// Ԥuv꣬ʹ䷶Χ[0,1)
-		vec3 real_uv = uv * scale;
-		real_uv[0] = real_uv[0] - std::floor(real_uv[0]);
-		real_uv[1] = real_uv[1] - std::floor(real_uv[1]);
-
-		// uvֵӳ䵽
-		// ӳֵΧΪ[0, cols - 1][0, rows - 1]
-		double row = real_uv[1] * (rows - 1);
-		double col = real_uv[0] * (cols - 1);
-
-		// ĸص
-		int row_0 = static_cast<int>(std::floor(row));
-		int row_1 = row_0 + 1;
-		int col_0 = static_cast<int>(std::floor(col));
-		int col_1 = col_0 + 1;
-
-		// ϲֵ
-		double displacement_left = displacement_mat[row_1][col_0] * (row - row_0) + displacement_mat[row_0][col_0] * (row_1 - row);
-		double displacement_right = displacement_mat[row_1][col_1] * (row - row_0) + displacement_mat[row_0][col_1] * (row_1 - row);
-
-		// ϲֵ
-		double displacement_value = displacement_right * (col - col_0) + displacement_left * (col_1 - col);
-		displacement_value *= strength;
-
-		return vec3(displacement_value, displacement_value, displacement_value);
-	}
-
-	double get_alpha(const vec3& uv) const override {
-
-		return 1;
-	}
-
-	~displacement_map() {
-		// ֶͷſռ
-		for (int i = 0; i < rows; i++) {
-			delete[] displacement_mat[i];
-		}
-		delete[] displacement_mat;
-	}
-};
-
-#endif
\ No newline at end of file
+#pragma once
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <vector>
+#include <mutex>
+#include "vec3.h"
+#include "texel_image.h"
+#include "texel_cache.h"
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+
+class texture {
+public:
+	virtual vec3 get_value(const vec3 &uv) const = 0;
+	virtual double get_alpha(const vec3 &uv) const = 0;
+	// 同时获取RGB与alpha，只计算一次uv映射与插值位置
+	// footprint为查找的足迹宽度（uv单位，未乘以scale），带mipmap的纹理据此选择LOD；为0时使用原始分辨率
+	virtual void get_rgba(const vec3 &uv, double footprint, vec3 &color, double &alpha) const = 0;
+	// texel占用的内存（字节）
+	virtual size_t memory_size() const = 0;
+	// uv包围盒[uv_min, uv_max]内get_alpha可能取到的alpha范围（保守估计），用于生成不透明度微图
+	virtual void alpha_range(const vec3 &uv_min, const vec3 &uv_max, double &alpha_min, double &alpha_max) const = 0;
+	// texel已经可用，查询不会等待。只有异步加载的纹理（见asset_loader.h）在加载完成前返回false
+	virtual bool loaded() const { return true; }
+};
+
+// 纯色texture
+class simple_color_texture : public texture {
+public:
+	vec3 color;
+	double alpha;
+
+public:
+	simple_color_texture(const vec3 &color_init, double alpha_init = 1)
+	{
+		color = clamp(color_init, 0, 1);
+		alpha = alpha_init;
+	}
+
+	simple_color_texture(int R, int G, int B, double alpha_init = 1)
+	{
+		color = clamp(vec3(pow(R / 255.0, 2.2), pow(G / 255.0, 2.2), pow(B / 255.0, 2.2)), 0, 1);
+		alpha = alpha_init;
+	}
+
+	virtual vec3 get_value(const vec3 &uv) const override
+	{
+		return color;
+	}
+
+	double get_alpha(const vec3 &uv) const override
+	{
+		return alpha;
+	}
+
+	void get_rgba(const vec3 &uv, double footprint, vec3 &color_out, double &alpha_out) const override
+	{
+		color_out = color;
+		alpha_out = alpha;
+	}
+
+	size_t memory_size() const override {
+		return 0;
+	}
+
+	void alpha_range(const vec3 &uv_min, const vec3 &uv_max, double &alpha_min, double &alpha_max) const override
+	{
+		alpha_min = alpha;
+		alpha_max = alpha;
+	}
+};
+
+// 读取图像的8位像素
+// 返回的像素按行存放，行号0为图像最下面一行，通道顺序为RGB(A)（opencv中为BGR(A)）
+inline std::vector<uint8_t> read_image_8bit(const cv::Mat& image, int channels) {
+	std::vector<uint8_t> pixels(static_cast<size_t>(image.rows) * image.cols * channels);
+	for (int i = 0; i < image.rows; i++) {
+		const uint8_t* row = image.ptr(image.rows - i - 1);
+		uint8_t* out = pixels.data() + static_cast<size_t>(i) * image.cols * channels;
+		for (int j = 0; j < image.cols; j++) {
+			for (int k = 0; k < channels; k++) {
+				// 前三个通道反转顺序
+				int source = k < 3 and channels >= 3 ? 2 - k : k;
+				out[j * channels + k] = row[j * channels + source];
+			}
+		}
+	}
+	return pixels;
+}
+
+
+// 双线性插值使用的四个texel坐标与权重
+struct bilinear_footprint {
+	int row_0, row_1, col_0, col_1;
+	double row, col;
+	double w_row_0, w_row_1, w_col_0, w_col_1; // 四个texel在行、列上的权重
+};
+
+inline bilinear_footprint get_bilinear_footprint(const vec3& uv, double scale, int rows, int cols) {
+	bilinear_footprint f;
+
+	// 预处理uv坐标，使其范围在[0,1)
+	vec3 real_uv = uv * scale;
+	real_uv[0] = real_uv[0] - std::floor(real_uv[0]);
+	real_uv[1] = real_uv[1] - std::floor(real_uv[1]);
+
+	// 将uv值映射到像素坐标
+	// 映射后的值范围为[0, cols - 1]与[0, rows - 1]
+	f.row = real_uv[1] * (rows - 1);
+	f.col = real_uv[0] * (cols - 1);
+
+	// 获得相邻四个像素的坐标
+	// real_uv可能因为舍入误差等于1，这时需要限制坐标范围
+	f.row_0 = std::min(static_cast<int>(std::floor(f.row)), std::max(rows - 2, 0));
+	f.row_1 = std::min(f.row_0 + 1, rows - 1);
+	f.col_0 = std::min(static_cast<int>(std::floor(f.col)), std::max(cols - 2, 0));
+	f.col_1 = std::min(f.col_0 + 1, cols - 1);
+
+	// 权重按未限制的相邻坐标计算，只有一行（列）时该行（列）的权重为1
+	f.w_row_1 = f.row - f.row_0;
+	f.w_row_0 = (f.row_0 + 1) - f.row;
+	f.w_col_1 = f.col - f.col_0;
+	f.w_col_0 = (f.col_0 + 1) - f.col;
+	return f;
+}
+
+// uv坐标的一个分量在[a, b]范围内时，双线性插值可能读取的texel范围[begin, end]
+// 映射方式与get_bilinear_footprint相同；范围跨过纹理的重复边界时返回整个纹理
+inline void bilinear_texel_range(double a, double b, double scale, int n, int& begin, int& end) {
+	double low = a * scale, high = b * scale;
+	double base = std::floor(low);
+	if (high - base >= 1) {
+		begin = 0;
+		end = n - 1;
+		return;
+	}
+	begin = std::max(static_cast<int>(std::floor((low - base) * (n - 1))), 0);
+	end = std::min(static_cast<int>(std::ceil((high - base) * (n - 1))), n - 1);
+}
+
+
+// 读取颜色图像（3或4通道），行号0为最下面一行，通道顺序为RGB(A)
+// 8位图像存入pixels；HDR图像（32位浮点，已经在线性空间）存入pixels_hdr
+// 返回通道数
+inline int read_color_image(const char file_name[], int& rows, int& cols, std::vector<uint8_t>& pixels, std::vector<float>& pixels_hdr) {
+	// 读取图像
+	cv::Mat image_file;
+	image_file = cv::imread(file_name, -1); // 第二个参数为-1，表示读取透明通道
+
+	// 获取图像尺寸
+	rows = image_file.rows;
+	cols = image_file.cols;
+
+	int channels = image_file.channels();
+	if (channels != 3 and channels != 4) { // 通道数不是3也不是4
+		std::cout << "error in texture.h: read_color_image(): unsupported image channels = " << channels << "\n";
+		std::cout << "file name : " << file_name << '\n';
+		exit(-1);
+	}
+
+	if (image_file.depth() == CV_32F) {
+		pixels_hdr.resize(static_cast<size_t>(rows) * cols * channels);
+		for (int i = 0; i < rows; i++) {
+			const float* row = reinterpret_cast<const float*>(image_file.ptr(rows - i - 1));
+			for (int j = 0; j < cols; j++) {
+				for (int k = 0; k < channels; k++) {
+					pixels_hdr[(static_cast<size_t>(i) * cols + j) * channels + k] = row[j * channels + (k < 3 ? 2 - k : k)];
+				}
+			}
+		}
+	}
+	else {
+		pixels = read_image_8bit(image_file, channels);
+	}
+	return channels;
+}
+
+// 8位颜色图像实际使用的存储格式
+// 只支持rgba8与bc1，bc1没有alpha，图像含有透明部分时退回rgba8
+inline texel_format color_format(const std::vector<uint8_t>& pixels, int channels, texel_format format) {
+	if (format != texel_format::bc1) return texel_format::rgba8;
+	if (channels == 4) {
+		for (size_t t = 3; t < pixels.size(); t += 4) {
+			if (pixels[t] != 255) return texel_format::rgba8;
+		}
+	}
+	return format;
+}
+
+
+// 将图像缩小为一半（向上取整），2x2的texel取平均，用于生成mipmap
+// 8位图像的前三个通道是gamma编码的颜色，在线性空间中平均后再编码；其余通道直接平均
+inline std::vector<uint8_t> downsample_image(const std::vector<uint8_t>& pixels, int rows, int cols, int channels) {
+	const gamma_decode_table& lut = gamma_decode();
+	int rows_half = (rows + 1) / 2, cols_half = (cols + 1) / 2;
+	std::vector<uint8_t> result(static_cast<size_t>(rows_half) * cols_half * channels);
+	for (int i = 0; i < rows_half; i++) {
+		int i_0 = 2 * i, i_1 = std::min(2 * i + 1, rows - 1);
+		for (int j = 0; j < cols_half; j++) {
+			int j_0 = 2 * j, j_1 = std::min(2 * j + 1, cols - 1);
+			const uint8_t* p[4] = {
+				pixels.data() + (static_cast<size_t>(i_0) * cols + j_0) * channels,
+				pixels.data() + (static_cast<size_t>(i_0) * cols + j_1) * channels,
+				pixels.data() + (static_cast<size_t>(i_1) * cols + j_0) * channels,
+				pixels.data() + (static_cast<size_t>(i_1) * cols + j_1) * channels };
+			uint8_t* out = result.data() + (static_cast<size_t>(i) * cols_half + j) * channels;
+			for (int k = 0; k < channels; k++) {
+				double sum = 0;
+				if (k < 3) {
+					for (int t = 0; t < 4; t++) sum += lut.value[p[t][k]];
+					sum = pow(sum / 4, 1 / 2.2) * 255;
+				}
+				else {
+					for (int t = 0; t < 4; t++) sum += p[t][k];
+					sum /= 4;
+				}
+				out[k] = static_cast<uint8_t>(std::min(std::round(sum), 255.0));
+			}
+		}
+	}
+	return result;
+}
+
+// 浮点图像（线性空间）的版本，所有通道直接平均
+inline std::vector<float> downsample_image(const std::vector<float>& pixels, int rows, int cols, int channels) {
+	int rows_half = (rows + 1) / 2, cols_half = (cols + 1) / 2;
+	std::vector<float> result(static_cast<size_t>(rows_half) * cols_half * channels);
+	for (int i = 0; i < rows_half; i++) {
+		int i_0 = 2 * i, i_1 = std::min(2 * i + 1, rows - 1);
+		for (int j = 0; j < cols_half; j++) {
+			int j_0 = 2 * j, j_1 = std::min(2 * j + 1, cols - 1);
+			for (int k = 0; k < channels; k++) {
+				float sum = pixels[(static_cast<size_t>(i_0) * cols + j_0) * channels + k]
+					+ pixels[(static_cast<size_t>(i_0) * cols + j_1) * channels + k]
+					+ pixels[(static_cast<size_t>(i_1) * cols + j_0) * channels + k]
+					+ pixels[(static_cast<size_t>(i_1) * cols + j_1) * channels + k];
+				result[(static_cast<size_t>(i) * cols_half + j) * channels + k] = sum / 4;
+			}
+		}
+	}
+	return result;
+}
+
+// 由原图逐层缩小生成mipmap，对每一层调用visit(level, pixels, rows, cols)
+// 每层都从上一层未压缩的像素生成，块压缩的误差不会累积
+template <typename pixel_type, typename visitor>
+void for_each_mip_level(std::vector<pixel_type> pixels, int rows, int cols, int channels, visitor visit) {
+	for (int level = 0; ; level++) {
+		visit(level, pixels, rows, cols);
+		if (rows <= 1 and cols <= 1) break;
+		pixels = downsample_image(pixels, rows, cols, channels);
+		rows = (rows + 1) / 2;
+		cols = (cols + 1) / 2;
+	}
+}
+
+// 按像素类型创建texel_image，浮点图像总是存储为rgba16f
+inline void create_texels(texel_image& image, const std::vector<uint8_t>& pixels, int rows, int cols, int channels, texel_format format) {
+	image.create(pixels.data(), rows, cols, channels, format);
+}
+
+inline void create_texels(texel_image& image, const std::vector<float>& pixels, int rows, int cols, int channels, texel_format format) {
+	image.create(pixels.data(), rows, cols, channels);
+}
+
+// 足迹对应的mipmap层级（可以是小数），足迹不超过一个texel时为0
+// footprint为uv单位，scale为纹理的放大倍数，rows、cols为层级0的尺寸
+inline double mip_lod(double footprint, double scale, int rows, int cols) {
+	double lod = footprint > 0 ? std::log2(footprint * scale * std::max(rows, cols)) : 0;
+	return lod > 0 ? lod : 0;
+}
+
+
+// 图像texture
+// 读取时生成完整的mipmap，查找时根据足迹宽度在相邻两层之间三线性插值
+// 缩小的纹理使用较小的层级，减少走样，也只访问较小的内存
+class color_map : public texture {
+public:
+	// 各层级图像的RGB值（线性空间）与alpha值，0为完全透明，1为完全不透明
+	// 层级0为原图，之后每层的尺寸减半，直到1x1
+	// 从下往上，从左往右
+	std::vector<texel_image> levels;
+	// 图像行数和列数
+	int rows, cols; 
+	// 放大倍数
+	double scale = 1;
+
+private:
+	mutable std::once_flag opaque_flag;
+	mutable bool opaque = true;
+
+public:
+	// scale越大，纹理越密集
+	// format为存储格式：rgba8（默认）或bc1。bc1没有alpha，图像含有透明部分时使用rgba8
+	// HDR图像（32位浮点）总是以rgba16f格式存储
+	color_map(const char file_name[], double scale_init = 1, texel_format format = texel_format::rgba8) {
+		scale = scale_init;
+
+		// 优先从解码缓存读取
+		std::string cache_params = "color_map format=" + std::to_string(static_cast<int>(format));
+		if (load_texel_cache(file_name, cache_params, levels)) {
+			rows = levels[0].rows;
+			cols = levels[0].cols;
+			return;
+		}
+		
+		std::vector<uint8_t> pixels;
+		std::vector<float> pixels_hdr;
+		int channels = read_color_image(file_name, rows, cols, pixels, pixels_hdr);
+		if (pixels_hdr.size() > 0) {
+			build_levels(pixels_hdr, channels, texel_format::rgba16f);
+		}
+		else {
+			build_levels(pixels, channels, color_format(pixels, channels, format));
+		}
+		if (rows > 0 and cols > 0) save_texel_cache(file_name, cache_params, levels);
+	}
+
+	virtual vec3 get_value(const vec3 &uv) const override
+	{
+		vec3 color;
+		double alpha;
+		get_rgba(uv, 0, color, alpha);
+		return color;
+	}
+
+	double get_alpha(const vec3 &uv) const override {
+		vec3 color;
+		double alpha;
+		get_rgba(uv, 0, color, alpha);
+		return alpha;
+	}
+
+	// 三线性插值
+	// LOD为足迹覆盖的texel数（以层级0计）的log2，足迹不超过一个texel时只在层级0上双线性插值
+	void get_rgba(const vec3 &uv, double footprint, vec3 &color, double &alpha) const override {
+		double lod = mip_lod(footprint, scale, rows, cols);
+		int last = static_cast<int>(levels.size()) - 1;
+		if (lod == 0) {
+			get_rgba_level(0, uv, color, alpha);
+			return;
+		}
+		if (lod >= last) {
+			get_rgba_level(last, uv, color, alpha);
+			return;
+		}
+
+		int level = static_cast<int>(lod);
+		double t = lod - level;
+		vec3 color_1;
+		double alpha_1;
+		get_rgba_level(level, uv, color, alpha);
+		get_rgba_level(level + 1, uv, color_1, alpha_1);
+		color = color * (1 - t) + color_1 * t;
+		alpha = alpha * (1 - t) + alpha_1 * t;
+	}
+
+	// 在一个层级上双线性插值
+	void get_rgba_level(int level, const vec3 &uv, vec3 &color, double &alpha) const {
+		const texel_image& image = levels[level];
+		bilinear_footprint f = get_bilinear_footprint(uv, scale, image.rows, image.cols);
+
+		// 读取相邻四个texel
+		vec3 c00, c01, c10, c11;
+		double a00, a01, a10, a11;
+		image.fetch_color(f.row_0, f.col_0, c00, a00);
+		image.fetch_color(f.row_0, f.col_1, c01, a01);
+		image.fetch_color(f.row_1, f.col_0, c10, a10);
+		image.fetch_color(f.row_1, f.col_1, c11, a11);
+
+		// 在列上插值，然后在行上插值。RGB与alpha共用权重
+		vec3 RGB_left = c10 * f.w_row_1 + c00 * f.w_row_0;
+		vec3 RGB_right = c11 * f.w_row_1 + c01 * f.w_row_0;
+		color = RGB_right * f.w_col_1 + RGB_left * f.w_col_0;
+
+		double alpha_left = a10 * f.w_row_1 + a00 * f.w_row_0;
+		double alpha_right = a11 * f.w_row_1 + a01 * f.w_row_0;
+		alpha = alpha_right * f.w_col_1 + alpha_left * f.w_col_0;
+	}
+
+	// texel占用的内存（字节），包括所有层级
+	size_t memory_size() const override {
+		size_t size = 0;
+		for (const texel_image& image : levels) size += image.memory_size();
+		return size;
+	}
+
+	// 双线性插值的结果在相邻texel的alpha之间，因此包围盒覆盖的texel的alpha范围是保守的
+	void alpha_range(const vec3 &uv_min, const vec3 &uv_max, double &alpha_min, double &alpha_max) const override {
+		if (fully_opaque()) {
+			alpha_min = 1;
+			alpha_max = 1;
+			return;
+		}
+		int row_begin, row_end, col_begin, col_end;
+		bilinear_texel_range(uv_min[1], uv_max[1], scale, rows, row_begin, row_end);
+		bilinear_texel_range(uv_min[0], uv_max[0], scale, cols, col_begin, col_end);
+		alpha_min = 1;
+		alpha_max = 0;
+		vec3 color;
+		double alpha;
+		for (int i = row_begin; i <= row_end; i++) {
+			for (int j = col_begin; j <= col_end; j++) {
+				levels[0].fetch_color(i, j, color, alpha);
+				alpha_min = std::min(alpha_min, alpha);
+				alpha_max = std::max(alpha_max, alpha);
+			}
+		}
+	}
+
+	// 所有texel都不透明，第一次调用时计算
+	bool fully_opaque() const {
+		std::call_once(opaque_flag, [this]() {
+			opaque = true;
+			if (levels.empty() or levels[0].format == texel_format::bc1) return;
+			vec3 color;
+			double alpha;
+			for (int i = 0; i < rows and opaque; i++) {
+				for (int j = 0; j < cols; j++) {
+					levels[0].fetch_color(i, j, color, alpha);
+					if (alpha < 1) {
+						opaque = false;
+						break;
+					}
+				}
+			}
+		});
+		return opaque;
+	}
+
+private:
+	// 生成mipmap的各层级
+	template <typename pixel_type>
+	void build_levels(const std::vector<pixel_type>& pixels, int channels, texel_format format) {
+		for_each_mip_level(pixels, rows, cols, channels, [&](int level, const std::vector<pixel_type>& level_pixels, int level_rows, int level_cols) {
+			levels.emplace_back();
+			create_texels(levels.back(), level_pixels, level_rows, level_cols, channels, format);
+		});
+	}
+};
+
+
+// 法线贴图
+class normal_map : public texture {
+public:
+	// 切线空间的法线
+	// 从下往上，从左往右
+	texel_image image;
+	// 图像行数和列数
+	int rows, cols;
+	// 放大倍数
+	double scale = 1;
+
+
+public:
+	// scale越大，纹理越密集
+	// format为存储格式：rg8_octahedral（默认）或bc5
+	normal_map(const char file_name[], double scale_init = 1, texel_format format = texel_format::rg8_octahedral) {
+		scale = scale_init;
+		if (format != texel_format::bc5) format = texel_format::rg8_octahedral;
+
+		// 优先从解码缓存读取
+		std::string cache_params = "normal_map format=" + std::to_string(static_cast<int>(format));
+		std::vector<texel_image> cached;
+		if (load_texel_cache(file_name, cache_params, cached)) {
+			image = std::move(cached[0]);
+			rows = image.rows;
+			cols = image.cols;
+			return;
+		}
+		
+		// 读取图像
+		cv::Mat image_file;
+		image_file = cv::imread(file_name);
+
+		// 获取图像尺寸
+		rows = image_file.rows;
+		cols = image_file.cols;
+
+		// 记录数据
+		// 三个通道依次为T、B、N分量，从[0, 255]映射到[-1, 1]后单位化
+		std::vector<uint8_t> pixels = read_image_8bit(image_file, image_file.channels());
+		image.create(pixels.data(), rows, cols, image_file.channels(), format);
+		if (rows > 0 and cols > 0) {
+			cached.push_back(std::move(image));
+			save_texel_cache(file_name, cache_params, cached);
+			image = std::move(cached[0]);
+		}
+	}
+
+	virtual vec3 get_value(const vec3 &uv) const override
+	{
+		bilinear_footprint f = get_bilinear_footprint(uv, scale, rows, cols);
+
+		// 在列上插值
+		vec3 RGB_left = image.fetch_normal(f.row_1, f.col_0) * f.w_row_1 + image.fetch_normal(f.row_0, f.col_0) * f.w_row_0;
+		vec3 RGB_right = image.fetch_normal(f.row_1, f.col_1) * f.w_row_1 + image.fetch_normal(f.row_0, f.col_1) * f.w_row_0;
+
+		// 在行上插值
+		vec3 RGB = RGB_right * f.w_col_1 + RGB_left * f.w_col_0;
+
+		// 单位化
+		RGB = unit_vector(RGB);
+		return RGB;
+	}
+
+	double get_alpha(const vec3 &uv) const override {
+		return 1;
+	}
+
+	void get_rgba(const vec3& uv, double footprint, vec3& color, double& alpha) const override {
+		color = get_value(uv);
+		alpha = 1;
+	}
+
+	// texel占用的内存（字节）
+	size_t memory_size() const override {
+		return image.memory_size();
+	}
+
+	void alpha_range(const vec3& uv_min, const vec3& uv_max, double& alpha_min, double& alpha_max) const override {
+		alpha_min = 1;
+		alpha_max = 1;
+	}
+};
+
+// 置换贴图
+class displacement_map : public texture {
+public:
+	// 位移量，以r8格式存储，[0, 255]映射到[-1, 1]
+	// 从下往上，从左往右
+	texel_image image;
+	// 图像行数和列数
+	int rows, cols;
+	// 放大倍数
+	double scale;
+	// 强度
+	double strength;
+
+public:
+	// scale越大，纹理越密集
+	displacement_map(const char file_name[], double scale_init = 1, double strength_init = 0.02) {
+		scale = scale_init;
+		strength = strength_init;
+
+		// 优先从解码缓存读取
+		std::vector<texel_image> cached;
+		if (load_texel_cache(file_name, "displacement_map", cached)) {
+			image = std::move(cached[0]);
+			rows = image.rows;
+			cols = image.cols;
+			return;
+		}
+
+		// 读取图像
+		cv::Mat image_file;
+		image_file = cv::imread(file_name, -1); // 第二个参数为-1，表示读取透明通道
+		  
+		// 获取图像尺寸
+		rows = image_file.rows;
+		cols = image_file.cols;
+
+		// 记录数据
+		// 多通道图像取RGB三个通道的平均值（忽略alpha）
+		int channels = image_file.channels();
+		if (channels != 1 and channels != 3 and channels != 4) {
+			std::cout << "error in texture.h: displacement_map::displacement_map(): unsupported image channels = " << channels << "\n";
+			std::cout << "file name : " << file_name << '\n';
+			exit(-1);
+		}
+		std::vector<uint8_t> pixels = read_image_8bit(image_file, channels);
+		image.create(pixels.data(), rows, cols, channels, texel_format::r8);
+		if (rows > 0 and cols > 0) {
+			cached.push_back(std::move(image));
+			save_texel_cache(file_name, "displacement_map", cached);
+			image = std::move(cached[0]);
+		}
+	}
+
+	virtual vec3 get_value(const vec3& uv) const override
+	{
+		bilinear_footprint f = get_bilinear_footprint(uv, scale, rows, cols);
+
+		// 在列上插值
+		double displacement_left = fetch(f.row_1, f.col_0) * f.w_row_1 + fetch(f.row_0, f.col_0) * f.w_row_0;
+		double displacement_right = fetch(f.row_1, f.col_1) * f.w_row_1 + fetch(f.row_0, f.col_1) * f.w_row_0;
+
+		// 在行上插值
+		double displacement_value = displacement_right * f.w_col_1 + displacement_left * f.w_col_0;
+		displacement_value *= strength;
+
+		return vec3(displacement_value, displacement_value, displacement_value);
+	}
+
+	double get_alpha(const vec3& uv) const override {
+
+		return 1;
+	}
+
+	void get_rgba(const vec3& uv, double footprint, vec3& color, double& alpha) const override {
+		color = get_value(uv);
+		alpha = 1;
+	}
+
+	// texel占用的内存（字节）
+	size_t memory_size() const override {
+		return image.memory_size();
+	}
+
+	void alpha_range(const vec3& uv_min, const vec3& uv_max, double& alpha_min, double& alpha_max) const override {
+		alpha_min = 1;
+		alpha_max = 1;
+	}
+
+private:
+	double fetch(int row, int col) const {
+		return image.fetch_scalar(row, col) * 2 - 1;
+	}
+};
+
+#endif
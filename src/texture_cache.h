@@ -0,0 +1,451 @@
+#pragma once
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include "global.h"
+#include "texture.h"
+
+// 分块纹理
+// 大场景中纹理（包括mipmap）的总大小可能超过内存。这里把每个纹理的各个层级切成固定大小的分块存放在文件中，
+// 渲染时按需读取分块，所有纹理共用一个有内存上限的LRU缓存。
+// 超过上限时淘汰最久未使用的分块，之后用到时再从文件读取，渲染变慢但不会耗尽内存
+
+
+// 分块边长（texel），为4的倍数，块压缩格式的4x4块不会跨越分块
+constexpr int texture_tile_size = 64;
+
+// 纹理分块缓存的内存上限（字节），第一次使用缓存之前设置
+inline size_t texture_cache_budget = static_cast<size_t>(1) << 30;
+
+
+// 全局的纹理分块缓存
+// 分块的键由纹理编号与纹理内的分块编号组成
+// 按键的哈希分为多个分片，每个分片有自己的锁、LRU链表和内存上限（总上限 / 分片数），不同线程访问不同分片时不会争用
+// 读取文件在锁外进行，两个线程同时缺失同一个分块时可能各读一次，只保留先插入的那个
+class texture_tile_cache {
+public:
+	static constexpr int shard_num = 16;
+	using tile_ptr = shared_ptr<const texel_image>;
+
+	// 统计信息
+	std::atomic<uint64_t> hit_count{ 0 };
+	std::atomic<uint64_t> miss_count{ 0 };
+	std::atomic<uint64_t> evict_count{ 0 };
+
+private:
+	using lru_list = std::list<std::pair<uint64_t, tile_ptr>>;
+	struct shard {
+		std::mutex shard_mutex;
+		lru_list lru; // 表头为最近使用的分块
+		std::unordered_map<uint64_t, lru_list::iterator> index;
+		size_t bytes = 0;
+	};
+	shard shards[shard_num];
+	size_t shard_budget;
+
+public:
+	texture_tile_cache(size_t budget) {
+		shard_budget = budget / shard_num;
+	}
+
+	// 获取分块，不在缓存中时调用load()从文件读取
+	// 返回的分块由调用者共同持有，被淘汰后在调用者释放之前仍然有效
+	template <typename loader>
+	tile_ptr get(uint64_t key, loader load) {
+		shard& s = shards[shard_of(key)];
+		{
+			std::lock_guard<std::mutex> lock(s.shard_mutex);
+			auto itr = s.index.find(key);
+			if (itr != s.index.end()) {
+				s.lru.splice(s.lru.begin(), s.lru, itr->second);
+				hit_count.fetch_add(1, std::memory_order_relaxed);
+				return itr->second->second;
+			}
+		}
+
+		miss_count.fetch_add(1, std::memory_order_relaxed);
+		tile_ptr tile = load();
+
+		std::lock_guard<std::mutex> lock(s.shard_mutex);
+		auto itr = s.index.find(key);
+		if (itr != s.index.end()) { // 其它线程已经读取
+			s.lru.splice(s.lru.begin(), s.lru, itr->second);
+			return itr->second->second;
+		}
+		s.lru.emplace_front(key, tile);
+		s.index[key] = s.lru.begin();
+		s.bytes += tile->memory_size();
+
+		// 淘汰最久未使用的分块，至少保留刚读取的分块
+		while (s.bytes > shard_budget and s.lru.size() > 1) {
+			s.bytes -= s.lru.back().second->memory_size();
+			s.index.erase(s.lru.back().first);
+			s.lru.pop_back();
+			evict_count.fetch_add(1, std::memory_order_relaxed);
+		}
+		return tile;
+	}
+
+	// 缓存中分块占用的内存（字节）
+	size_t memory_size() {
+		size_t bytes = 0;
+		for (shard& s : shards) {
+			std::lock_guard<std::mutex> lock(s.shard_mutex);
+			bytes += s.bytes;
+		}
+		return bytes;
+	}
+
+private:
+	// 打乱键的各位，使同一纹理中相邻的分块落在不同的分片
+	static int shard_of(uint64_t key) {
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		return static_cast<int>(key % shard_num);
+	}
+};
+
+inline texture_tile_cache& texture_cache() {
+	static texture_tile_cache cache(texture_cache_budget);
+	return cache;
+}
+
+
+// 每个线程最近使用的分块，直接映射
+// 命中时不需要加锁，也不需要修改引用计数。bilinear插值的四个texel通常落在同一个分块中
+struct tile_micro_cache {
+	static constexpr int size = 16;
+	uint64_t keys[size];
+	texture_tile_cache::tile_ptr tiles[size];
+
+	tile_micro_cache() {
+		std::fill(keys, keys + size, std::numeric_limits<uint64_t>::max());
+	}
+};
+
+inline thread_local tile_micro_cache local_tile_cache;
+
+
+// 分块图像texture
+// 与color_map相同，使用mipmap与三线性插值，但texel不常驻内存
+// 第一次使用某个图像时生成分块文件（图像文件名加上存储格式与.tiles，如wall_d.jpg.rgba8.tiles），图像比分块文件新时重新生成
+// 分块文件的格式：9个uint32的文件头{magic, version, 分块边长, 存储格式, 请求的格式, 行数, 列数, 层级数, 是否完全不透明}，
+// 之后按层级、分块行、分块列的顺序存放每个分块的texel数据
+class tiled_color_map final : public texture {
+public:
+	// 层级0的行数和列数
+	int rows = 0, cols = 0;
+	// 放大倍数
+	double scale = 1;
+	// 分块的存储格式
+	texel_format format = texel_format::rgba8;
+	// 所有texel都不透明
+	bool opaque = true;
+
+private:
+	static constexpr uint32_t file_magic = 0x454c4954; // "TILE"
+	static constexpr uint32_t file_version = 2;
+
+	struct level_info {
+		int rows, cols;
+		int tiles_x, tiles_y;
+		uint64_t first_tile; // 该层级第一个分块的编号
+	};
+	std::vector<level_info> levels;
+	std::vector<uint64_t> tile_offsets; // 每个分块在文件中的位置，最后多存一个文件末尾的位置
+
+	std::string tile_path;
+	mutable std::ifstream file;
+	mutable std::mutex file_mutex;
+	uint32_t texture_id;
+
+	// 分块文件无法生成或读取时（例如资源目录只读），改为把整个纹理读入内存
+	std::unique_ptr<color_map> fallback;
+
+public:
+	// scale越大，纹理越密集
+	// format为存储格式：rgba8（默认）或bc1，HDR图像总是以rgba16f格式存储
+	tiled_color_map(const char file_name[], double scale_init = 1, texel_format format_init = texel_format::rgba8) {
+		static std::atomic<uint32_t> texture_count{ 0 };
+		texture_id = texture_count++;
+		scale = scale_init;
+		// 文件名包含请求的存储格式，同一个图像以不同格式使用时各自有一个分块文件
+		tile_path = std::string(file_name) + "." + texel_format_name(format_init) + ".tiles";
+
+		if (not (up_to_date(file_name) and load_header(format_init))) {
+			build(file_name, format_init);
+			if (not load_header(format_init)) {
+				std::cout << "warning in texture_cache.h: tiled_color_map::tiled_color_map(): cannot read " << tile_path << ", loading " << file_name << " into memory\n";
+				file.close();
+				levels.clear();
+				tile_offsets.clear();
+				fallback = std::make_unique<color_map>(file_name, scale_init, format_init);
+				rows = fallback->rows;
+				cols = fallback->cols;
+			}
+		}
+	}
+
+	virtual vec3 get_value(const vec3& uv) const override {
+		vec3 color;
+		double alpha;
+		get_rgba(uv, 0, color, alpha);
+		return color;
+	}
+
+	double get_alpha(const vec3& uv) const override {
+		vec3 color;
+		double alpha;
+		get_rgba(uv, 0, color, alpha);
+		return alpha;
+	}
+
+	// 三线性插值，与color_map::get_rgba相同
+	void get_rgba(const vec3& uv, double footprint, vec3& color, double& alpha) const override {
+		if (fallback) {
+			fallback->get_rgba(uv, footprint, color, alpha);
+			return;
+		}
+		double lod = mip_lod(footprint, scale, rows, cols);
+		int last = static_cast<int>(levels.size()) - 1;
+		if (lod == 0) {
+			get_rgba_level(0, uv, color, alpha);
+			return;
+		}
+		if (lod >= last) {
+			get_rgba_level(last, uv, color, alpha);
+			return;
+		}
+
+		int level = static_cast<int>(lod);
+		double t = lod - level;
+		vec3 color_1;
+		double alpha_1;
+		get_rgba_level(level, uv, color, alpha);
+		get_rgba_level(level + 1, uv, color_1, alpha_1);
+		color = color * (1 - t) + color_1 * t;
+		alpha = alpha * (1 - t) + alpha_1 * t;
+	}
+
+	// 在一个层级上双线性插值
+	void get_rgba_level(int level, const vec3& uv, vec3& color, double& alpha) const {
+		const level_info& info = levels[level];
+		bilinear_footprint f = get_bilinear_footprint(uv, scale, info.rows, info.cols);
+
+		vec3 c00, c01, c10, c11;
+		double a00, a01, a10, a11;
+		fetch_color(info, f.row_0, f.col_0, c00, a00);
+		fetch_color(info, f.row_0, f.col_1, c01, a01);
+		fetch_color(info, f.row_1, f.col_0, c10, a10);
+		fetch_color(info, f.row_1, f.col_1, c11, a11);
+
+		vec3 RGB_left = c10 * f.w_row_1 + c00 * f.w_row_0;
+		vec3 RGB_right = c11 * f.w_row_1 + c01 * f.w_row_0;
+		color = RGB_right * f.w_col_1 + RGB_left * f.w_col_0;
+
+		double alpha_left = a10 * f.w_row_1 + a00 * f.w_row_0;
+		double alpha_right = a11 * f.w_row_1 + a01 * f.w_row_0;
+		alpha = alpha_right * f.w_col_1 + alpha_left * f.w_col_0;
+	}
+
+	// 常驻内存的texel为0，分块都在全局缓存中
+	size_t memory_size() const override {
+		return fallback ? fallback->memory_size() : 0;
+	}
+
+	// 与color_map::alpha_range相同，只读取包围盒覆盖的分块
+	void alpha_range(const vec3& uv_min, const vec3& uv_max, double& alpha_min, double& alpha_max) const override {
+		if (fallback) {
+			fallback->alpha_range(uv_min, uv_max, alpha_min, alpha_max);
+			return;
+		}
+		if (opaque) {
+			alpha_min = 1;
+			alpha_max = 1;
+			return;
+		}
+		int row_begin, row_end, col_begin, col_end;
+		bilinear_texel_range(uv_min[1], uv_max[1], scale, rows, row_begin, row_end);
+		bilinear_texel_range(uv_min[0], uv_max[0], scale, cols, col_begin, col_end);
+		alpha_min = 1;
+		alpha_max = 0;
+		vec3 color;
+		double alpha;
+		for (int i = row_begin; i <= row_end; i++) {
+			for (int j = col_begin; j <= col_end; j++) {
+				fetch_color(levels[0], i, j, color, alpha);
+				alpha_min = std::min(alpha_min, alpha);
+				alpha_max = std::max(alpha_max, alpha);
+			}
+		}
+	}
+
+	// 分块文件中texel数据的总大小（字节），包括所有层级
+	size_t file_size() const {
+		if (tile_offsets.empty()) return 0;
+		return tile_offsets.back() - tile_offsets.front();
+	}
+
+private:
+	// 读取一个texel，先查线程的分块缓存，再查全局缓存，都没有时从文件读取
+	void fetch_color(const level_info& info, int row, int col, vec3& color, double& alpha) const {
+		int tile_row = row / texture_tile_size, tile_col = col / texture_tile_size;
+		uint64_t tile_index = info.first_tile + static_cast<uint64_t>(tile_row) * info.tiles_x + tile_col;
+		uint64_t key = (static_cast<uint64_t>(texture_id) << 40) | tile_index;
+
+		tile_micro_cache& micro = local_tile_cache;
+		int slot = static_cast<int>((tile_index ^ (static_cast<uint64_t>(texture_id) * 7)) % tile_micro_cache::size);
+		if (micro.keys[slot] != key) {
+			micro.tiles[slot] = texture_cache().get(key, [&]() { return read_tile(info, tile_row, tile_col, tile_index); });
+			micro.keys[slot] = key;
+		}
+		micro.tiles[slot]->fetch_color(row - tile_row * texture_tile_size, col - tile_col * texture_tile_size, color, alpha);
+	}
+
+	// 从文件读取一个分块
+	texture_tile_cache::tile_ptr read_tile(const level_info& info, int tile_row, int tile_col, uint64_t tile_index) const {
+		int tile_rows = std::min(texture_tile_size, info.rows - tile_row * texture_tile_size);
+		int tile_cols = std::min(texture_tile_size, info.cols - tile_col * texture_tile_size);
+		std::vector<uint8_t> bytes(tile_offsets[tile_index + 1] - tile_offsets[tile_index]);
+		{
+			std::lock_guard<std::mutex> lock(file_mutex);
+			file.clear();
+			file.seekg(static_cast<std::streamoff>(tile_offsets[tile_index]));
+			if (not file.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) {
+				std::cout << "error in texture_cache.h: tiled_color_map::read_tile(): cannot read tile " << tile_index << " of " << tile_path << '\n';
+				std::fill(bytes.begin(), bytes.end(), 0);
+			}
+		}
+		shared_ptr<texel_image> tile = make_shared<texel_image>();
+		tile->assign(bytes.data(), tile_rows, tile_cols, format);
+		return tile;
+	}
+
+	// 分块文件存在且不比图像旧
+	bool up_to_date(const char file_name[]) const {
+		std::error_code ec_image, ec_tile;
+		auto image_time = std::filesystem::last_write_time(file_name, ec_image);
+		auto tile_time = std::filesystem::last_write_time(tile_path, ec_tile);
+		if (ec_tile) return false;
+		return ec_image or tile_time >= image_time; // 图像不存在时直接使用分块文件
+	}
+
+	// 读取文件头，计算每个层级与分块的位置
+	// 请求的格式与文件中的不同时返回false，需要重新生成
+	bool load_header(texel_format format_requested) {
+		file.close();
+		file.clear();
+		file.open(tile_path, std::ios::binary);
+		if (not file) return false;
+		uint32_t header[9];
+		if (not file.read(reinterpret_cast<char*>(header), sizeof(header))) return false;
+		if (header[0] != file_magic or header[1] != file_version or header[2] != texture_tile_size
+			or header[4] != static_cast<uint32_t>(format_requested)) return false;
+		format = static_cast<texel_format>(header[3]);
+		rows = static_cast<int>(header[5]);
+		cols = static_cast<int>(header[6]);
+		int level_num = static_cast<int>(header[7]);
+		opaque = header[8] != 0;
+
+		levels.clear();
+		tile_offsets.assign(1, sizeof(header));
+		int level_rows = rows, level_cols = cols;
+		for (int level = 0; level < level_num; level++) {
+			level_info info;
+			info.rows = level_rows;
+			info.cols = level_cols;
+			info.tiles_x = (level_cols + texture_tile_size - 1) / texture_tile_size;
+			info.tiles_y = (level_rows + texture_tile_size - 1) / texture_tile_size;
+			info.first_tile = tile_offsets.size() - 1;
+			for (int ty = 0; ty < info.tiles_y; ty++) {
+				for (int tx = 0; tx < info.tiles_x; tx++) {
+					int tile_rows = std::min(texture_tile_size, level_rows - ty * texture_tile_size);
+					int tile_cols = std::min(texture_tile_size, level_cols - tx * texture_tile_size);
+					tile_offsets.push_back(tile_offsets.back() + texel_image::storage_size(tile_rows, tile_cols, format));
+				}
+			}
+			levels.push_back(info);
+			level_rows = (level_rows + 1) / 2;
+			level_cols = (level_cols + 1) / 2;
+		}
+		// 文件被截断时（例如生成过程中被外部中断）重新生成，仍然无法读取时由构造函数改为读入内存
+		std::error_code ec;
+		uintmax_t size = std::filesystem::file_size(tile_path, ec);
+		if (ec or size < tile_offsets.back()) return false;
+		return level_num > 0;
+	}
+
+	// 读取图像，生成mipmap并逐个分块写入文件
+	// 先写到本线程的临时文件（见unique_temp_path），完成后再重命名，中断或多个线程、进程同时生成时不会留下不完整的分块文件
+	void build(const char file_name[], texel_format format_requested) {
+		int image_rows, image_cols;
+		std::vector<uint8_t> pixels;
+		std::vector<float> pixels_hdr;
+		int channels = read_color_image(file_name, image_rows, image_cols, pixels, pixels_hdr);
+		texel_format tile_format = pixels_hdr.size() > 0 ? texel_format::rgba16f : color_format(pixels, channels, format_requested);
+
+		file.close();
+		std::string temp_path = unique_temp_path(tile_path);
+		std::ofstream out(temp_path, std::ios::binary);
+		if (not out) return; // 无法写入时由构造函数改为读入内存
+		int level_num = 0;
+		for (int r = image_rows, c = image_cols; ; r = (r + 1) / 2, c = (c + 1) / 2) {
+			level_num++;
+			if (r <= 1 and c <= 1) break;
+		}
+		bool image_opaque = true;
+		if (channels == 4) {
+			for (size_t t = 3; t < pixels.size(); t += 4) image_opaque = image_opaque and pixels[t] == 255;
+			for (size_t t = 3; t < pixels_hdr.size(); t += 4) image_opaque = image_opaque and pixels_hdr[t] >= 1;
+		}
+		uint32_t header[9] = { file_magic, file_version, texture_tile_size, static_cast<uint32_t>(tile_format),
+			static_cast<uint32_t>(format_requested), static_cast<uint32_t>(image_rows), static_cast<uint32_t>(image_cols), static_cast<uint32_t>(level_num),
+			static_cast<uint32_t>(image_opaque) };
+		out.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+		auto write_level = [&](int level, const auto& level_pixels, int level_rows, int level_cols) {
+			using pixel_type = typename std::decay_t<decltype(level_pixels)>::value_type;
+			std::vector<pixel_type> tile_pixels;
+			texel_image tile;
+			for (int ty = 0; ty * texture_tile_size < level_rows; ty++) {
+				for (int tx = 0; tx * texture_tile_size < level_cols; tx++) {
+					int tile_rows = std::min(texture_tile_size, level_rows - ty * texture_tile_size);
+					int tile_cols = std::min(texture_tile_size, level_cols - tx * texture_tile_size);
+					tile_pixels.resize(static_cast<size_t>(tile_rows) * tile_cols * channels);
+					for (int i = 0; i < tile_rows; i++) {
+						const pixel_type* in = level_pixels.data() + (static_cast<size_t>(ty * texture_tile_size + i) * level_cols + tx * texture_tile_size) * channels;
+						std::copy(in, in + static_cast<size_t>(tile_cols) * channels, tile_pixels.data() + static_cast<size_t>(i) * tile_cols * channels);
+					}
+					create_texels(tile, tile_pixels, tile_rows, tile_cols, channels, tile_format);
+					out.write(reinterpret_cast<const char*>(tile.bytes()), tile.memory_size());
+				}
+			}
+		};
+		if (pixels_hdr.size() > 0) {
+			for_each_mip_level(pixels_hdr, image_rows, image_cols, channels, write_level);
+		}
+		else {
+			for_each_mip_level(pixels, image_rows, image_cols, channels, write_level);
+		}
+		out.close();
+
+		std::error_code ec;
+		if (not out) { // 写入失败（如磁盘已满），不使用不完整的文件
+			std::filesystem::remove(temp_path, ec);
+			return;
+		}
+		std::filesystem::rename(temp_path, tile_path, ec);
+		if (ec) std::filesystem::remove(temp_path, ec);
+	}
+};
+
+#endif
@@ -1,7 +1,48 @@
-#pragma once
-#ifndef TRANSFORM_H
-#define TRANSFORM_H
-
-#include "vec3.h"
-
-#endif
\ No newline at end of file
+#pragma once
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "vec3.h"
+
+// 网格顶点的变换：先缩放，再依次绕x,y,z轴旋转，最后平移
+// 结果与依次调用vec3::scale、rotate、translate相同，旋转角的正弦与余弦只在构造时计算一次，用于变换大量顶点
+struct vertex_transform {
+	vec3 scale_vec;
+	vec3 inverse_scale_vec; // 法线的缩放是顶点缩放的逆
+	vec3 translate_vec;
+	double cos_r[3], sin_r[3];
+
+	vertex_transform(const vec3& scale_init, const vec3& rotate_vec, const vec3& translate_init)
+		: scale_vec(scale_init), translate_vec(translate_init) {
+		inverse_scale_vec = vec3(1 / scale_vec[0], 1 / scale_vec[1], 1 / scale_vec[2]);
+		for (int i = 0; i < 3; i++) {
+			cos_r[i] = cos(rotate_vec[i]);
+			sin_r[i] = sin(rotate_vec[i]);
+		}
+	}
+
+	// 与vec3::rotate的计算顺序相同
+	vec3 rotate(vec3 p) const {
+		p[1] = cos_r[0] * p[1] - sin_r[0] * p[2];
+		p[2] = sin_r[0] * p[1] + cos_r[0] * p[2];
+		p[0] = cos_r[1] * p[0] + sin_r[1] * p[2];
+		p[2] = -sin_r[1] * p[0] + cos_r[1] * p[2];
+		p[0] = cos_r[2] * p[0] - sin_r[2] * p[1];
+		p[1] = sin_r[2] * p[0] + cos_r[2] * p[1];
+		return p;
+	}
+
+	// 变换顶点位置
+	vec3 point(const float* p) const {
+		vec3 result(p[0], p[1], p[2]);
+		return rotate(result.scale(scale_vec)).translate(translate_vec);
+	}
+
+	// 变换法线，不使用平移
+	vec3 normal(const float* n) const {
+		vec3 result(n[0], n[1], n[2]);
+		return rotate(result.scale(inverse_scale_vec));
+	}
+};
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef TRANSMITTANCE_H
+#define TRANSMITTANCE_H
+
+#include "global.h"
+#include "hittable.h"
+#include "material.h"
+
+
+// 光线经过表面后所在的介质
+// current为wo一侧（光线到达表面之前）的介质；wi与wo在同一侧时介质不变，否则切换为材质在wi一侧的介质
+inline const medium* medium_after(const material& mat, const medium* current, bool wo_front, bool wi_front) {
+	if (wi_front == wo_front) return current;
+	return wi_front ? mat.get_medium_outside_ptr() : mat.get_medium_inside_ptr();
+}
+
+// 光线在alpha测试中穿过表面后所在的介质
+// 介质边界切换到另一侧的介质；普通的镂空表面（如雾中的树叶）不改变光线所在的介质
+inline const medium* medium_after_pass_through(const material& mat, const medium* current, bool front_face) {
+	if (not mat.is_medium_boundary()) return current;
+	return medium_after(mat, current, front_face, not front_face);
+}
+
+
+// 从p0到p1的透射率，med为p0处的介质
+// 完全透明（alpha为0）的表面被穿过，只有介质边界切换介质；其他表面完全遮挡
+// 求交时已经完成alpha测试的交点（见opacity_micromap.h）直接遮挡，透明部分在求交时已经穿过
+// 没有参与介质时结果与原来的阴影光线相同，只是不再被介质边界遮挡
+vec3 shadow_transmittance(const point3& p0, const point3& p1, const medium* med, const shared_ptr<hittable>& world) {
+	vec3 T(1, 1, 1);
+	point3 o = p0;
+	for (int k = 0; k < 64; k++) {
+		vec3 d = p1 - o;
+		double distance = d.length();
+		vec3 dir = d / distance;
+
+		hit_record rec;
+		bool blocked = world->hit(ray(o, dir, med), 0.000001, infinity, rec) and rec.t < distance;
+		if (med and med->is_participating()) T = T * med->transmittance(o, dir, blocked ? rec.t : distance);
+		if (not blocked) return T;
+		if (rec.alpha_resolved or rec.mat_ptr()->get_color_map_ptr()->get_alpha(rec.uv) > 0) return vec3(0, 0, 0);
+
+		med = medium_after_pass_through(*rec.mat_ptr(), med, rec.front_face);
+		o = rec.p;
+	}
+	return vec3(0, 0, 0);
+}
+
+#endif
@@ -1,152 +1,260 @@
-#pragma once
-#ifndef TRIANGLE_H
-#define TRIANGLE_H
-
-#include <array>
-#include "hittable.h"
-#include "vec3.h"
-#include "material.h"
-#include "texture.h"
-using std::array;
-
-
-class triangle : public hittable {
-public:
-	vec3 vertex[3]; // 
-	vec3 uv[3]; // ռ꣬ʹxyΪuv
-	shared_ptr<material> mat_ptr; // material
-	vec3 vertex_normal[3]; // 㷨
-	vec3 tangent; // ߡʵַͼʱҪõϢ
-
-public:
-	// ʹλúͷԼһmaterialʼ
-	triangle(const vec3& vertex_1, const vec3& vertex_2, const vec3& vertex_3,
-		const shared_ptr<material>& mat_ptr_all,
-		const vec3& uv_1, const vec3& uv_2, const vec3& uv_3,
-		const vec3& vertex_normal_1, const vec3& vertex_normal_2, const vec3& vertex_normal_3) {
-
-		// û
-		vertex[0] = vertex_1;
-		vertex[1] = vertex_2;
-		vertex[2] = vertex_3;
-
-		mat_ptr = mat_ptr_all;
-
-		uv[0] = uv_1;
-		uv[1] = uv_2;
-		uv[2] = uv_3;
-
-		// ֱӼ¼Ķ㷨
-		vertex_normal[0] = vertex_normal_1;
-		vertex_normal[1] = vertex_normal_2;
-		vertex_normal[2] = vertex_normal_3;
-
-		// 
-		// ԭԲοzhuanlan.zhihu.com/p/414940275
-		vec3 AB = vertex[1] - vertex[0];
-		vec3 AC = vertex[2] - vertex[0];
-		double du1 = uv[2][0] - uv[0][0];
-		double du2 = uv[1][0] - uv[0][0];
-		double dv1 = uv[2][1] - uv[0][1];
-		double dv2 = uv[1][1] - uv[0][1];
-		// õߣδ
-		double tmp = du2 * dv1 - du1 * dv2;
-		if (tmp != 0) {
-			tangent = (dv1 * AB - dv2 * AC) / tmp;
-			tangent = unit_vector(tangent);
-		}
-		else {
-			tangent = unit_vector(AC);
-		}
-	}
-
-	// ʹλã޷ߣԼһmaterialʼ
-	triangle(const vec3& vertex_1, const vec3& vertex_2, const vec3& vertex_3,
-		const shared_ptr<material>& mat_ptr_all) {
-
-		// û
-		vertex[0] = vertex_1;
-		vertex[1] = vertex_2;
-		vertex[2] = vertex_3;
-
-		mat_ptr = mat_ptr_all;
-
-		// ֧uv
-		uv[0] = vec3(0, 0, 0);
-		uv[1] = vec3(0, 0, 0);
-		uv[2] = vec3(0, 0, 0);
-
-		// ݶλü㷨ߣϵ
-		vertex_normal[0] = unit_vector(cross(vertex[1] - vertex[0], vertex[2] - vertex[0]));
-		vertex_normal[1] = vertex_normal[0];
-		vertex_normal[2] = vertex_normal[0];
-
-		// ù캯֧uvò˷ͼԲҪ
-		tangent = vec3(0, 0, 0);
-	}
-
-	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override {
-		// tԼ꣬ͬʱжϹǷཻ
-		// 0,1,2ȨطֱΪ(1-b1-b2),b1,b2
-		vec3 E1 = vertex[1] - vertex[0];
-		vec3 E2 = vertex[2] - vertex[0];
-		vec3 S = r.orig - vertex[0];
-		vec3 S1 = cross(r.dir, E2);
-		vec3 S2 = cross(S, E1);
-		double S1E1_inv = 1 / dot(S1, E1);
-		double t = dot(S2, E2) * S1E1_inv;
-		if (t < t_min or t > t_max) return false; // t趨Χ֮Ϊûн
-		double b1 = dot(S1, S) * S1E1_inv;
-		double b2 = dot(S2, r.dir) * S1E1_inv;
-		if (b1 < 0 or b2 < 0 or b1 + b2 > 1) return false; // Ҳ޽
-
-		// 
-		double w0 = 1 - b1 - b2;
-		double w1 = std::move(b1);
-		double w2 = std::move(b2);
-
-		// ¼
-		rec.t = t;
-
-		// 㽻
-		rec.p = r.orig + t * r.dir;
-
-		// uv
-		rec.uv = w0 * uv[0] + w1 * uv[1] + w2 * uv[2];
-
-		// 㷨ߣ
-		// ʹƽɫݶ㷨ֵ߲õshading point
-		vec3 normal = w0 * vertex_normal[0] + w1 * vertex_normal[1] + w2 * vertex_normal[2];
-		normal = unit_vector(normal);
-
-		// ڷͼʹ÷ͼԷ߽д
-		if (mat_ptr->get_normal_map_ptr() != nullptr) {
-			// ݳԱtangentҵλ߻
-			vec3 basis_t = unit_vector(tangent - dot(tangent, normal) * normal);
-			// 㸱߻
-			vec3 basis_b = cross(normal, basis_t);
-			// ӷͼȡ߿ռ
-			vec3 tangent_coord = mat_ptr->get_normal_map_ptr()->get_value(rec.uv);
-			// 㷨
-			vec3 normal_old = normal;
-			normal = basis_t * tangent_coord[0] + basis_b * tangent_coord[1] + normal * tangent_coord[2];
-		}
-
-		rec.set_face_normal(r, normal);
-
-		// textureеmaterial޸
-		rec.mat_ptr = mat_ptr;
-
-		return true;
-	}
-
-	virtual bounds3 bounds() const override {
-		bounds3 ret(vertex[0], vertex[1]);
-		ret = Union(ret, vertex[2]);
-
-		// ΪοܺƽƽУԽΧһ㣬׵󽻽ضΪfalse
-		return Expand(ret, 0.00000001);
-	}
-};
-
+#pragma once
+#ifndef TRIANGLE_H
+#define TRIANGLE_H
+
+#include <array>
+#include "hittable.h"
+#include "vec3.h"
+#include "material.h"
+#include "texture.h"
+#include "opacity_micromap.h"
+using std::array;
+
+
+// 三角形的几何数据
+// 可以直接按字节复制，网格快照（见scene_snapshot.h）把它原样写入文件，读取时直接使用映射的数据
+struct triangle_data {
+	vec3 vertex[3]; // 顶点坐标
+	vec3 uv[3]; // 纹理空间坐标，使用xy项作为uv
+	vec3 vertex_normal[3]; // 顶点法线
+	vec3 tangent; // 切线。实现法线贴图时需要用到该信息
+	double uv_density = 0; // sqrt(uv面积 / 三角形面积)，用于从光锥宽度计算纹理足迹
+	// 求交时完成alpha测试。材质是介质边界时为false，透明的表面也需要返回交点，由积分器处理穿透与介质切换
+	bool alpha_in_traversal = false;
+	opacity_state omm_state = opacity_state::opaque; // 所有微三角形的状态相同时为该状态，否则为unknown
+	opacity_micromap omm; // 不透明度微图
+};
+
+
+// 光线与三角形求交，triangle与网格快照共用
+inline bool hit_triangle(const triangle_data& tri, uint32_t mat_id, uint32_t prim_id, const ray& r, double t_min, double t_max, hit_record& rec) {
+	// 完全透明的三角形在遍历中剔除
+	if (tri.omm_state == opacity_state::transparent) return false;
+
+	// 计算t以及重心坐标，同时判断光线与三角形是否相交
+	// 顶点0,1,2的权重分别为(1-b1-b2),b1,b2
+	const vec3* vertex = tri.vertex;
+	vec3 E1 = vertex[1] - vertex[0];
+	vec3 E2 = vertex[2] - vertex[0];
+	vec3 S = r.orig - vertex[0];
+	vec3 S1 = cross(r.dir, E2);
+	vec3 S2 = cross(S, E1);
+	double S1E1_inv = 1 / dot(S1, E1);
+	double t = dot(S2, E2) * S1E1_inv;
+	if (t < t_min or t > t_max) return false; // t在设定范围之外则认为没有交点
+	double b1 = dot(S1, S) * S1E1_inv;
+	double b2 = dot(S2, r.dir) * S1E1_inv;
+	if (b1 < 0 or b2 < 0 or b1 + b2 > 1) return false; // 交点在三角形外也无交点
+
+	// 将重心坐标存入三个变量中
+	double w0 = 1 - b1 - b2;
+	double w1 = std::move(b1);
+	double w2 = std::move(b2);
+
+	// 不透明度微图：完全透明的微三角形剔除，未知的区域读取alpha，按alpha随机决定是否穿过
+	// 穿过时返回false，遍历继续寻找后面的交点，积分器不需要再处理透明
+	const vec3* uv = tri.uv;
+	if (tri.omm_state == opacity_state::unknown) {
+		opacity_state state = tri.omm.get(opacity_micromap::micro_index(w1, w2));
+		if (state == opacity_state::transparent) return false;
+		if (state == opacity_state::unknown) {
+			vec3 uv_hit = w0 * uv[0] + w1 * uv[1] + w2 * uv[2];
+			if (random_double() > scene_materials.get(mat_id)->get_color_map_ptr()->get_alpha(uv_hit)) return false;
+		}
+	}
+
+	// 记录距离
+	rec.t = t;
+
+	// 计算交点坐标
+	rec.p = r.orig + t * r.dir;
+
+	// 计算uv
+	rec.uv = w0 * uv[0] + w1 * uv[1] + w2 * uv[2];
+
+	// 计算法线，
+	// 这里使用平滑着色，根据顶点法线插值得到shading point法线
+	vec3 normal = w0 * tri.vertex_normal[0] + w1 * tri.vertex_normal[1] + w2 * tri.vertex_normal[2];
+	normal = unit_vector(normal);
+
+	// 法线贴图在着色时才计算（见material.h中的apply_normal_map），这里只记录切线
+	rec.tangent = tri.tangent;
+	rec.uv_density = tri.uv_density;
+	rec.alpha_resolved = tri.alpha_in_traversal;
+
+	rec.set_face_normal(r, normal);
+
+	// 计算texture中的material参数并修改
+	rec.mat_id = mat_id;
+	rec.prim_id = prim_id;
+
+	return true;
+}
+
+// 三角形的包围盒
+inline bounds3 triangle_bounds(const triangle_data& tri) {
+	bounds3 ret(tri.vertex[0], tri.vertex[1]);
+	ret = Union(ret, tri.vertex[2]);
+
+	// 因为三角形可能和坐标平面平行，所以将包围盒扩大一点，否则容易导致求交结果必定为false
+	return Expand(ret, 0.00000001);
+}
+
+
+// 由顶点位置、uv与顶点法线填写三角形数据，并计算切线与uv密度
+// 不透明度微图与材质有关，由init_opacity_micromap设置
+inline void init_triangle_data(triangle_data& tri, const vec3& vertex_1, const vec3& vertex_2, const vec3& vertex_3,
+	const vec3& uv_1, const vec3& uv_2, const vec3& uv_3,
+	const vec3& vertex_normal_1, const vec3& vertex_normal_2, const vec3& vertex_normal_3) {
+
+	// 设置基本参数
+	tri.vertex[0] = vertex_1;
+	tri.vertex[1] = vertex_2;
+	tri.vertex[2] = vertex_3;
+
+	tri.uv[0] = uv_1;
+	tri.uv[1] = uv_2;
+	tri.uv[2] = uv_3;
+
+	// 直接记录传入的顶点法线
+	tri.vertex_normal[0] = vertex_normal_1;
+	tri.vertex_normal[1] = vertex_normal_2;
+	tri.vertex_normal[2] = vertex_normal_3;
+
+	// 计算切线
+	// 原理可以参考zhuanlan.zhihu.com/p/414940275
+	vec3 AB = tri.vertex[1] - tri.vertex[0];
+	vec3 AC = tri.vertex[2] - tri.vertex[0];
+	double du1 = tri.uv[2][0] - tri.uv[0][0];
+	double du2 = tri.uv[1][0] - tri.uv[0][0];
+	double dv1 = tri.uv[2][1] - tri.uv[0][1];
+	double dv2 = tri.uv[1][1] - tri.uv[0][1];
+	// 得到切线（未正交化）
+	double tmp = du2 * dv1 - du1 * dv2;
+	if (tmp != 0) {
+		tri.tangent = (dv1 * AB - dv2 * AC) / tmp;
+		tri.tangent = unit_vector(tri.tangent);
+	}
+	else {
+		tri.tangent = unit_vector(AC);
+	}
+
+	// uv面积与三角形面积之比（两个面积都省略了1/2）
+	double area = cross(AB, AC).length();
+	tri.uv_density = area > 0 ? sqrt(std::abs(tmp) / area) : 0;
+}
+
+// 生成不透明度微图，纹理还在加载时会等待
+// 每个微三角形的状态由其uv包围盒内的alpha范围决定：最小值为1时不透明，最大值为0时透明，否则未知
+inline void build_opacity_micromap(triangle_data& tri, const material* mat_ptr) {
+	if (not tri.alpha_in_traversal) return;
+
+	const texture* color_map_ptr = mat_ptr->get_color_map_ptr();
+	tri.omm = opacity_micromap::build([&](const vec3 b[3]) {
+		vec3 uv_min(infinity, infinity, 0), uv_max(-infinity, -infinity, 0);
+		for (int k = 0; k < 3; k++) {
+			vec3 uv_k = (1 - b[k][0] - b[k][1]) * tri.uv[0] + b[k][0] * tri.uv[1] + b[k][1] * tri.uv[2];
+			for (int c = 0; c < 2; c++) {
+				uv_min[c] = std::min(uv_min[c], uv_k[c]);
+				uv_max[c] = std::max(uv_max[c], uv_k[c]);
+			}
+		}
+		double alpha_min, alpha_max;
+		color_map_ptr->alpha_range(uv_min, uv_max, alpha_min, alpha_max);
+		if (alpha_min >= 1) return opacity_state::opaque;
+		if (alpha_max <= 0) return opacity_state::transparent;
+		return opacity_state::unknown;
+	});
+	tri.omm_state = tri.omm.uniform_state();
+}
+
+// 按材质设置alpha测试的方式，纹理已经可用时直接生成微图，否则推迟（不等待图像解码）
+// 推迟时所有微三角形为未知（每次击中都做alpha测试，结果正确但较慢），返回true，之后由build_opacity_micromap生成
+inline bool init_opacity_micromap(triangle_data& tri, const material* mat_ptr) {
+	tri.alpha_in_traversal = mat_ptr and not mat_ptr->is_medium_boundary();
+	if (not tri.alpha_in_traversal) return false;
+	if (mat_ptr->get_color_map_ptr()->loaded()) {
+		build_opacity_micromap(tri, mat_ptr);
+		return false;
+	}
+	tri.omm = opacity_micromap::build([](const vec3 b[3]) { return opacity_state::unknown; });
+	tri.omm_state = opacity_state::unknown;
+	return true;
+}
+
+
+class triangle : public hittable, public triangle_data {
+public:
+	uint32_t mat_id = 0; // 材质编号
+	uint32_t prim_id = 0; // 图元编号
+	// 构造时材质的纹理还在异步加载，微图尚未生成
+	// 由加载完成后的任务调用build_opacity_micromap生成，见bvh_node.h中的add_async与generate_bvh
+	bool omm_pending = false;
+
+public:
+	// 使用三个顶点的位置和法线以及一个material初始化
+	triangle(const vec3& vertex_1, const vec3& vertex_2, const vec3& vertex_3,
+		const shared_ptr<material>& mat_ptr_all,
+		const vec3& uv_1, const vec3& uv_2, const vec3& uv_3,
+		const vec3& vertex_normal_1, const vec3& vertex_normal_2, const vec3& vertex_normal_3) {
+		init_triangle_data(*this, vertex_1, vertex_2, vertex_3, uv_1, uv_2, uv_3, vertex_normal_1, vertex_normal_2, vertex_normal_3);
+		mat_id = scene_materials.add(mat_ptr_all);
+		prim_id = new_primitive_id();
+		omm_pending = init_opacity_micromap(*this, mat_ptr_all.get());
+	}
+
+	// 使用三个顶点的位置（无法线）以及一个material初始化
+	triangle(const vec3& vertex_1, const vec3& vertex_2, const vec3& vertex_3,
+		const shared_ptr<material>& mat_ptr_all) {
+
+		// 设置基本参数
+		vertex[0] = vertex_1;
+		vertex[1] = vertex_2;
+		vertex[2] = vertex_3;
+
+		mat_id = scene_materials.add(mat_ptr_all);
+		prim_id = new_primitive_id();
+
+		// 不支持uv
+		uv[0] = vec3(0, 0, 0);
+		uv[1] = vec3(0, 0, 0);
+		uv[2] = vec3(0, 0, 0);
+
+		// 根据顶点位置计算法线（右手系）
+		vertex_normal[0] = unit_vector(cross(vertex[1] - vertex[0], vertex[2] - vertex[0]));
+		vertex_normal[1] = vertex_normal[0];
+		vertex_normal[2] = vertex_normal[0];
+
+		// 该构造函数不支持uv，所以用不了法线贴图，所以不需要计算切线
+		tangent = vec3(0, 0, 0);
+
+		omm_pending = init_opacity_micromap(*this, mat_ptr_all.get());
+	}
+
+	// 由已经填写的三角形数据初始化（见mesh_triangle::unpack_faces）
+	triangle(const triangle_data& data, const shared_ptr<material>& mat_ptr_all) : triangle_data(data) {
+		mat_id = scene_materials.add(mat_ptr_all);
+		prim_id = new_primitive_id();
+		omm_pending = init_opacity_micromap(*this, mat_ptr_all.get());
+	}
+
+	virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override {
+		return hit_triangle(*this, mat_id, prim_id, r, t_min, t_max, rec);
+	}
+
+	virtual material* get_material() const override {
+		return scene_materials.get(mat_id);
+	}
+
+	// 生成推迟的不透明度微图，纹理还在加载时会等待
+	void build_opacity_micromap() {
+		omm_pending = false;
+		::build_opacity_micromap(*this, scene_materials.get(mat_id));
+	}
+
+	virtual bounds3 bounds() const override {
+		return triangle_bounds(*this);
+	}
+};
+
 #endif
\ No newline at end of file